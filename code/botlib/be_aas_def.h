@@ -143,6 +143,21 @@ typedef struct aas_routingcache_s
 	unsigned short int traveltimes[1];			//travel time for every area (variable sized)
 } aas_routingcache_t;
 
+//precomputed route table with the travel times of all the area and portal
+//caches for one combination of travel flags
+typedef struct aas_routetable_s
+{
+	const byte *data;							//mapped or loaded route table file
+	int size;									//size of the route table file
+	qboolean mapped;							//true if the file is memory mapped
+	int travelflags;							//travel flags the table is created for
+	int portalrowsize;							//size of the portal table of one area
+	const byte **clusterrows;					//area tables of every cluster
+	const byte *portalrows;						//portal tables of every area
+	int *clusterdisabledareas;					//number of disabled areas per cluster
+	int numdisabledareas;						//total number of disabled areas
+} aas_routetable_t;
+
 //fields for the routing algorithm
 typedef struct aas_routingupdate_s
 {
@@ -152,10 +167,34 @@ typedef struct aas_routingupdate_s
 	unsigned short int tmptraveltime;			//temporary travel time
 	unsigned short int *areatraveltimes;		//travel times within the area
 	qboolean inlist;							//true if the update is in the list
+	int heapindex;								//index in the routing update heap
 	struct aas_routingupdate_s *next;
 	struct aas_routingupdate_s *prev;
 } aas_routingupdate_t;
 
+//number of routing cache shards, power of two
+#define MAX_ROUTINGSHARDS		8
+
+//routing cache shard, the area lock guards the area cache lists of the
+//clusters in the shard and the portal lock the portal cache lists of the
+//areas in the shard, the routing update fields are used to fill the caches
+//of the shard while holding the matching lock
+typedef struct aas_routingshard_s
+{
+	void *arealock;
+	void *portallock;
+	aas_routingupdate_t *areaupdate;
+	aas_routingupdate_t *portalupdate;
+	//binary heaps on travel time with pending routing updates
+	aas_routingupdate_t **areaupdateheap;
+	aas_routingupdate_t **portalupdateheap;
+	//routing cache statistics
+	unsigned int numareacachehits;				//area cache lookups finding the cache
+	unsigned int numareacachemisses;			//area cache lookups creating the cache
+	unsigned int numportalcachehits;			//portal cache lookups finding the cache
+	unsigned int numportalcachemisses;			//portal cache lookups creating the cache
+} aas_routingshard_t;
+
 //reversed reachability link
 typedef struct aas_reversedlink_s
 {
@@ -247,9 +286,13 @@ typedef struct aas_s
 	int travelflagfortype[MAX_TRAVELTYPES];
 	//travel flags for each area based on contents
 	int *areacontentstravelflags;
-	//routing update
-	aas_routingupdate_t *areaupdate;
-	aas_routingupdate_t *portalupdate;
+	//routing cache shards with the routing update fields, only the first
+	//shard is used unless routing from several threads at once
+	aas_routingshard_t routingshards[MAX_ROUTINGSHARDS];
+	//lock of the cache list sorted on time and the routing cache size
+	void *routingcachelock;
+	//true while routing from several threads at once
+	int parallelrouting;
 	//number of routing updates during a frame (reset every frame)
 	int frameroutingupdates;
 	//reversed reachability links
@@ -262,6 +305,8 @@ typedef struct aas_s
 	//cache list sorted on time
 	aas_routingcache_t *oldestcache;		// start of cache list sorted on time
 	aas_routingcache_t *newestcache;		// end of cache list sorted on time
+	//precomputed travel times used instead of the cache when available
+	aas_routetable_t routetable;
 	//maximum travel time through portal areas
 	int *portalmaxtraveltimes;
 	//areas the reachabilities go through
@@ -79,11 +79,25 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 #ifdef ROUTING_DEBUG
 int numareacacheupdates;
 int numportalcacheupdates;
+int numareacacherepairs;
 #endif //ROUTING_DEBUG
 
 int routingcachesize;
 int max_routingcachesize;
 
+//routing cache size above which the least recently used cache is freed
+#define ROUTINGCACHE_HIGHWATER		(12 * 1024 * 1024)
+
+//routing cache statistics
+static int peak_routingcachesize;			//largest routing cache size
+static unsigned int numroutetablelookups;	//lookups served by the route table, not counted in parallel
+static unsigned int numcacheevictions;		//least recently used caches freed
+static int routingcachestatstime;			//time the statistics were reset
+
+//travel times within the start area of an area cache update, always zero
+//NOTE: not more than 128 reachabilities per area allowed
+static unsigned short int startareatraveltimes[128];
+
 //===========================================================================
 //
 // Parameter:			-
@@ -95,10 +109,104 @@ void AAS_RoutingInfo(void)
 {
 	botimport.Print(PRT_MESSAGE, "%d area cache updates\n", numareacacheupdates);
 	botimport.Print(PRT_MESSAGE, "%d portal cache updates\n", numportalcacheupdates);
+	botimport.Print(PRT_MESSAGE, "%d area cache repairs\n", numareacacherepairs);
 	botimport.Print(PRT_MESSAGE, "%d bytes routing cache\n", routingcachesize);
 } //end of the function AAS_RoutingInfo
 #endif //ROUTING_DEBUG
 //===========================================================================
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+void AAS_ResetRoutingCacheStats(void)
+{
+	int i;
+	aas_routingshard_t *shard;
+
+	peak_routingcachesize = routingcachesize;
+	for (i = 0; i < MAX_ROUTINGSHARDS; i++)
+	{
+		shard = &aasworld.routingshards[i];
+		shard->numareacachehits = 0;
+		shard->numareacachemisses = 0;
+		shard->numportalcachehits = 0;
+		shard->numportalcachemisses = 0;
+	} //end for
+	numroutetablelookups = 0;
+	numcacheevictions = 0;
+	routingcachestatstime = botimport.Sys_Milliseconds();
+} //end of the function AAS_ResetRoutingCacheStats
+//===========================================================================
+// returns the percentage of part in total
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+static float AAS_RoutingCachePercentage(unsigned int part, unsigned int total)
+{
+	if (!total) return 0;
+	return 100.0f * part / total;
+} //end of the function AAS_RoutingCachePercentage
+//===========================================================================
+// prints the routing cache hit, miss and eviction rates since the
+// statistics were reset
+//
+// Parameter:			reset		: reset the statistics after printing
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+void AAS_RoutingCacheStats(int reset)
+{
+	int i, numevictable;
+	unsigned int numareacachehits, numareacachemisses, numportalcachehits, numportalcachemisses;
+	unsigned int numareacachelookups, numportalcachelookups, nummisses;
+	float seconds;
+	aas_routingcache_t *cache;
+	aas_routingshard_t *shard;
+
+	numevictable = 0;
+	for (cache = aasworld.oldestcache; cache; cache = cache->time_next)
+	{
+		numevictable++;
+	} //end for
+	numareacachehits = numareacachemisses = 0;
+	numportalcachehits = numportalcachemisses = 0;
+	for (i = 0; i < MAX_ROUTINGSHARDS; i++)
+	{
+		shard = &aasworld.routingshards[i];
+		numareacachehits += shard->numareacachehits;
+		numareacachemisses += shard->numareacachemisses;
+		numportalcachehits += shard->numportalcachehits;
+		numportalcachemisses += shard->numportalcachemisses;
+	} //end for
+	seconds = (botimport.Sys_Milliseconds() - routingcachestatstime) / 1000.0f;
+	if (seconds <= 0) seconds = 0.001f;
+	numareacachelookups = numareacachehits + numareacachemisses;
+	numportalcachelookups = numportalcachehits + numportalcachemisses;
+	nummisses = numareacachemisses + numportalcachemisses;
+	//
+	botimport.Print(PRT_MESSAGE, "routing cache: %d KB, %d KB peak, %d KB high-water mark, %d evictable caches\n",
+						routingcachesize >> 10, peak_routingcachesize >> 10, ROUTINGCACHE_HIGHWATER >> 10, numevictable);
+	botimport.Print(PRT_MESSAGE, "area cache: %u lookups, %u hits, %u misses, %.1f%% hit rate\n",
+						numareacachelookups, numareacachehits, numareacachemisses,
+						AAS_RoutingCachePercentage(numareacachehits, numareacachelookups));
+	botimport.Print(PRT_MESSAGE, "portal cache: %u lookups, %u hits, %u misses, %.1f%% hit rate\n",
+						numportalcachelookups, numportalcachehits, numportalcachemisses,
+						AAS_RoutingCachePercentage(numportalcachehits, numportalcachelookups));
+	botimport.Print(PRT_MESSAGE, "route table: %u lookups\n", numroutetablelookups);
+	botimport.Print(PRT_MESSAGE, "%u evictions, %.1f%% of the misses\n", numcacheevictions,
+						AAS_RoutingCachePercentage(numcacheevictions, nummisses));
+	botimport.Print(PRT_MESSAGE, "over %.1f seconds: %.1f lookups, %.1f misses, %.1f evictions per second\n", seconds,
+						(numareacachelookups + numportalcachelookups + numroutetablelookups) / seconds,
+						nummisses / seconds, numcacheevictions / seconds);
+	if (reset)
+	{
+		AAS_ResetRoutingCacheStats();
+	} //end if
+} //end of the function AAS_RoutingCacheStats
+//===========================================================================
 // returns the number of the area in the cluster
 // assumes the given area is in the given cluster or a portal of the cluster
 //
@@ -192,6 +300,56 @@ int AAS_TravelFlagForType(int traveltype)
 	return AAS_TravelFlagForType_inline(traveltype);
 } //end of the function AAS_TravelFlagForType_inline
 //===========================================================================
+// returns true if the routing cache is kept in the list sorted on time
+// from which the least recently used cache is freed, area cache leading
+// towards a portal is never freed and isn't in the list
+//
+// Parameter:			cache		: routing cache
+// Returns:				qtrue if the routing cache can be freed
+// Changes Globals:		-
+//===========================================================================
+static ID_INLINE qboolean AAS_CacheEvictable(const aas_routingcache_t *cache)
+{
+	return cache->type != CACHETYPE_AREA || aasworld.areasettings[cache->areanum].cluster >= 0;
+} //end of the function AAS_CacheEvictable
+//===========================================================================
+// returns the routing cache shard with the given number, all routing uses
+// the first shard unless routing from several threads at once
+//
+// Parameter:			num			: cluster number for area cache or
+//									  area number for portal cache
+// Returns:				routing cache shard
+// Changes Globals:		-
+//===========================================================================
+static ID_INLINE aas_routingshard_t *AAS_RoutingShard(int num)
+{
+	if (!aasworld.parallelrouting) return &aasworld.routingshards[0];
+	return &aasworld.routingshards[num & (MAX_ROUTINGSHARDS - 1)];
+} //end of the function AAS_RoutingShard
+//===========================================================================
+// locks are only taken while routing from several threads at once
+// a thread holding a portal lock may take area locks, a thread holding an
+// area lock may only take the routing cache lock
+//
+// Parameter:			lock		: lock to take
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+static ID_INLINE void AAS_LockRouting(void *lock)
+{
+	if (aasworld.parallelrouting) botimport.LockMutex(lock);
+} //end of the function AAS_LockRouting
+//===========================================================================
+//
+// Parameter:			lock		: lock to release
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+static ID_INLINE void AAS_UnlockRouting(void *lock)
+{
+	if (aasworld.parallelrouting) botimport.UnlockMutex(lock);
+} //end of the function AAS_UnlockRouting
+//===========================================================================
 //
 // Parameter:			-
 // Returns:				-
@@ -199,6 +357,7 @@ int AAS_TravelFlagForType(int traveltype)
 //===========================================================================
 void AAS_UnlinkCache(aas_routingcache_t *cache)
 {
+	if (!AAS_CacheEvictable(cache)) return;
 	if (cache->time_next) cache->time_next->time_prev = cache->time_prev;
 	else aasworld.newestcache = cache->time_prev;
 	if (cache->time_prev) cache->time_prev->time_next = cache->time_next;
@@ -214,6 +373,7 @@ void AAS_UnlinkCache(aas_routingcache_t *cache)
 //===========================================================================
 void AAS_LinkCache(aas_routingcache_t *cache)
 {
+	if (!AAS_CacheEvictable(cache)) return;
 	if (aasworld.newestcache)
 	{
 		aasworld.newestcache->time_next = cache;
@@ -245,61 +405,6 @@ void AAS_FreeRoutingCache(aas_routingcache_t *cache)
 // Returns:				-
 // Changes Globals:		-
 //===========================================================================
-void AAS_RemoveRoutingCacheInCluster( int clusternum )
-{
-	int i;
-	aas_routingcache_t *cache, *nextcache;
-	aas_cluster_t *cluster;
-
-	if (!aasworld.clusterareacache)
-		return;
-	cluster = &aasworld.clusters[clusternum];
-	for (i = 0; i < cluster->numareas; i++)
-	{
-		for (cache = aasworld.clusterareacache[clusternum][i]; cache; cache = nextcache)
-		{
-			nextcache = cache->next;
-			AAS_FreeRoutingCache(cache);
-		} //end for
-		aasworld.clusterareacache[clusternum][i] = NULL;
-	} //end for
-} //end of the function AAS_RemoveRoutingCacheInCluster
-//===========================================================================
-//
-// Parameter:			-
-// Returns:				-
-// Changes Globals:		-
-//===========================================================================
-void AAS_RemoveRoutingCacheUsingArea( int areanum )
-{
-	int i, clusternum;
-	aas_routingcache_t *cache, *nextcache;
-
-	clusternum = aasworld.areasettings[areanum].cluster;
-	if (clusternum > 0)
-	{
-		//remove all the cache in the cluster the area is in
-		AAS_RemoveRoutingCacheInCluster( clusternum );
-	} //end if
-	else
-	{
-		// if this is a portal remove all cache in both the front and back cluster
-		AAS_RemoveRoutingCacheInCluster( aasworld.portals[-clusternum].frontcluster );
-		AAS_RemoveRoutingCacheInCluster( aasworld.portals[-clusternum].backcluster );
-	} //end else
-	// remove all portal cache
-	for (i = 0; i < aasworld.numareas; i++)
-	{
-		//refresh portal cache
-		for (cache = aasworld.portalcache[i]; cache; cache = nextcache)
-		{
-			nextcache = cache->next;
-			AAS_FreeRoutingCache(cache);
-		} //end for
-		aasworld.portalcache[i] = NULL;
-	} //end for
-} //end of the function AAS_RemoveRoutingCacheUsingArea
-//===========================================================================
 //
 // Parameter:			-
 // Returns:				-
@@ -328,8 +433,10 @@ int AAS_EnableRoutingArea(int areanum, int enable)
 	// if the status of the area changed
 	if ( (flags & AREA_DISABLED) != (aasworld.areasettings[areanum].areaflags & AREA_DISABLED) )
 	{
-		//remove all routing cache involving this area
-		AAS_RemoveRoutingCacheUsingArea( areanum );
+		//repair all routing cache involving this area
+		AAS_RepairRoutingCacheUsingArea( areanum, enable );
+		//the route table can't be used for routing around disabled areas
+		AAS_RouteTableEnableArea( areanum, enable );
 	} //end if
 	return !flags;
 } //end of the function AAS_EnableRoutingArea
@@ -344,6 +451,24 @@ static ID_INLINE float AAS_RoutingTime(void)
 	return AAS_Time();
 } //end of the function AAS_RoutingTime
 //===========================================================================
+// moves the routing cache to the end of the list sorted on time
+//
+// Parameter:			cache		: routing cache that was accessed
+//						type		: CACHETYPE_AREA or CACHETYPE_PORTAL
+//						linked		: true if the cache is already in the list
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+static void AAS_AccessRoutingCache(aas_routingcache_t *cache, int type, int linked)
+{
+	AAS_LockRouting(aasworld.routingcachelock);
+	if (linked) AAS_UnlinkCache(cache);
+	cache->time = AAS_RoutingTime();
+	cache->type = type;
+	AAS_LinkCache(cache);
+	AAS_UnlockRouting(aasworld.routingcachelock);
+} //end of the function AAS_AccessRoutingCache
+//===========================================================================
 //
 // Parameter:				-
 // Returns:					-
@@ -700,13 +825,8 @@ int AAS_FreeOldestCache(void)
 	int clusterareanum;
 	aas_routingcache_t *cache;
 
-	for (cache = aasworld.oldestcache; cache; cache = cache->time_next) {
-		// never free area cache leading towards a portal
-		if (cache->type == CACHETYPE_AREA && aasworld.areasettings[cache->areanum].cluster < 0) {
-			continue;
-		}
-		break;
-	}
+	// area cache leading towards a portal is never in the list
+	cache = aasworld.oldestcache;
 	if (cache) {
 		// unlink the cache
 		if (cache->type == CACHETYPE_AREA) {
@@ -724,6 +844,7 @@ int AAS_FreeOldestCache(void)
 			if (cache->next) cache->next->prev = cache->prev;
 		}
 		AAS_FreeRoutingCache(cache);
+		numcacheevictions++;
 		return qtrue;
 	}
 	return qfalse;
@@ -744,9 +865,12 @@ aas_routingcache_t *AAS_AllocRoutingCache(int numtraveltimes)
 						+ numtraveltimes * sizeof(unsigned short int)
 						+ numtraveltimes * sizeof(unsigned char);
 	//
+	AAS_LockRouting(aasworld.routingcachelock);
 	routingcachesize += size;
+	if (routingcachesize > peak_routingcachesize) peak_routingcachesize = routingcachesize;
 	//
 	cache = (aas_routingcache_t *) GetClearedMemory(size);
+	AAS_UnlockRouting(aasworld.routingcachelock);
 	cache->reachabilities = (unsigned char *) cache + sizeof(aas_routingcache_t)
 								+ numtraveltimes * sizeof(unsigned short int);
 	cache->size = size;
@@ -852,17 +976,36 @@ void AAS_InitPortalCache(void)
 								aasworld.numareas * sizeof(aas_routingcache_t *));
 } //end of the function AAS_InitPortalCache
 //===========================================================================
+// frees the routing update fields of the routing cache shard
 //
-// Parameter:				-
-// Returns:					-
+// Parameter:			shard		: routing cache shard
+// Returns:				-
 // Changes Globals:		-
 //===========================================================================
-void AAS_InitRoutingUpdate(void)
+static void AAS_FreeRoutingShardUpdates(aas_routingshard_t *shard)
+{
+	if (shard->areaupdate) FreeMemory(shard->areaupdate);
+	shard->areaupdate = NULL;
+	if (shard->areaupdateheap) FreeMemory(shard->areaupdateheap);
+	shard->areaupdateheap = NULL;
+	if (shard->portalupdate) FreeMemory(shard->portalupdate);
+	shard->portalupdate = NULL;
+	if (shard->portalupdateheap) FreeMemory(shard->portalupdateheap);
+	shard->portalupdateheap = NULL;
+} //end of the function AAS_FreeRoutingShardUpdates
+//===========================================================================
+// allocates the routing update fields of the routing cache shard
+//
+// Parameter:			shard		: routing cache shard
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+static void AAS_AllocRoutingShardUpdates(aas_routingshard_t *shard)
 {
 	int i, maxreachabilityareas;
 
 	//free routing update fields if already existing
-	if (aasworld.areaupdate) FreeMemory(aasworld.areaupdate);
+	AAS_FreeRoutingShardUpdates(shard);
 	//
 	maxreachabilityareas = 0;
 	for (i = 0; i < aasworld.numclusters; i++)
@@ -873,13 +1016,28 @@ void AAS_InitRoutingUpdate(void)
 		} //end if
 	} //end for
 	//allocate memory for the routing update fields
-	aasworld.areaupdate = (aas_routingupdate_t *) GetClearedMemory(
+	shard->areaupdate = (aas_routingupdate_t *) GetClearedMemory(
 									maxreachabilityareas * sizeof(aas_routingupdate_t));
-	//
-	if (aasworld.portalupdate) FreeMemory(aasworld.portalupdate);
+	//allocate memory for the area update heap
+	shard->areaupdateheap = (aas_routingupdate_t **) GetClearedMemory(
+									maxreachabilityareas * sizeof(aas_routingupdate_t *));
 	//allocate memory for the portal update fields
-	aasworld.portalupdate = (aas_routingupdate_t *) GetClearedMemory(
+	shard->portalupdate = (aas_routingupdate_t *) GetClearedMemory(
 									(aasworld.numportals+1) * sizeof(aas_routingupdate_t));
+	//allocate memory for the portal update heap
+	shard->portalupdateheap = (aas_routingupdate_t **) GetClearedMemory(
+									(aasworld.numportals+1) * sizeof(aas_routingupdate_t *));
+} //end of the function AAS_AllocRoutingShardUpdates
+//===========================================================================
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+void AAS_InitRoutingUpdate(void)
+{
+	//the other shards are only used while routing from several threads at once
+	AAS_AllocRoutingShardUpdates(&aasworld.routingshards[0]);
 } //end of the function AAS_InitRoutingUpdate
 //===========================================================================
 //
@@ -887,6 +1045,123 @@ void AAS_InitRoutingUpdate(void)
 // Returns:				-
 // Changes Globals:		-
 //===========================================================================
+static void AAS_FreeRoutingLocks(void)
+{
+	int i;
+	aas_routingshard_t *shard;
+
+	if (aasworld.routingcachelock) botimport.DestroyMutex(aasworld.routingcachelock);
+	aasworld.routingcachelock = NULL;
+	for (i = 0; i < MAX_ROUTINGSHARDS; i++)
+	{
+		shard = &aasworld.routingshards[i];
+		if (shard->arealock) botimport.DestroyMutex(shard->arealock);
+		shard->arealock = NULL;
+		if (shard->portallock) botimport.DestroyMutex(shard->portallock);
+		shard->portallock = NULL;
+	} //end for
+} //end of the function AAS_FreeRoutingLocks
+//===========================================================================
+//
+// Parameter:			-
+// Returns:				qtrue if all the locks were created
+// Changes Globals:		-
+//===========================================================================
+static int AAS_CreateRoutingLocks(void)
+{
+	int i;
+	aas_routingshard_t *shard;
+
+	aasworld.routingcachelock = botimport.CreateMutex();
+	if (!aasworld.routingcachelock)
+	{
+		botimport.Print(PRT_WARNING, "AAS_CreateRoutingLocks: failed to create the routing locks\n");
+		return qfalse;
+	} //end if
+	for (i = 0; i < MAX_ROUTINGSHARDS; i++)
+	{
+		shard = &aasworld.routingshards[i];
+		shard->arealock = botimport.CreateMutex();
+		shard->portallock = botimport.CreateMutex();
+		if (!shard->arealock || !shard->portallock)
+		{
+			AAS_FreeRoutingLocks();
+			botimport.Print(PRT_WARNING, "AAS_CreateRoutingLocks: failed to create the routing locks\n");
+			return qfalse;
+		} //end if
+	} //end for
+	return qtrue;
+} //end of the function AAS_CreateRoutingLocks
+//===========================================================================
+// frees the least recently used routing caches until the routing cache
+// is below the high-water mark
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+static void AAS_TrimRoutingCache(void)
+{
+	while ( routingcachesize > ROUTINGCACHE_HIGHWATER ) {
+		if ( !AAS_FreeOldestCache() ) {
+			break;
+		}
+	}
+} //end of the function AAS_TrimRoutingCache
+//===========================================================================
+// allows AAS_AreaRouteToGoalArea, AAS_PointAreaNum, AAS_TraceAreas and
+// BotPredictVisiblePosition to be called from several threads at once
+// until AAS_EndParallelRouting, nothing else may be called in between
+// routing caches are created under the lock of their shard and are never
+// freed while routing in parallel, the routing cache may grow beyond the
+// high-water mark until AAS_EndParallelRouting
+//
+// Parameter:			-
+// Returns:				qfalse if routing has to stay on the calling thread
+// Changes Globals:		-
+//===========================================================================
+int AAS_BeginParallelRouting(void)
+{
+	int i;
+
+	if (!aasworld.initialized) return qfalse;
+	//routing errors are only printed in developer mode, keep them in order
+	if (botDeveloper) return qfalse;
+	//
+	if (!aasworld.routingcachelock)
+	{
+		if (!AAS_CreateRoutingLocks()) return qfalse;
+	} //end if
+	for (i = 1; i < MAX_ROUTINGSHARDS; i++)
+	{
+		if (!aasworld.routingshards[i].areaupdate)
+		{
+			AAS_AllocRoutingShardUpdates(&aasworld.routingshards[i]);
+		} //end if
+	} //end for
+	AAS_TrimRoutingCache();
+	aasworld.parallelrouting = qtrue;
+	return qtrue;
+} //end of the function AAS_BeginParallelRouting
+//===========================================================================
+// called on the thread that called AAS_BeginParallelRouting after all
+// other threads stopped routing
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+void AAS_EndParallelRouting(void)
+{
+	aasworld.parallelrouting = qfalse;
+	AAS_TrimRoutingCache();
+} //end of the function AAS_EndParallelRouting
+//===========================================================================
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
 void AAS_CreateAllRoutingCache(void)
 {
 	int i, j;
@@ -1042,6 +1317,11 @@ aas_routingcache_t *AAS_ReadCache(fileHandle_t fp)
 	cache = (aas_routingcache_t *) GetMemory(size);
 	cache->size = size;
 	botimport.FS_Read((unsigned char *)cache + sizeof(size), size - sizeof(size), fp);
+	routingcachesize += size;
+	if (routingcachesize > peak_routingcachesize) peak_routingcachesize = routingcachesize;
+	//the links in the file are stale
+	cache->time_prev = NULL;
+	cache->time_next = NULL;
 	cache->reachabilities = (unsigned char *) cache + sizeof(aas_routingcache_t) - sizeof(unsigned short) +
 		(size - sizeof(aas_routingcache_t) + sizeof(unsigned short)) / 3 * 2;
 	return cache;
@@ -1108,6 +1388,7 @@ int AAS_ReadRouteCache(void)
 		if (aasworld.portalcache[cache->areanum])
 			aasworld.portalcache[cache->areanum]->prev = cache;
 		aasworld.portalcache[cache->areanum] = cache;
+		AAS_LinkCache(cache);
 	} //end for
 	//read all the cluster area cache
 	for (i = 0; i < routecacheheader.numareacache; i++)
@@ -1119,6 +1400,7 @@ int AAS_ReadRouteCache(void)
 		if (aasworld.clusterareacache[cache->cluster][clusterareanum])
 			aasworld.clusterareacache[cache->cluster][clusterareanum]->prev = cache;
 		aasworld.clusterareacache[cache->cluster][clusterareanum] = cache;
+		AAS_LinkCache(cache);
 	} //end for
 	// read the visareas
 	/*
@@ -1240,12 +1522,16 @@ void AAS_InitRouting(void)
 #ifdef ROUTING_DEBUG
 	numareacacheupdates = 0;
 	numportalcacheupdates = 0;
+	numareacacherepairs = 0;
 #endif //ROUTING_DEBUG
 	//
 	routingcachesize = 0;
 	max_routingcachesize = 1024 * (int) LibVarValue("max_routingcache", "4096");
+	AAS_ResetRoutingCacheStats();
 	// read any routing cache if available
 	AAS_ReadRouteCache();
+	// map the precomputed route table if available
+	AAS_LoadRouteTable();
 } //end of the function AAS_InitRouting
 //===========================================================================
 //
@@ -1255,10 +1541,14 @@ void AAS_InitRouting(void)
 //===========================================================================
 void AAS_FreeRoutingCaches(void)
 {
+	int i;
+
 	// free all the existing cluster area cache
 	AAS_FreeAllClusterAreaCache();
 	// free all the existing portal cache
 	AAS_FreeAllPortalCache();
+	// free the precomputed route table
+	AAS_FreeRouteTable();
 	// free cached travel times within areas
 	if (aasworld.areatraveltimes) FreeMemory(aasworld.areatraveltimes);
 	aasworld.areatraveltimes = NULL;
@@ -1268,11 +1558,12 @@ void AAS_FreeRoutingCaches(void)
 	// free reversed reachability links
 	if (aasworld.reversedreachability) FreeMemory(aasworld.reversedreachability);
 	aasworld.reversedreachability = NULL;
-	// free routing algorithm memory
-	if (aasworld.areaupdate) FreeMemory(aasworld.areaupdate);
-	aasworld.areaupdate = NULL;
-	if (aasworld.portalupdate) FreeMemory(aasworld.portalupdate);
-	aasworld.portalupdate = NULL;
+	// free routing algorithm memory and the routing locks
+	AAS_FreeRoutingLocks();
+	for (i = 0; i < MAX_ROUTINGSHARDS; i++)
+	{
+		AAS_FreeRoutingShardUpdates(&aasworld.routingshards[i]);
+	} //end for
 	// free lists with areas the reachabilities go through
 	if (aasworld.reachabilityareas) FreeMemory(aasworld.reachabilityareas);
 	aasworld.reachabilityareas = NULL;
@@ -1284,63 +1575,120 @@ void AAS_FreeRoutingCaches(void)
 	aasworld.areacontentstravelflags = NULL;
 } //end of the function AAS_FreeRoutingCaches
 //===========================================================================
-// update the given routing cache
+// moves the routing update towards the top of the heap until the update
+// above it has a smaller or equal travel time
 //
-// Parameter:			areacache		: routing cache to update
+// Parameter:			heap		: binary heap with routing updates
+//						index		: heap index of the update to move
 // Returns:				-
 // Changes Globals:		-
 //===========================================================================
-void AAS_UpdateAreaRoutingCache(aas_routingcache_t *areacache)
+static ID_INLINE void AAS_RoutingHeapUp(aas_routingupdate_t **heap, int index)
+{
+	int parent;
+	aas_routingupdate_t *update;
+
+	update = heap[index];
+	while (index > 0)
+	{
+		parent = (index - 1) >> 1;
+		if (heap[parent]->tmptraveltime <= update->tmptraveltime) break;
+		heap[index] = heap[parent];
+		heap[index]->heapindex = index;
+		index = parent;
+	} //end while
+	heap[index] = update;
+	update->heapindex = index;
+} //end of the function AAS_RoutingHeapUp
+//===========================================================================
+// adds the routing update to the heap, if the update is already in the
+// heap it's moved up because its travel time decreased
+//
+// Parameter:			heap		: binary heap with routing updates
+//						numupdates	: number of updates in the heap
+//						update		: update to add
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+static ID_INLINE void AAS_RoutingHeapPush(aas_routingupdate_t **heap, int *numupdates, aas_routingupdate_t *update)
+{
+	if (!update->inlist)
+	{
+		heap[*numupdates] = update;
+		update->inlist = qtrue;
+		AAS_RoutingHeapUp(heap, (*numupdates)++);
+	} //end if
+	else
+	{
+		AAS_RoutingHeapUp(heap, update->heapindex);
+	} //end else
+} //end of the function AAS_RoutingHeapPush
+//===========================================================================
+// removes the routing update with the smallest travel time from the heap
+//
+// Parameter:			heap		: binary heap with routing updates
+//						numupdates	: number of updates in the heap
+// Returns:				update with the smallest travel time
+// Changes Globals:		-
+//===========================================================================
+static ID_INLINE aas_routingupdate_t *AAS_RoutingHeapPop(aas_routingupdate_t **heap, int *numupdates)
+{
+	int index, child, n;
+	aas_routingupdate_t *top, *last;
+
+	top = heap[0];
+	top->inlist = qfalse;
+	n = --(*numupdates);
+	if (n > 0)
+	{
+		last = heap[n];
+		index = 0;
+		for (child = 1; child < n; child = index * 2 + 1)
+		{
+			if (child + 1 < n && heap[child + 1]->tmptraveltime < heap[child]->tmptraveltime) child++;
+			if (last->tmptraveltime <= heap[child]->tmptraveltime) break;
+			heap[index] = heap[child];
+			heap[index]->heapindex = index;
+			index = child;
+		} //end for
+		heap[index] = last;
+		last->heapindex = index;
+	} //end if
+	return top;
+} //end of the function AAS_RoutingHeapPop
+//===========================================================================
+// routes from the updates in the area update heap in order of travel time
+// and stores the travel times and reachabilities in the area cache
+//
+// Parameter:			shard			: routing cache shard of the area cache
+//						areacache		: routing cache to update
+//						numupdates		: number of updates in the area update heap
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+static void AAS_RelaxAreaRoutingCache(aas_routingshard_t *shard, aas_routingcache_t *areacache, int numupdates)
 {
-	int i, nextareanum, cluster, badtravelflags, clusterareanum, linknum;
+	int i, nextareanum, cluster, badtravelflags, clusterareanum, linknum, reachnum;
 	int numreachabilityareas;
-	unsigned short int t, startareatraveltimes[128]; //NOTE: not more than 128 reachabilities per area allowed
-	aas_routingupdate_t *updateliststart, *updatelistend, *curupdate, *nextupdate;
+	unsigned short int t;
+	aas_routingupdate_t **heap, *curupdate, *nextupdate;
 	aas_reachability_t *reach;
 	const aas_reversedreachability_t *revreach;
 	const aas_reversedlink_t *revlink;
 
-#ifdef ROUTING_DEBUG
-	numareacacheupdates++;
-#endif //ROUTING_DEBUG
 	//number of reachability areas within this cluster
 	numreachabilityareas = aasworld.clusters[areacache->cluster].numreachabilityareas;
-	//
-	aasworld.frameroutingupdates++;
-	//clear the routing update fields
-//	Com_Memset(aasworld.areaupdate, 0, aasworld.numareas * sizeof(aas_routingupdate_t));
 	//
 	badtravelflags = ~areacache->travelflags;
 	//
-	clusterareanum = AAS_ClusterAreaNum(areacache->cluster, areacache->areanum);
-	if (clusterareanum >= numreachabilityareas) return;
-	//
-	Com_Memset(startareatraveltimes, 0, sizeof(startareatraveltimes));
-	//
-	curupdate = &aasworld.areaupdate[clusterareanum];
-	curupdate->areanum = areacache->areanum;
-	//VectorCopy(areacache->origin, curupdate->start);
-	curupdate->areatraveltimes = startareatraveltimes;
-	curupdate->tmptraveltime = areacache->starttraveltime;
-	//
-	areacache->traveltimes[clusterareanum] = areacache->starttraveltime;
-	//put the area to start with in the current read list
-	curupdate->next = NULL;
-	curupdate->prev = NULL;
-	updateliststart = curupdate;
-	updatelistend = curupdate;
-	//while there are updates in the current list
-	while (updateliststart)
+	heap = shard->areaupdateheap;
+	//while there are updates in the heap
+	while (numupdates > 0)
 	{
-		curupdate = updateliststart;
-		//
-		if (curupdate->next) curupdate->next->prev = NULL;
-		else updatelistend = NULL;
-		updateliststart = curupdate->next;
-		//
-		curupdate->inlist = qfalse;
-		//check all reversed reachability links
-		revreach = &aasworld.reversedreachability[curupdate->areanum];
+		//the update with the smallest travel time
+		curupdate = AAS_RoutingHeapPop(heap, &numupdates);
+		//check all reversed reachability links
+		revreach = &aasworld.reversedreachability[curupdate->areanum];
 		//
 		for (i = 0, revlink = revreach->first; revlink; revlink = revlink->next, i++)
 		{
@@ -1367,33 +1715,67 @@ void AAS_UpdateAreaRoutingCache(aas_routingcache_t *areacache)
 						//AAS_AreaTravelTime(curupdate->areanum, curupdate->start, reach->end) +
 						curupdate->areatraveltimes[i] +
 							reach->traveltime;
-			//
+			//the reachability used to leave the next area
+			reachnum = linknum - aasworld.areasettings[nextareanum].firstreachablearea;
+			//on equal travel times use the first reachability so the
+			//result doesn't depend on the order of the updates
 			if (!areacache->traveltimes[clusterareanum] ||
-					areacache->traveltimes[clusterareanum] > t)
+					areacache->traveltimes[clusterareanum] > t ||
+					(areacache->traveltimes[clusterareanum] == t &&
+						areacache->reachabilities[clusterareanum] > reachnum))
 			{
 				areacache->traveltimes[clusterareanum] = t;
-				areacache->reachabilities[clusterareanum] = linknum - aasworld.areasettings[nextareanum].firstreachablearea;
-				nextupdate = &aasworld.areaupdate[clusterareanum];
+				areacache->reachabilities[clusterareanum] = reachnum;
+				nextupdate = &shard->areaupdate[clusterareanum];
 				nextupdate->areanum = nextareanum;
 				nextupdate->tmptraveltime = t;
 				//VectorCopy(reach->start, nextupdate->start);
-				nextupdate->areatraveltimes = aasworld.areatraveltimes[nextareanum][linknum -
-													aasworld.areasettings[nextareanum].firstreachablearea];
-				if (!nextupdate->inlist)
-				{
-					// we add the update to the end of the list
-					// we could also use a B+ tree to have a real sorted list
-					// on travel time which makes for faster routing updates
-					nextupdate->next = NULL;
-					nextupdate->prev = updatelistend;
-					if (updatelistend) updatelistend->next = nextupdate;
-					else updateliststart = nextupdate;
-					updatelistend = nextupdate;
-					nextupdate->inlist = qtrue;
-				} //end if
+				nextupdate->areatraveltimes = aasworld.areatraveltimes[nextareanum][reachnum];
+				//add the update to the heap or move it up when already in the heap
+				AAS_RoutingHeapPush(heap, &numupdates, nextupdate);
 			} //end if
 		} //end for
 	} //end while
+} //end of the function AAS_RelaxAreaRoutingCache
+//===========================================================================
+// update the given routing cache
+//
+// Parameter:			areacache		: routing cache to update
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+void AAS_UpdateAreaRoutingCache(aas_routingcache_t *areacache)
+{
+	int clusterareanum, numupdates;
+	aas_routingshard_t *shard;
+	aas_routingupdate_t *curupdate;
+
+	AAS_LockRouting(aasworld.routingcachelock);
+#ifdef ROUTING_DEBUG
+	numareacacheupdates++;
+#endif //ROUTING_DEBUG
+	aasworld.frameroutingupdates++;
+	AAS_UnlockRouting(aasworld.routingcachelock);
+	//the lock of this shard is held when routing in parallel
+	shard = AAS_RoutingShard(areacache->cluster);
+	//clear the routing update fields
+//	Com_Memset(shard->areaupdate, 0, aasworld.numareas * sizeof(aas_routingupdate_t));
+	//
+	clusterareanum = AAS_ClusterAreaNum(areacache->cluster, areacache->areanum);
+	if (clusterareanum >= aasworld.clusters[areacache->cluster].numreachabilityareas) return;
+	//
+	curupdate = &shard->areaupdate[clusterareanum];
+	curupdate->areanum = areacache->areanum;
+	//VectorCopy(areacache->origin, curupdate->start);
+	curupdate->areatraveltimes = startareatraveltimes;
+	curupdate->tmptraveltime = areacache->starttraveltime;
+	//
+	areacache->traveltimes[clusterareanum] = areacache->starttraveltime;
+	//put the area to start with in the heap
+	numupdates = 0;
+	AAS_RoutingHeapPush(shard->areaupdateheap, &numupdates, curupdate);
+	//route from the start area
+	AAS_RelaxAreaRoutingCache(shard, areacache, numupdates);
 } //end of the function AAS_UpdateAreaRoutingCache
 //===========================================================================
 //
@@ -1403,9 +1785,14 @@ void AAS_UpdateAreaRoutingCache(aas_routingcache_t *areacache)
 //===========================================================================
 aas_routingcache_t *AAS_GetAreaRoutingCache(int clusternum, int areanum, int travelflags)
 {
-	int clusterareanum;
+	int clusterareanum, miss;
 	aas_routingcache_t *cache, *clustercache;
+	aas_routingshard_t *shard;
 
+	//the cache is filled while holding the lock so other threads
+	//never see a partial cache
+	shard = AAS_RoutingShard(clusternum);
+	AAS_LockRouting(shard->arealock);
 	//number of the area in the cluster
 	clusterareanum = AAS_ClusterAreaNum(clusternum, areanum);
 	//pointer to the cache for the area in the cluster
@@ -1417,8 +1804,10 @@ aas_routingcache_t *AAS_GetAreaRoutingCache(int clusternum, int areanum, int tra
 		if (cache->travelflags == travelflags) break;
 	} //end for
 	//if there was no cache
-	if (!cache)
+	miss = !cache;
+	if (miss)
 	{
+		shard->numareacachemisses++;
 		cache = AAS_AllocRoutingCache(aasworld.clusters[clusternum].numreachabilityareas);
 		cache->cluster = clusternum;
 		cache->areanum = areanum;
@@ -1433,12 +1822,11 @@ aas_routingcache_t *AAS_GetAreaRoutingCache(int clusternum, int areanum, int tra
 	} //end if
 	else
 	{
-		AAS_UnlinkCache(cache);
+		shard->numareacachehits++;
 	} //end else
 	//the cache has been accessed
-	cache->time = AAS_RoutingTime();
-	cache->type = CACHETYPE_AREA;
-	AAS_LinkCache(cache);
+	AAS_AccessRoutingCache(cache, CACHETYPE_AREA, !miss);
+	AAS_UnlockRouting(shard->arealock);
 	return cache;
 } //end of the function AAS_GetAreaRoutingCache
 //===========================================================================
@@ -1449,20 +1837,25 @@ aas_routingcache_t *AAS_GetAreaRoutingCache(int clusternum, int areanum, int tra
 //===========================================================================
 void AAS_UpdatePortalRoutingCache(aas_routingcache_t *portalcache)
 {
-	int i, portalnum, clusterareanum, clusternum;
+	int i, portalnum, clusterareanum, clusternum, numupdates;
 	unsigned short int t;
 	aas_portal_t *portal;
 	aas_cluster_t *cluster;
 	aas_routingcache_t *cache;
-	aas_routingupdate_t *updateliststart, *updatelistend, *curupdate, *nextupdate;
+	aas_routingshard_t *shard;
+	aas_routingupdate_t **heap, *curupdate, *nextupdate;
 
 #ifdef ROUTING_DEBUG
+	AAS_LockRouting(aasworld.routingcachelock);
 	numportalcacheupdates++;
+	AAS_UnlockRouting(aasworld.routingcachelock);
 #endif //ROUTING_DEBUG
+	//the lock of this shard is held when routing in parallel
+	shard = AAS_RoutingShard(portalcache->areanum);
 	//clear the routing update fields
-//	Com_Memset(aasworld.portalupdate, 0, (aasworld.numportals+1) * sizeof(aas_routingupdate_t));
+//	Com_Memset(shard->portalupdate, 0, (aasworld.numportals+1) * sizeof(aas_routingupdate_t));
 	//
-	curupdate = &aasworld.portalupdate[aasworld.numportals];
+	curupdate = &shard->portalupdate[aasworld.numportals];
 	curupdate->cluster = portalcache->cluster;
 	curupdate->areanum = portalcache->areanum;
 	curupdate->tmptraveltime = portalcache->starttraveltime;
@@ -1472,21 +1865,15 @@ void AAS_UpdatePortalRoutingCache(aas_routingcache_t *portalcache)
 	{
 		portalcache->traveltimes[-clusternum] = portalcache->starttraveltime;
 	} //end if
-	//put the area to start with in the current read list
-	curupdate->next = NULL;
-	curupdate->prev = NULL;
-	updateliststart = curupdate;
-	updatelistend = curupdate;
-	//while there are updates in the current list
-	while (updateliststart)
-	{
-		curupdate = updateliststart;
-		//remove the current update from the list
-		if (curupdate->next) curupdate->next->prev = NULL;
-		else updatelistend = NULL;
-		updateliststart = curupdate->next;
-		//current update is removed from the list
-		curupdate->inlist = qfalse;
+	//put the area to start with in the heap
+	heap = shard->portalupdateheap;
+	numupdates = 0;
+	AAS_RoutingHeapPush(heap, &numupdates, curupdate);
+	//while there are updates in the heap
+	while (numupdates > 0)
+	{
+		//the update with the smallest travel time
+		curupdate = AAS_RoutingHeapPop(heap, &numupdates);
 		//
 		cluster = &aasworld.clusters[curupdate->cluster];
 		//
@@ -1511,7 +1898,7 @@ void AAS_UpdatePortalRoutingCache(aas_routingcache_t *portalcache)
 					portalcache->traveltimes[portalnum] > t)
 			{
 				portalcache->traveltimes[portalnum] = t;
-				nextupdate = &aasworld.portalupdate[portalnum];
+				nextupdate = &shard->portalupdate[portalnum];
 				if (portal->frontcluster == curupdate->cluster)
 				{
 					nextupdate->cluster = portal->backcluster;
@@ -1523,18 +1910,8 @@ void AAS_UpdatePortalRoutingCache(aas_routingcache_t *portalcache)
 				nextupdate->areanum = portal->areanum;
 				//add travel time through the actual portal area for the next update
 				nextupdate->tmptraveltime = t + aasworld.portalmaxtraveltimes[portalnum];
-				if (!nextupdate->inlist)
-				{
-					// we add the update to the end of the list
-					// we could also use a B+ tree to have a real sorted list
-					// on travel time which makes for faster routing updates
-					nextupdate->next = NULL;
-					nextupdate->prev = updatelistend;
-					if (updatelistend) updatelistend->next = nextupdate;
-					else updateliststart = nextupdate;
-					updatelistend = nextupdate;
-					nextupdate->inlist = qtrue;
-				} //end if
+				//add the update to the heap or move it up when already in the heap
+				AAS_RoutingHeapPush(heap, &numupdates, nextupdate);
 			} //end if
 		} //end for
 	} //end while
@@ -1547,16 +1924,23 @@ void AAS_UpdatePortalRoutingCache(aas_routingcache_t *portalcache)
 //===========================================================================
 aas_routingcache_t *AAS_GetPortalRoutingCache(int clusternum, int areanum, int travelflags)
 {
+	int miss;
 	aas_routingcache_t *cache;
+	aas_routingshard_t *shard;
 
+	//the portal cache update takes area locks while holding this lock
+	shard = AAS_RoutingShard(areanum);
+	AAS_LockRouting(shard->portallock);
 	//find the cached portal routing if existing
 	for (cache = aasworld.portalcache[areanum]; cache; cache = cache->next)
 	{
 		if (cache->travelflags == travelflags) break;
 	} //end for
 	//if the portal routing isn't cached
-	if (!cache)
+	miss = !cache;
+	if (miss)
 	{
+		shard->numportalcachemisses++;
 		cache = AAS_AllocRoutingCache(aasworld.numportals);
 		cache->cluster = clusternum;
 		cache->areanum = areanum;
@@ -1573,15 +1957,1069 @@ aas_routingcache_t *AAS_GetPortalRoutingCache(int clusternum, int areanum, int t
 	} //end if
 	else
 	{
-		AAS_UnlinkCache(cache);
+		shard->numportalcachehits++;
 	} //end else
 	//the cache has been accessed
-	cache->time = AAS_RoutingTime();
-	cache->type = CACHETYPE_PORTAL;
-	AAS_LinkCache(cache);
+	AAS_AccessRoutingCache(cache, CACHETYPE_PORTAL, !miss);
+	AAS_UnlockRouting(shard->portallock);
 	return cache;
 } //end of the function AAS_GetPortalRoutingCache
 //===========================================================================
+// repairs the area cache after the given area was enabled or disabled
+// for routing
+// the routing update handles the areas in order of travel time so the
+// areas with a smaller travel time than the toggled area are routed the
+// same way, only the areas with the same or a larger travel time are
+// cleared and routed again from the areas next to them
+//
+// Parameter:			areacache		: routing cache to repair
+//						areanum			: area that was enabled or disabled
+//						enable			: true if the area was enabled
+//						clusterareas	: area numbers of the cluster areas
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+static void AAS_RepairAreaRoutingCache(aas_routingcache_t *areacache, int areanum, int enable,
+										const int *clusterareas)
+{
+	int i, j, n, goal, toggled, next, numupdates, nextareanum, cluster;
+	unsigned short int t;
+	aas_reachability_t *reach;
+	aas_routingshard_t *shard;
+	aas_routingupdate_t *update;
+	aas_areasettings_t *settings;
+	const aas_reversedlink_t *revlink;
+
+	n = aasworld.clusters[areacache->cluster].numreachabilityareas;
+	goal = AAS_ClusterAreaNum(areacache->cluster, areacache->areanum);
+	toggled = AAS_ClusterAreaNum(areacache->cluster, areanum);
+	if (goal >= n || toggled >= n) return;
+	//if the area isn't reached in this cache no route goes through it
+	t = areacache->traveltimes[toggled];
+	if (!t) return;
+	//if the disabled area isn't used by any route
+	if (!enable)
+	{
+		for (revlink = aasworld.reversedreachability[areanum].first; revlink; revlink = revlink->next)
+		{
+			cluster = aasworld.areasettings[revlink->areanum].cluster;
+			if (cluster > 0 && cluster != areacache->cluster) continue;
+			next = AAS_ClusterAreaNum(areacache->cluster, revlink->areanum);
+			if (next >= n || !areacache->traveltimes[next]) continue;
+			if (aasworld.areasettings[revlink->areanum].firstreachablearea +
+					areacache->reachabilities[next] == revlink->linknum) break;
+		} //end for
+		if (!revlink) return;
+	} //end if
+	//
+#ifdef ROUTING_DEBUG
+	numareacacherepairs++;
+#endif //ROUTING_DEBUG
+	//clear the areas routed after the toggled area
+	for (i = 0; i < n; i++)
+	{
+		if (areacache->traveltimes[i] < t || i == toggled) continue;
+		areacache->traveltimes[i] = 0;
+		areacache->reachabilities[i] = 0;
+	} //end for
+	//route again from the areas next to the cleared areas
+	shard = AAS_RoutingShard(areacache->cluster);
+	numupdates = 0;
+	for (i = 0; i < n; i++)
+	{
+		if (areacache->traveltimes[i] || i == toggled) continue;
+		settings = &aasworld.areasettings[clusterareas[i]];
+		for (j = 0; j < settings->numreachableareas; j++)
+		{
+			reach = &aasworld.reachability[settings->firstreachablearea + j];
+			nextareanum = reach->areanum;
+			cluster = aasworld.areasettings[nextareanum].cluster;
+			if (cluster > 0 && cluster != areacache->cluster) continue;
+			next = AAS_ClusterAreaNum(areacache->cluster, nextareanum);
+			if (next >= n || !areacache->traveltimes[next]) continue;
+			update = &shard->areaupdate[next];
+			if (update->inlist) continue;
+			update->areanum = nextareanum;
+			update->tmptraveltime = areacache->traveltimes[next];
+			if (next == goal) update->areatraveltimes = startareatraveltimes;
+			else update->areatraveltimes = aasworld.areatraveltimes[nextareanum][areacache->reachabilities[next]];
+			AAS_RoutingHeapPush(shard->areaupdateheap, &numupdates, update);
+		} //end for
+	} //end for
+	AAS_RelaxAreaRoutingCache(shard, areacache, numupdates);
+} //end of the function AAS_RepairAreaRoutingCache
+//===========================================================================
+// returns the area numbers of the reachability areas in the cluster
+// indexed by their number in the cluster
+//
+// Parameter:			clusternum		: cluster to list the areas of
+//						clusterareas	: area numbers for every area in the cluster
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+static void AAS_ClusterAreas(int clusternum, int *clusterareas)
+{
+	int i, portalnum, clusterareanum;
+	aas_cluster_t *cluster;
+
+	cluster = &aasworld.clusters[clusternum];
+	for (i = 1; i < aasworld.numareas; i++)
+	{
+		if (aasworld.areasettings[i].cluster != clusternum) continue;
+		clusterareanum = aasworld.areasettings[i].clusterareanum;
+		if (clusterareanum < cluster->numreachabilityareas) clusterareas[clusterareanum] = i;
+	} //end for
+	for (i = 0; i < cluster->numportals; i++)
+	{
+		portalnum = aasworld.portalindex[cluster->firstportal + i];
+		clusterareanum = AAS_ClusterAreaNum(clusternum, aasworld.portals[portalnum].areanum);
+		if (clusterareanum < cluster->numreachabilityareas)
+		{
+			clusterareas[clusterareanum] = aasworld.portals[portalnum].areanum;
+		} //end if
+	} //end for
+} //end of the function AAS_ClusterAreas
+//===========================================================================
+// repairs all the area caches of the cluster after the given area was
+// enabled or disabled for routing
+//
+// Parameter:			clusternum		: cluster with the area caches to repair
+//						areanum			: area that was enabled or disabled
+//						enable			: true if the area was enabled
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+static void AAS_RepairRoutingCacheInCluster(int clusternum, int areanum, int enable)
+{
+	int i, numreachabilityareas, *clusterareas;
+	aas_routingcache_t *cache;
+	aas_cluster_t *cluster;
+
+	if (!aasworld.clusterareacache)
+		return;
+	cluster = &aasworld.clusters[clusternum];
+	numreachabilityareas = cluster->numreachabilityareas;
+	//areas without reachabilities are never routed through
+	if (AAS_ClusterAreaNum(clusternum, areanum) >= numreachabilityareas)
+		return;
+	clusterareas = (int *) GetClearedMemory(numreachabilityareas * sizeof(int));
+	AAS_ClusterAreas(clusternum, clusterareas);
+	for (i = 0; i < cluster->numareas; i++)
+	{
+		for (cache = aasworld.clusterareacache[clusternum][i]; cache; cache = cache->next)
+		{
+			AAS_RepairAreaRoutingCache(cache, areanum, enable, clusterareas);
+		} //end for
+	} //end for
+	FreeMemory(clusterareas);
+} //end of the function AAS_RepairRoutingCacheInCluster
+//===========================================================================
+// returns true if the portal cache routes through the given cluster
+//
+// Parameter:			portalcache		: portal cache to check
+//						clusternum		: cluster to check
+// Returns:				qtrue if the portal cache uses the area caches of the cluster
+// Changes Globals:		-
+//===========================================================================
+static qboolean AAS_PortalCacheInCluster(aas_routingcache_t *portalcache, int clusternum)
+{
+	int i;
+	aas_cluster_t *cluster;
+
+	if (portalcache->cluster == clusternum) return qtrue;
+	//the cluster is routed through when one of its portals is reached
+	cluster = &aasworld.clusters[clusternum];
+	for (i = 0; i < cluster->numportals; i++)
+	{
+		if (portalcache->traveltimes[aasworld.portalindex[cluster->firstportal + i]]) return qtrue;
+	} //end for
+	return qfalse;
+} //end of the function AAS_PortalCacheInCluster
+//===========================================================================
+// repairs the routing cache after the given area was enabled or disabled
+// for routing, the area caches of the cluster(s) of the area are repaired
+// and the portal caches routing through them are removed
+//
+// Parameter:			areanum			: area that was enabled or disabled
+//						enable			: true if the area was enabled
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+void AAS_RepairRoutingCacheUsingArea(int areanum, int enable)
+{
+	int i, clusternum, frontcluster, backcluster;
+	aas_routingcache_t *cache, *nextcache;
+
+	clusternum = aasworld.areasettings[areanum].cluster;
+	if (clusternum > 0)
+	{
+		frontcluster = backcluster = clusternum;
+	} //end if
+	else
+	{
+		//if this is a portal repair the cache in both the front and back cluster
+		frontcluster = aasworld.portals[-clusternum].frontcluster;
+		backcluster = aasworld.portals[-clusternum].backcluster;
+	} //end else
+	AAS_RepairRoutingCacheInCluster(frontcluster, areanum, enable);
+	if (backcluster != frontcluster)
+	{
+		AAS_RepairRoutingCacheInCluster(backcluster, areanum, enable);
+	} //end if
+	//remove the portal cache routing through the cluster(s)
+	if (!aasworld.portalcache)
+		return;
+	for (i = 0; i < aasworld.numareas; i++)
+	{
+		for (cache = aasworld.portalcache[i]; cache; cache = nextcache)
+		{
+			nextcache = cache->next;
+			if (!AAS_PortalCacheInCluster(cache, frontcluster) &&
+					!AAS_PortalCacheInCluster(cache, backcluster)) continue;
+			if (cache->prev) cache->prev->next = cache->next;
+			else aasworld.portalcache[i] = cache->next;
+			if (cache->next) cache->next->prev = cache->prev;
+			AAS_FreeRoutingCache(cache);
+		} //end for
+	} //end for
+} //end of the function AAS_RepairRoutingCacheUsingArea
+//===========================================================================
+// returns a routing cache which isn't linked into the cluster or portal
+// cache lists, used by the benchmark and the route table
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+static aas_routingcache_t *AAS_AllocPrivateRoutingCache(int type, int clusternum, int areanum, int numtraveltimes)
+{
+	aas_routingcache_t *cache;
+
+	cache = AAS_AllocRoutingCache(numtraveltimes);
+	cache->type = type;
+	cache->cluster = clusternum;
+	cache->areanum = areanum;
+	VectorCopy(aasworld.areas[areanum].center, cache->origin);
+	cache->starttraveltime = 1;
+	cache->travelflags = TFL_DEFAULT;
+	return cache;
+} //end of the function AAS_AllocPrivateRoutingCache
+//===========================================================================
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+static void AAS_ClearPrivateRoutingCache(aas_routingcache_t *cache, int numtraveltimes)
+{
+	Com_Memset(cache->traveltimes, 0, numtraveltimes * sizeof(unsigned short int));
+	Com_Memset(cache->reachabilities, 0, numtraveltimes * sizeof(unsigned char));
+} //end of the function AAS_ClearPrivateRoutingCache
+//===========================================================================
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+static void AAS_FreePrivateRoutingCache(aas_routingcache_t *cache)
+{
+	routingcachesize -= cache->size;
+	FreeMemory(cache);
+} //end of the function AAS_FreePrivateRoutingCache
+//===========================================================================
+// returns a random area with reachabilities
+//
+// Parameter:			seed		: random seed
+// Returns:				area number
+// Changes Globals:		-
+//===========================================================================
+static int AAS_RoutingBenchArea(unsigned int *seed)
+{
+	int i, areanum;
+
+	for (i = 0; i < 4096; i++)
+	{
+		*seed = *seed * 1103515245 + 12345;
+		areanum = 1 + (*seed >> 8) % (aasworld.numareas - 1);
+		if (aasworld.areasettings[areanum].numreachableareas) return areanum;
+	} //end for
+	return 0;
+} //end of the function AAS_RoutingBenchArea
+//===========================================================================
+// returns the cluster the routing towards the area starts in
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+static int AAS_RoutingGoalCluster(int areanum)
+{
+	int clusternum;
+
+	clusternum = aasworld.areasettings[areanum].cluster;
+	if (clusternum < 0) clusternum = aasworld.portals[-clusternum].frontcluster;
+	return clusternum;
+} //end of the function AAS_RoutingGoalCluster
+//===========================================================================
+// times the routing cache updates and the repairs after enabling or
+// disabling an area on the loaded AAS file
+// the routing caches used by the bots are not changed
+//
+// Parameter:			numcaches		: number of area and portal caches to update
+//						numtoggles		: number of areas to disable and enable again
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+void AAS_RoutingBench(int numcaches, int numtoggles)
+{
+	int i, j, k, pass, n, areanum, clusternum, enable, numupdates, numdiffs, numrepaired;
+	int *goalareas, *clusterareas;
+	unsigned int seed;
+	int64_t starttime, areatime, portaltime, repairtime, rebuildtime;
+	aas_routingcache_t **caches, **refcaches;
+
+	if (!aasworld.initialized)
+	{
+		botimport.Print(PRT_ERROR, "AAS_RoutingBench: AAS not initialized\n");
+		return;
+	} //end if
+	if (numcaches < 1) numcaches = 1;
+	if (numtoggles < 0) numtoggles = 0;
+	botimport.Print(PRT_MESSAGE, "routing bench on %s: %d areas, %d clusters, %d portals\n",
+						aasworld.filename, aasworld.numareas, aasworld.numclusters, aasworld.numportals);
+	seed = 0x5eed;
+	goalareas = (int *) GetMemory(numcaches * sizeof(int));
+	caches = (aas_routingcache_t **) GetClearedMemory(numcaches * 2 * sizeof(aas_routingcache_t *));
+	refcaches = caches + numcaches;
+	for (i = 0; i < numcaches; i++)
+	{
+		goalareas[i] = AAS_RoutingBenchArea(&seed);
+		if (!goalareas[i]) break;
+	} //end for
+	numcaches = i;
+	if (!numcaches)
+	{
+		botimport.Print(PRT_MESSAGE, "no areas with reachabilities\n");
+		FreeMemory(caches);
+		FreeMemory(goalareas);
+		return;
+	} //end if
+	//area cache updates
+	for (i = 0; i < numcaches; i++)
+	{
+		clusternum = AAS_RoutingGoalCluster(goalareas[i]);
+		caches[i] = AAS_AllocPrivateRoutingCache(CACHETYPE_AREA, clusternum, goalareas[i],
+									aasworld.clusters[clusternum].numreachabilityareas);
+	} //end for
+	areatime = 0;
+	for (pass = 0; pass < 4; pass++)
+	{
+		for (i = 0; i < numcaches; i++)
+		{
+			AAS_ClearPrivateRoutingCache(caches[i], aasworld.clusters[caches[i]->cluster].numreachabilityareas);
+		} //end for
+		starttime = botimport.Sys_Microseconds();
+		for (i = 0; i < numcaches; i++)
+		{
+			AAS_UpdateAreaRoutingCache(caches[i]);
+		} //end for
+		areatime += botimport.Sys_Microseconds() - starttime;
+	} //end for
+	numupdates = pass * numcaches;
+	botimport.Print(PRT_MESSAGE, "%d area cache updates: %.1f usec each, %.0f updates/sec\n",
+						numupdates, (double) areatime / numupdates,
+						areatime ? numupdates * 1000000.0 / areatime : 0.0);
+	for (i = 0; i < numcaches; i++)
+	{
+		AAS_FreePrivateRoutingCache(caches[i]);
+	} //end for
+	//portal cache updates, the first pass creates the area caches towards the portals
+	for (i = 0; i < numcaches; i++)
+	{
+		caches[i] = AAS_AllocPrivateRoutingCache(CACHETYPE_PORTAL, AAS_RoutingGoalCluster(goalareas[i]),
+											goalareas[i], aasworld.numportals);
+	} //end for
+	portaltime = 0;
+	for (pass = 0; pass < 5; pass++)
+	{
+		for (i = 0; i < numcaches; i++)
+		{
+			AAS_ClearPrivateRoutingCache(caches[i], aasworld.numportals);
+		} //end for
+		starttime = botimport.Sys_Microseconds();
+		for (i = 0; i < numcaches; i++)
+		{
+			AAS_UpdatePortalRoutingCache(caches[i]);
+		} //end for
+		if (pass) portaltime += botimport.Sys_Microseconds() - starttime;
+	} //end for
+	numupdates = (pass - 1) * numcaches;
+	botimport.Print(PRT_MESSAGE, "%d portal cache updates: %.1f usec each, %.0f updates/sec\n",
+						numupdates, (double) portaltime / numupdates,
+						portaltime ? numupdates * 1000000.0 / portaltime : 0.0);
+	for (i = 0; i < numcaches; i++)
+	{
+		AAS_FreePrivateRoutingCache(caches[i]);
+		caches[i] = NULL;
+	} //end for
+	//disable and enable again areas with all the area caches of their cluster
+	repairtime = rebuildtime = 0;
+	numdiffs = numrepaired = 0;
+	for (k = 0; k < numtoggles; k++)
+	{
+		areanum = AAS_RoutingBenchArea(&seed);
+		clusternum = AAS_RoutingGoalCluster(areanum);
+		n = aasworld.clusters[clusternum].numreachabilityareas;
+		clusterareas = (int *) GetClearedMemory(n * sizeof(int));
+		AAS_ClusterAreas(clusternum, clusterareas);
+		numupdates = n < numcaches ? n : numcaches;
+		for (i = 0; i < numupdates; i++)
+		{
+			j = (int) ((long long) i * n / numupdates);
+			caches[i] = AAS_AllocPrivateRoutingCache(CACHETYPE_AREA, clusternum, clusterareas[j], n);
+			refcaches[i] = AAS_AllocPrivateRoutingCache(CACHETYPE_AREA, clusternum, clusterareas[j], n);
+			AAS_UpdateAreaRoutingCache(caches[i]);
+		} //end for
+		for (pass = 0; pass < 2; pass++)
+		{
+			aasworld.areasettings[areanum].areaflags ^= AREA_DISABLED;
+			enable = !(aasworld.areasettings[areanum].areaflags & AREA_DISABLED);
+			//repair the caches
+			starttime = botimport.Sys_Microseconds();
+			for (i = 0; i < numupdates; i++)
+			{
+				AAS_RepairAreaRoutingCache(caches[i], areanum, enable, clusterareas);
+			} //end for
+			repairtime += botimport.Sys_Microseconds() - starttime;
+			//create the caches from scratch
+			starttime = botimport.Sys_Microseconds();
+			for (i = 0; i < numupdates; i++)
+			{
+				AAS_ClearPrivateRoutingCache(refcaches[i], n);
+				AAS_UpdateAreaRoutingCache(refcaches[i]);
+			} //end for
+			rebuildtime += botimport.Sys_Microseconds() - starttime;
+			//the repaired travel times should be the same
+			for (i = 0; i < numupdates; i++)
+			{
+				for (j = 0; j < n; j++)
+				{
+					if (caches[i]->traveltimes[j] != refcaches[i]->traveltimes[j]) numdiffs++;
+				} //end for
+			} //end for
+		} //end for
+		numrepaired += numupdates;
+		for (i = 0; i < numupdates; i++)
+		{
+			AAS_FreePrivateRoutingCache(caches[i]);
+			AAS_FreePrivateRoutingCache(refcaches[i]);
+		} //end for
+		FreeMemory(clusterareas);
+	} //end for
+	if (numtoggles)
+	{
+		botimport.Print(PRT_MESSAGE, "%d area toggles with %d area caches: repair %.1f usec, rebuild %.1f usec per toggle\n",
+							numtoggles * 2, numrepaired * 2, (double) repairtime / (numtoggles * 2),
+							(double) rebuildtime / (numtoggles * 2));
+		botimport.Print(PRT_MESSAGE, "%d repaired travel times differ from rebuilt caches\n", numdiffs);
+	} //end if
+	FreeMemory(caches);
+	FreeMemory(goalareas);
+} //end of the function AAS_RoutingBench
+//===========================================================================
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+
+//the route table header
+//this header is followed by the area tables of all the clusters and the
+//portal tables of all the areas, the tables have a row for every goal area
+//with the travel times and reachabilities towards that goal area
+typedef struct routetableheader_s
+{
+	int ident;
+	int version;
+	int numareas;
+	int numclusters;
+	int numportals;
+	int reachabilitysize;
+	int areacrc;
+	int settingscrc;
+	int reachabilitycrc;
+	int portalcrc;
+	int clustercrc;
+	int travelflags;
+	int size;
+} routetableheader_t;
+
+#define RTID						(('L'<<24)+('B'<<16)+('T'<<8)+'R')
+#define RTVERSION					1
+//maximum size of a route table file
+#define MAX_ROUTETABLESIZE			(1<<30)
+//number of route queries compared after creating the route table
+#define ROUTETABLE_NUMQUERIES		1024
+
+//===========================================================================
+// returns the size of a route table row, the travel times of the next row
+// stay aligned
+//
+// Parameter:			numtraveltimes	: number of travel times in the row
+// Returns:				size of the row in bytes
+// Changes Globals:		-
+//===========================================================================
+static ID_INLINE int AAS_RouteTableRowSize(int numtraveltimes)
+{
+	return (numtraveltimes * (sizeof(unsigned short int) + sizeof(unsigned char)) + 1) & ~1;
+} //end of the function AAS_RouteTableRowSize
+//===========================================================================
+// returns the size of the route table file for the loaded AAS file
+//
+// Parameter:			-
+// Returns:				size of the route table or -1 if it would be too large
+// Changes Globals:		-
+//===========================================================================
+static int AAS_RouteTableSize(void)
+{
+	int i, n;
+	int64_t size;
+
+	size = sizeof(routetableheader_t);
+	for (i = 0; i < aasworld.numclusters; i++)
+	{
+		n = aasworld.clusters[i].numreachabilityareas;
+		size += (int64_t) n * AAS_RouteTableRowSize(n);
+	} //end for
+	size += (int64_t) aasworld.numareas * AAS_RouteTableRowSize(aasworld.numportals);
+	if (size > MAX_ROUTETABLESIZE) return -1;
+	return (int) size;
+} //end of the function AAS_RouteTableSize
+//===========================================================================
+// returns the CRC of the area settings without the flag used to disable
+// areas while routing
+//
+// Parameter:			-
+// Returns:				CRC of the area settings
+// Changes Globals:		-
+//===========================================================================
+static int AAS_AreaSettingsCRC(void)
+{
+	int i;
+	unsigned short crc;
+	aas_areasettings_t settings;
+
+	CRC_Init(&crc);
+	for (i = 0; i < aasworld.numareasettings; i++)
+	{
+		settings = aasworld.areasettings[i];
+		settings.areaflags &= ~AREA_DISABLED;
+		CRC_ContinueProcessString(&crc, (char *) &settings, sizeof(aas_areasettings_t));
+	} //end for
+	return CRC_Value(crc);
+} //end of the function AAS_AreaSettingsCRC
+//===========================================================================
+// fills in the route table header for the loaded AAS file
+//
+// Parameter:			header		: header to fill in
+//						size		: size of the route table file
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+static void AAS_RouteTableHeader(routetableheader_t *header, int size)
+{
+	Com_Memset(header, 0, sizeof(routetableheader_t));
+	header->ident = RTID;
+	header->version = RTVERSION;
+	header->numareas = aasworld.numareas;
+	header->numclusters = aasworld.numclusters;
+	header->numportals = aasworld.numportals;
+	header->reachabilitysize = aasworld.reachabilitysize;
+	header->areacrc = CRC_ProcessString( (unsigned char *)aasworld.areas, sizeof(aas_area_t) * aasworld.numareas );
+	header->settingscrc = AAS_AreaSettingsCRC();
+	header->reachabilitycrc = CRC_ProcessString( (unsigned char *)aasworld.reachability, sizeof(aas_reachability_t) * aasworld.reachabilitysize );
+	header->portalcrc = CRC_ProcessString( (unsigned char *)aasworld.portals, sizeof(aas_portal_t) * aasworld.numportals );
+	header->clustercrc = CRC_ProcessString( (unsigned char *)aasworld.clusters, sizeof(aas_cluster_t) * aasworld.numclusters );
+	header->travelflags = TFL_DEFAULT;
+	header->size = size;
+} //end of the function AAS_RouteTableHeader
+//===========================================================================
+// keeps track of the disabled areas, the route table isn't used for the
+// area caches of a cluster with disabled areas and the portal caches
+// routing through such a cluster
+//
+// Parameter:			areanum		: area that was enabled or disabled
+//						enable		: true if the area was enabled
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+void AAS_RouteTableEnableArea(int areanum, int enable)
+{
+	int clusternum, change;
+	aas_portal_t *portal;
+	aas_routetable_t *table;
+
+	table = &aasworld.routetable;
+	if (!table->data) return;
+	change = enable ? -1 : 1;
+	table->numdisabledareas += change;
+	clusternum = aasworld.areasettings[areanum].cluster;
+	if (clusternum > 0)
+	{
+		table->clusterdisabledareas[clusternum] += change;
+	} //end if
+	else
+	{
+		//a portal is used for routing in both the front and back cluster
+		portal = &aasworld.portals[-clusternum];
+		table->clusterdisabledareas[portal->frontcluster] += change;
+		if (portal->backcluster != portal->frontcluster)
+		{
+			table->clusterdisabledareas[portal->backcluster] += change;
+		} //end if
+	} //end else
+} //end of the function AAS_RouteTableEnableArea
+//===========================================================================
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+void AAS_FreeRouteTable(void)
+{
+	aas_routetable_t *table;
+
+	table = &aasworld.routetable;
+	if (table->data)
+	{
+		if (table->mapped) botimport.FS_UnmapFile(table->data, table->size);
+		else free((void *) table->data);
+	} //end if
+	if (table->clusterrows) FreeMemory((void *) table->clusterrows);
+	if (table->clusterdisabledareas) FreeMemory(table->clusterdisabledareas);
+	Com_Memset(table, 0, sizeof(aas_routetable_t));
+} //end of the function AAS_FreeRouteTable
+//===========================================================================
+// maps the precomputed route table of the map, the route table is read
+// into memory when it's not a loose file
+//
+// Parameter:			-
+// Returns:				qtrue if the route table was loaded
+// Changes Globals:		-
+//===========================================================================
+int AAS_LoadRouteTable(void)
+{
+	int i, size, offset;
+	const byte *data;
+	byte *buf;
+	qboolean mapped;
+	fileHandle_t fp;
+	char filename[MAX_QPATH];
+	routetableheader_t header, fileheader;
+	aas_routetable_t *table;
+
+	AAS_FreeRouteTable();
+	//the route table has to be created from the same AAS data
+	AAS_RouteTableHeader(&header, AAS_RouteTableSize());
+	//
+	Com_sprintf(filename, MAX_QPATH, "maps/%s.rtb", aasworld.mapname);
+	data = botimport.FS_MapFile(filename, &size);
+	mapped = (data != NULL);
+	if (mapped)
+	{
+		if (size != header.size || memcmp(data, &header, sizeof(routetableheader_t)))
+		{
+			botimport.Print(PRT_WARNING, "%s doesn't match the AAS file, route table not used\n", filename);
+			botimport.FS_UnmapFile(data, size);
+			return qfalse;
+		} //end if
+	} //end if
+	else
+	{
+		size = botimport.FS_FOpenFile(filename, &fp, FS_READ);
+		if (!fp)
+		{
+			return qfalse;
+		} //end if
+		//check the header before reading the whole table
+		if (size < (int) sizeof(routetableheader_t) ||
+			botimport.FS_Read(&fileheader, sizeof(routetableheader_t), fp) != (int) sizeof(routetableheader_t) ||
+			size != header.size || memcmp(&fileheader, &header, sizeof(routetableheader_t)))
+		{
+			botimport.FS_FCloseFile(fp);
+			botimport.Print(PRT_WARNING, "%s doesn't match the AAS file, route table not used\n", filename);
+			return qfalse;
+		} //end if
+		//the table can be tens of megabytes, keep it out of the zone
+		buf = (byte *) malloc(size);
+		if (!buf)
+		{
+			botimport.FS_FCloseFile(fp);
+			botimport.Print(PRT_WARNING, "out of memory for %s (%d KB), route table not used\n", filename, size >> 10);
+			return qfalse;
+		} //end if
+		Com_Memcpy(buf, &fileheader, sizeof(routetableheader_t));
+		if (botimport.FS_Read(buf + sizeof(routetableheader_t), size - sizeof(routetableheader_t), fp) !=
+				size - (int) sizeof(routetableheader_t))
+		{
+			botimport.FS_FCloseFile(fp);
+			botimport.Print(PRT_WARNING, "couldn't read %s, route table not used\n", filename);
+			free(buf);
+			return qfalse;
+		} //end if
+		botimport.FS_FCloseFile(fp);
+		data = buf;
+	} //end if
+	//
+	table = &aasworld.routetable;
+	table->data = data;
+	table->size = size;
+	table->mapped = mapped;
+	table->travelflags = header.travelflags;
+	//the area tables of the clusters
+	table->clusterrows = (const byte **) GetClearedMemory(aasworld.numclusters * sizeof(byte *));
+	offset = sizeof(routetableheader_t);
+	for (i = 0; i < aasworld.numclusters; i++)
+	{
+		table->clusterrows[i] = data + offset;
+		offset += aasworld.clusters[i].numreachabilityareas *
+					AAS_RouteTableRowSize(aasworld.clusters[i].numreachabilityareas);
+	} //end for
+	//the portal tables of the areas
+	table->portalrowsize = AAS_RouteTableRowSize(aasworld.numportals);
+	table->portalrows = data + offset;
+	//count the areas already disabled
+	table->clusterdisabledareas = (int *) GetClearedMemory(aasworld.numclusters * sizeof(int));
+	table->numdisabledareas = 0;
+	for (i = 1; i < aasworld.numareas; i++)
+	{
+		if (aasworld.areasettings[i].areaflags & AREA_DISABLED)
+		{
+			AAS_RouteTableEnableArea(i, qfalse);
+		} //end if
+	} //end for
+	botimport.Print(PRT_MESSAGE, "loaded %s (%d KB%s)\n", filename, size >> 10, mapped ? ", mapped" : "");
+	return qtrue;
+} //end of the function AAS_LoadRouteTable
+//===========================================================================
+// frees all the area and portal caches
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+static void AAS_FlushRoutingCaches(void)
+{
+	AAS_FreeAllClusterAreaCache();
+	AAS_InitClusterAreaCache();
+	AAS_FreeAllPortalCache();
+	AAS_InitPortalCache();
+} //end of the function AAS_FlushRoutingCaches
+//===========================================================================
+// writes the travel times and reachabilities of the routing cache as a
+// route table row
+//
+// Parameter:			cache			: routing cache to write or NULL for an empty row
+//						numtraveltimes	: number of travel times in the cache
+//						row				: buffer for the row
+//						fp				: route table file
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+static void AAS_WriteRouteTableRow(aas_routingcache_t *cache, int numtraveltimes, byte *row, fileHandle_t fp)
+{
+	int rowsize;
+
+	rowsize = AAS_RouteTableRowSize(numtraveltimes);
+	Com_Memset(row, 0, rowsize);
+	if (cache)
+	{
+		Com_Memcpy(row, cache->traveltimes, numtraveltimes * sizeof(unsigned short int));
+		Com_Memcpy(row + numtraveltimes * sizeof(unsigned short int), cache->reachabilities,
+						numtraveltimes * sizeof(unsigned char));
+	} //end if
+	botimport.FS_Write(row, rowsize, fp);
+} //end of the function AAS_WriteRouteTableRow
+//===========================================================================
+// compares the first route queries after loading a map with only the
+// routing cache and with the route table
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+static void AAS_RouteTableReport(void)
+{
+	int i, pass, numdiffs, t, *goalareas, *traveltimes, startsize, cachesize[2];
+	unsigned int seed;
+	int64_t starttime, querytime[2];
+	aas_routetable_t table;
+
+	goalareas = (int *) GetClearedMemory(ROUTETABLE_NUMQUERIES * 2 * sizeof(int));
+	traveltimes = (int *) GetClearedMemory(ROUTETABLE_NUMQUERIES * sizeof(int));
+	seed = 1;
+	for (i = 0; i < ROUTETABLE_NUMQUERIES * 2; i++)
+	{
+		goalareas[i] = AAS_RoutingBenchArea(&seed);
+	} //end for
+	numdiffs = 0;
+	table = aasworld.routetable;
+	for (pass = 0; pass < 2; pass++)
+	{
+		//the first pass routes without the route table
+		if (pass == 0) Com_Memset(&aasworld.routetable, 0, sizeof(aas_routetable_t));
+		else aasworld.routetable = table;
+		AAS_FlushRoutingCaches();
+		//
+		startsize = routingcachesize;
+		starttime = botimport.Sys_Microseconds();
+		for (i = 0; i < ROUTETABLE_NUMQUERIES; i++)
+		{
+			t = AAS_AreaTravelTimeToGoalArea(goalareas[i * 2], NULL, goalareas[i * 2 + 1], TFL_DEFAULT);
+			if (pass == 0) traveltimes[i] = t;
+			else if (traveltimes[i] != t) numdiffs++;
+		} //end for
+		querytime[pass] = botimport.Sys_Microseconds() - starttime;
+		cachesize[pass] = routingcachesize - startsize;
+	} //end for
+	botimport.Print(PRT_MESSAGE, "first %d route queries with the routing cache: %.1f msec, %d KB cache\n",
+						ROUTETABLE_NUMQUERIES, querytime[0] / 1000.0, cachesize[0] >> 10);
+	botimport.Print(PRT_MESSAGE, "first %d route queries with the route table: %.1f msec, %d KB cache, %d KB table%s\n",
+						ROUTETABLE_NUMQUERIES, querytime[1] / 1000.0, cachesize[1] >> 10, table.size >> 10,
+						table.mapped ? " mapped" : "");
+	botimport.Print(PRT_MESSAGE, "%d route table travel times differ from the routing cache\n", numdiffs);
+	if (table.numdisabledareas)
+	{
+		botimport.Print(PRT_MESSAGE, "%d areas are disabled, the route table is only used for routes"
+							" not going through clusters with disabled areas\n", table.numdisabledareas);
+	} //end if
+	FreeMemory(traveltimes);
+	FreeMemory(goalareas);
+} //end of the function AAS_RouteTableReport
+//===========================================================================
+// precomputes the travel times of all the area caches and portal caches
+// for the default travel flags and writes them to the route table file
+// of the map, the areas are routed as if none of them is disabled
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+void AAS_WriteRouteTable(void)
+{
+	int i, j, n, size, rowsize, *clusterareas;
+	byte *disabled, *row;
+	int64_t starttime;
+	fileHandle_t fp;
+	char filename[MAX_QPATH];
+	routetableheader_t header;
+	aas_routingcache_t *cache;
+
+	size = AAS_RouteTableSize();
+	if (size < 0)
+	{
+		botimport.Print(PRT_ERROR, "route table for %s would be larger than %d MB\n",
+							aasworld.mapname, MAX_ROUTETABLESIZE >> 20);
+		return;
+	} //end if
+	//the route table might be mapped from the file that is written
+	AAS_FreeRouteTable();
+	//
+	Com_sprintf(filename, MAX_QPATH, "maps/%s.rtb", aasworld.mapname);
+	botimport.FS_FOpenFile( filename, &fp, FS_WRITE );
+	if (!fp)
+	{
+		AAS_Error("Unable to open file: %s\n", filename);
+		return;
+	} //end if
+	starttime = botimport.Sys_Microseconds();
+	AAS_RouteTableHeader(&header, size);
+	botimport.FS_Write(&header, sizeof(routetableheader_t), fp);
+	//route with all the areas enabled
+	disabled = (byte *) GetClearedMemory(aasworld.numareas * sizeof(byte));
+	for (i = 0; i < aasworld.numareas; i++)
+	{
+		if (aasworld.areasettings[i].areaflags & AREA_DISABLED)
+		{
+			aasworld.areasettings[i].areaflags &= ~AREA_DISABLED;
+			disabled[i] = qtrue;
+		} //end if
+	} //end for
+	AAS_FlushRoutingCaches();
+	//
+	rowsize = AAS_RouteTableRowSize(aasworld.numportals);
+	for (i = 0; i < aasworld.numclusters; i++)
+	{
+		rowsize = Maximum(rowsize, AAS_RouteTableRowSize(aasworld.clusters[i].numreachabilityareas));
+	} //end for
+	row = (byte *) GetMemory(rowsize);
+	//the area tables with a row for every reachability area in the cluster
+	for (i = 0; i < aasworld.numclusters; i++)
+	{
+		n = aasworld.clusters[i].numreachabilityareas;
+		if (!n) continue;
+		clusterareas = (int *) GetClearedMemory(n * sizeof(int));
+		AAS_ClusterAreas(i, clusterareas);
+		cache = AAS_AllocPrivateRoutingCache(CACHETYPE_AREA, i, clusterareas[0], n);
+		for (j = 0; j < n; j++)
+		{
+			if (!clusterareas[j])
+			{
+				AAS_WriteRouteTableRow(NULL, n, row, fp);
+				continue;
+			} //end if
+			cache->areanum = clusterareas[j];
+			AAS_ClearPrivateRoutingCache(cache, n);
+			AAS_UpdateAreaRoutingCache(cache);
+			AAS_WriteRouteTableRow(cache, n, row, fp);
+		} //end for
+		AAS_FreePrivateRoutingCache(cache);
+		FreeMemory(clusterareas);
+	} //end for
+	//the portal tables with a row for every area
+	n = aasworld.numportals;
+	cache = AAS_AllocPrivateRoutingCache(CACHETYPE_PORTAL, 0, 0, n);
+	for (i = 0; i < aasworld.numareas; i++)
+	{
+		if (!i || !aasworld.areasettings[i].numreachableareas)
+		{
+			AAS_WriteRouteTableRow(NULL, n, row, fp);
+			continue;
+		} //end if
+		cache->cluster = AAS_RoutingGoalCluster(i);
+		cache->areanum = i;
+		AAS_ClearPrivateRoutingCache(cache, n);
+		AAS_UpdatePortalRoutingCache(cache);
+		AAS_WriteRouteTableRow(cache, n, row, fp);
+		//the portal cache updates fill the area caches
+		while (routingcachesize > max_routingcachesize && AAS_FreeOldestCache())
+			;
+	} //end for
+	AAS_FreePrivateRoutingCache(cache);
+	FreeMemory(row);
+	botimport.FS_FCloseFile(fp);
+	//route with the disabled areas again
+	AAS_FlushRoutingCaches();
+	for (i = 0; i < aasworld.numareas; i++)
+	{
+		if (disabled[i]) aasworld.areasettings[i].areaflags |= AREA_DISABLED;
+	} //end for
+	FreeMemory(disabled);
+	botimport.Print(PRT_MESSAGE, "route table written to %s, %d KB in %.1f sec\n", filename, size >> 10,
+						(botimport.Sys_Microseconds() - starttime) / 1000000.0);
+	//
+	if (AAS_LoadRouteTable())
+	{
+		AAS_RouteTableReport();
+	} //end if
+} //end of the function AAS_WriteRouteTable
+//===========================================================================
+// returns the travel times and reachabilities towards the goal area within
+// the cluster, from the route table when possible or else from the area
+// routing cache
+//
+// Parameter:			clusternum		: cluster to route in
+//						areanum			: goal area
+//						travelflags		: allowed travel types
+//						traveltimes		: travel time for every area in the cluster
+//						reachabilities	: reachability to use for every area in the cluster
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+static ID_INLINE void AAS_AreaRoutingTimes(int clusternum, int areanum, int travelflags,
+								const unsigned short int **traveltimes, const unsigned char **reachabilities)
+{
+	int n, clusterareanum;
+	const byte *row;
+	aas_routingcache_t *cache;
+	aas_routetable_t *table;
+
+	table = &aasworld.routetable;
+	if (table->data && travelflags == table->travelflags && !table->clusterdisabledareas[clusternum])
+	{
+		n = aasworld.clusters[clusternum].numreachabilityareas;
+		clusterareanum = AAS_ClusterAreaNum(clusternum, areanum);
+		if (clusterareanum < n)
+		{
+			row = table->clusterrows[clusternum] + clusterareanum * AAS_RouteTableRowSize(n);
+			*traveltimes = (const unsigned short int *) row;
+			*reachabilities = row + n * sizeof(unsigned short int);
+			if (!aasworld.parallelrouting) numroutetablelookups++;
+			return;
+		} //end if
+	} //end if
+	cache = AAS_GetAreaRoutingCache(clusternum, areanum, travelflags);
+	*traveltimes = cache->traveltimes;
+	*reachabilities = cache->reachabilities;
+} //end of the function AAS_AreaRoutingTimes
+//===========================================================================
+// returns true if the portal table row of the route table can be used with
+// the disabled areas, the travel times only change when a cluster with
+// disabled areas is routed through
+//
+// Parameter:			traveltimes		: travel times of the portal table row
+//						clusternum		: cluster of the goal area
+// Returns:				qtrue if the portal table row can be used
+// Changes Globals:		-
+//===========================================================================
+static qboolean AAS_RouteTablePortalRowValid(const unsigned short int *traveltimes, int clusternum)
+{
+	int i, j;
+	aas_cluster_t *cluster;
+	aas_routetable_t *table;
+
+	table = &aasworld.routetable;
+	if (!table->numdisabledareas) return qtrue;
+	for (i = 1; i < aasworld.numclusters; i++)
+	{
+		if (!table->clusterdisabledareas[i]) continue;
+		if (i == clusternum) return qfalse;
+		//the cluster is routed through when one of its portals is reached
+		cluster = &aasworld.clusters[i];
+		for (j = 0; j < cluster->numportals; j++)
+		{
+			if (traveltimes[aasworld.portalindex[cluster->firstportal + j]]) return qfalse;
+		} //end for
+	} //end for
+	return qtrue;
+} //end of the function AAS_RouteTablePortalRowValid
+//===========================================================================
+// returns the travel times and reachabilities from all the portals towards
+// the goal area, from the route table when possible or else from the portal
+// routing cache
+//
+// Parameter:			clusternum		: cluster of the goal area
+//						areanum			: goal area
+//						travelflags		: allowed travel types
+//						traveltimes		: travel time for every portal
+//						reachabilities	: reachability to use for every portal
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+static ID_INLINE void AAS_PortalRoutingTimes(int clusternum, int areanum, int travelflags,
+								const unsigned short int **traveltimes, const unsigned char **reachabilities)
+{
+	const byte *row;
+	aas_routingcache_t *cache;
+	aas_routetable_t *table;
+
+	table = &aasworld.routetable;
+	if (table->data && travelflags == table->travelflags)
+	{
+		row = table->portalrows + areanum * table->portalrowsize;
+		if (AAS_RouteTablePortalRowValid((const unsigned short int *) row, clusternum))
+		{
+			*traveltimes = (const unsigned short int *) row;
+			*reachabilities = row + aasworld.numportals * sizeof(unsigned short int);
+			if (!aasworld.parallelrouting) numroutetablelookups++;
+			return;
+		} //end if
+	} //end if
+	cache = AAS_GetPortalRoutingCache(clusternum, areanum, travelflags);
+	*traveltimes = cache->traveltimes;
+	*reachabilities = cache->reachabilities;
+} //end of the function AAS_PortalRoutingTimes
+//===========================================================================
 //
 // Parameter:			-
 // Returns:				-
@@ -1591,9 +3029,10 @@ int AAS_AreaRouteToGoalArea(int areanum, vec3_t origin, int goalareanum, int tra
 {
 	int clusternum, goalclusternum, portalnum, i, clusterareanum, bestreachnum;
 	unsigned short int t, besttime;
+	const unsigned short int *traveltimes, *portaltraveltimes;
+	const unsigned char *reachabilities, *portalreachabilities;
 	aas_portal_t *portal;
 	aas_cluster_t *cluster;
-	aas_routingcache_t *areacache, *portalcache;
 	aas_reachability_t *reach;
 
 	if (!aasworld.initialized) return qfalse;
@@ -1626,12 +3065,12 @@ int AAS_AreaRouteToGoalArea(int areanum, vec3_t origin, int goalareanum, int tra
 		return qfalse;
 	} //end if
 
-	// make sure the routing cache doesn't grow to large
-	while ( routingcachesize > 12 * 1024 * 1024 ) {
-		if ( !AAS_FreeOldestCache() ) {
-			break;
-		}
-	}
+	// make sure the routing cache doesn't grow to large,
+	// caches may still be in use by other threads when routing in parallel
+	if (!aasworld.parallelrouting)
+	{
+		AAS_TrimRoutingCache();
+	} //end if
 
 	//
 	if (AAS_AreaDoNotEnter(areanum) || AAS_AreaDoNotEnter(goalareanum))
@@ -1676,7 +3115,7 @@ int AAS_AreaRouteToGoalArea(int areanum, vec3_t origin, int goalareanum, int tra
 	if (clusternum > 0 && goalclusternum > 0 && clusternum == goalclusternum)
 	{
 		//
-		areacache = AAS_GetAreaRoutingCache(clusternum, goalareanum, travelflags);
+		AAS_AreaRoutingTimes(clusternum, goalareanum, travelflags, &traveltimes, &reachabilities);
 		//the number of the area in the cluster
 		clusterareanum = AAS_ClusterAreaNum(clusternum, areanum);
 		//the cluster the area is in
@@ -1684,16 +3123,16 @@ int AAS_AreaRouteToGoalArea(int areanum, vec3_t origin, int goalareanum, int tra
 		//if the area is NOT a reachability area
 		if (clusterareanum >= cluster->numreachabilityareas) return 0;
 		//if it is possible to travel to the goal area through this cluster
-		if (areacache->traveltimes[clusterareanum] != 0)
+		if (traveltimes[clusterareanum] != 0)
 		{
 			*reachnum = aasworld.areasettings[areanum].firstreachablearea +
-							areacache->reachabilities[clusterareanum];
+							reachabilities[clusterareanum];
 			if (!origin) {
-				*traveltime = areacache->traveltimes[clusterareanum];
+				*traveltime = traveltimes[clusterareanum];
 				return qtrue;
 			}
 			reach = &aasworld.reachability[*reachnum];
-			*traveltime = areacache->traveltimes[clusterareanum] +
+			*traveltime = traveltimes[clusterareanum] +
 							AAS_AreaTravelTime(areanum, origin, reach->start);
 			//
 			return qtrue;
@@ -1710,13 +3149,13 @@ int AAS_AreaRouteToGoalArea(int areanum, vec3_t origin, int goalareanum, int tra
 		goalclusternum = portal->frontcluster;
 	} //end if
 	//get the portal routing cache
-	portalcache = AAS_GetPortalRoutingCache(goalclusternum, goalareanum, travelflags);
+	AAS_PortalRoutingTimes(goalclusternum, goalareanum, travelflags, &portaltraveltimes, &portalreachabilities);
 	//if the area is a cluster portal, read directly from the portal cache
 	if (clusternum < 0)
 	{
-		*traveltime = portalcache->traveltimes[-clusternum];
+		*traveltime = portaltraveltimes[-clusternum];
 		*reachnum = aasworld.areasettings[areanum].firstreachablearea +
-						portalcache->reachabilities[-clusternum];
+						portalreachabilities[-clusternum];
 		return qtrue;
 	} //end if
 	//
@@ -1729,20 +3168,20 @@ int AAS_AreaRouteToGoalArea(int areanum, vec3_t origin, int goalareanum, int tra
 	{
 		portalnum = aasworld.portalindex[cluster->firstportal + i];
 		//if the goal area isn't reachable from the portal
-		if (!portalcache->traveltimes[portalnum]) continue;
+		if (!portaltraveltimes[portalnum]) continue;
 		//
 		portal = &aasworld.portals[portalnum];
 		//get the cache of the portal area
-		areacache = AAS_GetAreaRoutingCache(clusternum, portal->areanum, travelflags);
+		AAS_AreaRoutingTimes(clusternum, portal->areanum, travelflags, &traveltimes, &reachabilities);
 		//current area inside the current cluster
 		clusterareanum = AAS_ClusterAreaNum(clusternum, areanum);
 		//if the area is NOT a reachability area
 		if (clusterareanum >= cluster->numreachabilityareas) continue;
 		//if the portal is NOT reachable from this area
-		if (!areacache->traveltimes[clusterareanum]) continue;
+		if (!traveltimes[clusterareanum]) continue;
 		//total travel time is the travel time the portal area is from
 		//the goal area plus the travel time towards the portal area
-		t = portalcache->traveltimes[portalnum] + areacache->traveltimes[clusterareanum];
+		t = portaltraveltimes[portalnum] + traveltimes[clusterareanum];
 		//FIXME: add the exact travel time through the actual portal area
 		//NOTE: for now we just add the largest travel time through the portal area
 		//		because we can't directly calculate the exact travel time
@@ -1753,7 +3192,7 @@ int AAS_AreaRouteToGoalArea(int areanum, vec3_t origin, int goalareanum, int tra
 		if (origin)
 		{
 			*reachnum = aasworld.areasettings[areanum].firstreachablearea +
-							areacache->reachabilities[clusterareanum];
+							reachabilities[clusterareanum];
 			reach = aasworld.reachability + *reachnum;
 			t += AAS_AreaTravelTime(areanum, origin, reach->start);
 		} //end if
@@ -2117,7 +3556,7 @@ int AAS_NearestHideArea(int srcnum, vec3_t origin, int areanum, int enemynum, ve
 	//
 	badtravelflags = ~travelflags;
 	//
-	curupdate = &aasworld.areaupdate[areanum];
+	curupdate = &aasworld.routingshards[0].areaupdate[areanum];
 	curupdate->areanum = areanum;
 	VectorCopy(origin, curupdate->start);
 	curupdate->areatraveltimes = aasworld.areatraveltimes[areanum][0];
@@ -2199,7 +3638,7 @@ int AAS_NearestHideArea(int srcnum, vec3_t origin, int areanum, int enemynum, ve
 					bestarea = nextareanum;
 				} //end if
 				hidetraveltimes[nextareanum] = t;
-				nextupdate = &aasworld.areaupdate[nextareanum];
+				nextupdate = &aasworld.routingshards[0].areaupdate[nextareanum];
 				nextupdate->areanum = nextareanum;
 				nextupdate->tmptraveltime = t;
 				//remember where we entered this area
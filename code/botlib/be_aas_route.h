@@ -39,8 +39,18 @@ unsigned short int AAS_AreaTravelTime(int areanum, vec3_t start, vec3_t end);
 //
 void AAS_CreateAllRoutingCache(void);
 void AAS_WriteRouteCache(void);
+//repair the routing cache after an area was enabled or disabled
+void AAS_RepairRoutingCacheUsingArea(int areanum, int enable);
+//map the precomputed route table of the map if available
+int AAS_LoadRouteTable(void);
+//free the precomputed route table
+void AAS_FreeRouteTable(void);
+//keep track of the disabled areas the route table can't be used with
+void AAS_RouteTableEnableArea(int areanum, int enable);
 //
 void AAS_RoutingInfo(void);
+//reset the routing cache statistics
+void AAS_ResetRoutingCacheStats(void);
 #endif //AASINTERN
 
 //returns the travel flag for the given travel type
@@ -59,9 +69,21 @@ int AAS_EnableRoutingArea(int areanum, int enable);
 unsigned short int AAS_AreaTravelTime(int areanum, vec3_t start, vec3_t end);
 //returns the travel time from the area to the goal area using the given travel flags
 int AAS_AreaTravelTimeToGoalArea(int areanum, vec3_t origin, int goalareanum, int travelflags);
+//returns the travel time and the reachability to take from the area to the goal area
+int AAS_AreaRouteToGoalArea(int areanum, vec3_t origin, int goalareanum, int travelflags, int *traveltime, int *reachnum);
 //predict a route up to a stop event
 int AAS_PredictRoute(struct aas_predictroute_s *route, int areanum, vec3_t origin,
 							int goalareanum, int travelflags, int maxareas, int maxtime,
 							int stopevent, int stopcontents, int stoptfl, int stopareanum);
+//time the routing cache updates on the loaded AAS file
+void AAS_RoutingBench(int numcaches, int numtoggles);
+//precompute the route table of the loaded AAS file
+void AAS_WriteRouteTable(void);
+//print the routing cache hit, miss and eviction rates
+void AAS_RoutingCacheStats(int reset);
+//allow routing from several threads at once, returns qfalse if not possible
+int AAS_BeginParallelRouting(void);
+//stop routing from several threads at once
+void AAS_EndParallelRouting(void);
 
 
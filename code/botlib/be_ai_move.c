@@ -963,6 +963,54 @@ int BotPredictVisiblePosition(vec3_t origin, int areanum, bot_goal_t *goal, int
 	return qfalse;
 } //end of the function BotPredictVisiblePosition
 //===========================================================================
+// evaluates the route and the visible position towards the goal for every
+// query, between AAS_BeginParallelRouting and AAS_EndParallelRouting this
+// may be called from several threads at once
+//
+// Parameter:			queries		: move queries
+//						numqueries	: number of move queries
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+void BotMoveQueries(bot_movequery_t *queries, int numqueries)
+{
+	int i, areanum, travelflags;
+	bot_goal_t goal;
+	bot_movequery_t *query;
+
+	for (i = 0; i < numqueries; i++)
+	{
+		query = &queries[i];
+		query->traveltime = 0;
+		query->reachnum = 0;
+		query->visible = qfalse;
+		VectorClear(query->target);
+		//
+		areanum = query->areanum;
+		if (!areanum) areanum = AAS_PointAreaNum(query->origin);
+		Com_Memset(&goal, 0, sizeof(bot_goal_t));
+		VectorCopy(query->goalorigin, goal.origin);
+		goal.areanum = query->goalareanum;
+		if (!goal.areanum) goal.areanum = AAS_PointAreaNum(goal.origin);
+		goal.entitynum = query->goalentitynum;
+		if (!areanum || !goal.areanum) continue;
+		//
+		travelflags = query->travelflags;
+		if (!travelflags) travelflags = TFL_DEFAULT;
+		if (!AAS_AreaRouteToGoalArea(areanum, query->origin, goal.areanum, travelflags,
+										&query->traveltime, &query->reachnum))
+		{
+			query->traveltime = 0;
+			query->reachnum = 0;
+			continue;
+		} //end if
+		if (query->flags & MOVEQUERY_PREDICTVISIBLE)
+		{
+			query->visible = BotPredictVisiblePosition(query->origin, areanum, &goal, travelflags, query->target);
+		} //end if
+	} //end for
+} //end of the function BotMoveQueries
+//===========================================================================
 //
 // Parameter:			-
 // Returns:				-
@@ -125,6 +125,8 @@ int BotReachabilityArea(vec3_t origin, int client);
 int BotMovementViewTarget(int movestate, bot_goal_t *goal, int travelflags, float lookahead, vec3_t target);
 //predict the position of a player based on movement towards a goal
 int BotPredictVisiblePosition(vec3_t origin, int areanum, bot_goal_t *goal, int travelflags, vec3_t target);
+//route and predict the visible position for several bots at once
+void BotMoveQueries(bot_movequery_t *queries, int numqueries);
 //returns the handle of a newly allocated movestate
 int BotAllocMoveState(void);
 //frees the movestate with the given handle
@@ -678,6 +678,11 @@ static void Init_AAS_Export( aas_export_t *aas ) {
 	aas->AAS_AreaTravelTimeToGoalArea = AAS_AreaTravelTimeToGoalArea;
 	aas->AAS_EnableRoutingArea = AAS_EnableRoutingArea;
 	aas->AAS_PredictRoute = AAS_PredictRoute;
+	aas->AAS_RoutingBench = AAS_RoutingBench;
+	aas->AAS_WriteRouteTable = AAS_WriteRouteTable;
+	aas->AAS_RoutingCacheStats = AAS_RoutingCacheStats;
+	aas->AAS_BeginParallelRouting = AAS_BeginParallelRouting;
+	aas->AAS_EndParallelRouting = AAS_EndParallelRouting;
 	//--------------------------------------------
 	// be_aas_altroute.c
 	//--------------------------------------------
@@ -808,6 +813,7 @@ static void Init_AI_Export( ai_export_t *ai ) {
 	ai->BotReachabilityArea = BotReachabilityArea;
 	ai->BotMovementViewTarget = BotMovementViewTarget;
 	ai->BotPredictVisiblePosition = BotPredictVisiblePosition;
+	ai->BotMoveQueries = BotMoveQueries;
 	ai->BotAllocMoveState = BotAllocMoveState;
 	ai->BotFreeMoveState = BotFreeMoveState;
 	ai->BotInitMoveState = BotInitMoveState;
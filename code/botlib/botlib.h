@@ -113,6 +113,31 @@ typedef struct bot_input_s
 	int weapon;				//weapon to use
 } bot_input_t;
 
+//bot move query flags
+#define MOVEQUERY_PREDICTVISIBLE	1	//predict the position from which the goal is visible
+
+//maximum number of move queries evaluated at once
+#define MAX_MOVEQUERIES			1024
+
+//route and visible position query towards a goal, evaluated for many
+//bots at once with BotMoveQueries
+typedef struct bot_movequery_s
+{
+	//input
+	vec3_t origin;			//start origin
+	int areanum;			//start area, 0 to use the area at the origin
+	vec3_t goalorigin;		//goal origin
+	int goalareanum;		//goal area, 0 to use the area at the goal origin
+	int goalentitynum;		//goal entity ignored by the visibility traces
+	int travelflags;		//allowed travel types, 0 for the default travel types
+	int flags;				//MOVEQUERY_? flags
+	//output
+	int traveltime;			//travel time to the goal area, 0 if not reachable
+	int reachnum;			//reachability to take towards the goal area
+	int visible;			//true if a position the goal is visible from was found
+	vec3_t target;			//position on the route the goal is visible from
+} bot_movequery_t;
+
 #ifndef BSPTRACE
 
 #define BSPTRACE
@@ -196,6 +221,8 @@ typedef struct botlib_import_s
 	int			(*FS_Write)( const void *buffer, int len, fileHandle_t f );
 	void		(*FS_FCloseFile)( fileHandle_t f );
 	int			(*FS_Seek)( fileHandle_t f, long offset, fsOrigin_t origin );
+	const void	*(*FS_MapFile)( const char *qpath, int *size );	// NULL if not a loose file
+	void		(*FS_UnmapFile)( const void *data, int size );
 	//debug visualisation stuff
 	int			(*DebugLineCreate)(void);
 	void		(*DebugLineDelete)(int line);
@@ -205,6 +232,12 @@ typedef struct botlib_import_s
 	void		(*DebugPolygonDelete)(int id);
 
 	int			(*Sys_Milliseconds)(void);
+	int64_t		(*Sys_Microseconds)(void);
+	//locks used while routing from several threads at once
+	void		*(*CreateMutex)(void);
+	void		(*DestroyMutex)(void *mutex);
+	void		(*LockMutex)(void *mutex);
+	void		(*UnlockMutex)(void *mutex);
 } botlib_import_t;
 
 typedef struct aas_export_s
@@ -248,6 +281,11 @@ typedef struct aas_export_s
 	int			(*AAS_PredictRoute)(struct aas_predictroute_s *route, int areanum, vec3_t origin,
 							int goalareanum, int travelflags, int maxareas, int maxtime,
 							int stopevent, int stopcontents, int stoptfl, int stopareanum);
+	void		(*AAS_RoutingBench)(int numcaches, int numtoggles);
+	void		(*AAS_WriteRouteTable)(void);
+	void		(*AAS_RoutingCacheStats)(int reset);
+	int			(*AAS_BeginParallelRouting)(void);
+	void		(*AAS_EndParallelRouting)(void);
 	//--------------------------------------------
 	// be_aas_altroute.c
 	//--------------------------------------------
@@ -378,6 +416,7 @@ typedef struct ai_export_s
 	int		(*BotReachabilityArea)(vec3_t origin, int testground);
 	int		(*BotMovementViewTarget)(int movestate, struct bot_goal_s *goal, int travelflags, float lookahead, vec3_t target);
 	int		(*BotPredictVisiblePosition)(vec3_t origin, int areanum, struct bot_goal_s *goal, int travelflags, vec3_t target);
+	void	(*BotMoveQueries)(bot_movequery_t *queries, int numqueries);
 	int		(*BotAllocMoveState)(void);
 	void	(*BotFreeMoveState)(int handle);
 	void	(*BotInitMoveState)(int handle, struct bot_initmove_s *initmove);
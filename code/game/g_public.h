@@ -97,6 +97,20 @@ typedef struct {
 } sharedEntity_t;
 
 
+// one request of G_TRACE_BATCH, same arguments as G_TRACE / G_TRACECAPSULE
+typedef struct {
+	vec3_t		start;
+	vec3_t		mins;
+	vec3_t		maxs;
+	vec3_t		end;
+	int			passEntityNum;
+	int			contentmask;
+	int			capsule;
+} traceRequest_t;
+
+#define	MAX_TRACE_BATCH		1024
+
+
 
 //===============================================================
 
@@ -404,6 +418,12 @@ typedef enum {
 #endif
 
 	// engine extensions
+	G_TRACE_BATCH = 650,	// ( trace_t *results, const traceRequest_t *requests, int count );
+	// G_TRACE or G_TRACECAPSULE for each request, world collision is done in packets
+
+	G_BOT_MOVE_QUERIES,		// ( bot_movequery_t *queries, int count );
+	// BotMoveQueries of the botlib, spread over sv_botThreads worker threads
+
 	G_TRAP_GETVALUE = COM_TRAP_GETVALUE
 
 } gameImport_t;
@@ -62,6 +62,8 @@ static byte *cmod_base;
 cvar_t		*cm_noAreas;
 cvar_t		*cm_noCurves;
 cvar_t		*cm_playerCurveClip;
+cvar_t		*cm_compactTree;
+cvar_t		*cm_patchThreads;
 #endif
 
 static cmodel_t box_model;
@@ -426,6 +428,65 @@ static void CMod_CheckLeafBrushes( void )
 }
 
 
+/*
+=================
+CMod_SetLeafContents
+
+Lets traces skip leafs without brushes they can hit
+=================
+*/
+static void CMod_SetLeafContents( cLeaf_t *leaf )
+{
+	int	i;
+
+	leaf->brushContents = 0;
+	for ( i = 0; i < leaf->numLeafBrushes; i++ ) {
+		leaf->brushContents |= cm.brushes[ cm.leafbrushes[ leaf->firstLeafBrush + i ] ].contents;
+	}
+}
+
+
+/*
+=================
+CMod_BuildCompactTree
+
+Copies node and brush side planes next to the data that
+references them, box hull sides are kept up to date by CM_TempBoxModel
+=================
+*/
+static void CMod_BuildCompactTree( void )
+{
+	const cplane_t	*plane;
+	cNodePlane_t	*out;
+	int				i, count;
+
+	cm.nodePlanes = Hunk_Alloc( cm.numNodes * sizeof( *cm.nodePlanes ), h_high );
+	for ( i = 0, out = cm.nodePlanes; i < cm.numNodes; i++, out++ ) {
+		plane = cm.nodes[ i ].plane;
+		VectorCopy( plane->normal, out->normal );
+		out->dist = plane->dist;
+		out->type = plane->type;
+		out->children[0] = cm.nodes[ i ].children[0];
+		out->children[1] = cm.nodes[ i ].children[1];
+	}
+
+	count = cm.numBrushSides + BOX_SIDES;
+	cm.sidePlanes.normal[0] = Hunk_Alloc( count * sizeof( float ), h_high );
+	cm.sidePlanes.normal[1] = Hunk_Alloc( count * sizeof( float ), h_high );
+	cm.sidePlanes.normal[2] = Hunk_Alloc( count * sizeof( float ), h_high );
+	cm.sidePlanes.dist = Hunk_Alloc( count * sizeof( float ), h_high );
+	cm.sidePlanes.signbits = Hunk_Alloc( count, h_high );
+	for ( i = 0; i < count; i++ ) {
+		plane = cm.brushsides[ i ].plane;
+		cm.sidePlanes.normal[0][ i ] = plane->normal[0];
+		cm.sidePlanes.normal[1][ i ] = plane->normal[1];
+		cm.sidePlanes.normal[2][ i ] = plane->normal[2];
+		cm.sidePlanes.dist[ i ] = plane->dist;
+		cm.sidePlanes.signbits[ i ] = plane->signbits;
+	}
+}
+
+
 /*
 =================
 CMod_LoadBrushSides
@@ -516,7 +577,9 @@ static void CMod_LoadPatches( const lump_t *surfs, const lump_t *verts ) {
 	int			i, j;
 	int			c;
 	cPatch_t	*patch;
-	vec3_t		points[MAX_PATCH_VERTS];
+	patchSource_t *sources;
+	vec3_t		*points;
+	int			numPatches, numPoints;
 	int			width, height;
 	int			shaderNum;
 
@@ -531,6 +594,27 @@ static void CMod_LoadPatches( const lump_t *surfs, const lump_t *verts ) {
 	if (verts->filelen % sizeof(*dv))
 		Com_Error( ERR_DROP, "%s: funny lump size", __func__ );
 
+	// count the patch points
+	numPatches = numPoints = 0;
+	for ( i = 0 ; i < count ; i++ ) {
+		if ( LittleLong( in[i].surfaceType ) != MST_PATCH ) {
+			continue;
+		}
+		c = LittleLong( in[i].patchWidth ) * LittleLong( in[i].patchHeight );
+		if ( c > 0 && c <= MAX_PATCH_VERTS ) {
+			numPoints += c;
+		}
+		numPatches++;
+	}
+
+	if ( !numPatches ) {
+		return;
+	}
+
+	sources = Z_Malloc( numPatches * sizeof( *sources ) + numPoints * sizeof( *points ) );
+	points = (vec3_t *)( sources + numPatches );
+	numPatches = 0;
+
 	// scan through all the surfaces, but only load patches,
 	// not planar faces
 	for ( i = 0 ; i < count ; i++, in++ ) {
@@ -541,28 +625,47 @@ static void CMod_LoadPatches( const lump_t *surfs, const lump_t *verts ) {
 
 		cm.surfaces[ i ] = patch = Hunk_Alloc( sizeof( *patch ), h_high );
 
-		// load the full drawverts onto the stack
+		// load the full drawverts
 		width = LittleLong( in->patchWidth );
 		height = LittleLong( in->patchHeight );
 		c = width * height;
 		if ( c > MAX_PATCH_VERTS ) {
+			Z_Free( sources );
 			Com_Error( ERR_DROP, "%s: MAX_PATCH_VERTS", __func__ );
 		}
 
+		sources[ numPatches ].width = width;
+		sources[ numPatches ].height = height;
+		sources[ numPatches ].points = points;
+		numPatches++;
+
 		dv_p = dv + LittleLong( in->firstVert );
-		for ( j = 0 ; j < c ; j++, dv_p++ ) {
-			points[j][0] = LittleFloat( dv_p->xyz[0] );
-			points[j][1] = LittleFloat( dv_p->xyz[1] );
-			points[j][2] = LittleFloat( dv_p->xyz[2] );
+		for ( j = 0 ; j < c ; j++, dv_p++, points++ ) {
+			(*points)[0] = LittleFloat( dv_p->xyz[0] );
+			(*points)[1] = LittleFloat( dv_p->xyz[1] );
+			(*points)[2] = LittleFloat( dv_p->xyz[2] );
 		}
 
 		shaderNum = LittleLong( in->shaderNum );
 		patch->contents = cm.shaders[shaderNum].contentFlags;
 		patch->surfaceFlags = cm.shaders[shaderNum].surfaceFlags;
+	}
+
+	// create the internal facet structures
+#ifdef BSPC
+	CM_GeneratePatchCollides( sources, numPatches, 1 );
+#else
+	CM_GeneratePatchCollides( sources, numPatches, cm_patchThreads->integer );
+#endif
 
-		// create the internal facet structure
-		patch->pc = CM_GeneratePatchCollide( width, height, points );
+	in = (void *)(cmod_base + surfs->fileofs);
+	for ( i = 0, numPatches = 0 ; i < count ; i++, in++ ) {
+		if ( LittleLong( in->surfaceType ) == MST_PATCH ) {
+			cm.surfaces[ i ]->pc = sources[ numPatches++ ].pc;
+		}
 	}
+
+	Z_Free( sources );
 }
 
 //==================================================================
@@ -603,6 +706,9 @@ Loads in the map and all submodels
 */
 void CM_LoadMap( const char *name, qboolean clientload, int *checksum ) {
 	void			*buf;
+#ifndef BSPC
+	unsigned		sum;
+#endif
 	int				i;
 	dheader_t		header;
 	int				length;
@@ -620,6 +726,16 @@ void CM_LoadMap( const char *name, qboolean clientload, int *checksum ) {
 
     cm_playerCurveClip = Cvar_Get ( "cm_playerCurveClip", "1", CVAR_ARCHIVE_ND | CVAR_CHEAT );
     Cvar_SetDescription( cm_playerCurveClip, "Don't clip player bounding box around curves\nDefault: 1" );
+
+	cm_compactTree = Cvar_Get( "cm_compactTree", "1", CVAR_ARCHIVE_ND );
+	Cvar_SetDescription( cm_compactTree, "Trace through a copy of the collision tree with planes stored in nodes and brush sides, 0 uses the loaded structures\nDefault: 1" );
+
+	cm_patchThreads = Cvar_Get( "cm_patchThreads", "0", 0 );
+	Cvar_CheckRange( cm_patchThreads, "0", "16", CV_INTEGER );
+	Cvar_SetDescription( cm_patchThreads, "Number of threads used to generate curved surface collision on map load:\n"
+		" 0 - one per CPU core\n"
+		" 1 - no threads\n"
+		"Default: 0" );
 #endif
 
 	Com_DPrintf( "%s( '%s', %i )\n", __func__, name, clientload );
@@ -659,6 +775,11 @@ void CM_LoadMap( const char *name, qboolean clientload, int *checksum ) {
 		Com_Error( ERR_DROP, "%s: %s has truncated header", __func__, name );
 	}
 
+#ifndef BSPC
+	if ( FS_PrefetchedChecksum( buf, &sum ) ) {
+		*checksum = cm.checksum = LittleLong( sum );
+	} else
+#endif
 	*checksum = cm.checksum = LittleLong( Com_BlockChecksum( buf, length ) );
 
 	header = *(dheader_t *)buf;
@@ -696,11 +817,20 @@ void CM_LoadMap( const char *name, qboolean clientload, int *checksum ) {
 
 	CMod_CheckLeafBrushes();
 
+	for ( i = 0; i < cm.numLeafs; i++ ) {
+		CMod_SetLeafContents( &cm.leafs[ i ] );
+	}
+	for ( i = 0; i < cm.numSubModels; i++ ) {
+		CMod_SetLeafContents( &cm.cmodels[ i ].leaf );
+	}
+
 	// we are NOT freeing the file, because it is cached for the ref
 	FS_FreeFile( buf );
 
 	CM_InitBoxHull();
 
+	CMod_BuildCompactTree();
+
 	CM_FloodAreaConnections();
 
 	// allow this to be cached if it is loaded by the server
@@ -815,6 +945,7 @@ void CM_InitBoxHull( void )
 	box_brush->contents = CONTENTS_BODY;
 
 	box_model.leaf.numLeafBrushes = 1;
+	box_model.leaf.brushContents = CONTENTS_BODY;
 //	box_model.leaf.firstLeafBrush = cm.numBrushes;
 	box_model.leaf.firstLeafBrush = cm.numLeafBrushes;
 	cm.leafbrushes[cm.numLeafBrushes] = cm.numBrushes;
@@ -856,6 +987,7 @@ Capsules are handled differently though.
 ===================
 */
 clipHandle_t CM_TempBoxModel( const vec3_t mins, const vec3_t maxs, int capsule ) {
+	int i;
 
 	VectorCopy( mins, box_model.mins );
 	VectorCopy( maxs, box_model.maxs );
@@ -877,6 +1009,12 @@ clipHandle_t CM_TempBoxModel( const vec3_t mins, const vec3_t maxs, int capsule
 	box_planes[10].dist = mins[2];
 	box_planes[11].dist = -mins[2];
 
+	if ( cm.sidePlanes.dist ) {
+		for ( i = 0; i < BOX_SIDES; i++ ) {
+			cm.sidePlanes.dist[ cm.numBrushSides + i ] = box_planes[ i * 2 + ( i & 1 ) ].dist;
+		}
+	}
+
 	VectorCopy( mins, box_brush->bounds[0] );
 	VectorCopy( maxs, box_brush->bounds[1] );
 
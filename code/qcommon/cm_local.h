@@ -84,6 +84,7 @@ typedef struct {
 
 	int			firstLeafBrush;
 	int			numLeafBrushes;
+	int			brushContents;		// all contents of the leaf brushes
 
 	int			firstLeafSurface;
 	int			numLeafSurfaces;
@@ -107,6 +108,8 @@ typedef struct {
 	int			numsides;
 	cbrushside_t	*sides;
 	int			checkcount;		// to avoid repeated testings
+	int			batchcount;		// packet that last touched batchmask
+	unsigned int batchmask;		// packet rays that already tested this brush
 } cbrush_t;
 
 
@@ -115,6 +118,8 @@ typedef struct {
 	int			surfaceFlags;
 	int			contents;
 	struct patchCollide_s	*pc;
+	int			batchcount;				// packet that last touched batchmask
+	unsigned int batchmask;				// packet rays that already tested this patch
 } cPatch_t;
 
 
@@ -123,6 +128,22 @@ typedef struct {
 	int			floodvalid;
 } cArea_t;
 
+// traversal copy of cm.nodes with the plane stored in place
+typedef struct {
+	vec3_t		normal;
+	float		dist;
+	int			type;
+	int			children[2];		// negative numbers are leafs
+	int			pad;
+} cNodePlane_t;
+
+// planes of cm.brushsides split into arrays, indexed like cm.brushsides
+typedef struct {
+	float		*normal[3];
+	float		*dist;
+	byte		*signbits;
+} cSidePlanes_t;
+
 typedef struct {
 	char		name[MAX_QPATH];
 
@@ -137,6 +158,9 @@ typedef struct {
 
 	int			numNodes;
 	cNode_t		*nodes;
+	cNodePlane_t *nodePlanes;
+
+	cSidePlanes_t sidePlanes;
 
 	int			numLeafs;
 	cLeaf_t		*leafs;
@@ -170,6 +194,7 @@ typedef struct {
 
 	int			floodvalid;
 	int			checkcount;					// incremented on each trace
+	int			batchcount;					// incremented on each trace packet
 
 	unsigned int checksum;
 } clipMap_t;
@@ -179,12 +204,16 @@ typedef struct {
 // and to avoid various numeric issues
 #define	SURFACE_CLIP_EPSILON	(0.125)
 
+#define BOUNDS_CLIP_EPSILON 0.25f // assume single precision and slightly increase to compensate potential SIMD precison loss in 64-bit environment
+
 extern	clipMap_t	cm;
 extern	int			c_pointcontents;
 extern	int			c_traces, c_brush_traces, c_patch_traces;
 extern	cvar_t		*cm_noAreas;
 extern	cvar_t		*cm_noCurves;
 extern	cvar_t		*cm_playerCurveClip;
+extern	cvar_t		*cm_compactTree;
+extern	cvar_t		*cm_patchThreads;
 
 // cm_test.c
 
@@ -208,6 +237,7 @@ typedef struct {
 	vec3_t		modelOrigin;// origin of the model tracing through
 	int			contents;	// ored contents of the model tracing through
 	qboolean	isPoint;	// optimized case
+	qboolean	compact;	// use cm.nodePlanes and cm.sidePlanes
 	trace_t		trace;		// returned from trace call
 	sphere_t	sphere;		// sphere for oriendted capsule collision
 } traceWork_t;
@@ -236,7 +266,15 @@ qboolean CM_BoundsIntersectPoint( const vec3_t mins, const vec3_t maxs, const ve
 
 // cm_patch.c
 
-struct patchCollide_s	*CM_GeneratePatchCollide( int width, int height, vec3_t *points );
+typedef struct {
+	int			width;
+	int			height;
+	const vec3_t *points;
+	struct patchCollide_s *pc;		// filled in by CM_GeneratePatchCollides
+} patchSource_t;
+
+struct patchCollide_s	*CM_GeneratePatchCollide( int width, int height, const vec3_t *points );
+void CM_GeneratePatchCollides( patchSource_t *sources, int numPatches, int numThreads );
 void CM_TraceThroughPatchCollide( traceWork_t *tw, const struct patchCollide_s *pc );
 qboolean CM_PositionTestInPatchCollide( traceWork_t *tw, const struct patchCollide_s *pc );
 void CM_ClearLevelPatches( void );
@@ -419,15 +419,145 @@ PATCH COLLIDE GENERATION
 ================================================================================
 */
 
-static	int				numPlanes;
-static	patchPlane_t	planes[MAX_PATCH_PLANES];
-
-static	int				numFacets;
-static	facet_t			facets[MAX_FACETS];
-
 #define	NORMAL_EPSILON	0.0001
 #define	DIST_EPSILON	0.02
 
+#define	PLANE_HASH_SIZE		1024
+#define	PLANE_HASH_DIST		4.0		// cell sizes, must not be smaller than the epsilons
+#define	PLANE_HASH_NORMAL	( 1.0 / 64 )
+
+#define	MAX_PATCH_MESSAGES	16
+
+// diagnostics of a patch generated on a worker thread,
+// printed by the main thread in load order
+typedef struct {
+	int			numMessages;
+	const char	*messages[MAX_PATCH_MESSAGES];
+	qboolean	developer[MAX_PATCH_MESSAGES];
+	qboolean	debugBlock;
+	vec3_t		debugBlockPoints[4];
+	qboolean	failed;				// must be generated again on the main thread
+} patchReport_t;
+
+typedef struct {
+	int				numPlanes;
+	patchPlane_t	planes[MAX_PATCH_PLANES];
+
+	int				numFacets;
+	facet_t			facets[MAX_FACETS];
+
+	// CM_FindPlane2 lookup by quantized distance and normal z
+	int				planeHash[PLANE_HASH_SIZE];
+	int				planeHashNext[MAX_PATCH_PLANES];
+
+	vec3_t			bounds[2];
+	int				blocks;
+
+	qboolean		worker;			// not on the main thread, errors and prints go to report
+	patchReport_t	report;
+} patchWork_t;
+
+static patchWork_t	patchWork;		// main thread
+
+
+/*
+==================
+CM_PatchPrint
+==================
+*/
+static void CM_PatchPrint( patchWork_t *pw, qboolean developer, const char *msg ) {
+	patchReport_t *r = &pw->report;
+
+	if ( !pw->worker ) {
+		if ( developer ) {
+			Com_DPrintf( "%s", msg );
+		} else {
+			Com_Printf( "%s", msg );
+		}
+		return;
+	}
+
+	if ( r->numMessages == MAX_PATCH_MESSAGES ) {
+		r->failed = qtrue;
+		return;
+	}
+
+	r->messages[ r->numMessages ] = msg;
+	r->developer[ r->numMessages ] = developer;
+	r->numMessages++;
+}
+
+
+/*
+==================
+CM_PatchError
+
+Worker threads can't drop the map, the patch is
+generated again by the main thread instead
+==================
+*/
+static void CM_PatchError( patchWork_t *pw, errorParm_t code, const char *msg ) {
+	if ( !pw->worker ) {
+		Com_Error( code, "%s", msg );
+	}
+	pw->report.failed = qtrue;
+}
+
+
+/*
+==================
+CM_PlaneHashCell
+==================
+*/
+static int CM_PlaneHashCell( double value, double scale ) {
+	value *= scale;
+
+	if ( !( value > -1e8 ) ) {
+		return value == value ? -100000000 : 0;		// NaN planes never match anything
+	}
+	if ( value > 1e8 ) {
+		return 100000000;
+	}
+
+	return (int)floor( value );
+}
+
+
+/*
+==================
+CM_PlaneHashKey
+==================
+*/
+static int CM_PlaneHashKey( int distCell, int normalCell ) {
+	return ( ( (unsigned int)distCell * 73856093U ) ^ ( (unsigned int)normalCell * 19349663U ) ) & ( PLANE_HASH_SIZE - 1 );
+}
+
+
+/*
+==================
+CM_AddPatchPlane
+
+Finishes the plane the caller copied to the end of the plane list
+==================
+*/
+static int CM_AddPatchPlane( patchWork_t *pw ) {
+	patchPlane_t *p;
+	int key;
+
+	p = &pw->planes[pw->numPlanes];
+	p->signbits = CM_SignbitsForNormal( p->plane );
+
+	key = CM_PlaneHashKey( CM_PlaneHashCell( p->plane[3], 1.0 / PLANE_HASH_DIST ),
+		CM_PlaneHashCell( p->plane[2], 1.0 / PLANE_HASH_NORMAL ) );
+	pw->planeHashNext[pw->numPlanes] = pw->planeHash[key];
+	pw->planeHash[key] = pw->numPlanes;
+
+	pw->numPlanes++;
+
+	return pw->numPlanes-1;
+}
+
+
 /*
 ==================
 CM_PlaneEqual
@@ -494,27 +624,53 @@ static void CM_SnapVector( vec3_t normal ) {
 CM_FindPlane2
 ==================
 */
-static int CM_FindPlane2( const float plane[4], int *flipped ) {
-	int i;
+static int CM_FindPlane2( patchWork_t *pw, const float plane[4], int *flipped ) {
+	int		i, side, d, n, dmin, dmax, nmin, nmax;
+	int		best, bestFlipped, f;
+	double	dist, nz;
+
+	// see if the points are close enough to an existing plane, this
+	// finds the lowest numbered match like a search through all planes
+	best = pw->numPlanes;
+	bestFlipped = qfalse;
+
+	for ( side = 0; side < 2; side++ ) {
+		// cells that may hold the plane or its opposite
+		dist = side ? -plane[3] : plane[3];
+		nz = side ? -plane[2] : plane[2];
+		dmin = CM_PlaneHashCell( dist - 2 * DIST_EPSILON, 1.0 / PLANE_HASH_DIST );
+		dmax = CM_PlaneHashCell( dist + 2 * DIST_EPSILON, 1.0 / PLANE_HASH_DIST );
+		nmin = CM_PlaneHashCell( nz - 2 * NORMAL_EPSILON, 1.0 / PLANE_HASH_NORMAL );
+		nmax = CM_PlaneHashCell( nz + 2 * NORMAL_EPSILON, 1.0 / PLANE_HASH_NORMAL );
+
+		for ( d = dmin; d <= dmax; d++ ) {
+			for ( n = nmin; n <= nmax; n++ ) {
+				for ( i = pw->planeHash[ CM_PlaneHashKey( d, n ) ]; i >= 0; i = pw->planeHashNext[i] ) {
+					if ( i < best && CM_PlaneEqual( &pw->planes[i], plane, &f ) ) {
+						best = i;
+						bestFlipped = f;
+					}
+				}
+			}
+		}
+	}
 
-	// see if the points are close enough to an existing plane
-	for ( i = 0 ; i < numPlanes ; i++ ) {
-		if (CM_PlaneEqual(&planes[i], plane, flipped)) return i;
+	if ( best < pw->numPlanes ) {
+		*flipped = bestFlipped;
+		return best;
 	}
 
 	// add a new plane
-	if ( numPlanes == MAX_PATCH_PLANES ) {
-		Com_Error( ERR_DROP, "MAX_PATCH_PLANES" );
+	if ( pw->numPlanes == MAX_PATCH_PLANES ) {
+		CM_PatchError( pw, ERR_DROP, "MAX_PATCH_PLANES" );
+		return pw->numPlanes - 1;
 	}
 
-	Vector4Copy( plane, planes[numPlanes].plane );
-	planes[numPlanes].signbits = CM_SignbitsForNormal( plane );
-
-	numPlanes++;
+	Vector4Copy( plane, pw->planes[pw->numPlanes].plane );
 
 	*flipped = qfalse;
 
-	return numPlanes-1;
+	return CM_AddPatchPlane( pw );
 }
 
 
@@ -523,7 +679,7 @@ static int CM_FindPlane2( const float plane[4], int *flipped ) {
 CM_FindPlane
 ==================
 */
-static int CM_FindPlane( const float *p1, const float *p2, const float *p3 ) {
+static int CM_FindPlane( patchWork_t *pw, const float *p1, const float *p2, const float *p3 ) {
 	float	plane[4];
 	int		i;
 	float	d;
@@ -533,22 +689,22 @@ static int CM_FindPlane( const float *p1, const float *p2, const float *p3 ) {
 	}
 
 	// see if the points are close enough to an existing plane
-	for ( i = 0 ; i < numPlanes ; i++ ) {
-		if ( DotProduct( plane, planes[i].plane ) < 0 ) {
+	for ( i = 0 ; i < pw->numPlanes ; i++ ) {
+		if ( DotProduct( plane, pw->planes[i].plane ) < 0 ) {
 			continue;	// allow backwards planes?
 		}
 
-		d = DotProduct( p1, planes[i].plane ) - planes[i].plane[3];
+		d = DotProduct( p1, pw->planes[i].plane ) - pw->planes[i].plane[3];
 		if ( d < -PLANE_TRI_EPSILON || d > PLANE_TRI_EPSILON ) {
 			continue;
 		}
 
-		d = DotProduct( p2, planes[i].plane ) - planes[i].plane[3];
+		d = DotProduct( p2, pw->planes[i].plane ) - pw->planes[i].plane[3];
 		if ( d < -PLANE_TRI_EPSILON || d > PLANE_TRI_EPSILON ) {
 			continue;
 		}
 
-		d = DotProduct( p3, planes[i].plane ) - planes[i].plane[3];
+		d = DotProduct( p3, pw->planes[i].plane ) - pw->planes[i].plane[3];
 		if ( d < -PLANE_TRI_EPSILON || d > PLANE_TRI_EPSILON ) {
 			continue;
 		}
@@ -557,17 +713,17 @@ static int CM_FindPlane( const float *p1, const float *p2, const float *p3 ) {
 		return i;
 	}
 
-	// add a new plane
-	if ( numPlanes == MAX_PATCH_PLANES ) {
-		Com_Error( ERR_DROP, "MAX_PATCH_PLANES" );
+	// add a new plane, copied here instead of passing its address on:
+	// gcc 12 -O2 then vectorizes CM_PlaneFromPoints without rounding
+	// the cross product to float and the planes come out different
+	if ( pw->numPlanes == MAX_PATCH_PLANES ) {
+		CM_PatchError( pw, ERR_DROP, "MAX_PATCH_PLANES" );
+		return pw->numPlanes - 1;
 	}
 
-	Vector4Copy( plane, planes[numPlanes].plane );
-	planes[numPlanes].signbits = CM_SignbitsForNormal( plane );
+	Vector4Copy( plane, pw->planes[pw->numPlanes].plane );
 
-	numPlanes++;
-
-	return numPlanes-1;
+	return CM_AddPatchPlane( pw );
 }
 
 
@@ -576,14 +732,14 @@ static int CM_FindPlane( const float *p1, const float *p2, const float *p3 ) {
 CM_PointOnPlaneSide
 ==================
 */
-static int CM_PointOnPlaneSide( const float *p, int planeNum ) {
+static int CM_PointOnPlaneSide( const patchWork_t *pw, const float *p, int planeNum ) {
 	const float *plane;
 	double	d;
 
 	if ( planeNum == -1 ) {
 		return SIDE_ON;
 	}
-	plane = planes[ planeNum ].plane;
+	plane = pw->planes[ planeNum ].plane;
 
 	d = DotProductDPf( p, plane ) - plane[3];
 
@@ -604,7 +760,7 @@ static int CM_PointOnPlaneSide( const float *p, int planeNum ) {
 CM_GridPlane
 ==================
 */
-static int	CM_GridPlane( int gridPlanes[MAX_GRID_SIZE][MAX_GRID_SIZE][2], int i, int j, int tri ) {
+static int	CM_GridPlane( patchWork_t *pw, int gridPlanes[MAX_GRID_SIZE][MAX_GRID_SIZE][2], int i, int j, int tri ) {
 	int		p;
 
 	p = gridPlanes[i][j][tri];
@@ -617,7 +773,7 @@ static int	CM_GridPlane( int gridPlanes[MAX_GRID_SIZE][MAX_GRID_SIZE][2], int i,
 	}
 
 	// should never happen
-	Com_Printf( "WARNING: CM_GridPlane unresolvable\n" );
+	CM_PatchPrint( pw, qfalse, "WARNING: CM_GridPlane unresolvable\n" );
 	return -1;
 }
 
@@ -627,7 +783,7 @@ static int	CM_GridPlane( int gridPlanes[MAX_GRID_SIZE][MAX_GRID_SIZE][2], int i,
 CM_EdgePlaneNum
 ==================
 */
-static int CM_EdgePlaneNum( const cGrid_t *grid, int gridPlanes[MAX_GRID_SIZE][MAX_GRID_SIZE][2], int i, int j, int k ) {
+static int CM_EdgePlaneNum( patchWork_t *pw, const cGrid_t *grid, int gridPlanes[MAX_GRID_SIZE][MAX_GRID_SIZE][2], int i, int j, int k ) {
 	const float *p1, *p2;
 	vec3_t		up;
 	int			p;
@@ -636,66 +792,66 @@ static int CM_EdgePlaneNum( const cGrid_t *grid, int gridPlanes[MAX_GRID_SIZE][M
 	case 0:	// top border
 		p1 = grid->points[i][j];
 		p2 = grid->points[i+1][j];
-		p = CM_GridPlane( gridPlanes, i, j, 0 );
+		p = CM_GridPlane( pw, gridPlanes, i, j, 0 );
 		if ( p == -1 ) {
 			return -1;
 		}
-		VectorMA( p1, 4, planes[ p ].plane, up );
-		return CM_FindPlane( p1, p2, up );
+		VectorMA( p1, 4, pw->planes[ p ].plane, up );
+		return CM_FindPlane( pw, p1, p2, up );
 
 	case 2:	// bottom border
 		p1 = grid->points[i][j+1];
 		p2 = grid->points[i+1][j+1];
-		p = CM_GridPlane( gridPlanes, i, j, 1 );
+		p = CM_GridPlane( pw, gridPlanes, i, j, 1 );
 		if ( p == -1 ) {
 			return -1;
 		}
-		VectorMA( p1, 4, planes[ p ].plane, up );
-		return CM_FindPlane( p2, p1, up );
+		VectorMA( p1, 4, pw->planes[ p ].plane, up );
+		return CM_FindPlane( pw, p2, p1, up );
 
 	case 3: // left border
 		p1 = grid->points[i][j];
 		p2 = grid->points[i][j+1];
-		p = CM_GridPlane( gridPlanes, i, j, 1 );
+		p = CM_GridPlane( pw, gridPlanes, i, j, 1 );
 		if ( p == -1 ) {
 			return -1;
 		}
-		VectorMA( p1, 4, planes[ p ].plane, up );
-		return CM_FindPlane( p2, p1, up );
+		VectorMA( p1, 4, pw->planes[ p ].plane, up );
+		return CM_FindPlane( pw, p2, p1, up );
 
 	case 1:	// right border
 		p1 = grid->points[i+1][j];
 		p2 = grid->points[i+1][j+1];
-		p = CM_GridPlane( gridPlanes, i, j, 0 );
+		p = CM_GridPlane( pw, gridPlanes, i, j, 0 );
 		if ( p == -1 ) {
 			return -1;
 		}
-		VectorMA( p1, 4, planes[ p ].plane, up );
-		return CM_FindPlane( p1, p2, up );
+		VectorMA( p1, 4, pw->planes[ p ].plane, up );
+		return CM_FindPlane( pw, p1, p2, up );
 
 	case 4:	// diagonal out of triangle 0
 		p1 = grid->points[i+1][j+1];
 		p2 = grid->points[i][j];
-		p = CM_GridPlane( gridPlanes, i, j, 0 );
+		p = CM_GridPlane( pw, gridPlanes, i, j, 0 );
 		if ( p == -1 ) {
 			return -1;
 		}
-		VectorMA( p1, 4, planes[ p ].plane, up );
-		return CM_FindPlane( p1, p2, up );
+		VectorMA( p1, 4, pw->planes[ p ].plane, up );
+		return CM_FindPlane( pw, p1, p2, up );
 
 	case 5:	// diagonal out of triangle 1
 		p1 = grid->points[i][j];
 		p2 = grid->points[i+1][j+1];
-		p = CM_GridPlane( gridPlanes, i, j, 1 );
+		p = CM_GridPlane( pw, gridPlanes, i, j, 1 );
 		if ( p == -1 ) {
 			return -1;
 		}
-		VectorMA( p1, 4, planes[ p ].plane, up );
-		return CM_FindPlane( p1, p2, up );
+		VectorMA( p1, 4, pw->planes[ p ].plane, up );
+		return CM_FindPlane( pw, p1, p2, up );
 
 	}
 
-	Com_Error( ERR_DROP, "CM_EdgePlaneNum: bad k" );
+	CM_PatchError( pw, ERR_DROP, "CM_EdgePlaneNum: bad k" );
 	return -1;
 }
 
@@ -705,7 +861,7 @@ static int CM_EdgePlaneNum( const cGrid_t *grid, int gridPlanes[MAX_GRID_SIZE][M
 CM_SetBorderInward
 ===================
 */
-static void CM_SetBorderInward( facet_t *facet, const cGrid_t *grid, int gridPlanes[MAX_GRID_SIZE][MAX_GRID_SIZE][2],
+static void CM_SetBorderInward( patchWork_t *pw, facet_t *facet, const cGrid_t *grid, int gridPlanes[MAX_GRID_SIZE][MAX_GRID_SIZE][2],
 						  int i, int j, int which ) {
 	int		k, l;
 	const float *points[4];
@@ -732,7 +888,7 @@ static void CM_SetBorderInward( facet_t *facet, const cGrid_t *grid, int gridPla
 		numPoints = 3;
 		break;
 	default:
-		Com_Error( ERR_FATAL, "CM_SetBorderInward: bad parameter" );
+		CM_PatchError( pw, ERR_FATAL, "CM_SetBorderInward: bad parameter" );
 		numPoints = 0;
 		break;
 	}
@@ -746,7 +902,7 @@ static void CM_SetBorderInward( facet_t *facet, const cGrid_t *grid, int gridPla
 		for ( l = 0 ; l < numPoints ; l++ ) {
 			int		side;
 
-			side = CM_PointOnPlaneSide( points[l], facet->borderPlanes[k] );
+			side = CM_PointOnPlaneSide( pw, points[l], facet->borderPlanes[k] );
 			if ( side == SIDE_FRONT ) {
 				front++;
 			} else if ( side == SIDE_BACK ) {
@@ -763,14 +919,14 @@ static void CM_SetBorderInward( facet_t *facet, const cGrid_t *grid, int gridPla
 			facet->borderPlanes[k] = -1;
 		} else {
 			// bisecting side border
-			Com_DPrintf( "WARNING: CM_SetBorderInward: mixed plane sides\n" );
+			CM_PatchPrint( pw, qtrue, "WARNING: CM_SetBorderInward: mixed plane sides\n" );
 			facet->borderInward[k] = qfalse;
-			if ( !debugBlock ) {
-				debugBlock = qtrue;
-				VectorCopy( grid->points[i][j], debugBlockPoints[0] );
-				VectorCopy( grid->points[i+1][j], debugBlockPoints[1] );
-				VectorCopy( grid->points[i+1][j+1], debugBlockPoints[2] );
-				VectorCopy( grid->points[i][j+1], debugBlockPoints[3] );
+			if ( !pw->report.debugBlock ) {
+				pw->report.debugBlock = qtrue;
+				VectorCopy( grid->points[i][j], pw->report.debugBlockPoints[0] );
+				VectorCopy( grid->points[i+1][j], pw->report.debugBlockPoints[1] );
+				VectorCopy( grid->points[i+1][j+1], pw->report.debugBlockPoints[2] );
+				VectorCopy( grid->points[i][j+1], pw->report.debugBlockPoints[3] );
 			}
 		}
 	}
@@ -784,7 +940,7 @@ CM_ValidateFacet
 If the facet isn't bounded by its borders, we screwed up.
 ==================
 */
-static qboolean CM_ValidateFacet( const facet_t *facet ) {
+static qboolean CM_ValidateFacet( patchWork_t *pw, const facet_t *facet ) {
 	float		plane[4];
 	int			j;
 	winding_t	*w;
@@ -794,19 +950,27 @@ static qboolean CM_ValidateFacet( const facet_t *facet ) {
 		return qfalse;
 	}
 
-	Vector4Copy( planes[ facet->surfacePlane ].plane, plane );
+	Vector4Copy( pw->planes[ facet->surfacePlane ].plane, plane );
 	w = BaseWindingForPlane( plane,  plane[3] );
+	if ( !w ) {
+		CM_PatchError( pw, ERR_DROP, "BaseWindingForPlane: no axis found" );
+		return qfalse;
+	}
 	for ( j = 0 ; j < facet->numBorders && w ; j++ ) {
 		if ( facet->borderPlanes[j] == -1 ) {
 			FreeWinding( w );
 			return qfalse;
 		}
-		Vector4Copy( planes[ facet->borderPlanes[j] ].plane, plane );
+		Vector4Copy( pw->planes[ facet->borderPlanes[j] ].plane, plane );
 		if ( !facet->borderInward[j] ) {
 			VectorSubtract( vec3_origin, plane, plane );
 			plane[3] = -plane[3];
 		}
-		ChopWindingInPlace( &w, plane, plane[3], 0.1f );
+		if ( !ChopWindingInPlace( &w, plane, plane[3], 0.1f ) ) {
+			FreeWinding( w );
+			CM_PatchError( pw, ERR_DROP, "ChopWindingInPlace: MAX_POINTS_ON_WINDING" );
+			return qfalse;
+		}
 	}
 
 	if ( !w ) {
@@ -837,7 +1001,7 @@ static qboolean CM_ValidateFacet( const facet_t *facet ) {
 CM_AddFacetBevels
 ==================
 */
-static void CM_AddFacetBevels( facet_t *facet ) {
+static void CM_AddFacetBevels( patchWork_t *pw, facet_t *facet ) {
 
 	int i, j, k, l;
 	int axis, dir, order, flipped;
@@ -846,19 +1010,27 @@ static void CM_AddFacetBevels( facet_t *facet ) {
 	vec3_t mins, maxs, vec, vec2;
 	double d, d1[3], d2[3];
 
-	Vector4Copy( planes[ facet->surfacePlane ].plane, plane );
+	Vector4Copy( pw->planes[ facet->surfacePlane ].plane, plane );
 
 	w = BaseWindingForPlane( plane,  plane[3] );
+	if ( !w ) {
+		CM_PatchError( pw, ERR_DROP, "BaseWindingForPlane: no axis found" );
+		return;
+	}
 	for ( j = 0 ; j < facet->numBorders && w ; j++ ) {
 		if (facet->borderPlanes[j] == facet->surfacePlane) continue;
-		Vector4Copy( planes[ facet->borderPlanes[j] ].plane, plane );
+		Vector4Copy( pw->planes[ facet->borderPlanes[j] ].plane, plane );
 
 		if ( !facet->borderInward[j] ) {
 			VectorSubtract( vec3_origin, plane, plane );
 			plane[3] = -plane[3];
 		}
 
-		ChopWindingInPlace( &w, plane, plane[3], 0.1f );
+		if ( !ChopWindingInPlace( &w, plane, plane[3], 0.1f ) ) {
+			FreeWinding( w );
+			CM_PatchError( pw, ERR_DROP, "ChopWindingInPlace: MAX_POINTS_ON_WINDING" );
+			return;
+		}
 	}
 	if ( !w ) {
 		return;
@@ -881,21 +1053,21 @@ static void CM_AddFacetBevels( facet_t *facet ) {
 				plane[3] = -mins[axis];
 			}
 			//if it's the surface plane
-			if (CM_PlaneEqual(&planes[facet->surfacePlane], plane, &flipped)) {
+			if (CM_PlaneEqual(&pw->planes[facet->surfacePlane], plane, &flipped)) {
 				continue;
 			}
 			// see if the plane is already present
 			for ( i = 0 ; i < facet->numBorders ; i++ ) {
-				if (CM_PlaneEqual(&planes[facet->borderPlanes[i]], plane, &flipped))
+				if (CM_PlaneEqual(&pw->planes[facet->borderPlanes[i]], plane, &flipped))
 					break;
 			}
 
 			if ( i == facet->numBorders ) {
 				if ( facet->numBorders >= 4 + 6 + 16 ) {
-					Com_Printf( "ERROR: too many bevels\n" );
+					CM_PatchPrint( pw, qfalse, "ERROR: too many bevels\n" );
 					continue;
 				}
-				facet->borderPlanes[facet->numBorders] = CM_FindPlane2(plane, &flipped);
+				facet->borderPlanes[facet->numBorders] = CM_FindPlane2( pw, plane, &flipped);
 				facet->borderNoAdjust[facet->numBorders] = 0;
 				facet->borderInward[facet->numBorders] = flipped;
 				facet->numBorders++;
@@ -947,41 +1119,51 @@ static void CM_AddFacetBevels( facet_t *facet ) {
 					continue;
 
 				//if it's the surface plane
-				if (CM_PlaneEqual(&planes[facet->surfacePlane], plane, &flipped)) {
+				if (CM_PlaneEqual(&pw->planes[facet->surfacePlane], plane, &flipped)) {
 					continue;
 				}
 				// see if the plane is already present
 				for ( i = 0 ; i < facet->numBorders ; i++ ) {
-					if (CM_PlaneEqual(&planes[facet->borderPlanes[i]], plane, &flipped)) {
+					if (CM_PlaneEqual(&pw->planes[facet->borderPlanes[i]], plane, &flipped)) {
 							break;
 					}
 				}
 
 				if ( i == facet->numBorders ) {
 					if ( facet->numBorders >= 4 + 6 + 16 ) {
-						Com_Printf( "ERROR: too many bevels\n" );
+						CM_PatchPrint( pw, qfalse, "ERROR: too many bevels\n" );
 						continue;
 					}
-					facet->borderPlanes[facet->numBorders] = CM_FindPlane2(plane, &flipped);
+					facet->borderPlanes[facet->numBorders] = CM_FindPlane2( pw, plane, &flipped);
 
 					for ( k = 0 ; k < facet->numBorders ; k++ ) {
 						if (facet->borderPlanes[facet->numBorders] ==
-							facet->borderPlanes[k]) Com_Printf("WARNING: bevel plane already used\n");
+							facet->borderPlanes[k]) CM_PatchPrint( pw, qfalse, "WARNING: bevel plane already used\n" );
 					}
 
 					facet->borderNoAdjust[facet->numBorders] = 0;
 					facet->borderInward[facet->numBorders] = flipped;
 					//
 					w2 = CopyWinding(w);
-					Vector4Copy(planes[facet->borderPlanes[facet->numBorders]].plane, newplane);
+					if (!w2) {
+						FreeWinding( w );
+						CM_PatchError( pw, ERR_FATAL, "CopyWinding: out of memory" );
+						return;
+					}
+					Vector4Copy(pw->planes[facet->borderPlanes[facet->numBorders]].plane, newplane);
 					if (!facet->borderInward[facet->numBorders])
 					{
 						VectorNegate(newplane, newplane);
 						newplane[3] = -newplane[3];
 					} //end if
-					ChopWindingInPlace( &w2, newplane, newplane[3], 0.1f );
+					if ( !ChopWindingInPlace( &w2, newplane, newplane[3], 0.1f ) ) {
+						FreeWinding( w2 );
+						FreeWinding( w );
+						CM_PatchError( pw, ERR_DROP, "ChopWindingInPlace: MAX_POINTS_ON_WINDING" );
+						return;
+					}
 					if (!w2) {
-						Com_DPrintf("WARNING: CM_AddFacetBevels... invalid bevel\n");
+						CM_PatchPrint( pw, qtrue, "WARNING: CM_AddFacetBevels... invalid bevel\n" );
 						continue;
 					}
 					else {
@@ -1000,7 +1182,7 @@ static void CM_AddFacetBevels( facet_t *facet ) {
 #ifndef BSPC
 	//add opposite plane
 	if ( facet->numBorders >= 4 + 6 + 16 ) {
-		Com_Printf( "ERROR: too many bevels\n" );
+		CM_PatchPrint( pw, qfalse, "ERROR: too many bevels\n" );
 		return;
 	}
 	facet->borderPlanes[facet->numBorders] = facet->surfacePlane;
@@ -1023,7 +1205,7 @@ typedef enum {
 CM_PatchCollideFromGrid
 ==================
 */
-static void CM_PatchCollideFromGrid( const cGrid_t *grid, patchCollide_t *pf ) {
+static void CM_PatchCollideFromGrid( patchWork_t *pw, const cGrid_t *grid ) {
 	int				i, j;
 	const float		*p1, *p2, *p3;
 	int				gridPlanes[MAX_GRID_SIZE][MAX_GRID_SIZE][2];
@@ -1031,8 +1213,11 @@ static void CM_PatchCollideFromGrid( const cGrid_t *grid, patchCollide_t *pf ) {
 	int				borders[4];
 	qboolean		noAdjust[4];
 
-	numPlanes = 0;
-	numFacets = 0;
+	pw->numPlanes = 0;
+	pw->numFacets = 0;
+	for ( i = 0 ; i < PLANE_HASH_SIZE ; i++ ) {
+		pw->planeHash[i] = -1;
+	}
 
 	// find the planes for each triangle of the grid
 	for ( i = 0 ; i < grid->width - 1 ; i++ ) {
@@ -1040,12 +1225,12 @@ static void CM_PatchCollideFromGrid( const cGrid_t *grid, patchCollide_t *pf ) {
 			p1 = grid->points[i][j];
 			p2 = grid->points[i+1][j];
 			p3 = grid->points[i+1][j+1];
-			gridPlanes[i][j][0] = CM_FindPlane( p1, p2, p3 );
+			gridPlanes[i][j][0] = CM_FindPlane( pw, p1, p2, p3 );
 
 			p1 = grid->points[i+1][j+1];
 			p2 = grid->points[i][j+1];
 			p3 = grid->points[i][j];
-			gridPlanes[i][j][1] = CM_FindPlane( p1, p2, p3 );
+			gridPlanes[i][j][1] = CM_FindPlane( pw, p1, p2, p3 );
 		}
 	}
 
@@ -1061,7 +1246,7 @@ static void CM_PatchCollideFromGrid( const cGrid_t *grid, patchCollide_t *pf ) {
 			}
 			noAdjust[EN_TOP] = ( borders[EN_TOP] == gridPlanes[i][j][0] );
 			if ( borders[EN_TOP] == -1 || noAdjust[EN_TOP] ) {
-				borders[EN_TOP] = CM_EdgePlaneNum( grid, gridPlanes, i, j, 0 );
+				borders[EN_TOP] = CM_EdgePlaneNum( pw, grid, gridPlanes, i, j, 0 );
 			}
 
 			borders[EN_BOTTOM] = -1;
@@ -1072,7 +1257,7 @@ static void CM_PatchCollideFromGrid( const cGrid_t *grid, patchCollide_t *pf ) {
 			}
 			noAdjust[EN_BOTTOM] = ( borders[EN_BOTTOM] == gridPlanes[i][j][1] );
 			if ( borders[EN_BOTTOM] == -1 || noAdjust[EN_BOTTOM] ) {
-				borders[EN_BOTTOM] = CM_EdgePlaneNum( grid, gridPlanes, i, j, 2 );
+				borders[EN_BOTTOM] = CM_EdgePlaneNum( pw, grid, gridPlanes, i, j, 2 );
 			}
 
 			borders[EN_LEFT] = -1;
@@ -1083,7 +1268,7 @@ static void CM_PatchCollideFromGrid( const cGrid_t *grid, patchCollide_t *pf ) {
 			}
 			noAdjust[EN_LEFT] = ( borders[EN_LEFT] == gridPlanes[i][j][1] );
 			if ( borders[EN_LEFT] == -1 || noAdjust[EN_LEFT] ) {
-				borders[EN_LEFT] = CM_EdgePlaneNum( grid, gridPlanes, i, j, 3 );
+				borders[EN_LEFT] = CM_EdgePlaneNum( pw, grid, gridPlanes, i, j, 3 );
 			}
 
 			borders[EN_RIGHT] = -1;
@@ -1094,13 +1279,14 @@ static void CM_PatchCollideFromGrid( const cGrid_t *grid, patchCollide_t *pf ) {
 			}
 			noAdjust[EN_RIGHT] = ( borders[EN_RIGHT] == gridPlanes[i][j][0] );
 			if ( borders[EN_RIGHT] == -1 || noAdjust[EN_RIGHT] ) {
-				borders[EN_RIGHT] = CM_EdgePlaneNum( grid, gridPlanes, i, j, 1 );
+				borders[EN_RIGHT] = CM_EdgePlaneNum( pw, grid, gridPlanes, i, j, 1 );
 			}
 
-			if ( numFacets == MAX_FACETS ) {
-				Com_Error( ERR_DROP, "MAX_FACETS" );
+			if ( pw->numFacets == MAX_FACETS ) {
+				CM_PatchError( pw, ERR_DROP, "MAX_FACETS" );
+				return;
 			}
-			facet = &facets[numFacets];
+			facet = &pw->facets[pw->numFacets];
 			Com_Memset( facet, 0, sizeof( *facet ) );
 
 			if ( gridPlanes[i][j][0] == gridPlanes[i][j][1] ) {
@@ -1117,10 +1303,10 @@ static void CM_PatchCollideFromGrid( const cGrid_t *grid, patchCollide_t *pf ) {
 				facet->borderNoAdjust[2] = noAdjust[EN_BOTTOM];
 				facet->borderPlanes[3] = borders[EN_LEFT];
 				facet->borderNoAdjust[3] = noAdjust[EN_LEFT];
-				CM_SetBorderInward( facet, grid, gridPlanes, i, j, -1 );
-				if ( CM_ValidateFacet( facet ) ) {
-					CM_AddFacetBevels( facet );
-					numFacets++;
+				CM_SetBorderInward( pw, facet, grid, gridPlanes, i, j, -1 );
+				if ( CM_ValidateFacet( pw, facet ) ) {
+					CM_AddFacetBevels( pw, facet );
+					pw->numFacets++;
 				}
 			} else {
 				// two separate triangles
@@ -1134,19 +1320,20 @@ static void CM_PatchCollideFromGrid( const cGrid_t *grid, patchCollide_t *pf ) {
 				if ( facet->borderPlanes[2] == -1 ) {
 					facet->borderPlanes[2] = borders[EN_BOTTOM];
 					if ( facet->borderPlanes[2] == -1 ) {
-						facet->borderPlanes[2] = CM_EdgePlaneNum( grid, gridPlanes, i, j, 4 );
+						facet->borderPlanes[2] = CM_EdgePlaneNum( pw, grid, gridPlanes, i, j, 4 );
 					}
 				}
- 				CM_SetBorderInward( facet, grid, gridPlanes, i, j, 0 );
-				if ( CM_ValidateFacet( facet ) ) {
-					CM_AddFacetBevels( facet );
-					numFacets++;
+ 				CM_SetBorderInward( pw, facet, grid, gridPlanes, i, j, 0 );
+				if ( CM_ValidateFacet( pw, facet ) ) {
+					CM_AddFacetBevels( pw, facet );
+					pw->numFacets++;
 				}
 
-				if ( numFacets == MAX_FACETS ) {
-					Com_Error( ERR_DROP, "MAX_FACETS" );
+				if ( pw->numFacets == MAX_FACETS ) {
+					CM_PatchError( pw, ERR_DROP, "MAX_FACETS" );
+					return;
 				}
-				facet = &facets[numFacets];
+				facet = &pw->facets[pw->numFacets];
 				Com_Memset( facet, 0, sizeof( *facet ) );
 
 				facet->surfacePlane = gridPlanes[i][j][1];
@@ -1159,54 +1346,51 @@ static void CM_PatchCollideFromGrid( const cGrid_t *grid, patchCollide_t *pf ) {
 				if ( facet->borderPlanes[2] == -1 ) {
 					facet->borderPlanes[2] = borders[EN_TOP];
 					if ( facet->borderPlanes[2] == -1 ) {
-						facet->borderPlanes[2] = CM_EdgePlaneNum( grid, gridPlanes, i, j, 5 );
+						facet->borderPlanes[2] = CM_EdgePlaneNum( pw, grid, gridPlanes, i, j, 5 );
 					}
 				}
-				CM_SetBorderInward( facet, grid, gridPlanes, i, j, 1 );
-				if ( CM_ValidateFacet( facet ) ) {
-					CM_AddFacetBevels( facet );
-					numFacets++;
+				CM_SetBorderInward( pw, facet, grid, gridPlanes, i, j, 1 );
+				if ( CM_ValidateFacet( pw, facet ) ) {
+					CM_AddFacetBevels( pw, facet );
+					pw->numFacets++;
 				}
 			}
 		}
 	}
-
-	// copy the results out
-	pf->numPlanes = numPlanes;
-	pf->numFacets = numFacets;
-	pf->facets = Hunk_Alloc( numFacets * sizeof( *pf->facets ), h_high );
-	Com_Memcpy( pf->facets, facets, numFacets * sizeof( *pf->facets ) );
-	pf->planes = Hunk_Alloc( numPlanes * sizeof( *pf->planes ), h_high );
-	Com_Memcpy( pf->planes, planes, numPlanes * sizeof( *pf->planes ) );
 }
 
 
 /*
 ===================
-CM_GeneratePatchCollide
-
-Creates an internal structure that will be used to perform
-collision detection with a patch mesh.
+CM_GeneratePatchWork
 
+Builds the facets and planes of a patch mesh in the work area.
 Points is packed as concatenated rows.
 ===================
 */
-struct patchCollide_s *CM_GeneratePatchCollide( int width, int height, vec3_t *points ) {
-	patchCollide_t	*pf;
+static void CM_GeneratePatchWork( patchWork_t *pw, int width, int height, const vec3_t *points ) {
 	cGrid_t			grid;
 	int				i, j;
 
+	Com_Memset( &pw->report, 0, sizeof( pw->report ) );
+
 	if ( width <= 2 || height <= 2 || !points ) {
-		Com_Error( ERR_DROP, "CM_GeneratePatchFacets: bad parameters: (%i, %i, %p)",
-			width, height, (void *)points );
+		if ( !pw->worker ) {
+			Com_Error( ERR_DROP, "CM_GeneratePatchFacets: bad parameters: (%i, %i, %p)",
+				width, height, (void *)points );
+		}
+		pw->report.failed = qtrue;
+		return;
 	}
 
 	if ( !(width & 1) || !(height & 1) ) {
-		Com_Error( ERR_DROP, "CM_GeneratePatchFacets: even sizes are invalid for quadratic meshes" );
+		CM_PatchError( pw, ERR_DROP, "CM_GeneratePatchFacets: even sizes are invalid for quadratic meshes" );
+		return;
 	}
 
 	if ( width > MAX_GRID_SIZE || height > MAX_GRID_SIZE ) {
-		Com_Error( ERR_DROP, "CM_GeneratePatchFacets: source is > MAX_GRID_SIZE" );
+		CM_PatchError( pw, ERR_DROP, "CM_GeneratePatchFacets: source is > MAX_GRID_SIZE" );
+		return;
 	}
 
 	// build a grid
@@ -1234,31 +1418,332 @@ struct patchCollide_s *CM_GeneratePatchCollide( int width, int height, vec3_t *p
 	// we now have a grid of points exactly on the curve
 	// the approximate surface defined by these points will be
 	// collided against
-	pf = Hunk_Alloc( sizeof( *pf ), h_high );
-	ClearBounds( pf->bounds[0], pf->bounds[1] );
+	ClearBounds( pw->bounds[0], pw->bounds[1] );
 	for ( i = 0 ; i < grid.width ; i++ ) {
 		for ( j = 0 ; j < grid.height ; j++ ) {
-			AddPointToBounds( grid.points[i][j], pf->bounds[0], pf->bounds[1] );
+			AddPointToBounds( grid.points[i][j], pw->bounds[0], pw->bounds[1] );
 		}
 	}
 
-	c_totalPatchBlocks += ( grid.width - 1 ) * ( grid.height - 1 );
+	pw->blocks = ( grid.width - 1 ) * ( grid.height - 1 );
 
 	// generate a bsp tree for the surface
-	CM_PatchCollideFromGrid( &grid, pf );
+	CM_PatchCollideFromGrid( pw, &grid );
 
 	// expand by one unit for epsilon purposes
-	pf->bounds[0][0] -= 1;
-	pf->bounds[0][1] -= 1;
-	pf->bounds[0][2] -= 1;
+	pw->bounds[0][0] -= 1;
+	pw->bounds[0][1] -= 1;
+	pw->bounds[0][2] -= 1;
+
+	pw->bounds[1][0] += 1;
+	pw->bounds[1][1] += 1;
+	pw->bounds[1][2] += 1;
+}
+
 
-	pf->bounds[1][0] += 1;
-	pf->bounds[1][1] += 1;
-	pf->bounds[1][2] += 1;
+/*
+===================
+CM_ApplyPatchReport
+
+Main thread side effects of generating a patch
+===================
+*/
+static void CM_ApplyPatchReport( const patchReport_t *r, qboolean print, int blocks ) {
+	int i;
+
+	if ( print ) {
+		for ( i = 0; i < r->numMessages; i++ ) {
+			if ( r->developer[i] ) {
+				Com_DPrintf( "%s", r->messages[i] );
+			} else {
+				Com_Printf( "%s", r->messages[i] );
+			}
+		}
+	}
+
+	if ( r->debugBlock && !debugBlock ) {
+		debugBlock = qtrue;
+		Com_Memcpy( debugBlockPoints, r->debugBlockPoints, sizeof( debugBlockPoints ) );
+	}
+
+	c_totalPatchBlocks += blocks;
+}
+
+
+/*
+===================
+CM_GeneratePatchCollide
+
+Creates an internal structure that will be used to perform
+collision detection with a patch mesh.
+
+Points is packed as concatenated rows.
+===================
+*/
+struct patchCollide_s *CM_GeneratePatchCollide( int width, int height, const vec3_t *points ) {
+	patchWork_t		*pw = &patchWork;
+	patchCollide_t	*pf;
+
+	CM_GeneratePatchWork( pw, width, height, points );
+	CM_ApplyPatchReport( &pw->report, qfalse, pw->blocks );
+
+	// copy the results out
+	pf = Hunk_Alloc( sizeof( *pf ), h_high );
+	VectorCopy( pw->bounds[0], pf->bounds[0] );
+	VectorCopy( pw->bounds[1], pf->bounds[1] );
+	pf->numPlanes = pw->numPlanes;
+	pf->numFacets = pw->numFacets;
+	pf->facets = Hunk_Alloc( pw->numFacets * sizeof( *pf->facets ), h_high );
+	Com_Memcpy( pf->facets, pw->facets, pw->numFacets * sizeof( *pf->facets ) );
+	pf->planes = Hunk_Alloc( pw->numPlanes * sizeof( *pf->planes ), h_high );
+	Com_Memcpy( pf->planes, pw->planes, pw->numPlanes * sizeof( *pf->planes ) );
 
 	return pf;
 }
 
+
+/*
+================================================================================
+
+THREADED GENERATION
+
+================================================================================
+*/
+
+#define	MAX_PATCH_THREADS	16
+#define	MIN_THREAD_PATCHES	16		// don't start threads for fewer patches than this
+
+typedef struct {
+	patchReport_t	report;
+	vec3_t			bounds[2];
+	int				blocks;
+	int				numPlanes;
+	patchPlane_t	*planes;		// malloc'ed
+	int				numFacets;
+	facet_t			*facets;
+	int				done;
+} patchJob_t;
+
+typedef struct {
+	patchSource_t	*sources;
+	patchJob_t		*jobs;
+	int				numJobs;
+	int				next;
+	void			*signal;
+	int				numThreads;
+	void			*threads[ MAX_PATCH_THREADS ];
+} patchPool_t;
+
+
+/*
+===================
+CM_PatchWorkerSafe
+
+Points that could make plane math raise errors are left to the main thread
+===================
+*/
+static qboolean CM_PatchWorkerSafe( const patchSource_t *src ) {
+	int i, n;
+
+	if ( !src->points ) {
+		return qfalse;
+	}
+
+	n = src->width * src->height;
+	for ( i = 0; i < n; i++ ) {
+		if ( !( fabs( src->points[i][0] ) < MAX_MAP_BOUNDS * 4 )
+			|| !( fabs( src->points[i][1] ) < MAX_MAP_BOUNDS * 4 )
+			|| !( fabs( src->points[i][2] ) < MAX_MAP_BOUNDS * 4 ) ) {
+			return qfalse;
+		}
+	}
+
+	return qtrue;
+}
+
+
+/*
+===================
+CM_PatchWorker
+===================
+*/
+static void CM_PatchWorker( void *param ) {
+	patchPool_t		*pool = (patchPool_t *)param;
+	patchSource_t	*src;
+	patchJob_t		*job;
+	patchWork_t		*pw;
+	int				index;
+
+	pw = malloc( sizeof( *pw ) );
+
+	while ( ( index = Sys_AtomicAdd( &pool->next, 1 ) ) < pool->numJobs ) {
+		src = &pool->sources[ index ];
+		job = &pool->jobs[ index ];
+
+		if ( pw == NULL || !CM_PatchWorkerSafe( src ) ) {
+			job->report.failed = qtrue;
+		} else {
+			pw->worker = qtrue;
+			CM_GeneratePatchWork( pw, src->width, src->height, src->points );
+			job->report = pw->report;
+		}
+
+		if ( !job->report.failed ) {
+			VectorCopy( pw->bounds[0], job->bounds[0] );
+			VectorCopy( pw->bounds[1], job->bounds[1] );
+			job->blocks = pw->blocks;
+			job->numPlanes = pw->numPlanes;
+			job->numFacets = pw->numFacets;
+			job->planes = malloc( pw->numPlanes * sizeof( *job->planes ) + 1 );
+			job->facets = malloc( pw->numFacets * sizeof( *job->facets ) + 1 );
+			if ( job->planes && job->facets ) {
+				Com_Memcpy( job->planes, pw->planes, pw->numPlanes * sizeof( *job->planes ) );
+				Com_Memcpy( job->facets, pw->facets, pw->numFacets * sizeof( *job->facets ) );
+			} else {
+				job->report.failed = qtrue;
+			}
+		}
+
+		Sys_AtomicStore( &job->done, 1 );
+		Sys_RaiseSignal( pool->signal );
+	}
+
+	free( pw );
+}
+
+
+/*
+===================
+CM_StopPatchPool
+===================
+*/
+static void CM_StopPatchPool( patchPool_t *pool ) {
+	int i;
+
+	Sys_AtomicStore( &pool->next, pool->numJobs );
+
+	for ( i = 0; i < pool->numThreads; i++ ) {
+		Sys_JoinThread( pool->threads[i] );
+	}
+
+	for ( i = 0; i < pool->numJobs; i++ ) {
+		free( pool->jobs[i].planes );
+		free( pool->jobs[i].facets );
+	}
+
+	Sys_DestroySignal( pool->signal );
+	Z_Free( pool );
+}
+
+
+/*
+===================
+CM_StartPatchPool
+
+Returns NULL if patches should be generated serially
+===================
+*/
+static patchPool_t *CM_StartPatchPool( patchSource_t *sources, int numPatches, int numThreads ) {
+	patchPool_t *pool;
+
+	if ( numThreads <= 0 ) {
+		numThreads = Sys_NumCPUs();
+	}
+	if ( numThreads > numPatches / MIN_THREAD_PATCHES ) {
+		numThreads = numPatches / MIN_THREAD_PATCHES;
+	}
+	if ( numThreads > MAX_PATCH_THREADS ) {
+		numThreads = MAX_PATCH_THREADS;
+	}
+	if ( numThreads < 2 ) {
+		return NULL;
+	}
+
+	pool = Z_Malloc( sizeof( *pool ) + numPatches * sizeof( pool->jobs[0] ) );
+	Com_Memset( pool, 0, sizeof( *pool ) + numPatches * sizeof( pool->jobs[0] ) );
+	pool->jobs = (patchJob_t *)( pool + 1 );
+	pool->sources = sources;
+	pool->numJobs = numPatches;
+
+	pool->signal = Sys_CreateSignal();
+	if ( pool->signal == NULL ) {
+		Z_Free( pool );
+		return NULL;
+	}
+
+	while ( pool->numThreads < numThreads ) {
+		pool->threads[ pool->numThreads ] = Sys_CreateThread( CM_PatchWorker, pool );
+		if ( pool->threads[ pool->numThreads ] == NULL ) {
+			break;
+		}
+		pool->numThreads++;
+	}
+
+	if ( pool->numThreads == 0 ) {
+		Sys_DestroySignal( pool->signal );
+		Z_Free( pool );
+		return NULL;
+	}
+
+	return pool;
+}
+
+
+/*
+===================
+CM_GeneratePatchCollides
+
+Same as calling CM_GeneratePatchCollide for each source in order,
+patches are generated on numThreads worker threads, 0 is one per CPU
+===================
+*/
+void CM_GeneratePatchCollides( patchSource_t *sources, int numPatches, int numThreads ) {
+	patchPool_t		*pool;
+	patchJob_t		*job;
+	patchCollide_t	*pf;
+	int				i;
+
+	pool = CM_StartPatchPool( sources, numPatches, numThreads );
+
+	for ( i = 0; i < numPatches; i++ ) {
+		if ( pool ) {
+			job = &pool->jobs[i];
+			while ( !Sys_AtomicLoad( &job->done ) ) {
+				Sys_WaitSignal( pool->signal, 1 );
+			}
+
+			if ( !job->report.failed ) {
+				CM_ApplyPatchReport( &job->report, qtrue, job->blocks );
+
+				pf = Hunk_Alloc( sizeof( *pf ), h_high );
+				VectorCopy( job->bounds[0], pf->bounds[0] );
+				VectorCopy( job->bounds[1], pf->bounds[1] );
+				pf->numPlanes = job->numPlanes;
+				pf->numFacets = job->numFacets;
+				pf->facets = Hunk_Alloc( job->numFacets * sizeof( *pf->facets ), h_high );
+				Com_Memcpy( pf->facets, job->facets, job->numFacets * sizeof( *pf->facets ) );
+				pf->planes = Hunk_Alloc( job->numPlanes * sizeof( *pf->planes ), h_high );
+				Com_Memcpy( pf->planes, job->planes, job->numPlanes * sizeof( *pf->planes ) );
+
+				sources[i].pc = pf;
+				continue;
+			}
+
+			// generating it again on this thread can drop the map,
+			// finish the rest serially
+			CM_StopPatchPool( pool );
+			pool = NULL;
+		}
+
+		sources[i].pc = CM_GeneratePatchCollide( sources[i].width, sources[i].height, sources[i].points );
+	}
+
+	if ( pool ) {
+		CM_StopPatchPool( pool );
+	}
+}
+
+
 /*
 ================================================================================
 
@@ -1775,7 +2260,10 @@ void CM_DrawDebugSurface( void (*drawPoly)(int color, int numPoints, float *poin
 				VectorNegate(plane, v2);
 				plane[3] -= fabs(DotProduct(v1, v2));
 
-				ChopWindingInPlace( &w, plane, plane[3], 0.1f );
+				if ( !ChopWindingInPlace( &w, plane, plane[3], 0.1f ) ) {
+					FreeWinding( w );
+					w = NULL;
+				}
 			}
 			if ( w ) {
 				if ( facet == debugFacet ) {
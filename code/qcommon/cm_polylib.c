@@ -26,12 +26,9 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 #include "cm_local.h"
 
 
-// counters are only bumped when running single threaded,
-// because they are an awful coherence problem
-static int c_active_windings;
-static int c_peak_windings;
-static int c_winding_allocs;
-static int c_winding_points;
+// windings are allocated with malloc because patch collision
+// is generated on worker threads, see CM_GeneratePatchCollides,
+// functions used there fail instead of raising errors
 
 #if 0
 static void pw(winding_t *w)
@@ -45,23 +42,35 @@ static void pw(winding_t *w)
 
 /*
 =============
-AllocWinding
+TryAllocWinding
 =============
 */
-static winding_t *AllocWinding( int points )
+static winding_t *TryAllocWinding( int points )
 {
 	winding_t	*w;
 	size_t		s;
 
-	c_winding_allocs++;
-	c_winding_points += points;
-	c_active_windings++;
-	if ( c_active_windings > c_peak_windings )
-		c_peak_windings = c_active_windings;
-
 	s = sizeof( *w ) - sizeof( w->p ) + sizeof( w->p[0] ) * points;
-	w = Z_Malloc( s );
-	Com_Memset( w, 0, s );
+	w = malloc( s );
+	if ( w != NULL )
+		Com_Memset( w, 0, s );
+	return w;
+}
+
+
+/*
+=============
+AllocWinding
+=============
+*/
+static winding_t *AllocWinding( int points )
+{
+	winding_t	*w;
+
+	w = TryAllocWinding( points );
+	if ( w == NULL )
+		Com_Error( ERR_FATAL, "AllocWinding: failed on allocation of %i bytes",
+			(int)( sizeof( *w ) - sizeof( w->p ) + sizeof( w->p[0] ) * points ) );
 	return w;
 }
 
@@ -72,8 +81,7 @@ void FreeWinding (winding_t *w)
 		Com_Error (ERR_FATAL, "FreeWinding: freed a freed winding");
 	*(unsigned *)w = 0xdeaddead;
 
-	c_active_windings--;
-	Z_Free (w);
+	free (w);
 }
 
 /*
@@ -202,6 +210,8 @@ void	WindingCenter (winding_t *w, vec3_t center)
 /*
 =================
 BaseWindingForPlane
+
+Returns NULL if the normal has no major axis or out of memory
 =================
 */
 winding_t *BaseWindingForPlane (vec3_t normal, vec_t dist)
@@ -225,7 +235,7 @@ winding_t *BaseWindingForPlane (vec3_t normal, vec_t dist)
 		}
 	}
 	if (x==-1)
-		Com_Error (ERR_DROP, "BaseWindingForPlane: no axis found");
+		return NULL;
 		
 	VectorCopy (vec3_origin, vup);
 	switch (x)
@@ -251,7 +261,9 @@ winding_t *BaseWindingForPlane (vec3_t normal, vec_t dist)
 	VectorScale (vright, MAX_MAP_BOUNDS, vright);
 
 // project a really big	axis aligned box onto the plane
-	w = AllocWinding (4);
+	w = TryAllocWinding (4);
+	if (!w)
+		return NULL;
 	
 	VectorSubtract (org, vright, w->p[0]);
 	VectorAdd (w->p[0], vup, w->p[0]);
@@ -274,6 +286,8 @@ winding_t *BaseWindingForPlane (vec3_t normal, vec_t dist)
 /*
 ==================
 CopyWinding
+
+Returns NULL if out of memory
 ==================
 */
 winding_t *CopyWinding( const winding_t *w )
@@ -281,7 +295,9 @@ winding_t *CopyWinding( const winding_t *w )
 	size_t		size;
 	winding_t	*c;
 
-	c = AllocWinding( w->numpoints );
+	c = TryAllocWinding( w->numpoints );
+	if ( c == NULL )
+		return NULL;
 	size = sizeof( *w ) - sizeof( w->p ) + sizeof( w->p[0] )* w->numpoints;
 	Com_Memcpy( c, w, size );
 	return c;
@@ -426,9 +442,12 @@ static void ClipWindingEpsilon( winding_t *in, vec3_t normal, vec_t dist, vec_t
 /*
 =============
 ChopWindingInPlace
+
+Fails if the result would have too many points or out of memory,
+the original winding is kept then
 =============
 */
-void ChopWindingInPlace( winding_t **inout, const vec3_t normal, vec_t dist, vec_t epsilon )
+qboolean ChopWindingInPlace( winding_t **inout, const vec3_t normal, vec_t dist, vec_t epsilon )
 {
 	winding_t	*in;
 	vec_t	dists[MAX_POINTS_ON_WINDING+4];
@@ -470,15 +489,18 @@ void ChopWindingInPlace( winding_t **inout, const vec3_t normal, vec_t dist, vec
 	{
 		FreeWinding (in);
 		*inout = NULL;
-		return;
+		return qtrue;
 	}
 	if (!counts[1])
-		return;		// inout stays the same
+		return qtrue;		// inout stays the same
 
 	maxpts = in->numpoints+4;	// cant use counts[0]+2 because
 								// of fp grouping errors
 
-	f = AllocWinding (maxpts);
+	// room for a split point after each point, the estimate is checked afterwards
+	f = TryAllocWinding (in->numpoints*2);
+	if (!f)
+		return qfalse;
 		
 	for (i=0 ; i<in->numpoints ; i++)
 	{
@@ -521,14 +543,16 @@ void ChopWindingInPlace( winding_t **inout, const vec3_t normal, vec_t dist, vec
 		VectorCopy (mid, f->p[f->numpoints]);
 		f->numpoints++;
 	}
-	
-	if (f->numpoints > maxpts)
-		Com_Error (ERR_DROP, "ClipWinding: points exceeded estimate");
-	if (f->numpoints > MAX_POINTS_ON_WINDING)
-		Com_Error (ERR_DROP, "ClipWinding: MAX_POINTS_ON_WINDING");
+
+	if (f->numpoints > maxpts || f->numpoints > MAX_POINTS_ON_WINDING)
+	{
+		FreeWinding (f);
+		return qfalse;
+	}
 
 	FreeWinding (in);
 	*inout = f;
+	return qtrue;
 }
 
 
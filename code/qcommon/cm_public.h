@@ -46,6 +46,19 @@ void		CM_TransformedBoxTrace( trace_t *results, const vec3_t start, const vec3_t
 						clipHandle_t model, int brushmask,
 						const vec3_t origin, const vec3_t angles, qboolean capsule );
 
+// one ray of a batched world trace
+typedef struct {
+	vec3_t		start;
+	vec3_t		end;
+	vec3_t		mins;
+	vec3_t		maxs;
+	int			brushmask;
+	qboolean	capsule;
+} cmTraceRay_t;
+
+// same results as CM_BoxTrace for each ray, but traverses the tree in packets
+void		CM_BoxTraceBatch( trace_t *results, const cmTraceRay_t *rays, int numRays, clipHandle_t model );
+
 byte		*CM_ClusterPVS (int cluster);
 
 int			CM_PointLeafnum( const vec3_t p );
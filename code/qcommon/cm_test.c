@@ -481,8 +481,6 @@ int CM_WriteAreaBits (byte *buffer, int area)
 }
 
 
-#define BOUNDS_CLIP_EPSILON 0.25f // assume single precision and slightly increase to compensate potential SIMD precison loss in 64-bit environment
-
 /*
 ====================
 CM_BoundsIntersect
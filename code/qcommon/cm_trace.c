@@ -21,6 +21,12 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 */
 #include "cm_local.h"
 
+// packed plane tests for batched traces, x86 builds may use x87 for the scalar path
+#if idx64 && ( defined(__SSE2__) || defined(_MSC_VER) )
+#include <emmintrin.h>
+#define USE_SSE2_TRACE
+#endif
+
 // always use bbox vs. bbox collision and never capsule vs. bbox or vice versa
 //#define ALWAYS_BBOX_VS_BBOX
 // always use capsule vs. capsule collision and never capsule vs. bbox or vice versa
@@ -232,13 +238,16 @@ CM_TestInLeaf
 ================
 */
 static void CM_TestInLeaf( traceWork_t *tw, const cLeaf_t *leaf ) {
-	int			k;
+	int			k, numBrushes;
 	int			brushnum;
 	cbrush_t	*b;
 	cPatch_t	*patch;
 
+	// none of the leaf brushes can be hit
+	numBrushes = ( leaf->brushContents & tw->contents ) ? leaf->numLeafBrushes : 0;
+
 	// test box position against all brushes in the leaf
-	for (k=0 ; k<leaf->numLeafBrushes ; k++) {
+	for (k=0 ; k<numBrushes ; k++) {
 		brushnum = cm.leafbrushes[leaf->firstLeafBrush+k];
 		b = &cm.brushes[brushnum];
 		if (b->checkcount == cm.checkcount) {
@@ -469,6 +478,44 @@ static void CM_TraceThroughPatch( traceWork_t *tw, const cPatch_t *patch ) {
 }
 
 
+/*
+================
+CM_ClipToBrush
+
+All planes have been checked, and the trace was not
+completely outside the brush
+================
+*/
+static void CM_ClipToBrush( traceWork_t *tw, const cbrush_t *brush, qboolean startout, qboolean getout,
+						float enterFrac, float leaveFrac, const cplane_t *clipplane, const cbrushside_t *leadside ) {
+	if (!startout) {	// original point was inside brush
+		tw->trace.startsolid = qtrue;
+		if (!getout) {
+			tw->trace.allsolid = qtrue;
+			tw->trace.fraction = 0;
+			tw->trace.contents = brush->contents;
+		}
+		return;
+	}
+
+	if (enterFrac < leaveFrac) {
+		if (enterFrac > -1 && enterFrac < tw->trace.fraction) {
+			if (enterFrac < 0) {
+				enterFrac = 0;
+			}
+			tw->trace.fraction = enterFrac;
+			if ( clipplane != NULL ) {
+				tw->trace.plane = *clipplane;
+			}
+			if ( leadside != NULL ) {
+				tw->trace.surfaceFlags = leadside->surfaceFlags;
+			}
+			tw->trace.contents = brush->contents;
+		}
+	}
+}
+
+
 /*
 ================
 CM_TraceThroughBrush
@@ -625,35 +672,100 @@ static void CM_TraceThroughBrush( traceWork_t *tw, const cbrush_t *brush ) {
 		}
 	}
 
-	//
-	// all planes have been checked, and the trace was not
-	// completely outside the brush
-	//
-	if (!startout) {	// original point was inside brush
-		tw->trace.startsolid = qtrue;
-		if (!getout) {
-			tw->trace.allsolid = qtrue;
-			tw->trace.fraction = 0;
-			tw->trace.contents = brush->contents;
-		}
+	CM_ClipToBrush( tw, brush, startout, getout, enterFrac, leaveFrac, clipplane, leadside );
+}
+
+
+/*
+================
+CM_TraceThroughBrushCompact
+
+Box sweep through a brush using cm.sidePlanes,
+gives the same results as CM_TraceThroughBrush
+================
+*/
+static void CM_TraceThroughBrushCompact( traceWork_t *tw, const cbrush_t *brush ) {
+	const float	*nx, *ny, *nz, *pdist;
+	const byte	*signbits;
+	const float	*offset;
+	int			i, first, lead;
+	double		dist;
+	float		enterFrac, leaveFrac;
+	double		d1, d2;
+	qboolean	getout, startout;
+	float		f;
+
+	if ( !brush->numsides ) {
 		return;
 	}
 
-	if (enterFrac < leaveFrac) {
-		if (enterFrac > -1 && enterFrac < tw->trace.fraction) {
-			if (enterFrac < 0) {
-				enterFrac = 0;
+	c_brush_traces++;
+
+	first = brush->sides - cm.brushsides;
+	nx = cm.sidePlanes.normal[0] + first;
+	ny = cm.sidePlanes.normal[1] + first;
+	nz = cm.sidePlanes.normal[2] + first;
+	pdist = cm.sidePlanes.dist + first;
+	signbits = cm.sidePlanes.signbits + first;
+
+	enterFrac = -1.0;
+	leaveFrac = 1.0;
+	lead = -1;
+
+	getout = qfalse;
+	startout = qfalse;
+
+	for ( i = 0; i < brush->numsides; i++ ) {
+		// adjust the plane distance appropriately for mins/maxs
+		offset = tw->offsets[ signbits[i] ];
+		dist = pdist[i] - ( (double)offset[0]*nx[i] + (double)offset[1]*ny[i] + (double)offset[2]*nz[i] );
+
+		d1 = ( (double)tw->start[0]*nx[i] + (double)tw->start[1]*ny[i] + (double)tw->start[2]*nz[i] ) - dist;
+		d2 = ( (double)tw->end[0]*nx[i] + (double)tw->end[1]*ny[i] + (double)tw->end[2]*nz[i] ) - dist;
+
+		if (d2 > 0) {
+			getout = qtrue;	// endpoint is not in solid
+		}
+		if (d1 > 0) {
+			startout = qtrue;
+		}
+
+		// if completely in front of face, no intersection with the entire brush
+		if (d1 > 0 && ( d2 >= SURFACE_CLIP_EPSILON || d2 >= d1 )  ) {
+			return;
+		}
+
+		// if it doesn't cross the plane, the plane isn't relevant
+		if (d1 <= 0 && d2 <= 0 ) {
+			continue;
+		}
+
+		// crosses face
+		if (d1 > d2) {	// enter
+			f = (d1-SURFACE_CLIP_EPSILON) / (d1-d2);
+			if ( f < 0 ) {
+				f = 0;
 			}
-			tw->trace.fraction = enterFrac;
-			if ( clipplane != NULL ) {
-				tw->trace.plane = *clipplane;
+			if (f > enterFrac) {
+				enterFrac = f;
+				lead = i;
 			}
-			if ( leadside != NULL ) {
-				tw->trace.surfaceFlags = leadside->surfaceFlags;
+		} else {	// leave
+			f = (d1+SURFACE_CLIP_EPSILON) / (d1-d2);
+			if ( f > 1 ) {
+				f = 1;
+			}
+			if (f < leaveFrac) {
+				leaveFrac = f;
 			}
-			tw->trace.contents = brush->contents;
 		}
 	}
+
+	if ( lead >= 0 ) {
+		CM_ClipToBrush( tw, brush, startout, getout, enterFrac, leaveFrac, brush->sides[ lead ].plane, &brush->sides[ lead ] );
+	} else {
+		CM_ClipToBrush( tw, brush, startout, getout, enterFrac, leaveFrac, NULL, NULL );
+	}
 }
 
 
@@ -663,13 +775,16 @@ CM_TraceThroughLeaf
 ================
 */
 static void CM_TraceThroughLeaf( traceWork_t *tw, const cLeaf_t *leaf ) {
-	int			k;
+	int			k, numBrushes;
 	int			brushnum;
 	cbrush_t	*b;
 	cPatch_t	*patch;
 
+	// none of the leaf brushes can be hit
+	numBrushes = ( leaf->brushContents & tw->contents ) ? leaf->numLeafBrushes : 0;
+
 	// trace line against all brushes in the leaf
-	for ( k = 0 ; k < leaf->numLeafBrushes ; k++ ) {
+	for ( k = 0 ; k < numBrushes ; k++ ) {
 		brushnum = cm.leafbrushes[leaf->firstLeafBrush+k];
 
 		b = &cm.brushes[brushnum];
@@ -687,7 +802,11 @@ static void CM_TraceThroughLeaf( traceWork_t *tw, const cLeaf_t *leaf ) {
 			continue;
 		}
 
-		CM_TraceThroughBrush( tw, b );
+		if ( tw->compact ) {
+			CM_TraceThroughBrushCompact( tw, b );
+		} else {
+			CM_TraceThroughBrush( tw, b );
+		}
 		if ( !tw->trace.fraction ) {
 			return;
 		}
@@ -1032,8 +1151,10 @@ a smaller intercept fraction.
 ==================
 */
 static void CM_TraceThroughTree( traceWork_t *tw, int num, float p1f, float p2f, const vec3_t p1, const vec3_t p2 ) {
-	cNode_t		*node;
-	cplane_t	*plane;
+	const float	*normal;
+	const int	*children;
+	float		dist;
+	int			type;
 	double		t1, t2, offset;
 	float		frac, frac2;
 	float		idist;
@@ -1055,17 +1176,28 @@ static void CM_TraceThroughTree( traceWork_t *tw, int num, float p1f, float p2f,
 	// find the point distances to the separating plane
 	// and the offset for the size of the box
 	//
-	node = cm.nodes + num;
-	plane = node->plane;
+	if ( tw->compact ) {
+		const cNodePlane_t *node = cm.nodePlanes + num;
+		normal = node->normal;
+		dist = node->dist;
+		type = node->type;
+		children = node->children;
+	} else {
+		const cNode_t *node = cm.nodes + num;
+		normal = node->plane->normal;
+		dist = node->plane->dist;
+		type = node->plane->type;
+		children = node->children;
+	}
 
 	// adjust the plane distance appropriately for mins/maxs
-	if ( plane->type < 3 ) {
-		t1 = p1[plane->type] - plane->dist;
-		t2 = p2[plane->type] - plane->dist;
-		offset = tw->extents[plane->type];
+	if ( type < 3 ) {
+		t1 = p1[type] - dist;
+		t2 = p2[type] - dist;
+		offset = tw->extents[type];
 	} else {
-		t1 = DotProductDP( plane->normal, p1 ) - plane->dist;
-		t2 = DotProductDP( plane->normal, p2 ) - plane->dist;
+		t1 = DotProductDP( normal, p1 ) - dist;
+		t2 = DotProductDP( normal, p2 ) - dist;
 		if ( tw->isPoint ) {
 			offset = 0;
 		} else {
@@ -1076,11 +1208,11 @@ static void CM_TraceThroughTree( traceWork_t *tw, int num, float p1f, float p2f,
 
 	// see which sides we need to consider
 	if ( t1 >= offset + 1 && t2 >= offset + 1 ) {
-		CM_TraceThroughTree( tw, node->children[0], p1f, p2f, p1, p2 );
+		CM_TraceThroughTree( tw, children[0], p1f, p2f, p1, p2 );
 		return;
 	}
 	if ( t1 < -offset - 1 && t2 < -offset - 1 ) {
-		CM_TraceThroughTree( tw, node->children[1], p1f, p2f, p1, p2 );
+		CM_TraceThroughTree( tw, children[1], p1f, p2f, p1, p2 );
 		return;
 	}
 
@@ -1114,7 +1246,7 @@ static void CM_TraceThroughTree( traceWork_t *tw, int num, float p1f, float p2f,
 	mid[1] = p1[1] + frac*(p2[1] - p1[1]);
 	mid[2] = p1[2] + frac*(p2[2] - p1[2]);
 
-	CM_TraceThroughTree( tw, node->children[side], p1f, midf, p1, mid );
+	CM_TraceThroughTree( tw, children[side], p1f, midf, p1, mid );
 
 	// go past the node
 	if ( frac2 < 0 ) {
@@ -1129,7 +1261,7 @@ static void CM_TraceThroughTree( traceWork_t *tw, int num, float p1f, float p2f,
 	mid[1] = p1[1] + frac2*(p2[1] - p1[1]);
 	mid[2] = p1[2] + frac2*(p2[2] - p1[2]);
 
-	CM_TraceThroughTree( tw, node->children[side^1], midf, p2f, mid, p2 );
+	CM_TraceThroughTree( tw, children[side^1], midf, p2f, mid, p2 );
 }
 
 
@@ -1138,31 +1270,24 @@ static void CM_TraceThroughTree( traceWork_t *tw, int num, float p1f, float p2f,
 
 /*
 ==================
-CM_Trace
+CM_SetupTrace
+
+Fills in the trace work for a sweep of the given box, returns qfalse
+if there is no map to trace through
 ==================
 */
-static void CM_Trace( trace_t *results, const vec3_t start, const vec3_t end, const vec3_t mins, const vec3_t maxs,
-						clipHandle_t model, const vec3_t origin, int brushmask, qboolean capsule, const sphere_t *sphere ) {
+static qboolean CM_SetupTrace( traceWork_t *tw, const vec3_t start, const vec3_t end, const vec3_t mins, const vec3_t maxs,
+						const vec3_t origin, int brushmask, qboolean capsule, const sphere_t *sphere ) {
 	int			i;
-	traceWork_t	tw;
 	vec3_t		offset;
-	cmodel_t	*cmod;
-
-	cmod = CM_ClipHandleToModel( model );
-
-	cm.checkcount++;		// for multi-check avoidance
-
-	c_traces++;				// for statistics, may be zeroed
 
 	// fill in a default trace
-	Com_Memset( &tw, 0, sizeof(tw) );
-	tw.trace.fraction = 1;	// assume it goes the entire distance until shown otherwise
-	VectorCopy(origin, tw.modelOrigin);
+	Com_Memset( tw, 0, sizeof(*tw) );
+	tw->trace.fraction = 1;	// assume it goes the entire distance until shown otherwise
+	VectorCopy(origin, tw->modelOrigin);
 
 	if (!cm.numNodes) {
-		*results = tw.trace;
-
-		return;	// map not loaded, shouldn't happen
+		return qfalse;	// map not loaded, shouldn't happen
 	}
 
 	// allow NULL to be passed in for 0,0,0
@@ -1174,91 +1299,168 @@ static void CM_Trace( trace_t *results, const vec3_t start, const vec3_t end, co
 	}
 
 	// set basic parms
-	tw.contents = brushmask;
+	tw->contents = brushmask;
+	tw->compact = ( cm.nodePlanes && cm_compactTree && cm_compactTree->integer );
 
 	// adjust so that mins and maxs are always symetric, which
 	// avoids some complications with plane expanding of rotated
 	// bmodels
 	for ( i = 0 ; i < 3 ; i++ ) {
 		offset[i] = ( mins[i] + maxs[i] ) * 0.5;
-		tw.size[0][i] = mins[i] - offset[i];
-		tw.size[1][i] = maxs[i] - offset[i];
-		tw.start[i] = start[i] + offset[i];
-		tw.end[i] = end[i] + offset[i];
+		tw->size[0][i] = mins[i] - offset[i];
+		tw->size[1][i] = maxs[i] - offset[i];
+		tw->start[i] = start[i] + offset[i];
+		tw->end[i] = end[i] + offset[i];
 	}
 
 	// if a sphere is already specified
 	if ( sphere ) {
-		tw.sphere = *sphere;
+		tw->sphere = *sphere;
 	}
 	else {
-		tw.sphere.use = capsule;
-		tw.sphere.radius = ( tw.size[1][0] > tw.size[1][2] ) ? tw.size[1][2]: tw.size[1][0];
-		tw.sphere.halfheight = tw.size[1][2];
-		VectorSet( tw.sphere.offset, 0, 0, tw.size[1][2] - tw.sphere.radius );
+		tw->sphere.use = capsule;
+		tw->sphere.radius = ( tw->size[1][0] > tw->size[1][2] ) ? tw->size[1][2]: tw->size[1][0];
+		tw->sphere.halfheight = tw->size[1][2];
+		VectorSet( tw->sphere.offset, 0, 0, tw->size[1][2] - tw->sphere.radius );
 	}
 
-	tw.maxOffset = tw.size[1][0] + tw.size[1][1] + tw.size[1][2];
+	tw->maxOffset = tw->size[1][0] + tw->size[1][1] + tw->size[1][2];
 
-	// tw.offsets[signbits] = vector to appropriate corner from origin
-	tw.offsets[0][0] = tw.size[0][0];
-	tw.offsets[0][1] = tw.size[0][1];
-	tw.offsets[0][2] = tw.size[0][2];
+	// tw->offsets[signbits] = vector to appropriate corner from origin
+	tw->offsets[0][0] = tw->size[0][0];
+	tw->offsets[0][1] = tw->size[0][1];
+	tw->offsets[0][2] = tw->size[0][2];
 
-	tw.offsets[1][0] = tw.size[1][0];
-	tw.offsets[1][1] = tw.size[0][1];
-	tw.offsets[1][2] = tw.size[0][2];
+	tw->offsets[1][0] = tw->size[1][0];
+	tw->offsets[1][1] = tw->size[0][1];
+	tw->offsets[1][2] = tw->size[0][2];
 
-	tw.offsets[2][0] = tw.size[0][0];
-	tw.offsets[2][1] = tw.size[1][1];
-	tw.offsets[2][2] = tw.size[0][2];
+	tw->offsets[2][0] = tw->size[0][0];
+	tw->offsets[2][1] = tw->size[1][1];
+	tw->offsets[2][2] = tw->size[0][2];
 
-	tw.offsets[3][0] = tw.size[1][0];
-	tw.offsets[3][1] = tw.size[1][1];
-	tw.offsets[3][2] = tw.size[0][2];
+	tw->offsets[3][0] = tw->size[1][0];
+	tw->offsets[3][1] = tw->size[1][1];
+	tw->offsets[3][2] = tw->size[0][2];
 
-	tw.offsets[4][0] = tw.size[0][0];
-	tw.offsets[4][1] = tw.size[0][1];
-	tw.offsets[4][2] = tw.size[1][2];
+	tw->offsets[4][0] = tw->size[0][0];
+	tw->offsets[4][1] = tw->size[0][1];
+	tw->offsets[4][2] = tw->size[1][2];
 
-	tw.offsets[5][0] = tw.size[1][0];
-	tw.offsets[5][1] = tw.size[0][1];
-	tw.offsets[5][2] = tw.size[1][2];
+	tw->offsets[5][0] = tw->size[1][0];
+	tw->offsets[5][1] = tw->size[0][1];
+	tw->offsets[5][2] = tw->size[1][2];
 
-	tw.offsets[6][0] = tw.size[0][0];
-	tw.offsets[6][1] = tw.size[1][1];
-	tw.offsets[6][2] = tw.size[1][2];
+	tw->offsets[6][0] = tw->size[0][0];
+	tw->offsets[6][1] = tw->size[1][1];
+	tw->offsets[6][2] = tw->size[1][2];
 
-	tw.offsets[7][0] = tw.size[1][0];
-	tw.offsets[7][1] = tw.size[1][1];
-	tw.offsets[7][2] = tw.size[1][2];
+	tw->offsets[7][0] = tw->size[1][0];
+	tw->offsets[7][1] = tw->size[1][1];
+	tw->offsets[7][2] = tw->size[1][2];
 
 	//
 	// calculate bounds
 	//
-	if ( tw.sphere.use ) {
+	if ( tw->sphere.use ) {
 		for ( i = 0 ; i < 3 ; i++ ) {
-			if ( tw.start[i] < tw.end[i] ) {
-				tw.bounds[0][i] = tw.start[i] - fabs(tw.sphere.offset[i]) - tw.sphere.radius;
-				tw.bounds[1][i] = tw.end[i] + fabs(tw.sphere.offset[i]) + tw.sphere.radius;
+			if ( tw->start[i] < tw->end[i] ) {
+				tw->bounds[0][i] = tw->start[i] - fabs(tw->sphere.offset[i]) - tw->sphere.radius;
+				tw->bounds[1][i] = tw->end[i] + fabs(tw->sphere.offset[i]) + tw->sphere.radius;
 			} else {
-				tw.bounds[0][i] = tw.end[i] - fabs(tw.sphere.offset[i]) - tw.sphere.radius;
-				tw.bounds[1][i] = tw.start[i] + fabs(tw.sphere.offset[i]) + tw.sphere.radius;
+				tw->bounds[0][i] = tw->end[i] - fabs(tw->sphere.offset[i]) - tw->sphere.radius;
+				tw->bounds[1][i] = tw->start[i] + fabs(tw->sphere.offset[i]) + tw->sphere.radius;
 			}
 		}
 	}
 	else {
 		for ( i = 0 ; i < 3 ; i++ ) {
-			if ( tw.start[i] < tw.end[i] ) {
-				tw.bounds[0][i] = tw.start[i] + tw.size[0][i];
-				tw.bounds[1][i] = tw.end[i] + tw.size[1][i];
+			if ( tw->start[i] < tw->end[i] ) {
+				tw->bounds[0][i] = tw->start[i] + tw->size[0][i];
+				tw->bounds[1][i] = tw->end[i] + tw->size[1][i];
 			} else {
-				tw.bounds[0][i] = tw.end[i] + tw.size[0][i];
-				tw.bounds[1][i] = tw.start[i] + tw.size[1][i];
+				tw->bounds[0][i] = tw->end[i] + tw->size[0][i];
+				tw->bounds[1][i] = tw->start[i] + tw->size[1][i];
 			}
 		}
 	}
 
+	return qtrue;
+}
+
+
+/*
+==================
+CM_SetupSweep
+
+Prepares the trace work for a sweep that is not a position test
+==================
+*/
+static void CM_SetupSweep( traceWork_t *tw ) {
+	//
+	// check for point special case
+	//
+	if ( tw->size[0][0] == 0 && tw->size[0][1] == 0 && tw->size[0][2] == 0 ) {
+		tw->isPoint = qtrue;
+		VectorClear( tw->extents );
+	} else {
+		tw->isPoint = qfalse;
+		tw->extents[0] = tw->size[1][0];
+		tw->extents[1] = tw->size[1][1];
+		tw->extents[2] = tw->size[1][2];
+	}
+}
+
+
+/*
+==================
+CM_FinishTrace
+==================
+*/
+static void CM_FinishTrace( trace_t *results, traceWork_t *tw, const vec3_t start, const vec3_t end ) {
+	int			i;
+
+	// generate endpos from the original, unmodified start/end
+	if ( tw->trace.fraction == 1 ) {
+		VectorCopy (end, tw->trace.endpos);
+	} else {
+		for ( i=0 ; i<3 ; i++ ) {
+			tw->trace.endpos[i] = start[i] + tw->trace.fraction * (end[i] - start[i]);
+		}
+	}
+
+        // If allsolid is set (was entirely inside something solid), the plane is not valid.
+        // If fraction == 1.0, we never hit anything, and thus the plane is not valid.
+        // Otherwise, the normal on the plane should have unit length
+        assert(tw->trace.allsolid ||
+               tw->trace.fraction == 1.0 ||
+               VectorLengthSquared(tw->trace.plane.normal) > 0.9999);
+	*results = tw->trace;
+}
+
+
+/*
+==================
+CM_Trace
+==================
+*/
+static void CM_Trace( trace_t *results, const vec3_t start, const vec3_t end, const vec3_t mins, const vec3_t maxs,
+						clipHandle_t model, const vec3_t origin, int brushmask, qboolean capsule, const sphere_t *sphere ) {
+	traceWork_t	tw;
+	cmodel_t	*cmod;
+
+	cmod = CM_ClipHandleToModel( model );
+
+	cm.checkcount++;		// for multi-check avoidance
+
+	c_traces++;				// for statistics, may be zeroed
+
+	if ( !CM_SetupTrace( &tw, start, end, mins, maxs, origin, brushmask, capsule, sphere ) ) {
+		*results = tw.trace;
+
+		return;	// map not loaded, shouldn't happen
+	}
+
 	//
 	// check for position test special case
 	//
@@ -1291,18 +1493,7 @@ static void CM_Trace( trace_t *results, const vec3_t start, const vec3_t end, co
 			CM_PositionTest( &tw );
 		}
 	} else {
-		//
-		// check for point special case
-		//
-		if ( tw.size[0][0] == 0 && tw.size[0][1] == 0 && tw.size[0][2] == 0 ) {
-			tw.isPoint = qtrue;
-			VectorClear( tw.extents );
-		} else {
-			tw.isPoint = qfalse;
-			tw.extents[0] = tw.size[1][0];
-			tw.extents[1] = tw.size[1][1];
-			tw.extents[2] = tw.size[1][2];
-		}
+		CM_SetupSweep( &tw );
 
 		//
 		// general sweeping through world
@@ -1336,22 +1527,7 @@ static void CM_Trace( trace_t *results, const vec3_t start, const vec3_t end, co
 		}
 	}
 
-	// generate endpos from the original, unmodified start/end
-	if ( tw.trace.fraction == 1 ) {
-		VectorCopy (end, tw.trace.endpos);
-	} else {
-		for ( i=0 ; i<3 ; i++ ) {
-			tw.trace.endpos[i] = start[i] + tw.trace.fraction * (end[i] - start[i]);
-		}
-	}
-
-        // If allsolid is set (was entirely inside something solid), the plane is not valid.
-        // If fraction == 1.0, we never hit anything, and thus the plane is not valid.
-        // Otherwise, the normal on the plane should have unit length
-        assert(tw.trace.allsolid ||
-               tw.trace.fraction == 1.0 ||
-               VectorLengthSquared(tw.trace.plane.normal) > 0.9999);
-	*results = tw.trace;
+	CM_FinishTrace( results, &tw, start, end );
 }
 
 
@@ -1466,3 +1642,610 @@ void CM_TransformedBoxTrace( trace_t *results, const vec3_t start, const vec3_t
 
 	*results = trace;
 }
+
+
+/*
+===============================================================================
+
+BATCHED TRACING
+
+===============================================================================
+*/
+
+// rays traversing the tree together, limited by batchmask width and stack usage
+#define MAX_TRACE_PACKET	16
+
+typedef struct {
+	traceWork_t	tw[ MAX_TRACE_PACKET ];
+	int			count;
+
+	// trace bounds and contents by lane, for culling brushes against the whole packet
+	float		mins[3][ MAX_TRACE_PACKET ];
+	float		maxs[3][ MAX_TRACE_PACKET ];
+	int			contents[ MAX_TRACE_PACKET ];
+} tracePacket_t;
+
+
+/*
+================
+CM_LowestLane
+================
+*/
+static ID_INLINE int CM_LowestLane( unsigned int mask ) {
+#if defined(__GNUC__) || defined(__clang__)
+	return __builtin_ctz( mask );
+#elif defined(_MSC_VER)
+	unsigned long n;
+	_BitScanForward( &n, mask );
+	return (int)n;
+#else
+	int n;
+	for ( n = 0; !( mask & 1 ); n++ ) {
+		mask >>= 1;
+	}
+	return n;
+#endif
+}
+
+
+#ifdef USE_SSE2_TRACE
+/*
+================
+CM_TraceThroughBrush2
+
+Box sweep of two traces against the same brush, plane distances
+are evaluated in packed doubles in the same order as DotProductDP
+so results are identical to CM_TraceThroughBrush
+================
+*/
+static void CM_TraceThroughBrush2( traceWork_t *tw0, traceWork_t *tw1, const cbrush_t *brush ) {
+	traceWork_t	*tw[2];
+	const cbrushside_t *side, *leadside[2];
+	const cplane_t *plane, *clipplane[2];
+	const float	*o0, *o1;
+	float		enterFrac[2], leaveFrac[2];
+	qboolean	getout[2], startout[2];
+	double		d1v[2], d2v[2];
+	double		d1, d2;
+	float		f;
+	__m128d		sx, sy, sz, ex, ey, ez;
+	__m128d		nx, ny, nz, dist;
+	int			i, n, active;
+
+	tw[0] = tw0;
+	tw[1] = tw1;
+
+	for ( n = 0; n < 2; n++ ) {
+		enterFrac[n] = -1.0;
+		leaveFrac[n] = 1.0;
+		clipplane[n] = NULL;
+		leadside[n] = NULL;
+		getout[n] = qfalse;
+		startout[n] = qfalse;
+	}
+
+	c_brush_traces += 2;
+
+	sx = _mm_set_pd( tw1->start[0], tw0->start[0] );
+	sy = _mm_set_pd( tw1->start[1], tw0->start[1] );
+	sz = _mm_set_pd( tw1->start[2], tw0->start[2] );
+	ex = _mm_set_pd( tw1->end[0], tw0->end[0] );
+	ey = _mm_set_pd( tw1->end[1], tw0->end[1] );
+	ez = _mm_set_pd( tw1->end[2], tw0->end[2] );
+
+	active = 3;
+
+	for ( i = 0; i < brush->numsides; i++ ) {
+		side = brush->sides + i;
+		plane = side->plane;
+
+		nx = _mm_set1_pd( plane->normal[0] );
+		ny = _mm_set1_pd( plane->normal[1] );
+		nz = _mm_set1_pd( plane->normal[2] );
+
+		// adjust the plane distance appropriately for mins/maxs
+		o0 = tw0->offsets[ plane->signbits ];
+		o1 = tw1->offsets[ plane->signbits ];
+		dist = _mm_add_pd( _mm_add_pd( _mm_mul_pd( _mm_set_pd( o1[0], o0[0] ), nx ),
+			_mm_mul_pd( _mm_set_pd( o1[1], o0[1] ), ny ) ), _mm_mul_pd( _mm_set_pd( o1[2], o0[2] ), nz ) );
+		dist = _mm_sub_pd( _mm_set1_pd( plane->dist ), dist );
+
+		_mm_storeu_pd( d1v, _mm_sub_pd( _mm_add_pd( _mm_add_pd( _mm_mul_pd( sx, nx ),
+			_mm_mul_pd( sy, ny ) ), _mm_mul_pd( sz, nz ) ), dist ) );
+		_mm_storeu_pd( d2v, _mm_sub_pd( _mm_add_pd( _mm_add_pd( _mm_mul_pd( ex, nx ),
+			_mm_mul_pd( ey, ny ) ), _mm_mul_pd( ez, nz ) ), dist ) );
+
+		for ( n = 0; n < 2; n++ ) {
+			if ( !( active & ( 1 << n ) ) ) {
+				continue;
+			}
+
+			d1 = d1v[n];
+			d2 = d2v[n];
+
+			if (d2 > 0) {
+				getout[n] = qtrue;	// endpoint is not in solid
+			}
+			if (d1 > 0) {
+				startout[n] = qtrue;
+			}
+
+			// if completely in front of face, no intersection with the entire brush
+			if (d1 > 0 && ( d2 >= SURFACE_CLIP_EPSILON || d2 >= d1 )  ) {
+				active &= ~( 1 << n );
+				continue;
+			}
+
+			// if it doesn't cross the plane, the plane isn't relevant
+			if (d1 <= 0 && d2 <= 0 ) {
+				continue;
+			}
+
+			// crosses face
+			if (d1 > d2) {	// enter
+				f = (d1-SURFACE_CLIP_EPSILON) / (d1-d2);
+				if ( f < 0 ) {
+					f = 0;
+				}
+				if (f > enterFrac[n]) {
+					enterFrac[n] = f;
+					clipplane[n] = plane;
+					leadside[n] = side;
+				}
+			} else {	// leave
+				f = (d1+SURFACE_CLIP_EPSILON) / (d1-d2);
+				if ( f > 1 ) {
+					f = 1;
+				}
+				if (f < leaveFrac[n]) {
+					leaveFrac[n] = f;
+				}
+			}
+		}
+
+		if ( !active ) {
+			return;
+		}
+	}
+
+	for ( n = 0; n < 2; n++ ) {
+		if ( active & ( 1 << n ) ) {
+			CM_ClipToBrush( tw[n], brush, startout[n], getout[n], enterFrac[n], leaveFrac[n], clipplane[n], leadside[n] );
+		}
+	}
+}
+#endif // USE_SSE2_TRACE
+
+
+/*
+================
+CM_TraceThroughBrushLanes
+================
+*/
+static void CM_TraceThroughBrushLanes( tracePacket_t *tp, const cbrush_t *brush, unsigned int lanes ) {
+#ifdef USE_SSE2_TRACE
+	int			n, pending;
+
+	if ( !brush->numsides ) {
+		return;
+	}
+
+	pending = -1;
+	for ( ; lanes; lanes &= lanes - 1 ) {
+		n = CM_LowestLane( lanes );
+		if ( pending < 0 ) {
+			pending = n;
+		} else {
+			CM_TraceThroughBrush2( &tp->tw[ pending ], &tp->tw[ n ], brush );
+			pending = -1;
+		}
+	}
+
+	if ( pending >= 0 ) {
+		CM_TraceThroughBrush( &tp->tw[ pending ], brush );
+	}
+#else
+	for ( ; lanes; lanes &= lanes - 1 ) {
+		CM_TraceThroughBrush( &tp->tw[ CM_LowestLane( lanes ) ], brush );
+	}
+#endif
+}
+
+
+/*
+================
+CM_PacketTouchesBrush
+
+Returns the lanes of test that pass the contents and
+bounds tests of CM_TraceThroughLeaf for this brush
+================
+*/
+static unsigned int CM_PacketTouchesBrush( const tracePacket_t *tp, const cbrush_t *b, unsigned int test ) {
+	unsigned int lanes;
+	int			n;
+#ifdef USE_SSE2_TRACE
+	__m128		bmin0, bmin1, bmin2, bmax0, bmax1, bmax2, out;
+	__m128i		contents, zero;
+
+	bmin0 = _mm_set1_ps( b->bounds[0][0] - BOUNDS_CLIP_EPSILON );
+	bmin1 = _mm_set1_ps( b->bounds[0][1] - BOUNDS_CLIP_EPSILON );
+	bmin2 = _mm_set1_ps( b->bounds[0][2] - BOUNDS_CLIP_EPSILON );
+	bmax0 = _mm_set1_ps( b->bounds[1][0] + BOUNDS_CLIP_EPSILON );
+	bmax1 = _mm_set1_ps( b->bounds[1][1] + BOUNDS_CLIP_EPSILON );
+	bmax2 = _mm_set1_ps( b->bounds[1][2] + BOUNDS_CLIP_EPSILON );
+	contents = _mm_set1_epi32( b->contents );
+	zero = _mm_setzero_si128();
+
+	lanes = 0;
+	for ( n = 0; n < tp->count; n += 4 ) {
+		if ( !( ( test >> n ) & 15 ) ) {
+			continue;
+		}
+		out = _mm_cmplt_ps( _mm_loadu_ps( &tp->maxs[0][n] ), bmin0 );
+		out = _mm_or_ps( out, _mm_cmplt_ps( _mm_loadu_ps( &tp->maxs[1][n] ), bmin1 ) );
+		out = _mm_or_ps( out, _mm_cmplt_ps( _mm_loadu_ps( &tp->maxs[2][n] ), bmin2 ) );
+		out = _mm_or_ps( out, _mm_cmpgt_ps( _mm_loadu_ps( &tp->mins[0][n] ), bmax0 ) );
+		out = _mm_or_ps( out, _mm_cmpgt_ps( _mm_loadu_ps( &tp->mins[1][n] ), bmax1 ) );
+		out = _mm_or_ps( out, _mm_cmpgt_ps( _mm_loadu_ps( &tp->mins[2][n] ), bmax2 ) );
+		out = _mm_or_ps( out, _mm_castsi128_ps( _mm_cmpeq_epi32( _mm_and_si128(
+			_mm_loadu_si128( (const __m128i *)&tp->contents[n] ), contents ), zero ) ) );
+		lanes |= ( ~_mm_movemask_ps( out ) & 15 ) << n;
+	}
+#else
+	lanes = 0;
+	for ( ; test; test &= test - 1 ) {
+		n = CM_LowestLane( test );
+		if ( ( b->contents & tp->contents[n] ) && CM_BoundsIntersect( tp->tw[n].bounds[0], tp->tw[n].bounds[1],
+				b->bounds[0], b->bounds[1] ) ) {
+			lanes |= 1U << n;
+		}
+	}
+#endif
+	return lanes & test;
+}
+
+
+/*
+================
+CM_TraceThroughLeafPacket
+
+Each ray in the packet sees the brushes and patches
+in the same order as CM_TraceThroughLeaf would
+================
+*/
+static void CM_TraceThroughLeafPacket( tracePacket_t *tp, const cLeaf_t *leaf, unsigned int active ) {
+	int			k, n;
+	unsigned int test, lanes;
+	cbrush_t	*b;
+	cPatch_t	*patch;
+
+	// trace lines against all brushes in the leaf
+	for ( k = 0 ; k < leaf->numLeafBrushes ; k++ ) {
+		b = &cm.brushes[ cm.leafbrushes[ leaf->firstLeafBrush + k ] ];
+		if ( b->batchcount != cm.batchcount ) {
+			b->batchcount = cm.batchcount;
+			b->batchmask = 0;
+		}
+
+		// skip rays that already checked this brush in another leaf
+		test = active & ~b->batchmask;
+		if ( !test ) {
+			continue;
+		}
+		b->batchmask |= test;
+
+		lanes = CM_PacketTouchesBrush( tp, b, test );
+		if ( !lanes ) {
+			continue;
+		}
+
+		CM_TraceThroughBrushLanes( tp, b, lanes );
+
+		for ( ; lanes; lanes &= lanes - 1 ) {
+			n = CM_LowestLane( lanes );
+			if ( !tp->tw[n].trace.fraction ) {
+				active &= ~( 1U << n );
+			}
+		}
+
+		if ( !active ) {
+			return;
+		}
+	}
+
+	// trace lines against all patches in the leaf
+#ifdef BSPC
+	if (1) {
+#else
+	if ( !cm_noCurves->integer ) {
+#endif
+		for ( k = 0 ; k < leaf->numLeafSurfaces ; k++ ) {
+			patch = cm.surfaces[ cm.leafsurfaces[ leaf->firstLeafSurface + k ] ];
+			if ( !patch ) {
+				continue;
+			}
+			if ( patch->batchcount != cm.batchcount ) {
+				patch->batchcount = cm.batchcount;
+				patch->batchmask = 0;
+			}
+
+			test = active & ~patch->batchmask;
+			if ( !test ) {
+				continue;
+			}
+			patch->batchmask |= test;
+
+			for ( ; test; test &= test - 1 ) {
+				n = CM_LowestLane( test );
+				if ( !(patch->contents & tp->tw[n].contents) ) {
+					continue;
+				}
+				CM_TraceThroughPatch( &tp->tw[n], patch );
+				if ( !tp->tw[n].trace.fraction ) {
+					active &= ~( 1U << n );
+				}
+			}
+
+			if ( !active ) {
+				return;
+			}
+		}
+	}
+}
+
+
+/*
+==================
+CM_TraceThroughTreePacket
+
+Same traversal as CM_TraceThroughTree for a set of rays at once.
+Rays crossing a node are split so that every ray still visits the
+leafs in its own near-to-far order:
+  children[0] gets rays in front and near halves of rays entering from the front,
+  children[1] gets rays behind, far halves of front rays and near halves of back rays,
+  children[0] then gets far halves of rays entering from the back.
+==================
+*/
+static void CM_TraceThroughTreePacket( tracePacket_t *tp, int num, unsigned int active,
+		const float *p1f, const float *p2f, vec3_t *p1, vec3_t *p2 ) {
+	cNode_t		*node;
+	cplane_t	*plane;
+	traceWork_t	*tw;
+	double		t1, t2, offset;
+	float		frac, frac2;
+	float		idist;
+	unsigned int front, back, crossFront, crossBack, bit, m;
+	int			n;
+	float		nearf[ MAX_TRACE_PACKET ], farf[ MAX_TRACE_PACKET ], startf[ MAX_TRACE_PACKET ];
+	vec3_t		nearp[ MAX_TRACE_PACKET ], farp[ MAX_TRACE_PACKET ], startp[ MAX_TRACE_PACKET ];
+
+	for ( m = active; m; m &= m - 1 ) {
+		n = CM_LowestLane( m );
+		if ( tp->tw[n].trace.fraction <= p1f[n] ) {
+			active &= ~( 1U << n );		// already hit something nearer
+		}
+	}
+
+	if ( !active ) {
+		return;
+	}
+
+	// if < 0, we are in a leaf node
+	if ( num < 0 ) {
+		CM_TraceThroughLeafPacket( tp, &cm.leafs[-1-num], active );
+		return;
+	}
+
+	node = cm.nodes + num;
+	plane = node->plane;
+
+	front = back = crossFront = crossBack = 0;
+
+	for ( m = active; m; m &= m - 1 ) {
+		n = CM_LowestLane( m );
+		bit = 1U << n;
+		tw = &tp->tw[n];
+
+		// adjust the plane distance appropriately for mins/maxs
+		if ( plane->type < 3 ) {
+			t1 = p1[n][plane->type] - plane->dist;
+			t2 = p2[n][plane->type] - plane->dist;
+			offset = tw->extents[plane->type];
+		} else {
+			t1 = DotProductDP( plane->normal, p1[n] ) - plane->dist;
+			t2 = DotProductDP( plane->normal, p2[n] ) - plane->dist;
+			if ( tw->isPoint ) {
+				offset = 0;
+			} else {
+				// this is silly
+				offset = 2048;
+			}
+		}
+
+		// see which sides we need to consider
+		if ( t1 >= offset + 1 && t2 >= offset + 1 ) {
+			front |= bit;
+			continue;
+		}
+		if ( t1 < -offset - 1 && t2 < -offset - 1 ) {
+			back |= bit;
+			continue;
+		}
+
+		// put the crosspoint SURFACE_CLIP_EPSILON pixels on the near side
+		if ( t1 < t2 ) {
+			idist = 1.0/(t1-t2);
+			crossBack |= bit;
+			frac2 = (t1 + offset + SURFACE_CLIP_EPSILON)*idist;
+			frac = (t1 - offset + SURFACE_CLIP_EPSILON)*idist;
+		} else if (t1 > t2) {
+			idist = 1.0/(t1-t2);
+			crossFront |= bit;
+			frac2 = (t1 - offset - SURFACE_CLIP_EPSILON)*idist;
+			frac = (t1 + offset + SURFACE_CLIP_EPSILON)*idist;
+		} else {
+			crossFront |= bit;
+			frac = 1;
+			frac2 = 0;
+		}
+
+		// move up to the node
+		if ( frac < 0 ) {
+			frac = 0;
+		} else if ( frac > 1 ) {
+			frac = 1;
+		}
+
+		nearf[n] = p1f[n] + (p2f[n] - p1f[n])*frac;
+
+		nearp[n][0] = p1[n][0] + frac*(p2[n][0] - p1[n][0]);
+		nearp[n][1] = p1[n][1] + frac*(p2[n][1] - p1[n][1]);
+		nearp[n][2] = p1[n][2] + frac*(p2[n][2] - p1[n][2]);
+
+		// go past the node
+		if ( frac2 < 0 ) {
+			frac2 = 0;
+		} else if ( frac2 > 1 ) {
+			frac2 = 1;
+		}
+
+		farf[n] = p1f[n] + (p2f[n] - p1f[n])*frac2;
+
+		farp[n][0] = p1[n][0] + frac2*(p2[n][0] - p1[n][0]);
+		farp[n][1] = p1[n][1] + frac2*(p2[n][1] - p1[n][1]);
+		farp[n][2] = p1[n][2] + frac2*(p2[n][2] - p1[n][2]);
+	}
+
+	if ( !( crossFront | crossBack ) ) {
+		// nothing to split
+		if ( front ) {
+			CM_TraceThroughTreePacket( tp, node->children[0], front, p1f, p2f, p1, p2 );
+		}
+		if ( back ) {
+			CM_TraceThroughTreePacket( tp, node->children[1], back, p1f, p2f, p1, p2 );
+		}
+		return;
+	}
+
+	if ( front | crossFront ) {
+		for ( m = front; m; m &= m - 1 ) {
+			n = CM_LowestLane( m );
+			nearf[n] = p2f[n];
+			VectorCopy( p2[n], nearp[n] );
+		}
+		CM_TraceThroughTreePacket( tp, node->children[0], front | crossFront, p1f, nearf, p1, nearp );
+	}
+
+	// nearf/nearp still hold the near halves of crossBack rays
+	for ( m = back | crossBack; m; m &= m - 1 ) {
+		n = CM_LowestLane( m );
+		startf[n] = p1f[n];
+		VectorCopy( p1[n], startp[n] );
+	}
+	for ( m = back | crossFront; m; m &= m - 1 ) {
+		n = CM_LowestLane( m );
+		nearf[n] = p2f[n];
+		VectorCopy( p2[n], nearp[n] );
+	}
+	for ( m = crossFront; m; m &= m - 1 ) {
+		n = CM_LowestLane( m );
+		startf[n] = farf[n];
+		VectorCopy( farp[n], startp[n] );
+	}
+	CM_TraceThroughTreePacket( tp, node->children[1], back | crossFront | crossBack, startf, nearf, startp, nearp );
+
+	if ( crossBack ) {
+		CM_TraceThroughTreePacket( tp, node->children[0], crossBack, farf, p2f, farp, p2 );
+	}
+}
+
+
+/*
+==================
+CM_TracePacket
+==================
+*/
+static void CM_TracePacket( trace_t *results, const cmTraceRay_t *rays, tracePacket_t *tp, const int *index ) {
+	float		p1f[ MAX_TRACE_PACKET ], p2f[ MAX_TRACE_PACKET ];
+	vec3_t		p1[ MAX_TRACE_PACKET ], p2[ MAX_TRACE_PACKET ];
+	int			i, n;
+
+	if ( tp->count == 1 ) {
+		// nothing to share, plain traversal is cheaper
+		cm.checkcount++;
+		CM_TraceThroughTree( &tp->tw[0], 0, 0, 1, tp->tw[0].start, tp->tw[0].end );
+		CM_FinishTrace( &results[ index[0] ], &tp->tw[0], rays[ index[0] ].start, rays[ index[0] ].end );
+		return;
+	}
+
+	for ( n = 0; n < tp->count; n++ ) {
+		p1f[n] = 0;
+		p2f[n] = 1;
+		VectorCopy( tp->tw[n].start, p1[n] );
+		VectorCopy( tp->tw[n].end, p2[n] );
+		for ( i = 0; i < 3; i++ ) {
+			tp->mins[i][n] = tp->tw[n].bounds[0][i];
+			tp->maxs[i][n] = tp->tw[n].bounds[1][i];
+		}
+		tp->contents[n] = tp->tw[n].contents;
+	}
+
+	// unused lanes of the last group of four never touch anything
+	for ( ; n & 3; n++ ) {
+		for ( i = 0; i < 3; i++ ) {
+			tp->mins[i][n] = 0;
+			tp->maxs[i][n] = 0;
+		}
+		tp->contents[n] = 0;
+	}
+
+	cm.batchcount++;		// for multi-check avoidance
+
+	CM_TraceThroughTreePacket( tp, 0, ( 1U << tp->count ) - 1, p1f, p2f, p1, p2 );
+
+	for ( n = 0; n < tp->count; n++ ) {
+		CM_FinishTrace( &results[ index[n] ], &tp->tw[n], rays[ index[n] ].start, rays[ index[n] ].end );
+	}
+}
+
+
+/*
+==================
+CM_BoxTraceBatch
+
+World sweeps are grouped into packets that walk the tree together,
+position tests, capsules and inline models go through CM_BoxTrace
+==================
+*/
+void CM_BoxTraceBatch( trace_t *results, const cmTraceRay_t *rays, int numRays, clipHandle_t model ) {
+	tracePacket_t	tp;
+	int				index[ MAX_TRACE_PACKET ];
+	const cmTraceRay_t *ray;
+	int				i;
+
+	tp.count = 0;
+
+	for ( i = 0; i < numRays; i++ ) {
+		ray = &rays[i];
+
+		if ( model || ray->capsule || !cm.numNodes || VectorCompare( ray->start, ray->end ) ) {
+			CM_BoxTrace( &results[i], ray->start, ray->end, ray->mins, ray->maxs, model, ray->brushmask, ray->capsule );
+			continue;
+		}
+
+		c_traces++;			// for statistics, may be zeroed
+
+		CM_SetupTrace( &tp.tw[ tp.count ], ray->start, ray->end, ray->mins, ray->maxs, vec3_origin, ray->brushmask, qfalse, NULL );
+		CM_SetupSweep( &tp.tw[ tp.count ] );
+		index[ tp.count ] = i;
+
+		if ( ++tp.count == MAX_TRACE_PACKET ) {
+			CM_TracePacket( results, rays, &tp, index );
+			tp.count = 0;
+		}
+	}
+
+	if ( tp.count ) {
+		CM_TracePacket( results, rays, &tp, index );
+	}
+}
@@ -400,6 +400,7 @@ typedef struct cmd_function_s
     char					*description;
 	xcommand_t				function;
 	completionFunc_t	complete;
+	unsigned int			hash;	// Com_HashNameNoCase( name )
 } cmd_function_t;
 
 
@@ -674,6 +675,89 @@ void Cmd_TokenizeStringIgnoreQuotes( const char *text_in ) {
 }
 
 
+/*
+============
+Command hash
+
+Open addressing with linear probing, kept at most half full
+============
+*/
+#define	CMD_HASH_MIN	512
+
+static cmd_function_t **cmd_hashTable;
+static int cmd_hashSize;
+static int cmd_hashCount;
+
+
+static void Cmd_HashInsert( cmd_function_t *cmd );
+
+static void Cmd_HashResize( int size ) {
+	cmd_function_t **oldTable;
+	int i, oldSize;
+
+	oldTable = cmd_hashTable;
+	oldSize = cmd_hashSize;
+
+	// commands are registered before the main zone exists
+	cmd_hashTable = S_Malloc( size * sizeof( *cmd_hashTable ) );
+	Com_Memset( cmd_hashTable, 0, size * sizeof( *cmd_hashTable ) );
+	cmd_hashSize = size;
+	cmd_hashCount = 0;
+
+	for ( i = 0; i < oldSize; i++ ) {
+		if ( oldTable[ i ] ) {
+			Cmd_HashInsert( oldTable[ i ] );
+		}
+	}
+
+	if ( oldTable ) {
+		Z_Free( oldTable );
+	}
+}
+
+
+static void Cmd_HashInsert( cmd_function_t *cmd ) {
+	int mask, i;
+
+	if ( ( cmd_hashCount + 1 ) * 2 > cmd_hashSize ) {
+		Cmd_HashResize( cmd_hashSize ? cmd_hashSize * 2 : CMD_HASH_MIN );
+	}
+
+	mask = cmd_hashSize - 1;
+	for ( i = cmd->hash & mask; cmd_hashTable[ i ]; i = ( i + 1 ) & mask )
+		;
+
+	cmd_hashTable[ i ] = cmd;
+	cmd_hashCount++;
+}
+
+
+static void Cmd_HashRemove( const cmd_function_t *cmd ) {
+	cmd_function_t *other;
+	int mask, i, j, k;
+
+	mask = cmd_hashSize - 1;
+	for ( i = cmd->hash & mask; cmd_hashTable[ i ] != cmd; i = ( i + 1 ) & mask ) {
+		if ( cmd_hashTable[ i ] == NULL ) {
+			return;
+		}
+	}
+
+	// shift back following entries of the probe run that
+	// would no longer be reachable over the hole
+	for ( j = ( i + 1 ) & mask; ( other = cmd_hashTable[ j ] ) != NULL; j = ( j + 1 ) & mask ) {
+		k = other->hash & mask;
+		if ( ( ( j - k ) & mask ) >= ( ( j - i ) & mask ) ) {
+			cmd_hashTable[ i ] = other;
+			i = j;
+		}
+	}
+
+	cmd_hashTable[ i ] = NULL;
+	cmd_hashCount--;
+}
+
+
 /*
 ============
 Cmd_FindCommand
@@ -682,9 +766,20 @@ Cmd_FindCommand
 static cmd_function_t *Cmd_FindCommand( const char *cmd_name )
 {
 	cmd_function_t *cmd;
-	for( cmd = cmd_functions; cmd; cmd = cmd->next )
-		if( !Q_stricmp( cmd_name, cmd->name ) )
+	unsigned int hash;
+	int mask, i;
+
+	if ( !cmd_hashSize )
+		return NULL;
+
+	hash = Com_HashNameNoCase( cmd_name );
+	mask = cmd_hashSize - 1;
+
+	for ( i = hash & mask; ( cmd = cmd_hashTable[ i ] ) != NULL; i = ( i + 1 ) & mask ) {
+		if ( cmd->hash == hash && !Q_stricmp( cmd_name, cmd->name ) )
 			return cmd;
+	}
+
 	return NULL;
 }
 
@@ -712,8 +807,11 @@ void Cmd_AddCommand( const char *cmd_name, xcommand_t function ) {
     cmd->description = NULL;
 	cmd->function = function;
 	cmd->complete = NULL;
+	cmd->hash = Com_HashNameNoCase( cmd_name );
 	cmd->next = cmd_functions;
 	cmd_functions = cmd;
+
+	Cmd_HashInsert( cmd );
 }
 
 /*
@@ -795,11 +893,9 @@ Cmd_SetCommandCompletionFunc
 void Cmd_SetCommandCompletionFunc( const char *command, completionFunc_t complete ) {
 	cmd_function_t *cmd;
 
-	for( cmd = cmd_functions; cmd; cmd = cmd->next ) {
-		if( !Q_stricmp( command, cmd->name ) ) {
-			cmd->complete = complete;
-			return;
-		}
+	cmd = Cmd_FindCommand( command );
+	if ( cmd ) {
+		cmd->complete = complete;
 	}
 }
 
@@ -812,14 +908,17 @@ Cmd_RemoveCommand
 void Cmd_RemoveCommand( const char *cmd_name ) {
 	cmd_function_t *cmd, **back;
 
+	cmd = Cmd_FindCommand( cmd_name );
+	if ( !cmd ) {
+		// command wasn't active
+		return;
+	}
+
+	Cmd_HashRemove( cmd );
+
 	back = &cmd_functions;
 	while( 1 ) {
-		cmd = *back;
-		if ( !cmd ) {
-			// command wasn't active
-			return;
-		}
-		if ( !Q_stricmp( cmd_name, cmd->name ) ) {
+		if ( *back == cmd ) {
 			*back = cmd->next;
 			if (cmd->name) {
 				Z_Free(cmd->name);
@@ -830,7 +929,7 @@ void Cmd_RemoveCommand( const char *cmd_name ) {
 			Z_Free (cmd);
 			return;
 		}
-		back = &cmd->next;
+		back = &(*back)->next;
 	}
 }
 
@@ -906,13 +1005,12 @@ Cmd_CompleteArgument
 qboolean Cmd_CompleteArgument( const char *command, char *args, int argNum ) {
 	const cmd_function_t *cmd;
 
-	for( cmd = cmd_functions; cmd; cmd = cmd->next ) {
-		if ( !Q_stricmp( command, cmd->name ) ) {
-			if ( cmd->complete ) {
-				cmd->complete( args, argNum );
-			}
-			return qtrue;
+	cmd = Cmd_FindCommand( command );
+	if ( cmd ) {
+		if ( cmd->complete ) {
+			cmd->complete( args, argNum );
 		}
+		return qtrue;
 	}
 
 	return qfalse;
@@ -927,7 +1025,7 @@ A complete command line has been parsed, so try to execute it
 ============
 */
 void Cmd_ExecuteString( const char *text ) {
-	cmd_function_t *cmd, **prev;
+	cmd_function_t *cmd;
 
 	// execute the command line
 	Cmd_TokenizeString( text );
@@ -935,25 +1033,13 @@ void Cmd_ExecuteString( const char *text ) {
 		return;		// no tokens
 	}
 
-	// check registered command functions
-	for ( prev = &cmd_functions ; *prev ; prev = &cmd->next ) {
-		cmd = *prev;
-		if ( !Q_stricmp( cmd_argv[0], cmd->name ) ) {
-			// rearrange the links so that the command will be
-			// near the head of the list next time it is used
-			*prev = cmd->next;
-			cmd->next = cmd_functions;
-			cmd_functions = cmd;
-
-			// perform the action
-			if ( !cmd->function ) {
-				// let the cgame or game handle it
-				break;
-			} else {
-				cmd->function();
-			}
-			return;
-		}
+	// check registered command functions,
+	// without a function the cgame or game handles it
+	cmd = Cmd_FindCommand( cmd_argv[0] );
+	if ( cmd && cmd->function ) {
+		// perform the action
+		cmd->function();
+		return;
 	}
 
 	// check cvars
@@ -1011,6 +1011,10 @@ all big things are allocated on the hunk.
 #define USE_STATIC_TAGS
 #define USE_TRASH_TEST
 
+#ifndef ZONE_DEBUG
+#define USE_ZONE_SLABS // serve small allocations from size-class slabs
+#endif
+
 #ifdef ZONE_DEBUG
 typedef struct zonedebug_s {
 	char *label;
@@ -1338,33 +1342,13 @@ static void MergeBlock( memblock_t *curr_free, const memblock_t *next )
 
 /*
 ========================
-Z_Free
+Z_ZoneFree
 ========================
 */
-void Z_Free( void *ptr ) {
-	memblock_t	*block, *other;
+static void Z_ZoneFree( memblock_t *block ) {
+	memblock_t	*other;
 	memzone_t *zone;
 
-	if (!ptr) {
-		Com_Error( ERR_DROP, "Z_Free: NULL pointer" );
-	}
-
-	block = (memblock_t *) ( (byte *)ptr - sizeof(memblock_t));
-	if (block->id != ZONEID) {
-		Com_Error( ERR_FATAL, "Z_Free: freed a pointer without ZONEID" );
-	}
-
-	if (block->tag == TAG_FREE) {
-		Com_Error( ERR_FATAL, "Z_Free: freed a freed pointer" );
-	}
-
-	// if static memory
-#ifdef USE_STATIC_TAGS
-	if (block->tag == TAG_STATIC) {
-		return;
-	}
-#endif
-
 	// check the memory trash tester
 #ifdef USE_TRASH_TEST
 	if ( *(int *)((byte *)block + block->size - 4 ) != ZONEID ) {
@@ -1382,7 +1366,7 @@ void Z_Free( void *ptr ) {
 
 	// set the block to something that should cause problems
 	// if it is referenced...
-	Com_Memset( ptr, 0xaa, block->size - sizeof( *block ) );
+	Com_Memset( block + 1, 0xaa, block->size - sizeof( *block ) );
 
 	block->tag = TAG_FREE; // mark as free
 	block->id = ZONEID;
@@ -1421,6 +1405,316 @@ void Z_Free( void *ptr ) {
 }
 
 
+#ifdef USE_ZONE_SLABS
+/*
+==============================================================================
+
+Size-class slabs
+
+Allocations of up to SLAB_MAX_SIZE bytes are carved out of fixed size pages
+instead of searching and splitting zone free lists. A slab page is a regular
+block of the owning zone that carries the tag of its objects, so zone walks
+and per-tag accounting see it like any other block, only with SLABID.
+
+Each object keeps a full memblock_t header with SLABID, its tag, its class
+size and the trash tester; prev points to the owning page and next links
+free objects of the page.
+==============================================================================
+*/
+
+#define	SLABID			0x1d4a12
+#define	SLAB_MAX_SIZE	256
+#define	SLAB_MAX_BLOCK	296		// header + SLAB_MAX_SIZE + trash tester, padded
+#define	SLAB_PAGE_SIZE	4096
+
+typedef struct slabpage_s {
+	struct slabpage_s	*next, *prev;	// pages with free objects of the same class and tag
+	memblock_t	*freelist;
+	int			used;
+	int			count;
+	int			cls;
+	memtag_t	tag;
+} slabpage_t;
+
+static const int slabSizes[] = { 48, 64, 80, 96, 112, 128, 160, 192, 224, 256, SLAB_MAX_BLOCK };
+
+#define	SLAB_CLASSES	ARRAY_LEN( slabSizes )
+
+static byte slabClass[ ( SLAB_MAX_BLOCK >> 3 ) + 1 ];
+
+// pages with at least one free object
+static slabpage_t *slabPages[ TAG_COUNT ][ SLAB_CLASSES ];
+
+static qboolean zone_slabs = qtrue;
+
+static void *Z_ZoneMalloc( int size, memtag_t tag );
+
+
+static void Z_InitSlabs( void ) {
+	int i, cls;
+
+	for ( i = 0, cls = 0; i < ARRAY_LEN( slabClass ); i++ ) {
+		while ( slabSizes[ cls ] < i * 8 ) {
+			cls++;
+		}
+		slabClass[ i ] = cls;
+	}
+
+	Com_Memset( slabPages, 0, sizeof( slabPages ) );
+}
+
+
+static void Z_SlabLink( slabpage_t *page ) {
+	slabpage_t **head = &slabPages[ page->tag ][ page->cls ];
+
+	page->prev = NULL;
+	page->next = *head;
+	if ( *head ) {
+		(*head)->prev = page;
+	}
+	*head = page;
+}
+
+
+static void Z_SlabUnlink( slabpage_t *page ) {
+	if ( page->prev ) {
+		page->prev->next = page->next;
+	} else {
+		slabPages[ page->tag ][ page->cls ] = page->next;
+	}
+	if ( page->next ) {
+		page->next->prev = page->prev;
+	}
+	page->next = page->prev = NULL;
+}
+
+
+/*
+================
+Z_SlabNewPage
+================
+*/
+static slabpage_t *Z_SlabNewPage( int cls, memtag_t tag ) {
+	memblock_t *base, *block;
+	slabpage_t *page;
+	int i, size;
+
+	base = (memblock_t *)Z_ZoneMalloc( SLAB_PAGE_SIZE - sizeof( *base ) - 4, tag ) - 1;
+	base->id = SLABID;
+
+	size = slabSizes[ cls ];
+
+	page = (slabpage_t *)( base + 1 );
+	page->cls = cls;
+	page->tag = tag;
+	page->used = 0;
+	page->count = ( SLAB_PAGE_SIZE - sizeof( *base ) - 4 - sizeof( *page ) ) / size;
+	page->freelist = NULL;
+
+	// build the free list in address order
+	for ( i = page->count - 1; i >= 0; i-- ) {
+		block = (memblock_t *)( (byte *)( page + 1 ) + i * size );
+		block->prev = (memblock_t *)page;
+		block->next = page->freelist;
+		block->size = size;
+		block->tag = TAG_FREE;
+		block->id = SLABID;
+		page->freelist = block;
+	}
+
+	Z_SlabLink( page );
+
+	return page;
+}
+
+
+/*
+================
+Z_SlabReleasePage
+
+Returns the page to its zone, objects still in use are dropped
+================
+*/
+static int Z_SlabReleasePage( slabpage_t *page ) {
+	memblock_t *base = (memblock_t *)page - 1;
+	int used = page->used;
+
+	if ( page->freelist ) {
+		Z_SlabUnlink( page );
+	}
+
+	base->id = ZONEID;
+	Z_ZoneFree( base );
+
+	return used;
+}
+
+
+/*
+================
+Z_SlabAlloc
+================
+*/
+static void *Z_SlabAlloc( int size, memtag_t tag ) {
+	slabpage_t *page;
+	memblock_t *block;
+	int cls;
+
+	// account for block header and trash tester
+	cls = slabClass[ ( sizeof( *block ) + size + 4 + 7 ) >> 3 ];
+
+	page = slabPages[ tag ][ cls ];
+	if ( page == NULL ) {
+		page = Z_SlabNewPage( cls, tag );
+	}
+
+	block = page->freelist;
+	page->freelist = block->next;
+	page->used++;
+	if ( page->freelist == NULL ) {
+		Z_SlabUnlink( page );
+	}
+
+	block->tag = tag;
+
+#ifdef USE_TRASH_TEST
+	*(int *)((byte *)block + block->size - 4) = ZONEID;
+#endif
+
+	return (void *) ( block + 1 );
+}
+
+
+/*
+================
+Z_SlabFree
+================
+*/
+static void Z_SlabFree( memblock_t *block ) {
+	slabpage_t *page;
+
+	if ( block->tag == TAG_FREE ) {
+		Com_Error( ERR_FATAL, "Z_Free: freed a freed pointer" );
+	}
+
+#ifdef USE_TRASH_TEST
+	if ( *(int *)((byte *)block + block->size - 4 ) != ZONEID ) {
+		Com_Error( ERR_FATAL, "Z_Free: memory block wrote past end" );
+	}
+#endif
+
+	page = (slabpage_t *)block->prev;
+
+	Com_Memset( block + 1, 0xaa, block->size - sizeof( *block ) );
+
+	block->tag = TAG_FREE;
+	block->next = page->freelist;
+	if ( page->freelist == NULL ) {
+		Z_SlabLink( page ); // was full
+	}
+	page->freelist = block;
+
+	// keep only one empty page per class around
+	if ( --page->used == 0 && ( page->prev || page->next ) ) {
+		Z_SlabReleasePage( page );
+	}
+}
+
+
+/*
+==============================================================================
+
+Allocation trace
+
+Records Z_TagMalloc/Z_Free calls so they can be replayed later by zonebench.
+Events are kept in system memory to not disturb the zone while recording.
+==============================================================================
+*/
+
+#define	ZONE_TRACE_MAX	(1<<22)
+
+typedef struct {
+	int			size;	// -1 for Z_Free
+	int			tag;
+	uint64_t	ptr;
+} zoneTraceEvent_t;
+
+static struct {
+	zoneTraceEvent_t *events;
+	int			count;
+	int			max;
+	qboolean	active;
+	char		name[ MAX_QPATH ];
+} zoneTrace;
+
+
+static void Z_TraceEvent( const void *ptr, int size, memtag_t tag ) {
+	zoneTraceEvent_t *ev;
+
+	if ( zoneTrace.count >= zoneTrace.max ) {
+		if ( zoneTrace.max >= ZONE_TRACE_MAX ) {
+			return;
+		}
+		ev = realloc( zoneTrace.events, ( zoneTrace.max + 65536 ) * sizeof( *ev ) );
+		if ( ev == NULL ) {
+			return;
+		}
+		zoneTrace.events = ev;
+		zoneTrace.max += 65536;
+	}
+
+	ev = zoneTrace.events + zoneTrace.count++;
+	ev->size = size;
+	ev->tag = tag;
+	ev->ptr = (uintptr_t)ptr;
+}
+#endif // USE_ZONE_SLABS
+
+
+/*
+========================
+Z_Free
+========================
+*/
+void Z_Free( void *ptr ) {
+	memblock_t	*block;
+
+	if (!ptr) {
+		Com_Error( ERR_DROP, "Z_Free: NULL pointer" );
+	}
+
+	block = (memblock_t *) ( (byte *)ptr - sizeof(memblock_t));
+
+#ifdef USE_ZONE_SLABS
+	if ( zoneTrace.active && block->tag != TAG_STATIC ) {
+		Z_TraceEvent( ptr, -1, block->tag );
+	}
+
+	if ( block->id == SLABID ) {
+		Z_SlabFree( block );
+		return;
+	}
+#endif
+
+	if (block->id != ZONEID) {
+		Com_Error( ERR_FATAL, "Z_Free: freed a pointer without ZONEID" );
+	}
+
+	if (block->tag == TAG_FREE) {
+		Com_Error( ERR_FATAL, "Z_Free: freed a freed pointer" );
+	}
+
+	// if static memory
+#ifdef USE_STATIC_TAGS
+	if (block->tag == TAG_STATIC) {
+		return;
+	}
+#endif
+
+	Z_ZoneFree( block );
+}
+
+
 /*
 ================
 Z_FreeTags
@@ -1451,6 +1745,16 @@ int Z_FreeTags( memtag_t tag ) {
 			block = freed;
 			count++;
 		}
+#ifdef USE_ZONE_SLABS
+		else if ( block->tag == tag && block->id == SLABID ) {
+			if ( block->prev->tag == TAG_FREE )
+				freed = block->prev;
+			else
+				freed = block;
+			count += Z_SlabReleasePage( (slabpage_t *)( block + 1 ) );
+			block = freed;
+		}
+#endif
 		if ( block->next == &zone->blocklist ) {
 			break;	// all blocks have been hit
 		}
@@ -1469,6 +1773,8 @@ Z_TagMalloc
 #ifdef ZONE_DEBUG
 void *Z_TagMallocDebug( int size, memtag_t tag, char *label, char *file, int line ) {
 	int		allocSize;
+#elif defined (USE_ZONE_SLABS)
+static void *Z_ZoneMalloc( int size, memtag_t tag ) {
 #else
 void *Z_TagMalloc( int size, memtag_t tag ) {
 #endif
@@ -1585,6 +1891,30 @@ void *Z_TagMalloc( int size, memtag_t tag ) {
 }
 
 
+#ifdef USE_ZONE_SLABS
+/*
+================
+Z_TagMalloc
+================
+*/
+void *Z_TagMalloc( int size, memtag_t tag ) {
+	void *ptr;
+
+	if ( (unsigned)size <= SLAB_MAX_SIZE && tag != TAG_FREE && (unsigned)tag < TAG_COUNT && zone_slabs ) {
+		ptr = Z_SlabAlloc( size, tag );
+	} else {
+		ptr = Z_ZoneMalloc( size, tag );
+	}
+
+	if ( zoneTrace.active ) {
+		Z_TraceEvent( ptr, size, tag );
+	}
+
+	return ptr;
+}
+#endif
+
+
 /*
 ========================
 Z_Malloc
@@ -1703,6 +2033,11 @@ static void Z_LogZoneHeap( memzone_t *zone, const char *name ) {
 			allocSize += block->d.allocSize;
 #endif
 			size += block->size;
+#ifdef USE_ZONE_SLABS
+			if ( block->id == SLABID ) {
+				numBlocks += ((slabpage_t *)( block + 1 ))->used;
+			} else
+#endif
 			numBlocks++;
 		}
 		if ( block->next == &zone->blocklist ) {
@@ -1734,6 +2069,291 @@ void Z_LogHeap( void ) {
 	Z_LogZoneHeap( smallzone, "SMALL" );
 }
 
+
+#ifdef USE_ZONE_SLABS
+#define ZONE_TRACE_MAGIC "ZTRACE1"
+
+/*
+========================
+Z_Trace_f
+========================
+*/
+static void Z_Trace_f( void ) {
+	fileHandle_t f;
+
+	if ( zoneTrace.active ) {
+		zoneTrace.active = qfalse;
+		f = FS_FOpenFileWrite( zoneTrace.name );
+		if ( f == FS_INVALID_HANDLE ) {
+			Com_Printf( "Couldn't write %s.\n", zoneTrace.name );
+		} else {
+			// events are stored in host byte order
+			FS_Write( ZONE_TRACE_MAGIC, 8, f );
+			FS_Write( zoneTrace.events, zoneTrace.count * sizeof( zoneTraceEvent_t ), f );
+			FS_FCloseFile( f );
+			Com_Printf( "Wrote %i zone events to %s%s\n", zoneTrace.count, zoneTrace.name,
+				zoneTrace.count >= ZONE_TRACE_MAX ? " (truncated)" : "" );
+		}
+		free( zoneTrace.events );
+		zoneTrace.events = NULL;
+		zoneTrace.count = zoneTrace.max = 0;
+		return;
+	}
+
+	if ( Cmd_Argc() < 2 ) {
+		Com_Printf( "usage: zonetrace <filename>\n" );
+		return;
+	}
+
+	Q_strncpyz( zoneTrace.name, Cmd_Argv( 1 ), sizeof( zoneTrace.name ) );
+	COM_DefaultExtension( zoneTrace.name, sizeof( zoneTrace.name ), ".ztr" );
+	zoneTrace.count = 0;
+	zoneTrace.active = qtrue;
+
+	Com_Printf( "Recording zone allocations to %s, run zonetrace again to stop.\n", zoneTrace.name );
+}
+
+
+typedef struct {
+	int		slot;
+	int		size;	// -1 for Z_Free
+	memtag_t tag;
+} zoneBenchOp_t;
+
+
+/*
+========================
+Z_BenchBlockSize
+
+Zone memory taken by an allocation of the given size, at least
+========================
+*/
+static int Z_BenchBlockSize( int size ) {
+	size += sizeof( memblock_t ) + 4;
+	if ( size <= SLAB_MAX_BLOCK ) {
+		return slabSizes[ slabClass[ ( size + 7 ) >> 3 ] ];
+	}
+	return PAD( size, sizeof( intptr_t ) );
+}
+
+
+static void Z_BenchReplay( const zoneBenchOp_t *ops, int numOps, const int *leftover, int numLeftover, void **ptrs, int *peak ) {
+	const zoneBenchOp_t *op;
+	int i, base, used;
+
+	base = mainzone->used + smallzone->used;
+	for ( i = 0, op = ops; i < numOps; i++, op++ ) {
+		if ( op->size >= 0 ) {
+			ptrs[ op->slot ] = Z_TagMalloc( op->size, op->tag );
+			if ( peak ) {
+				used = mainzone->used + smallzone->used - base;
+				if ( used > *peak ) {
+					*peak = used;
+				}
+			}
+		} else {
+			Z_Free( ptrs[ op->slot ] );
+		}
+	}
+
+	// blocks still in use at the end of the trace
+	for ( i = 0; i < numLeftover; i++ ) {
+		Z_Free( ptrs[ leftover[ i ] ] );
+	}
+}
+
+
+/*
+========================
+Z_Bench_f
+
+Replays an allocation trace recorded by zonetrace with and without slabs
+========================
+*/
+static void Z_Bench_f( void ) {
+	char name[ MAX_QPATH ];
+	union {
+		byte *b;
+		void *v;
+	} buf;
+	const zoneTraceEvent_t *ev;
+	zoneBenchOp_t *ops;
+	uint64_t *slotPtr;
+	int *heads, *chain, *leftover, *blockSize;
+	byte *live;
+	void **ptrs;
+	int64_t start, elapsed[2];
+	int peak[2];
+	int64_t liveBytes[2], peakBytes[2], limit;
+	int len, numEvents, numOps, numSlots, numAllocs, numFrees, numLeftover, dropped;
+	int i, h, slot, zone, mask, mode, iter, iterations;
+	qboolean slabs, fits;
+
+	if ( Cmd_Argc() < 2 ) {
+		Com_Printf( "usage: zonebench <filename> [iterations]\n" );
+		return;
+	}
+
+	if ( zoneTrace.active ) {
+		Com_Printf( "Stop zonetrace first.\n" );
+		return;
+	}
+
+	Q_strncpyz( name, Cmd_Argv( 1 ), sizeof( name ) );
+	COM_DefaultExtension( name, sizeof( name ), ".ztr" );
+
+	iterations = Cmd_Argc() > 2 ? atoi( Cmd_Argv( 2 ) ) : 10;
+	if ( iterations < 1 ) {
+		iterations = 1;
+	}
+
+	len = FS_ReadFile( name, &buf.v );
+	if ( len < 8 || memcmp( buf.b, ZONE_TRACE_MAGIC, 8 ) ) {
+		Com_Printf( "Couldn't load zone trace %s.\n", name );
+		if ( len > 0 ) {
+			FS_FreeFile( buf.v );
+		}
+		return;
+	}
+
+	numEvents = ( len - 8 ) / sizeof( zoneTraceEvent_t );
+	ev = (const zoneTraceEvent_t *)( buf.b + 8 );
+
+	for ( mask = 1; mask < numEvents * 2; mask <<= 1 )
+		;
+	mask--;
+
+	ops = malloc( numEvents * sizeof( *ops ) );
+	slotPtr = malloc( numEvents * sizeof( *slotPtr ) );
+	chain = malloc( numEvents * sizeof( *chain ) );
+	leftover = malloc( numEvents * sizeof( *leftover ) );
+	live = malloc( numEvents * sizeof( *live ) );
+	blockSize = malloc( numEvents * sizeof( *blockSize ) );
+	ptrs = malloc( numEvents * sizeof( *ptrs ) );
+	heads = malloc( ( mask + 1 ) * sizeof( *heads ) );
+	if ( !ops || !slotPtr || !chain || !leftover || !live || !blockSize || !ptrs || !heads ) {
+		Com_Printf( S_COLOR_RED "zonebench: out of memory for %i events\n", numEvents );
+		free( ops );
+		free( slotPtr );
+		free( chain );
+		free( leftover );
+		free( live );
+		free( blockSize );
+		free( ptrs );
+		free( heads );
+		FS_FreeFile( buf.v );
+		return;
+	}
+	memset( heads, -1, ( mask + 1 ) * sizeof( *heads ) );
+
+	// turn pointers into slot indexes, frees of blocks allocated
+	// before the trace was started are dropped, live bytes are
+	// counted separately for the main [0] and small [1] zone
+	numOps = numSlots = numAllocs = numFrees = dropped = 0;
+	liveBytes[0] = liveBytes[1] = peakBytes[0] = peakBytes[1] = 0;
+	for ( i = 0; i < numEvents; i++, ev++ ) {
+		h = (int)( ( ev->ptr >> 3 ) * 2654435761U ) & mask;
+		if ( ev->size >= 0 ) {
+			slot = numSlots++;
+			slotPtr[ slot ] = ev->ptr;
+			chain[ slot ] = heads[ h ];
+			heads[ h ] = slot;
+			if ( ev->tag <= TAG_FREE || ev->tag >= TAG_STATIC ) {
+				live[ slot ] = 0;
+				dropped++;
+				continue;
+			}
+			zone = ( ev->tag == TAG_SMALL ) ? 1 : 0;
+			live[ slot ] = 1 + zone;
+			blockSize[ slot ] = Z_BenchBlockSize( ev->size );
+			liveBytes[ zone ] += blockSize[ slot ];
+			if ( liveBytes[ zone ] > peakBytes[ zone ] ) {
+				peakBytes[ zone ] = liveBytes[ zone ];
+			}
+			ops[ numOps ].slot = slot;
+			ops[ numOps ].size = ev->size;
+			ops[ numOps ].tag = ev->tag;
+			numOps++;
+			numAllocs++;
+		} else {
+			for ( slot = heads[ h ]; slot >= 0 && slotPtr[ slot ] != ev->ptr; slot = chain[ slot ] )
+				;
+			if ( slot < 0 || !live[ slot ] ) {
+				dropped++;
+				continue;
+			}
+			liveBytes[ live[ slot ] - 1 ] -= blockSize[ slot ];
+			live[ slot ] = 0;
+			ops[ numOps ].slot = slot;
+			ops[ numOps ].size = -1;
+			ops[ numOps ].tag = TAG_FREE;
+			numOps++;
+			numFrees++;
+		}
+	}
+
+	FS_FreeFile( buf.v );
+
+	numLeftover = 0;
+	for ( slot = 0; slot < numSlots; slot++ ) {
+		if ( live[ slot ] ) {
+			leftover[ numLeftover++ ] = slot;
+		}
+	}
+
+	// the trace is replayed in the live zones where running out of memory
+	// is fatal, leave an eighth of the free space and partially used slab pages
+	fits = qtrue;
+	for ( zone = 0; zone < 2; zone++ ) {
+		if ( zone == 0 ) {
+			limit = Z_AvailableMemory() - TAG_COUNT * SLAB_CLASSES * SLAB_PAGE_SIZE;
+		} else {
+			limit = Z_AvailableZoneMemory( smallzone ) - SLAB_CLASSES * SLAB_PAGE_SIZE;
+		}
+		limit -= limit / 8;
+		if ( peakBytes[ zone ] > limit ) {
+			Com_Printf( S_COLOR_RED "zonebench: %s peaks at %i KB in the %s zone, only %i KB can be used\n",
+				name, (int)( peakBytes[ zone ] >> 10 ), zone ? "small" : "main", limit > 0 ? (int)( limit >> 10 ) : 0 );
+			fits = qfalse;
+		}
+	}
+
+	if ( fits ) {
+		slabs = zone_slabs;
+		for ( mode = 0; mode < 2; mode++ ) {
+			zone_slabs = ( mode == 0 ) ? qtrue : qfalse;
+			peak[ mode ] = 0;
+			Z_BenchReplay( ops, numOps, leftover, numLeftover, ptrs, &peak[ mode ] );
+			start = Sys_Microseconds();
+			for ( iter = 0; iter < iterations; iter++ ) {
+				Z_BenchReplay( ops, numOps, leftover, numLeftover, ptrs, NULL );
+			}
+			elapsed[ mode ] = Sys_Microseconds() - start;
+		}
+		zone_slabs = slabs;
+
+		Z_CheckHeap();
+
+		numOps += numLeftover;
+		Com_Printf( "%i zone events from %s: %i allocations, %i frees, %i dropped, %i iterations\n",
+			numEvents, name, numAllocs, numFrees + numLeftover, dropped, iterations );
+		if ( numOps ) {
+			Com_Printf( "slab: %.1f nsec/call, peak %i bytes\n", elapsed[0] * 1000.0 / ( (double)numOps * iterations ), peak[0] );
+			Com_Printf( "zone: %.1f nsec/call, peak %i bytes\n", elapsed[1] * 1000.0 / ( (double)numOps * iterations ), peak[1] );
+		}
+	}
+
+	free( ops );
+	free( slotPtr );
+	free( chain );
+	free( leftover );
+	free( live );
+	free( blockSize );
+	free( ptrs );
+	free( heads );
+}
+#endif // USE_ZONE_SLABS
+
 #ifdef USE_STATIC_TAGS
 
 // static mem blocks to reduce a lot of small zone overhead
@@ -1878,6 +2498,9 @@ typedef struct zone_stats_s {
 	int freeBlocks;
 	int freeSmallest;
 	int freeLargest;
+	int slabPages;
+	int slabObjects;
+	int slabBytes;
 } zone_stats_t;
 
 
@@ -1904,6 +2527,15 @@ static void Zone_Stats( const char *name, const memzone_t *z, qboolean printDeta
 		}
 		if ( block->tag != TAG_FREE ) {
 			st.zoneBytes += block->size;
+#ifdef USE_ZONE_SLABS
+			if ( block->id == SLABID ) {
+				const slabpage_t *page = (const slabpage_t *)( block + 1 );
+				st.slabPages++;
+				st.slabObjects += page->used;
+				st.slabBytes += page->used * slabSizes[ page->cls ];
+				st.zoneBlocks += page->used;
+			} else
+#endif
 			st.zoneBlocks++;
 			if ( block->tag == TAG_BOTLIB ) {
 				st.botlibBytes += block->size;
@@ -1994,6 +2626,9 @@ static void Com_Meminfo_f( void ) {
 	Com_Printf( "        %8i bytes in botlib\n", st.botlibBytes );
 	Com_Printf( "        %8i bytes in renderer\n", st.rendererBytes );
 	Com_Printf( "        %8i bytes in other\n", st.zoneBytes - ( st.botlibBytes + st.rendererBytes ) );
+	if ( st.slabPages ) {
+		Com_Printf( "        %8i bytes in %i slab objects on %i pages\n", st.slabBytes, st.slabObjects, st.slabPages );
+	}
 	Com_Printf( "        %8i bytes in %i free blocks\n", st.freeBytes, st.freeBlocks );
 	if ( st.freeBlocks > 1 ) {
 		Com_Printf( "        (largest: %i bytes, smallest: %i bytes)\n\n", st.freeLargest, st.freeSmallest );
@@ -2003,6 +2638,9 @@ static void Com_Meminfo_f( void ) {
 	Com_Printf( "%8i bytes total small zone\n\n", smallzone->size );
 	Com_Printf( "%8i bytes in %i small zone blocks%s\n", st.zoneBytes, st.zoneBlocks,
 		st.zoneSegments > 1 ? va( " and %i segments", st.zoneSegments ) : "" );
+	if ( st.slabPages ) {
+		Com_Printf( "        %8i bytes in %i slab objects on %i pages\n", st.slabBytes, st.slabObjects, st.slabPages );
+	}
 	Com_Printf( "        %8i bytes in %i free blocks\n", st.freeBytes, st.freeBlocks );
 	if ( st.freeBlocks > 1 ) {
 		Com_Printf( "        (largest: %i bytes, smallest: %i bytes)\n\n", st.freeLargest, st.freeSmallest );
@@ -2073,6 +2711,10 @@ static void Com_InitSmallZoneMemory( void ) {
 	Com_Memset( s_buf, 0, smallZoneSize );
 	smallzone = (memzone_t *)s_buf;
 	Z_ClearZone( smallzone, smallzone, smallZoneSize, 1 );
+
+#ifdef USE_ZONE_SLABS
+	Z_InitSlabs();
+#endif
 }
 
 
@@ -2226,6 +2868,12 @@ static void Com_InitHunkMemory( void ) {
 	Hunk_Clear();
 
 	Cmd_AddCommand( "meminfo", Com_Meminfo_f );
+#ifdef USE_ZONE_SLABS
+	Cmd_AddCommand( "zonetrace", Z_Trace_f );
+	Cmd_SetDescription( "zonetrace", "Records zone allocations to a file for zonebench, run again to stop\nusage: zonetrace <filename>" );
+	Cmd_AddCommand( "zonebench", Z_Bench_f );
+	Cmd_SetDescription( "zonebench", "Replays a zone allocation trace with and without size-class slabs and times both\nusage: zonebench <filename> [iterations]" );
+#endif
 #ifdef ZONE_DEBUG
 	Cmd_AddCommand( "zonelog", Z_LogHeap );
 #endif
@@ -3795,6 +4443,8 @@ void Com_Init( char *commandLine ) {
 	Cmd_AddCommand( "quit", Com_Quit_f );
 	Cmd_AddCommand( "reboot", Com_Quit_f );
 	Cmd_AddCommand( "changeVectors", MSG_ReportChangeVectors_f );
+	Cmd_AddCommand( "msgbench", MSG_Bench_f );
+	Cmd_SetDescription( "msgbench", "Checks message bit packing against the bit at a time reference and times both\nusage: msgbench [iterations]" );
 	Cmd_AddCommand( "writeconfig", Com_WriteConfig_f );
 	Cmd_SetCommandCompletionFunc( "writeconfig", Cmd_CompleteWriteCfgName );
 	Cmd_AddCommand( "game_restart", Com_GameRestart_f );
@@ -35,32 +35,10 @@ static int		cvar_numIndexes;
 
 static int	cvar_group[ CVG_MAX ];
 
-#define FILE_HASH_SIZE		256
+#define FILE_HASH_SIZE		1024
 static	cvar_t	*hashTable[FILE_HASH_SIZE];
 static	qboolean cvar_sort = qfalse;
 
-/*
-================
-return a hash value for the filename
-================
-*/
-static long generateHashValue( const char *fname ) {
-	int		i;
-	long	hash;
-	char	letter;
-
-	hash = 0;
-	i = 0;
-	while (fname[i] != '\0') {
-		letter = locase[(byte)fname[i]];
-		hash+=(long)(letter)*(i+119);
-		i++;
-	}
-	hash &= (FILE_HASH_SIZE-1);
-	return hash;
-}
-
-
 /*
 ============
 Cvar_ValidateName
@@ -95,15 +73,15 @@ Cvar_FindVar
 */
 static cvar_t *Cvar_FindVar( const char *var_name ) {
 	cvar_t	*var;
-	long hash;
+	unsigned int hash;
 
 	if ( !var_name )
 		return NULL;
 
-	hash = generateHashValue( var_name );
-	
-	for ( var = hashTable[ hash ] ; var ; var = var->hashNext ) {
-		if ( !Q_stricmp( var_name, var->name ) ) {
+	hash = Com_HashNameNoCase( var_name );
+
+	for ( var = hashTable[ hash & (FILE_HASH_SIZE-1) ] ; var ; var = var->hashNext ) {
+		if ( var->hashValue == hash && !Q_stricmp( var_name, var->name ) ) {
 			return var;
 		}
 	}
@@ -112,6 +90,198 @@ static cvar_t *Cvar_FindVar( const char *var_name ) {
 }
 
 
+/*
+============
+Cvar_FindCached
+
+Resolves a name through a small cache keyed by the caller's name pointer,
+callers like VM syscalls pass the same strings over and over. The cached
+handle is only trusted while the cvar it points to still has that name.
+============
+*/
+cvar_t *Cvar_FindCached( cvarCache_t *cache, const char *var_name ) {
+	cvarCacheEntry_t *entry;
+	cvar_t	*var;
+
+	if ( !var_name )
+		return NULL;
+
+	entry = &cache->entry[ ( (uintptr_t)var_name ^ ( (uintptr_t)var_name >> 6 ) ) & (CVAR_CACHE_SIZE-1) ];
+	if ( entry->name == var_name ) {
+		var = cvar_indexes + entry->handle;
+		if ( var->name && !strcmp( var->name, var_name ) ) {
+			return var;
+		}
+	}
+
+	var = Cvar_FindVar( var_name );
+	if ( var ) {
+		entry->name = var_name;
+		entry->handle = var - cvar_indexes;
+	}
+
+	return var;
+}
+
+
+/*
+============
+Cvar_ResetCache
+============
+*/
+void Cvar_ResetCache( cvarCache_t *cache ) {
+	Com_Memset( cache, 0, sizeof( *cache ) );
+}
+
+
+/*
+==============================================================================
+
+Change subscriptions
+
+Subsystems register callbacks for single cvars or for cvar flags instead of
+polling modification counts or cvar_modifiedFlags every frame. Callbacks run
+synchronously from the cvar code, so they should only mark what to update.
+==============================================================================
+*/
+
+#define	MAX_CVAR_SUBSCRIPTIONS	64
+
+typedef struct {
+	cvar_t			*var;		// NULL for flag subscriptions
+	int				flags;
+	cvarCallback_t	callback;
+} cvarSubscription_t;
+
+static cvarSubscription_t cvar_subscriptions[ MAX_CVAR_SUBSCRIPTIONS ];
+static int cvar_numSubscriptions;
+static int cvar_subscribedFlags;
+
+
+static void Cvar_AddSubscription( cvar_t *var, int flags, cvarCallback_t callback ) {
+	cvarSubscription_t *sub;
+
+	if ( cvar_numSubscriptions >= MAX_CVAR_SUBSCRIPTIONS ) {
+		Com_Error( ERR_FATAL, "Cvar_Subscribe: too many subscriptions" );
+	}
+
+	sub = &cvar_subscriptions[ cvar_numSubscriptions++ ];
+	sub->var = var;
+	sub->flags = flags;
+	sub->callback = callback;
+
+	if ( var ) {
+		var->subscribers++;
+	} else {
+		cvar_subscribedFlags |= flags;
+	}
+}
+
+
+static void Cvar_RemoveSubscriptions( const cvar_t *var, cvarCallback_t callback ) {
+	cvarSubscription_t *sub;
+	int i, n;
+
+	cvar_subscribedFlags = 0;
+	for ( i = 0, n = 0; i < cvar_numSubscriptions; i++ ) {
+		sub = &cvar_subscriptions[ i ];
+		if ( ( var && sub->var == var ) || ( callback && sub->callback == callback ) ) {
+			if ( sub->var ) {
+				sub->var->subscribers--;
+			}
+			continue;
+		}
+		if ( !sub->var ) {
+			cvar_subscribedFlags |= sub->flags;
+		}
+		cvar_subscriptions[ n++ ] = *sub;
+	}
+	cvar_numSubscriptions = n;
+}
+
+
+/*
+============
+Cvar_Subscribe
+============
+*/
+void Cvar_Subscribe( cvar_t *var, cvarCallback_t callback ) {
+	if ( var && callback ) {
+		Cvar_AddSubscription( var, 0, callback );
+	}
+}
+
+
+/*
+============
+Cvar_SubscribeFlags
+============
+*/
+void Cvar_SubscribeFlags( int flags, cvarCallback_t callback ) {
+	if ( flags && callback ) {
+		Cvar_AddSubscription( NULL, flags, callback );
+	}
+}
+
+
+/*
+============
+Cvar_Unsubscribe
+============
+*/
+void Cvar_Unsubscribe( cvarCallback_t callback ) {
+	Cvar_RemoveSubscriptions( NULL, callback );
+}
+
+
+/*
+============
+Cvar_NotifyValue
+
+The value of var has been changed
+============
+*/
+static void Cvar_NotifyValue( cvar_t *var ) {
+	const cvarSubscription_t *sub;
+	int i;
+
+	if ( !var->subscribers && !( var->flags & cvar_subscribedFlags ) ) {
+		return;
+	}
+
+	for ( i = 0; i < cvar_numSubscriptions; i++ ) {
+		sub = &cvar_subscriptions[ i ];
+		if ( sub->var ? sub->var == var : ( sub->flags & var->flags ) != 0 ) {
+			sub->callback( var );
+		}
+	}
+}
+
+
+/*
+============
+Cvar_NotifyFlags
+
+A cvar with these flags has been created or removed, or the flags were added
+============
+*/
+static void Cvar_NotifyFlags( int flags ) {
+	const cvarSubscription_t *sub;
+	int i;
+
+	if ( !( flags & cvar_subscribedFlags ) ) {
+		return;
+	}
+
+	for ( i = 0; i < cvar_numSubscriptions; i++ ) {
+		sub = &cvar_subscriptions[ i ];
+		if ( !sub->var && ( sub->flags & flags ) ) {
+			sub->callback( NULL );
+		}
+	}
+}
+
+
 /*
 ============
 Cvar_VariableValue
@@ -347,7 +517,7 @@ The flags will be or'ed in if the variable exists.
 */
 cvar_t *Cvar_Get( const char *var_name, const char *var_value, int flags ) {
 	cvar_t	*var;
-	long	hash;
+	unsigned int hash;
 	int	index;
 
 	if ( !var_name || !var_value ) {
@@ -371,6 +541,7 @@ cvar_t *Cvar_Get( const char *var_name, const char *var_value, int flags ) {
 	if(var)
 	{
 		int vm_created = (flags & CVAR_VM_CREATED);
+		int added;
 		var_value = Cvar_Validate(var, var_value, qfalse);
 
 		// Make sure the game code cannot mark engine-added variables as gamecode vars
@@ -428,7 +599,9 @@ cvar_t *Cvar_Get( const char *var_name, const char *var_value, int flags ) {
 				flags &= ~CVAR_SERVER_CREATED;
 		}
 
+		added = flags & ~var->flags;
 		var->flags |= flags;
+		Cvar_NotifyFlags( added );
 
 		// only allow one non-empty reset string without a warning
 		if ( !var->resetString[0] ) {
@@ -505,15 +678,18 @@ cvar_t *Cvar_Get( const char *var_name, const char *var_value, int flags ) {
 	// note what types of cvars have been modified (userinfo, archive, serverinfo, systeminfo)
 	cvar_modifiedFlags |= var->flags;
 
-	hash = generateHashValue(var_name);
-	var->hashIndex = hash;
+	hash = Com_HashNameNoCase( var_name );
+	var->hashValue = hash;
+	var->hashIndex = hash & (FILE_HASH_SIZE-1);
 
-	var->hashNext = hashTable[hash];
-	if ( hashTable[hash] )
-		hashTable[hash]->hashPrev = var;
+	var->hashNext = hashTable[var->hashIndex];
+	if ( hashTable[var->hashIndex] )
+		hashTable[var->hashIndex]->hashPrev = var;
 
 	var->hashPrev = NULL;
-	hashTable[hash] = var;
+	hashTable[var->hashIndex] = var;
+
+	Cvar_NotifyFlags( var->flags );
 
 	 // sort on write
 	cvar_sort = qtrue;
@@ -746,6 +922,8 @@ cvar_t *Cvar_Set2( const char *var_name, const char *value, qboolean force ) {
 	var->value = Q_atof( var->string );
 	var->integer = atoi( var->string );
 
+	Cvar_NotifyValue( var );
+
 	return var;
 }
 
@@ -1058,18 +1236,21 @@ static void Cvar_Set_f( void ) {
 			if( !( v->flags & CVAR_ARCHIVE ) ) {
 				v->flags |= CVAR_ARCHIVE;
 				cvar_modifiedFlags |= CVAR_ARCHIVE;
+				Cvar_NotifyFlags( CVAR_ARCHIVE );
 			}
 			break;
 		case 'u':
 			if( !( v->flags & CVAR_USERINFO ) ) {
 				v->flags |= CVAR_USERINFO;
 				cvar_modifiedFlags |= CVAR_USERINFO;
+				Cvar_NotifyFlags( CVAR_USERINFO );
 			}
 			break;
 		case 's':
 			if( !( v->flags & CVAR_SERVERINFO ) ) {
 				v->flags |= CVAR_SERVERINFO;
 				cvar_modifiedFlags |= CVAR_SERVERINFO;
+				Cvar_NotifyFlags( CVAR_SERVERINFO );
 			}
 			break;
 	}
@@ -1552,6 +1733,9 @@ static cvar_t *Cvar_Unset( cvar_t *cv )
 
 	// note what types of cvars have been modified (userinfo, archive, serverinfo, systeminfo)
 	cvar_modifiedFlags |= cv->flags;
+
+	if ( cv->subscribers )
+		Cvar_RemoveSubscriptions( cv, NULL );
 	
 	if ( cv->name )
 		Z_Free( cv->name );
@@ -1582,6 +1766,8 @@ static cvar_t *Cvar_Unset( cvar_t *cv )
 	if ( cv->hashNext )
 		cv->hashNext->hashPrev = cv->hashPrev;
 
+	Cvar_NotifyFlags( cv->flags );
+
 	Com_Memset( cv, '\0', sizeof( *cv ) );
 	
 	return next;
@@ -308,6 +308,8 @@ static	cvar_t		*fs_gamedirvar;
 static	cvar_t		*fs_locked;
 #endif
 static	cvar_t		*fs_excludeReference;
+static	cvar_t		*fs_scanThreads;
+static	cvar_t		*fs_mappedPaks;
 
 static	searchpath_t	*fs_searchpaths;
 static	int			fs_readCount;			// total bytes read
@@ -388,6 +390,8 @@ void FS_Reload( void );
 static cvar_t  *fs_acquire_checksums;
 static int     inMainDirAcquire = 0;
 static char    *fs_lastBuiltOsPath = 0;
+static char    *fs_preloadedCsum;	// contents of fs_lastBuiltOsPath + ".crc"
+static int     fs_preloadedCsumLen;
 
 //======
 
@@ -2156,6 +2160,503 @@ qboolean FS_FileIsInPAK( const char *filename, int *pChecksum, char *pakName ) {
 }
 
 
+// FS_ReadFile() buffers which are not in the temp hunk
+#define MAX_MAPPED_FILES	64
+#define MIN_MAPPED_FILE		0x10000		// smaller files are cheaper to copy
+
+typedef struct {
+	byte		*data;
+	int			length;
+	qboolean	prefetched;		// malloc'ed by FS_PrefetchFile()
+	unsigned	checksum;		// Com_BlockChecksum() of prefetched data
+} mappedFile_t;
+
+static mappedFile_t fs_mappedFiles[ MAX_MAPPED_FILES ];
+
+
+/*
+============
+FS_AllocMappedFile
+============
+*/
+static mappedFile_t *FS_AllocMappedFile( void ) {
+	int i;
+
+	for ( i = 0; i < MAX_MAPPED_FILES; i++ ) {
+		if ( fs_mappedFiles[i].data == NULL ) {
+			return &fs_mappedFiles[i];
+		}
+	}
+
+	return NULL;
+}
+
+
+/*
+============
+FS_MapPakFile
+
+Returns a private copy-on-write view of a stored (not compressed) pk3 entry
+instead of reading it into a temp buffer, released by FS_FreeFile()
+============
+*/
+static byte *FS_MapPakFile( fileHandle_t f, long len ) {
+	mappedFile_t *mf;
+	long offset;
+
+	if ( !fs_mappedPaks->integer || !fsh[f].zipFile || len < MIN_MAPPED_FILE ) {
+		return NULL;
+	}
+
+	mf = FS_AllocMappedFile();
+	if ( mf == NULL ) {
+		return NULL;
+	}
+
+	offset = unzGetStoredDataOffset( fsh[f].handleFiles.file.z );
+	if ( offset < 0 ) {
+		return NULL;
+	}
+
+	// one more byte for trailing zero, there is always a central directory after file data
+	mf->data = Sys_MapFileRange( fsh[f].pak->pakFilename, offset, len + 1 );
+	if ( mf->data == NULL ) {
+		return NULL;
+	}
+
+	mf->length = len + 1;
+	mf->prefetched = qfalse;
+
+	return mf->data;
+}
+
+
+/*
+============
+FS_MapFile
+
+Same lookup as in FS_FOpenFileRead(), returns a read-only view of the file
+if the winning copy is a loose file, NULL if it is inside a pk3 or missing
+============
+*/
+const void *FS_MapFile( const char *qpath, int *size ) {
+	const searchpath_t *search;
+	const fileInPack_t *pf;
+	long fullHash, hash;
+	fileOffset_t len;
+	const void *data;
+	char *netpath;
+
+	*size = 0;
+
+	if ( !fs_searchpaths || FS_CheckDirTraversal( qpath ) ) {
+		return NULL;
+	}
+
+	fullHash = FS_HashFileName( qpath, 0U );
+
+	for ( search = fs_searchpaths ; search ; search = search->next ) {
+		if ( search->pack && search->pack->hashTable[ (hash = fullHash & (search->pack->hashSize-1)) ] ) {
+			if ( !FS_PakIsPure( search->pack ) )
+				continue;
+			for ( pf = search->pack->hashTable[ hash ]; pf; pf = pf->next ) {
+				if ( !FS_FilenameCompare( pf->name, qpath ) ) {
+					// pk3 copy takes priority, it has to be read
+					return NULL;
+				}
+			}
+		} else if ( search->dir && search->policy != DIR_DENY ) {
+			netpath = FS_BuildOSPath( search->dir->path, search->dir->gamedir, qpath );
+			data = Sys_MapFile( netpath, &len );
+			if ( data == NULL ) {
+				continue;
+			}
+			if ( len > INT_MAX ) {
+				Sys_UnmapFile( data, len );
+				return NULL;
+			}
+			if ( fs_debug->integer ) {
+				Com_Printf( "FS_MapFile: %s (found in '%s/%s')\n", qpath,
+					search->dir->path, search->dir->gamedir );
+			}
+			*size = (int)len;
+			return data;
+		}
+	}
+
+	return NULL;
+}
+
+
+/*
+============
+FS_UnmapFile
+============
+*/
+void FS_UnmapFile( const void *data, int size ) {
+	Sys_UnmapFile( data, size );
+}
+
+
+/*
+============
+Background file prefetch
+
+Whole pk3 entries are read and uncompressed by a worker thread ahead
+of time, FS_ReadFile() hands the buffer over if the file still resolves
+to the very same pk3 entry by then
+============
+*/
+#define MAX_PREFETCH_FILES	4
+
+typedef struct {
+	char			qpath[ MAX_QPATH ];
+	char			ospath[ MAX_OSPATH * 2 + 1 ];	// pk3 file
+	unsigned long	pos;							// file info position in zip
+	unz_file_data	zdata;
+	prefetchValidate_t validate;
+	qboolean		keep;							// qfalse to drop the data once read
+	qboolean		loaded;							// set by the worker if the file was read
+	void			*thread;
+	byte			*data;							// malloc'ed, NULL if failed or not kept
+	unsigned		checksum;
+	int				workTime;						// usec spent by the worker
+	int				waitTime;						// usec spent waiting for the worker
+	prefetchState_t	state;
+	int				done;
+	int				cancelled;						// worker frees its data, slot is released once done
+} prefetchFile_t;
+
+static prefetchFile_t fs_prefetchFiles[ MAX_PREFETCH_FILES ];
+
+
+/*
+============
+FS_PrefetchWorker
+============
+*/
+static void FS_PrefetchWorker( void *param ) {
+	prefetchFile_t *pf = (prefetchFile_t *)param;
+	int64_t start;
+	byte *data;
+	int length;
+
+	start = Sys_Microseconds();
+	length = pf->zdata.uncompressed_size;
+
+	data = malloc( length + 1 );
+	if ( data != NULL ) {
+		if ( unzReadFileData( pf->ospath, &pf->zdata, data ) != UNZ_OK || Sys_AtomicLoad( &pf->cancelled )
+			|| ( pf->validate && !pf->validate( data, length ) ) ) {
+			free( data );
+			data = NULL;
+		} else if ( !pf->keep ) {
+			// only the OS file cache is warmed up
+			free( data );
+			data = NULL;
+			pf->loaded = qtrue;
+		} else {
+			// guarantee that it will have a trailing 0 for string operations
+			data[ length ] = '\0';
+			pf->checksum = Com_BlockChecksum( data, length );
+			pf->loaded = qtrue;
+		}
+	}
+
+	pf->data = data;
+	pf->workTime = Sys_Microseconds() - start;
+	Sys_AtomicStore( &pf->done, 1 );
+}
+
+
+/*
+============
+FS_FindPakFile
+
+Same lookup as in FS_FOpenFileRead() but without opening the file, fails for files outside of pk3s
+============
+*/
+static qboolean FS_FindPakFile( const char *filename, pack_t **pak, fileInPack_t **pakFile ) {
+	const searchpath_t *search;
+	fileInPack_t *pf;
+	long fullHash, hash;
+	fileOffset_t size;
+	fileTime_t mtime, ctime;
+	char *netpath;
+
+	fullHash = FS_HashFileName( filename, 0U );
+
+	for ( search = fs_searchpaths ; search ; search = search->next ) {
+		if ( search->pack && search->pack->hashTable[ (hash = fullHash & (search->pack->hashSize-1)) ] ) {
+			if ( !FS_PakIsPure( search->pack ) )
+				continue;
+			for ( pf = search->pack->hashTable[ hash ]; pf; pf = pf->next ) {
+				if ( !FS_FilenameCompare( pf->name, filename ) ) {
+					*pak = search->pack;
+					*pakFile = pf;
+					return qtrue;
+				}
+			}
+		} else if ( search->dir && search->policy != DIR_DENY ) {
+			netpath = FS_BuildOSPath( search->dir->path, search->dir->gamedir, filename );
+			if ( Sys_GetFileStats( netpath, &size, &mtime, &ctime ) ) {
+				return qfalse;
+			}
+		}
+	}
+
+	return qfalse;
+}
+
+
+/*
+============
+FS_ReleasePrefetch
+============
+*/
+static void FS_ReleasePrefetch( prefetchFile_t *pf ) {
+	if ( pf->thread ) {
+		Sys_JoinThread( pf->thread );
+	}
+	if ( pf->data ) {
+		free( pf->data );
+	}
+	Com_Memset( pf, 0, sizeof( *pf ) );
+}
+
+
+/*
+============
+FS_ReapPrefetch
+
+Releases slots of cancelled prefetches whose workers are done
+============
+*/
+static void FS_ReapPrefetch( void ) {
+	prefetchFile_t *pf;
+	int i;
+
+	for ( i = 0; i < MAX_PREFETCH_FILES; i++ ) {
+		pf = &fs_prefetchFiles[i];
+		if ( pf->cancelled && Sys_AtomicLoad( &pf->done ) ) {
+			FS_ReleasePrefetch( pf );
+		}
+	}
+}
+
+
+/*
+============
+FS_PrefetchFile
+
+Starts reading of a pk3 file in background, validate() is called from the worker thread,
+fails while all slots are busy, including cancelled prefetches which are still running.
+Data which is not kept is freed by the worker and only warms up the OS file cache
+============
+*/
+qboolean FS_PrefetchFile( const char *qpath, prefetchValidate_t validate, qboolean keep ) {
+	prefetchFile_t *pf;
+	fileInPack_t *pakFile;
+	pack_t *pak;
+	unzFile uf;
+	int i;
+
+	if ( !fs_searchpaths || FS_CheckDirTraversal( qpath ) ) {
+		return qfalse;
+	}
+
+	FS_ReapPrefetch();
+
+	pf = NULL;
+	for ( i = 0; i < MAX_PREFETCH_FILES; i++ ) {
+		if ( fs_prefetchFiles[i].state == PREFETCH_NONE ) {
+			if ( pf == NULL ) {
+				pf = &fs_prefetchFiles[i];
+			}
+		} else if ( !fs_prefetchFiles[i].cancelled && !Q_stricmp( fs_prefetchFiles[i].qpath, qpath ) ) {
+			return qtrue; // already there
+		}
+	}
+
+	if ( pf == NULL || !FS_FindPakFile( qpath, &pak, &pakFile ) ) {
+		return qfalse;
+	}
+
+	// use a separate handle to keep current file of pak->handle intact
+	uf = unzOpen( pak->pakFilename );
+	if ( uf == NULL ) {
+		return qfalse;
+	}
+
+	Com_Memset( pf, 0, sizeof( *pf ) );
+	if ( unzSetCurrentFileInfoPosition( uf, pakFile->pos ) != UNZ_OK || unzGetCurrentFileData( uf, &pf->zdata ) != UNZ_OK
+		|| pf->zdata.uncompressed_size != pakFile->size ) {
+		unzClose( uf );
+		return qfalse;
+	}
+	unzClose( uf );
+
+	Q_strncpyz( pf->qpath, qpath, sizeof( pf->qpath ) );
+	Q_strncpyz( pf->ospath, pak->pakFilename, sizeof( pf->ospath ) );
+	pf->pos = pakFile->pos;
+	pf->validate = validate;
+	pf->keep = keep;
+
+	pf->thread = Sys_CreateThread( FS_PrefetchWorker, pf );
+	if ( pf->thread == NULL ) {
+		return qfalse;
+	}
+
+	pf->state = PREFETCH_LOADING;
+
+	return qtrue;
+}
+
+
+/*
+============
+FS_FinishPrefetch
+============
+*/
+static void FS_FinishPrefetch( prefetchFile_t *pf ) {
+	int64_t start;
+
+	if ( pf->thread ) {
+		start = Sys_Microseconds();
+		Sys_JoinThread( pf->thread );
+		pf->thread = NULL;
+		pf->waitTime = Sys_Microseconds() - start;
+		pf->state = pf->loaded ? PREFETCH_READY : PREFETCH_FAILED;
+	}
+}
+
+
+/*
+============
+FS_PrefetchState
+
+Returns state of the last prefetch of qpath and optionally
+the time saved by it if it was used
+============
+*/
+prefetchState_t FS_PrefetchState( const char *qpath, int *savedMsec ) {
+	prefetchFile_t *pf;
+	int i;
+
+	for ( i = 0; i < MAX_PREFETCH_FILES; i++ ) {
+		pf = &fs_prefetchFiles[i];
+		if ( pf->state != PREFETCH_NONE && !pf->cancelled && !Q_stricmp( pf->qpath, qpath ) ) {
+			if ( pf->state == PREFETCH_LOADING && Sys_AtomicLoad( &pf->done ) ) {
+				FS_FinishPrefetch( pf );
+			}
+			if ( savedMsec ) {
+				*savedMsec = pf->state == PREFETCH_USED ? ( pf->workTime - pf->waitTime ) / 1000 : 0;
+			}
+			return pf->state;
+		}
+	}
+
+	if ( savedMsec ) {
+		*savedMsec = 0;
+	}
+
+	return PREFETCH_NONE;
+}
+
+
+/*
+============
+FS_CancelPrefetch
+
+Releases all data which was not handed over, workers which are still
+reading are not waited for, they drop their data when done
+============
+*/
+void FS_CancelPrefetch( void ) {
+	prefetchFile_t *pf;
+	int i;
+
+	for ( i = 0; i < MAX_PREFETCH_FILES; i++ ) {
+		pf = &fs_prefetchFiles[i];
+		if ( pf->state == PREFETCH_LOADING && !Sys_AtomicLoad( &pf->done ) ) {
+			Sys_AtomicStore( &pf->cancelled, 1 );
+			continue;
+		}
+		FS_ReleasePrefetch( pf );
+	}
+}
+
+
+/*
+============
+FS_TakePrefetched
+============
+*/
+static byte *FS_TakePrefetched( const char *qpath, fileHandle_t f, long len ) {
+	prefetchFile_t *pf;
+	mappedFile_t *mf;
+	int i;
+
+	if ( !fsh[f].zipFile ) {
+		return NULL;
+	}
+
+	for ( i = 0; i < MAX_PREFETCH_FILES; i++ ) {
+		pf = &fs_prefetchFiles[i];
+		if ( ( pf->state != PREFETCH_LOADING && pf->state != PREFETCH_READY ) || pf->cancelled || !pf->keep ) {
+			continue;
+		}
+		if ( Q_stricmp( pf->qpath, qpath ) || pf->pos != fsh[f].zipFilePos || pf->zdata.uncompressed_size != len
+			|| strcmp( pf->ospath, fsh[f].pak->pakFilename ) ) {
+			continue;
+		}
+
+		mf = FS_AllocMappedFile();
+		if ( mf == NULL ) {
+			return NULL;
+		}
+
+		FS_FinishPrefetch( pf );
+		if ( pf->data == NULL ) {
+			return NULL;
+		}
+
+		mf->data = pf->data;
+		mf->length = len + 1;
+		mf->prefetched = qtrue;
+		mf->checksum = pf->checksum;
+
+		pf->data = NULL;
+		pf->state = PREFETCH_USED;
+
+		return mf->data;
+	}
+
+	return NULL;
+}
+
+
+/*
+============
+FS_PrefetchedChecksum
+
+Saves Com_BlockChecksum() of a FS_ReadFile() buffer if it was already computed in background
+============
+*/
+qboolean FS_PrefetchedChecksum( const void *buffer, unsigned *checksum ) {
+	int i;
+
+	for ( i = 0; i < MAX_MAPPED_FILES; i++ ) {
+		if ( fs_mappedFiles[i].data == buffer && fs_mappedFiles[i].prefetched ) {
+			*checksum = fs_mappedFiles[i].checksum;
+			return qtrue;
+		}
+	}
+
+	return qfalse;
+}
+
+
 /*
 ============
 FS_ReadFile
@@ -2251,11 +2752,19 @@ int FS_ReadFile( const char *qpath, void **buffer ) {
 		return len;
 	}
 
-	buf = Hunk_AllocateTempMemory( len + 1 );
+	buf = NULL;
+	if ( !isConfig ) {
+		buf = FS_TakePrefetched( qpath, h, len );
+		if ( buf == NULL ) {
+			buf = FS_MapPakFile( h, len );
+		}
+	}
+	if ( buf == NULL ) {
+		buf = Hunk_AllocateTempMemory( len + 1 );
+		FS_Read( buf, len, h );
+	}
 	*buffer = buf;
 
-	FS_Read( buf, len, h );
-
 	fs_loadCount++;
 	fs_loadStack++;
 
@@ -2280,6 +2789,8 @@ FS_FreeFile
 =============
 */
 void FS_FreeFile( void *buffer ) {
+	int i;
+
 	if ( !fs_searchpaths ) {
 		Com_Error( ERR_FATAL, "Filesystem call made without initialization" );
 	}
@@ -2288,7 +2799,21 @@ void FS_FreeFile( void *buffer ) {
 	}
 	fs_loadStack--;
 
-	Hunk_FreeTempMemory( buffer );
+	for ( i = 0; i < MAX_MAPPED_FILES; i++ ) {
+		if ( fs_mappedFiles[i].data == buffer ) {
+			if ( fs_mappedFiles[i].prefetched ) {
+				free( fs_mappedFiles[i].data );
+			} else {
+				Sys_UnmapFileRange( fs_mappedFiles[i].data, fs_mappedFiles[i].length );
+			}
+			fs_mappedFiles[i].data = NULL;
+			break;
+		}
+	}
+
+	if ( i == MAX_MAPPED_FILES ) {
+		Hunk_FreeTempMemory( buffer );
+	}
 
 	// if all of our temp files are free, clear all of our space
 	if ( fs_loadStack == 0 ) {
@@ -2387,9 +2912,10 @@ static void FS_ConvertFilename( char *name )
 
 unsigned Fs_BlockChecksum(const void *buffer, int length, int pure) {
 	// int pure = *(int *)buffer == fs_checksumFeed;
-	char *name = 0;
+	// main thread only, keep the large buffer off the stack
+	static char buf[CSUMHEX_MAXLEN];
+	char *name = 0, *p = buf;
 	int exists = 0;
-	char buf[CSUMHEX_MAXLEN], *p = buf;
 	unsigned char *b = (unsigned char *) buffer;
 	int i, c = CSUMHEX_MAXLEN, n = 0, v;
 
@@ -2399,10 +2925,32 @@ unsigned Fs_BlockChecksum(const void *buffer, int length, int pure) {
 		if (fs_lastBuiltOsPath) {
 			snprintf(buf, c, "%s.crc", fs_lastBuiltOsPath);
 			name = buf;
-			exists = access(name, F_OK) != -1;
+			// checksum file already read by FS_ScanPakFiles()
+			exists = fs_preloadedCsum != NULL || access(name, F_OK) != -1;
 		}
 	}
 
+	if (exists && fs_preloadedCsum) {
+		Com_DPrintf("Minify PK3: Using checksum file: %s\n", name);
+		b = (unsigned char *) p;
+		if (pure) {
+			*(int *)p = *(int *) buffer;
+			p += sizeof(int);
+			b += sizeof(int);
+		}
+
+		n = MIN( fs_preloadedCsumLen, c - (int)( p - buf ) - 1 );
+		Com_Memcpy(p, fs_preloadedCsum, n);
+		while (n && p[n - 1] < '0') n--;
+
+		for (i = 0; i < n; i += 2, b++, p += 2) {
+			sscanf(p, "%02x", &v);
+			*b = (unsigned char) v;
+		}
+
+		return Com_BlockChecksum(buf, (char *) b - buf);
+	}
+
 	if (exists) {
 		Com_DPrintf("Minify PK3: Using checksum file: %s\n", name);
 		FILE *csumFile = fopen(name, "r");
@@ -3080,19 +3628,19 @@ static void FS_LoadCache( void )
 FS_LoadZipFile
 
 Creates a new pak_t in the search chain for the contents
-of a zip file.
+of a zip file. Central directory may be already read by
+FS_ScanPakFiles(), it is released in any case.
 =================
 */
-static pack_t *FS_LoadZipFile( const char *zipfile )
+static pack_t *FS_LoadZipFile( const char *zipfile, unz_central_dir *cd )
 {
 	fileInPack_t	*curFile;
 	pack_t			*pack;
-	unzFile			uf;
 	int				err;
-	unz_global_info gi;
 	char			filename_inzip[MAX_ZPATH];
 	unz_file_info	file_info;
 	unsigned int	i, namelen, hashSize, size;
+	unsigned long	pos;
 	long			hash;
 	int				fs_numHeaderLongs;
 	int				*fs_headerLongs;
@@ -3116,6 +3664,8 @@ static pack_t *FS_LoadZipFile( const char *zipfile )
 		}
 
 		pack->touched = qtrue;
+		if ( cd )
+			unzFreeCentralDir( cd );
 		return pack; // loaded from cache
 	}
 #endif
@@ -3131,35 +3681,34 @@ static pack_t *FS_LoadZipFile( const char *zipfile )
 	fileNameLen = (int) strlen( zipfile ) + 1;
 	baseNameLen = (int) strlen( basename ) + 1;
 
-	uf = unzOpen( zipfile );
-	err = unzGetGlobalInfo( uf, &gi );
-
-	if ( err != UNZ_OK ) {
-		return NULL;
+	if ( cd == NULL ) {
+		cd = unzReadCentralDir( zipfile );
+		if ( cd == NULL ) {
+			return NULL;
+		}
 	}
 
 	namelen = 0;
 	filecount = 0;
-	unzGoToFirstFile( uf );
-	for (i = 0; i < gi.number_entry; i++)
+	pos = cd->offset_central_dir;
+	for (i = 0; i < cd->gi.number_entry; i++)
 	{
-		err = unzGetCurrentFileInfo(uf, &file_info, filename_inzip, sizeof(filename_inzip), NULL, 0, NULL, 0);
+		err = unzGetCentralDirFileInfo( cd, pos, &file_info, filename_inzip, sizeof(filename_inzip) );
 		filename_inzip[sizeof(filename_inzip)-1] = '\0';
 		if (err != UNZ_OK) {
 			break;
 		}
+		pos = unzNextCentralDirFile( pos, &file_info );
 		if ( file_info.compression_method != 0 && file_info.compression_method != 8 /*Z_DEFLATED*/ ) {
 			Com_Printf( S_COLOR_YELLOW "%s|%s: unsupported compression method %i\n", basename, filename_inzip, (int)file_info.compression_method );
-			unzGoToNextFile( uf );
 			continue;
 		} 
 		namelen += strlen( filename_inzip ) + 1;
-		unzGoToNextFile( uf );
 		filecount++;
 	}
 
 	if ( filecount == 0 ) {
-		unzClose( uf );
+		unzFreeCentralDir( cd );
 		return NULL;
 	}
 
@@ -3177,7 +3726,7 @@ static pack_t *FS_LoadZipFile( const char *zipfile )
 	pack = Z_TagMalloc( size, TAG_PACK );
 	Com_Memset( pack, 0, size );
 
-	pack->handle = uf;
+	pack->handle = NULL; // opened on first access
 	pack->numfiles = filecount;
 	pack->hashSize = hashSize;
 	pack->hashTable = (fileInPack_t **)( pack + 1 );
@@ -3203,17 +3752,17 @@ static pack_t *FS_LoadZipFile( const char *zipfile )
 	// strip .pk3 if needed
 	FS_StripExt( pack->pakBasename, ".pk3" );
 
-	unzGoToFirstFile( uf );
+	pos = cd->offset_central_dir;
 	curFile = pack->buildBuffer;
-	for ( i = 0; i < gi.number_entry; i++ )
+	for ( i = 0; i < cd->gi.number_entry; i++ )
 	{
-		err = unzGetCurrentFileInfo( uf, &file_info, filename_inzip, sizeof(filename_inzip), NULL, 0, NULL, 0 );
+		err = unzGetCentralDirFileInfo( cd, pos, &file_info, filename_inzip, sizeof(filename_inzip) );
 		filename_inzip[sizeof(filename_inzip)-1] = '\0';
 		if (err != UNZ_OK) {
 			break;
 		}
 		if ( file_info.compression_method != 0 && file_info.compression_method != 8 /*Z_DEFLATED*/ ) {
-			unzGoToNextFile( uf );
+			pos = unzNextCentralDirFile( pos, &file_info );
 			continue;
 		} 
 		if ( file_info.uncompressed_size > 0 ) {
@@ -3223,7 +3772,7 @@ static pack_t *FS_LoadZipFile( const char *zipfile )
 		FS_ConvertFilename( filename_inzip );
 		if ( !FS_BannedPakFile( filename_inzip ) ) {
 			// store the file position in the zip
-			unzGetCurrentFileInfoPosition( uf, &curFile->pos );
+			curFile->pos = pos;
 			curFile->size = file_info.uncompressed_size;
 			curFile->name = namePtr;
 			strcpy( curFile->name, filename_inzip );
@@ -3238,9 +3787,11 @@ static pack_t *FS_LoadZipFile( const char *zipfile )
 			pack->numfiles--;
 		}
 
-		unzGoToNextFile( uf );
+		pos = unzNextCentralDirFile( pos, &file_info );
 	}
 
+	unzFreeCentralDir( cd );
+
 	pack->checksum = Fs_BlockChecksum( fs_headerLongs + 1, sizeof( fs_headerLongs[0] ) * ( fs_numHeaderLongs - 1 ), 0 );
 	pack->checksum = LittleLong( pack->checksum );
 
@@ -3255,13 +3806,10 @@ static pack_t *FS_LoadZipFile( const char *zipfile )
 	Z_Free( fs_headerLongs );
 #endif
 
-#ifdef USE_HANDLE_CACHE
-	FS_AddToHandleList( pack );
-#else
-	if ( fs_locked->integer == 0 )
+#ifndef USE_HANDLE_CACHE
+	if ( fs_locked->integer )
 	{
-		unzClose( pack->handle );
-		pack->handle = NULL;
+		pack->handle = unzOpen( zipfile );
 	}
 #endif
 
@@ -3311,7 +3859,7 @@ qboolean FS_CompareZipChecksum(const char *zipfile)
 	pack_t *thepak;
 	int index, checksum;
 	
-	thepak = FS_LoadZipFile( zipfile );
+	thepak = FS_LoadZipFile( zipfile, NULL );
 	
 	if ( !thepak )
 		return qfalse;
@@ -3341,7 +3889,7 @@ int FS_GetZipChecksum( const char *zipfile )
 	pack_t *pak;
 	int checksum;
 	
-	pak = FS_LoadZipFile( zipfile );
+	pak = FS_LoadZipFile( zipfile, NULL );
 	
 	if ( !pak )
 		return 0xFFFFFFFF;
@@ -4206,6 +4754,236 @@ static void FS_Which_f( void ) {
 //===========================================================================
 
 
+/*
+================
+Parallel pk3 scanning
+
+Central directories of pk3 files are read by a pool of worker threads
+while FS_AddGameDirectory() walks the sorted file list and consumes them
+in the very same order it would load them serially. Workers only do file
+i/o into malloc'ed memory, everything else stays on the main thread.
+Existing Minify PK3 checksum files are read ahead the same way.
+================
+*/
+
+#define MAX_SCAN_THREADS	16
+#define MIN_SCAN_PAKS		16		// not worth spawning threads for less
+
+typedef struct {
+	const char		*ospath;		// NULL if not a pk3 file
+	unz_central_dir	*cd;
+	char			*csum;			// contents of ospath + ".crc", if any
+	int				csumLen;
+	int				done;
+} pakScanJob_t;
+
+typedef struct {
+	pakScanJob_t	*jobs;
+	int				numJobs;
+	int				next;
+	int				numThreads;
+	qboolean		readCsum;
+	void			*threads[ MAX_SCAN_THREADS ];
+	void			*signal;
+} pakScanner_t;
+
+
+/*
+================
+FS_ReadCsumFile
+
+Thread-safe counterpart of the checksum file lookup in Fs_BlockChecksum()
+================
+*/
+static char *FS_ReadCsumFile( const char *ospath, int *length ) {
+	char name[ MAX_OSPATH * 2 + 5 ];
+	FILE *f;
+	char *buf;
+	int n;
+
+	snprintf( name, sizeof( name ), "%s.crc", ospath );
+	f = fopen( name, "r" );
+	if ( f == NULL ) {
+		return NULL;
+	}
+
+	fseek( f, 0, SEEK_END );
+	n = ftell( f );
+	fseek( f, 0, SEEK_SET );
+	if ( n < 0 || n > CSUMHEX_MAXLEN ) {
+		n = CSUMHEX_MAXLEN;
+	}
+
+	buf = malloc( n + 1 );
+	if ( buf == NULL ) {
+		fclose( f );
+		return NULL;
+	}
+
+	n = fread( buf, 1, n, f );
+	fclose( f );
+
+	*length = n;
+	return buf;
+}
+
+
+/*
+================
+FS_PakScanWorker
+================
+*/
+static void FS_PakScanWorker( void *param ) {
+	pakScanner_t *sc = (pakScanner_t *)param;
+	pakScanJob_t *job;
+	int index;
+
+	while ( ( index = Sys_AtomicAdd( &sc->next, 1 ) ) < sc->numJobs ) {
+		job = &sc->jobs[ index ];
+		if ( job->ospath ) {
+			job->cd = unzReadCentralDir( job->ospath );
+			if ( job->cd && sc->readCsum ) {
+				job->csum = FS_ReadCsumFile( job->ospath, &job->csumLen );
+			}
+		}
+		Sys_AtomicStore( &job->done, 1 );
+		Sys_RaiseSignal( sc->signal );
+	}
+}
+
+
+/*
+================
+FS_StartPakScan
+
+Returns NULL if pk3 files should be loaded serially
+================
+*/
+static pakScanner_t *FS_StartPakScan( const char *path, const char *dir, char **pakfiles, int numfiles ) {
+	pakScanner_t *sc;
+	const char *ospath;
+	char *s;
+	int threads, size, i;
+
+	if ( numfiles < MIN_SCAN_PAKS || fs_scanThreads->integer == 1 ) {
+		return NULL;
+	}
+
+	threads = fs_scanThreads->integer;
+	if ( threads <= 0 ) {
+		threads = Sys_NumCPUs();
+	}
+	if ( threads > numfiles / MIN_SCAN_PAKS ) {
+		threads = numfiles / MIN_SCAN_PAKS;
+	}
+	if ( threads > MAX_SCAN_THREADS ) {
+		threads = MAX_SCAN_THREADS;
+	}
+	if ( threads < 2 ) {
+		return NULL;
+	}
+
+	size = sizeof( *sc ) + numfiles * sizeof( sc->jobs[0] );
+	for ( i = 0; i < numfiles; i++ ) {
+		if ( FS_IsExt( pakfiles[i], ".pk3", strlen( pakfiles[i] ) ) ) {
+			size += strlen( FS_BuildOSPath( path, dir, pakfiles[i] ) ) + 1;
+		}
+	}
+
+	sc = Z_Malloc( size );
+	Com_Memset( sc, 0, size );
+	sc->jobs = (pakScanJob_t *)( sc + 1 );
+	sc->numJobs = numfiles;
+	sc->readCsum = !inMainDirAcquire;
+
+	s = (char *)( sc->jobs + numfiles );
+	for ( i = 0; i < numfiles; i++ ) {
+		if ( FS_IsExt( pakfiles[i], ".pk3", strlen( pakfiles[i] ) ) ) {
+			ospath = FS_BuildOSPath( path, dir, pakfiles[i] );
+			strcpy( s, ospath );
+			sc->jobs[i].ospath = s;
+			s += strlen( s ) + 1;
+		}
+	}
+
+	sc->signal = Sys_CreateSignal();
+	if ( sc->signal == NULL ) {
+		Z_Free( sc );
+		return NULL;
+	}
+
+	for ( i = 0; i < threads; i++ ) {
+		sc->threads[ sc->numThreads ] = Sys_CreateThread( FS_PakScanWorker, sc );
+		if ( sc->threads[ sc->numThreads ] == NULL ) {
+			break;
+		}
+		sc->numThreads++;
+	}
+
+	if ( sc->numThreads == 0 ) {
+		Sys_DestroySignal( sc->signal );
+		Z_Free( sc );
+		return NULL;
+	}
+
+	return sc;
+}
+
+
+/*
+================
+FS_WaitPakScan
+
+Takes over central directory of a scanned pk3 file and exposes its
+checksum file to Fs_BlockChecksum() until FS_LoadZipFile() is done,
+the caller releases it afterwards
+================
+*/
+static unz_central_dir *FS_WaitPakScan( pakScanner_t *sc, int index ) {
+	pakScanJob_t *job = &sc->jobs[ index ];
+	unz_central_dir *cd;
+
+	while ( !Sys_AtomicLoad( &job->done ) ) {
+		Sys_WaitSignal( sc->signal, 1 );
+	}
+
+	cd = job->cd;
+	job->cd = NULL;
+
+	fs_preloadedCsum = job->csum;
+	fs_preloadedCsumLen = job->csumLen;
+	job->csum = NULL;
+
+	return cd;
+}
+
+
+/*
+================
+FS_FinishPakScan
+================
+*/
+static void FS_FinishPakScan( pakScanner_t *sc ) {
+	int i;
+
+	for ( i = 0; i < sc->numThreads; i++ ) {
+		Sys_JoinThread( sc->threads[ i ] );
+	}
+
+	for ( i = 0; i < sc->numJobs; i++ ) {
+		if ( sc->jobs[ i ].cd ) {
+			unzFreeCentralDir( sc->jobs[ i ].cd );
+		}
+		if ( sc->jobs[ i ].csum ) {
+			free( sc->jobs[ i ].csum );
+		}
+	}
+
+	Sys_DestroySignal( sc->signal );
+	Z_Free( sc );
+}
+
+
 /*
 ================
 FS_AddGameDirectory
@@ -4230,6 +5008,7 @@ static void FS_AddGameDirectory( const char *path, const char *dir ) {
 	int				pakwhich;
 	int				path_len;
 	int				dir_len;
+	pakScanner_t	*scanner;
 
 	inMainDirAcquire = (
 		fs_acquire_checksums->integer &&
@@ -4281,6 +5060,8 @@ static void FS_AddGameDirectory( const char *path, const char *dir ) {
 	if ( numfiles >= 2 )
 		FS_SortFileList( pakfiles, numfiles - 1 );
 
+	scanner = FS_StartPakScan( path, dir, pakfiles, numfiles );
+
 	pakfilesi = 0;
 	pakdirsi = 0;
 
@@ -4322,7 +5103,17 @@ static void FS_AddGameDirectory( const char *path, const char *dir ) {
 
 			// The next .pk3 file is before the next .pk3dir
 			pakfile = FS_BuildOSPath( path, dir, pakfiles[pakfilesi] );
-			if ( (pak = FS_LoadZipFile( pakfile ) ) == NULL ) {
+			if ( scanner ) {
+				unz_central_dir *cd = FS_WaitPakScan( scanner, pakfilesi );
+				pak = cd ? FS_LoadZipFile( pakfile, cd ) : NULL;
+				if ( fs_preloadedCsum ) {
+					free( fs_preloadedCsum );
+					fs_preloadedCsum = NULL;
+				}
+			} else {
+				pak = FS_LoadZipFile( pakfile, NULL );
+			}
+			if ( pak == NULL ) {
 				// This isn't a .pk3! Next!
 				pakfilesi++;
 				continue;
@@ -4383,6 +5174,10 @@ static void FS_AddGameDirectory( const char *path, const char *dir ) {
 	}
 
 	// done
+	if ( scanner ) {
+		FS_FinishPakScan( scanner );
+	}
+
 	Sys_FreeFileList( pakdirs );
 	Sys_FreeFileList( pakfiles );
 
@@ -4964,6 +5759,18 @@ static void FS_Startup( void ) {
 		"Exclude specified pak files from download list on client side.\n"
 		"Format is <moddir>/<pakname> (without .pk3 suffix), you may list multiple entries separated by space." );
 
+	fs_scanThreads = Cvar_Get( "fs_scanThreads", "0", 0 );
+	Cvar_CheckRange( fs_scanThreads, "0", XSTRING(MAX_SCAN_THREADS), CV_INTEGER );
+	Cvar_SetDescription( fs_scanThreads, "Number of threads used to read pk3 file directories on filesystem startup:\n"
+		" 0 - one per CPU core\n"
+		" 1 - read all pk3 files on the main thread\n"
+		"Default: 0" );
+
+	fs_mappedPaks = Cvar_Get( "fs_mappedPaks", "1", 0 );
+	Cvar_CheckRange( fs_mappedPaks, "0", "1", CV_INTEGER );
+	Cvar_SetDescription( fs_mappedPaks, "Map large uncompressed pk3 entries into memory instead of copying them on file load.\n"
+		"Default: 1" );
+
 	start = Sys_Milliseconds();
 
 #ifdef USE_PK3_CACHE
@@ -5819,6 +6626,20 @@ void FS_Flush( fileHandle_t f )
 }
 
 
+/*
+================
+FS_FileStream
+
+Returns stdio stream of a plain write handle, so that background writers
+don't need to go through FS_Write(), handle itself is still closed by FS_FCloseFile()
+================
+*/
+FILE *FS_FileStream( fileHandle_t f )
+{
+	return FS_FileForHandle( f );
+}
+
+
 void	FS_FilenameCompletion( const char *dir, const char *ext,
 		qboolean stripExt, void(*callback)(const char *s), int flags ) {
 	char	filename[ MAX_STRING_CHARS ];
@@ -209,3 +209,73 @@ int HuffmanGetSymbol( unsigned int* symbol, const byte* buffer, int bitIndex )
 
 	return (int)(entry >> 8);
 }
+
+
+// word at a time versions of the above, bits are collected in a 64-bit register
+// and stored or loaded a byte at a time instead of going through memory bit by bit
+
+int HuffmanPutBits( byte* fout, int32_t bitIndex, uint32_t value, int rawBits, int numSymbols )
+{
+	byte* out = fout + (bitIndex >> 3);
+	const int offset = bitIndex & 7;
+	uint64_t bits;
+	int count, i;
+
+	// raw bits go first, then the codes of the following bytes,
+	// at most 7 + 4 * 11 bits so the byte offset still fits
+	bits = value & ((1U << rawBits) - 1);
+	count = rawBits;
+	value >>= rawBits;
+	for ( i = 0; i < numSymbols; ++i )
+	{
+		const uint16_t result = HuffmanEncoderTable[ value & 0xFF ];
+		bits |= (uint64_t)((result >> 4) & 0x7FF) << count;
+		count += result & 15;
+		value >>= 8;
+	}
+
+	// same as HuffmanPutBit for each bit: the first byte is
+	// added to unless it is a new one, the rest are replaced
+	bits <<= offset;
+	if ( offset == 0 )
+		*out = (byte)bits;
+	else
+		*out |= (byte)bits;
+
+	for ( i = offset + count - 8; i > 0; i -= 8 )
+	{
+		bits >>= 8;
+		*++out = (byte)bits;
+	}
+
+	return count;
+}
+
+
+int HuffmanGetBits( uint32_t* value, const byte* buffer, int bitIndex, int rawBits, int numSymbols )
+{
+	const byte* in = buffer + (bitIndex >> 3);
+	uint64_t bits;
+	uint32_t result;
+	int count, i;
+
+	// caller makes sure all 8 bytes are inside the buffer
+	bits = (uint64_t)in[0] | ((uint64_t)in[1] << 8) | ((uint64_t)in[2] << 16) | ((uint64_t)in[3] << 24)
+		| ((uint64_t)in[4] << 32) | ((uint64_t)in[5] << 40) | ((uint64_t)in[6] << 48) | ((uint64_t)in[7] << 56);
+	bits >>= bitIndex & 7;
+
+	result = (uint32_t)bits & ((1U << rawBits) - 1);
+	bits >>= rawBits;
+	count = rawBits;
+	for ( i = 0; i < numSymbols; ++i )
+	{
+		const uint16_t entry = HuffmanDecoderTable[ bits & 0x7FF ];
+		result |= (uint32_t)(entry & 0xFF) << (rawBits + i * 8);
+		bits >>= entry >> 8;
+		count += entry >> 8;
+	}
+
+	*value = result;
+
+	return count;
+}
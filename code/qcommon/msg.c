@@ -95,8 +95,6 @@ bit functions
 
 // negative bit values include signs
 void MSG_WriteBits( msg_t *msg, int value, int bits ) {
-	int	i;
-
 	if ( bits == 0 || bits < -31 || bits > 32 ) {
 		Com_Error( ERR_DROP, "MSG_WriteBits: bad bits %i", bits );
 	}
@@ -127,22 +125,7 @@ void MSG_WriteBits( msg_t *msg, int value, int bits ) {
 		}
 	} else {
 		value &= (0xffffffff>>(32-bits));
-		if ( bits & 7 ) {
-			int nbits;
-			nbits = bits&7;
-			for ( i = 0; i < nbits ; i++ ) {
-				HuffmanPutBit( msg->data, msg->bit, (value & 1) );
-				msg->bit++;
-				value = (value>>1);
-			}
-			bits = bits - nbits;
-		}
-		if ( bits ) {
-			for( i = 0 ; i < bits ; i += 8 ) {
-				msg->bit += HuffmanPutSymbol( msg->data, msg->bit, (value & 0xFF) );
-				value = (value>>8);
-			}
-		}
+		msg->bit += HuffmanPutBits( msg->data, msg->bit, value, bits & 7, bits >> 3 );
 		msg->cursize = (msg->bit>>3)+1;
 	}
 
@@ -157,6 +140,7 @@ int MSG_ReadBits( msg_t *msg, int bits ) {
 	qboolean	sgn;
 	int		i;
 	unsigned int	sym;
+	uint32_t	word;
 	const byte *buffer = msg->data; // dereference optimization
 
 	if ( msg->bit >= msg->maxbits )
@@ -197,20 +181,25 @@ int MSG_ReadBits( msg_t *msg, int bits ) {
 	} else {
 		const int nbits = bits & 7;
 		int bitIndex = msg->bit; // dereference optimization
-		if ( nbits )
-		{		
-			for ( i = 0; i < nbits; i++ ) {
-				value |= HuffmanGetBit( buffer, bitIndex ) << i;
-				bitIndex++;
-			}
+		if ( ( bitIndex >> 3 ) + 8 <= msg->maxsize ) {
+			// the whole value is decoded from one 64-bit window
+			bitIndex += HuffmanGetBits( &word, buffer, bitIndex, nbits, bits >> 3 );
+			value = (int)word;
 			bits -= nbits;
-		}
-		if ( bits )
-		{
-			for ( i = 0; i < bits; i += 8 )
-			{
-				bitIndex += HuffmanGetSymbol( &sym, buffer, bitIndex );
-				value |= ( sym << (i+nbits) );
+		} else {
+			// near the end of the buffer
+			if ( nbits ) {
+				for ( i = 0; i < nbits; i++ ) {
+					value |= HuffmanGetBit( buffer, bitIndex ) << i;
+					bitIndex++;
+				}
+				bits -= nbits;
+			}
+			if ( bits ) {
+				for ( i = 0; i < bits; i += 8 ) {
+					bitIndex += HuffmanGetSymbol( &sym, buffer, bitIndex );
+					value |= ( sym << (i+nbits) );
+				}
 			}
 		}
 		msg->bit = bitIndex;
@@ -228,6 +217,257 @@ int MSG_ReadBits( msg_t *msg, int bits ) {
 
 
 
+/*
+=================
+MSG_WriteBitstream
+
+Appends numBits bits that were written with MSG_WriteBits to another bitstream
+message starting at bit 0. Static huffman codes don't depend on the position,
+so the result is the same as repeating the original MSG_WriteBits calls.
+=================
+*/
+void MSG_WriteBitstream( msg_t *msg, const byte *data, int numBits ) {
+	byte *out;
+	int offset, i;
+
+	if ( msg->overflowed != qfalse || numBits <= 0 )
+		return;
+
+	if ( msg->oob ) {
+		Com_Error( ERR_DROP, "MSG_WriteBitstream: out of band message" );
+	}
+
+	if ( msg->bit + numBits > msg->maxbits ) {
+		msg->overflowed = qtrue;
+		return;
+	}
+
+	out = msg->data + ( msg->bit >> 3 );
+	offset = msg->bit & 7;
+
+	if ( offset == 0 ) {
+		// a new byte, data has zeroes after the last bit
+		Com_Memcpy( out, data, ( numBits + 7 ) >> 3 );
+	} else {
+		// add to the current byte, replace the following ones
+		for ( i = 0; i < numBits; i += 8, data++, out++ ) {
+			*out |= *data << offset;
+			if ( numBits - i > 8 - offset ) {
+				out[1] = *data >> ( 8 - offset );
+			}
+		}
+	}
+
+	msg->bit += numBits;
+	msg->cursize = (msg->bit>>3)+1;
+}
+
+
+/*
+=================
+MSG_WriteBitsSlow
+
+Bit at a time huffman writer, reference for msgbench
+=================
+*/
+static void MSG_WriteBitsSlow( msg_t *msg, int value, int bits ) {
+	int i;
+
+	if ( bits < 0 ) {
+		bits = -bits;
+	}
+	value &= (0xffffffff>>(32-bits));
+	for ( i = 0; i < ( bits & 7 ); i++ ) {
+		HuffmanPutBit( msg->data, msg->bit, (value & 1) );
+		msg->bit++;
+		value = (value>>1);
+	}
+	for ( i = 0; i < ( bits >> 3 ); i++ ) {
+		msg->bit += HuffmanPutSymbol( msg->data, msg->bit, (value & 0xFF) );
+		value = (value>>8);
+	}
+	msg->cursize = (msg->bit>>3)+1;
+}
+
+
+/*
+=================
+MSG_ReadBitsSlow
+
+Symbol at a time huffman reader, reference for msgbench
+=================
+*/
+static int MSG_ReadBitsSlow( msg_t *msg, int bits ) {
+	unsigned int sym;
+	int value, nbits, i;
+
+	if ( bits < 0 ) {
+		bits = -bits;
+	}
+	nbits = bits & 7;
+	value = 0;
+	for ( i = 0; i < nbits; i++ ) {
+		value |= HuffmanGetBit( msg->data, msg->bit ) << i;
+		msg->bit++;
+	}
+	for ( i = 0; i < ( bits >> 3 ); i++ ) {
+		msg->bit += HuffmanGetSymbol( &sym, msg->data, msg->bit );
+		value |= ( sym << (i*8+nbits) );
+	}
+	msg->readcount = (msg->bit >> 3) + 1;
+
+	return value;
+}
+
+
+/*
+=================
+MSG_Bench_f
+
+Writes and reads a stream of random fields with MSG_WriteBits/MSG_ReadBits and with
+the bit at a time reference code, checks that the bytes match and times both
+=================
+*/
+void MSG_Bench_f( void ) {
+	// field sizes seen in entity and playerstate deltas
+	static const int widths[] = { 1, 1, 1, 1, 4, 5, 6, 7, 8, 8, 8, 10, 12, 13, 16, 16, -8, -16, 19, 24, 32, 32 };
+	static byte fastData[MAX_MSGLEN_BUF], slowData[MAX_MSGLEN_BUF];
+	static int bits[4096], values[4096];
+	msg_t fast, slow;
+	int64_t start, writeFast, writeSlow, readFast, readSlow;
+	int i, n, iter, iterations, seed, errors;
+	unsigned int mask, sumFast, sumSlow;
+
+	iterations = Cmd_Argc() > 1 ? atoi( Cmd_Argv( 1 ) ) : 1000;
+	if ( iterations < 1 ) {
+		iterations = 1;
+	}
+
+	seed = 12345;
+	for ( n = 0; n < ARRAY_LEN( bits ); n++ ) {
+		bits[n] = widths[ Q_rand( &seed ) % ARRAY_LEN( widths ) ];
+		values[n] = Q_rand( &seed ) ^ ( Q_rand( &seed ) << 16 );
+		// most delta fields are small
+		if ( n & 1 ) {
+			values[n] &= 0xFF;
+		}
+	}
+
+	// fill with garbage, huffman writes must not depend on it
+	Com_Memset( fastData, 0xA5, sizeof( fastData ) );
+	Com_Memset( slowData, 0xA5, sizeof( slowData ) );
+
+	MSG_Init( &fast, fastData, MAX_MSGLEN );
+	MSG_Init( &slow, slowData, MAX_MSGLEN );
+	for ( n = 0; n < ARRAY_LEN( bits ); n++ ) {
+		if ( slow.bit + 64 > slow.maxbits ) {
+			break;
+		}
+		MSG_WriteBits( &fast, values[n], bits[n] );
+		MSG_WriteBitsSlow( &slow, values[n], bits[n] );
+	}
+
+	errors = 0;
+	if ( fast.bit != slow.bit || fast.cursize != slow.cursize || memcmp( fastData, slowData, slow.cursize ) ) {
+		Com_Printf( S_COLOR_RED "write mismatch: %i/%i bits\n", fast.bit, slow.bit );
+		errors++;
+	}
+
+	MSG_BeginReading( &fast );
+	MSG_BeginReading( &slow );
+	for ( i = 0; i < n; i++ ) {
+		// MSG_ReadBits sign extends, the reference doesn't
+		mask = 0xffffffff >> ( 32 - abs( bits[i] ) );
+		if ( ( MSG_ReadBits( &fast, bits[i] ) ^ MSG_ReadBitsSlow( &slow, bits[i] ) ) & mask || fast.bit != slow.bit ) {
+			Com_Printf( S_COLOR_RED "read mismatch at field %i\n", i );
+			errors++;
+			break;
+		}
+	}
+
+	// entity deltas appended as bitstreams must match deltas written in place
+	MSG_Init( &fast, fastData, MAX_MSGLEN );
+	MSG_Init( &slow, slowData, MAX_MSGLEN );
+	for ( i = 0; i < 64; i++ ) {
+		entityState_t from, to;
+		byte deltaData[ 1024 ];
+		msg_t delta;
+		int *f = (int *)&from, *t = (int *)&to;
+		int k;
+
+		for ( k = 0; k < (int)( sizeof( from ) / sizeof( int ) ); k++ ) {
+			f[k] = Q_rand( &seed ) ^ ( Q_rand( &seed ) << 16 );
+			t[k] = ( Q_rand( &seed ) & 3 ) ? f[k] : ( Q_rand( &seed ) & 0xFFFF );
+		}
+		from.number = to.number = i;
+
+		// start the delta at any bit position
+		k = ( Q_rand( &seed ) & 7 ) + 1;
+		MSG_WriteBits( &fast, i, k );
+		MSG_WriteBits( &slow, i, k );
+
+		MSG_WriteDeltaEntity( &slow, &from, &to, i & 1 );
+
+		MSG_Init( &delta, deltaData, sizeof( deltaData ) );
+		MSG_WriteDeltaEntity( &delta, &from, &to, i & 1 );
+		MSG_WriteBitstream( &fast, deltaData, delta.bit );
+	}
+	if ( fast.bit != slow.bit || fast.cursize != slow.cursize || memcmp( fastData, slowData, slow.cursize ) ) {
+		Com_Printf( S_COLOR_RED "entity bitstream mismatch: %i/%i bits\n", fast.bit, slow.bit );
+		errors++;
+	}
+
+	start = Sys_Microseconds();
+	for ( iter = 0; iter < iterations; iter++ ) {
+		MSG_Clear( &fast );
+		for ( i = 0; i < n; i++ ) {
+			MSG_WriteBits( &fast, values[i], bits[i] );
+		}
+	}
+	writeFast = Sys_Microseconds() - start;
+
+	start = Sys_Microseconds();
+	for ( iter = 0; iter < iterations; iter++ ) {
+		MSG_Clear( &slow );
+		for ( i = 0; i < n; i++ ) {
+			MSG_WriteBitsSlow( &slow, values[i], bits[i] );
+		}
+	}
+	writeSlow = Sys_Microseconds() - start;
+
+	sumFast = 0;
+	start = Sys_Microseconds();
+	for ( iter = 0; iter < iterations; iter++ ) {
+		MSG_BeginReading( &fast );
+		for ( i = 0; i < n; i++ ) {
+			sumFast += MSG_ReadBits( &fast, bits[i] ) & 0xFF;
+		}
+	}
+	readFast = Sys_Microseconds() - start;
+
+	sumSlow = 0;
+	start = Sys_Microseconds();
+	for ( iter = 0; iter < iterations; iter++ ) {
+		MSG_BeginReading( &slow );
+		for ( i = 0; i < n; i++ ) {
+			sumSlow += MSG_ReadBitsSlow( &slow, bits[i] ) & 0xFF;
+		}
+	}
+	readSlow = Sys_Microseconds() - start;
+
+	if ( sumFast != sumSlow ) {
+		errors++;
+	}
+
+	Com_Printf( "%i fields, %i bytes, %i iterations\n", n, slow.cursize, iterations );
+	Com_Printf( "write: %.2f nsec/field (bit at a time %.2f)\n",
+		writeFast * 1000.0 / ( (double)n * iterations ), writeSlow * 1000.0 / ( (double)n * iterations ) );
+	Com_Printf( "read: %.2f nsec/field (symbol at a time %.2f)\n",
+		readFast * 1000.0 / ( (double)n * iterations ), readSlow * 1000.0 / ( (double)n * iterations ) );
+	Com_Printf( "%i mismatches\n", errors );
+}
+
+
 //================================================================================
 
 //
@@ -1044,16 +1284,20 @@ void MSG_WriteDeltaEntity( msg_t *msg, const entityState_t *from, const entitySt
 	}
 
 	lc = 0;
-	// build the change vector as bytes so it is endien independent
-	for ( i = 0, field = entityStateFields ; i < numFields ; i++, field++ ) {
-		fromF = (int *)( (byte *)from + field->offset );
-		toF = (int *)( (byte *)to + field->offset );
+	// most entities don't change between snapshots, a plain
+	// compare of the whole state is much cheaper than the field walk
+	if ( memcmp( from, to, sizeof( *to ) ) != 0 ) {
+		// build the change vector as bytes so it is endien independent
+		for ( i = 0, field = entityStateFields ; i < numFields ; i++, field++ ) {
+			fromF = (int *)( (byte *)from + field->offset );
+			toF = (int *)( (byte *)to + field->offset );
 #ifdef USE_MV
-		if ( ( field->mergeMask & MSG_entMergeMask ) && to->number < MAX_CLIENTS )
-			continue;
+			if ( ( field->mergeMask & MSG_entMergeMask ) && to->number < MAX_CLIENTS )
+				continue;
 #endif
-		if ( *fromF != *toF ) {
-			lc = i+1;
+			if ( *fromF != *toF ) {
+				lc = i+1;
+			}
 		}
 	}
 
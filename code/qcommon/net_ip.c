@@ -20,6 +20,10 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 ===========================================================================
 */
 
+#ifdef __linux__
+#define _GNU_SOURCE // recvmmsg, sendmmsg
+#endif
+
 #include "../qcommon/q_shared.h"
 #include "../qcommon/qcommon.h"
 
@@ -93,6 +97,11 @@ static qboolean	winsockInitialized = qfalse;
 #		include <sys/filio.h>
 #	endif
 
+#	ifdef __linux__
+#		define USE_NET_MMSG
+#		include <sys/epoll.h>
+#	endif
+
 typedef int SOCKET;
 #	define INVALID_SOCKET		-1
 #	define SOCKET_ERROR			-1
@@ -175,6 +184,9 @@ static cvar_t	*net_mcast6addr;
 static cvar_t	*net_mcast6iface;
 #endif
 static cvar_t	*net_dropsim;
+#ifdef USE_NET_MMSG
+static cvar_t	*net_batchIO;
+#endif
 
 static sockaddr_t socksRelayAddr;
 
@@ -213,6 +225,33 @@ typedef struct
 static nip_localaddr_t localIP[MAX_IPS];
 static int numIP;
 
+#ifdef USE_NET_MMSG
+// batched i/o: epoll + recvmmsg for incoming and sendmmsg for outgoing datagrams
+#define	NET_BATCH_RECV	32
+#define	NET_BATCH_SEND	128
+
+typedef struct {
+	sockaddr_t	addr;
+	int			length;
+	byte		data[ MAX_PACKETLEN + 16 ];
+} batchPacket_t;
+
+static int				epoll_fd = -1;
+
+static struct mmsghdr	recv_msgs[ NET_BATCH_RECV ];
+static struct iovec		recv_iov[ NET_BATCH_RECV ];
+static sockaddr_t		recv_addr[ NET_BATCH_RECV ];
+static byte				recv_buf[ NET_BATCH_RECV ][ MAX_MSGLEN_BUF ];
+
+static qboolean			send_batching;
+static int				send_count;
+static batchPacket_t	send_queue[ NET_BATCH_SEND ];
+
+static void NET_SendBatch( void );
+static void NET_OpenBatch( void );
+static void NET_CloseBatch( void );
+#endif
+
 static void	NET_Restart_f( void );
 
 //=============================================================================
@@ -803,6 +842,26 @@ void Sys_SendPacket( int length, const void *data, const netadr_t *to ) {
 
 	NetadrToSockadr( to, &addr );
 
+#ifdef USE_NET_MMSG
+	if ( send_count || send_batching ) {
+		if ( send_batching && !usingSocks && ( to->type == NA_IP || to->type == NA_IP6 ) && length <= sizeof( send_queue[0].data ) ) {
+			batchPacket_t *packet;
+
+			if ( send_count == NET_BATCH_SEND )
+				NET_SendBatch();
+
+			packet = &send_queue[ send_count++ ];
+			packet->addr = addr;
+			packet->length = length;
+			memcpy( packet->data, data, length );
+			return;
+		}
+
+		// keep packet order
+		NET_SendBatch();
+	}
+#endif
+
 	if ( usingSocks && to->type == NA_IP ) {
 		socks5_udp_request_t cmd;
 
@@ -844,6 +903,103 @@ void Sys_SendPacket( int length, const void *data, const netadr_t *to ) {
 }
 
 
+#ifdef USE_NET_MMSG
+/*
+==================
+NET_SendBatchFamily
+
+One sendmmsg() call per socket for all queued packets of given family
+==================
+*/
+static void NET_SendBatchFamily( SOCKET sock, sa_family_t family, socklen_t addrlen )
+{
+	struct mmsghdr msgs[ NET_BATCH_SEND ];
+	struct iovec iov[ NET_BATCH_SEND ];
+	int i, n, sent, ret;
+
+	n = 0;
+	for ( i = 0; i < send_count; i++ ) {
+		if ( send_queue[i].addr.ss.ss_family != family )
+			continue;
+		iov[n].iov_base = send_queue[i].data;
+		iov[n].iov_len = send_queue[i].length;
+		memset( &msgs[n].msg_hdr, 0, sizeof( msgs[n].msg_hdr ) );
+		msgs[n].msg_hdr.msg_name = &send_queue[i].addr;
+		msgs[n].msg_hdr.msg_namelen = addrlen;
+		msgs[n].msg_hdr.msg_iov = &iov[n];
+		msgs[n].msg_hdr.msg_iovlen = 1;
+		n++;
+	}
+
+	if ( n == 0 || sock == INVALID_SOCKET )
+		return;
+
+	sent = 0;
+	while ( sent < n ) {
+		ret = sendmmsg( sock, msgs + sent, n - sent, 0 );
+		if ( ret <= 0 ) {
+			// skip failed datagram, wouldblock is silent
+			if ( ret < 0 && socketError != EAGAIN && socketError != EINTR )
+				Com_Printf( "Sys_SendPacket: %s\n", NET_ErrorString() );
+			sent++;
+		} else {
+			sent += ret;
+		}
+	}
+}
+
+
+/*
+==================
+NET_SendBatch
+==================
+*/
+static void NET_SendBatch( void )
+{
+	if ( !send_count )
+		return;
+
+	NET_SendBatchFamily( ip_socket, AF_INET, sizeof( struct sockaddr_in ) );
+#ifdef USE_IPV6
+	NET_SendBatchFamily( ip6_socket, AF_INET6, sizeof( struct sockaddr_in6 ) );
+#endif
+
+	send_count = 0;
+}
+#endif
+
+
+/*
+==================
+NET_BeginBatch
+
+Outgoing packets are queued until NET_FlushBatch(), so that
+they can be sent with a single syscall if batched i/o is enabled
+==================
+*/
+void NET_BeginBatch( void )
+{
+#ifdef USE_NET_MMSG
+	if ( epoll_fd != -1 )
+		send_batching = qtrue;
+#endif
+}
+
+
+/*
+==================
+NET_FlushBatch
+==================
+*/
+void NET_FlushBatch( void )
+{
+#ifdef USE_NET_MMSG
+	NET_SendBatch();
+	send_batching = qfalse;
+#endif
+}
+
+
 //=============================================================================
 
 /*
@@ -1691,6 +1847,14 @@ static qboolean NET_GetCvars( void ) {
 	net_dropsim = Cvar_Get( "net_dropsim", "", CVAR_TEMP );
     Cvar_SetDescription(net_dropsim, "Simulate packet dropping events for debugging purposes in percent\nDefault: empty");
 
+#ifdef USE_NET_MMSG
+	net_batchIO = Cvar_Get( "net_batchIO", "0", CVAR_LATCH | CVAR_ARCHIVE_ND );
+	Cvar_SetDescription( net_batchIO, "Use epoll, recvmmsg and sendmmsg to receive and send packets in batches, ignored with socks proxy\nDefault: 0" );
+	Cvar_CheckRange( net_batchIO, "0", "1", CV_INTEGER );
+	modified += net_batchIO->modified;
+	net_batchIO->modified = qfalse;
+#endif
+
     return modified ? qtrue : qfalse;
 }
 
@@ -1740,6 +1904,9 @@ static void NET_Config( qboolean enableNetworking ) {
 	}
 
 	if( stop ) {
+#ifdef USE_NET_MMSG
+		NET_CloseBatch();
+#endif
 		if ( ip_socket != INVALID_SOCKET ) {
 			closesocket( ip_socket );
 			ip_socket = INVALID_SOCKET;
@@ -1772,6 +1939,9 @@ static void NET_Config( qboolean enableNetworking ) {
 			NET_OpenIP();
 #ifdef USE_IPV6
 			NET_SetMulticast6();
+#endif
+#ifdef USE_NET_MMSG
+			NET_OpenBatch();
 #endif
 		}
 	}
@@ -1823,6 +1993,31 @@ void NET_Shutdown( void ) {
 }
 
 
+/*
+====================
+NET_DispatchPacket
+====================
+*/
+static void NET_DispatchPacket( const netadr_t *from, msg_t *netmsg )
+{
+	if ( net_dropsim->value > 0.0f && net_dropsim->value <= 100.0f )
+	{
+		// com_dropsim->value percent of incoming packets get dropped.
+		if ( rand() < (int) (((double) RAND_MAX) / 100.0 * (double) net_dropsim->value) )
+			return; // drop this packet
+	}
+
+#ifdef DEDICATED
+	Com_RunAndTimeServerPacket( from, netmsg );
+#else
+	if ( com_sv_running->integer || com_dedicated->integer )
+		Com_RunAndTimeServerPacket( from, netmsg );
+	else
+		CL_PacketEvent( from, netmsg );
+#endif
+}
+
+
 /*
 ====================
 NET_Event
@@ -1841,27 +2036,176 @@ static void NET_Event( const fd_set *fdr )
 		MSG_Init( &netmsg, bufData, MAX_MSGLEN );
 
 		if ( NET_GetPacket( &from, &netmsg, fdr ) )
-		{
-			if ( net_dropsim->value > 0.0f && net_dropsim->value <= 100.0f )
-			{
-				// com_dropsim->value percent of incoming packets get dropped.
-				if ( rand() < (int) (((double) RAND_MAX) / 100.0 * (double) net_dropsim->value) )
-					continue; // drop this packet
+			NET_DispatchPacket( &from, &netmsg );
+		else
+			break;
+	}
+}
+
+
+#ifdef USE_NET_MMSG
+/*
+====================
+NET_EventBatch
+
+Drains socket with recvmmsg() calls, NET_BATCH_RECV datagrams at a time
+====================
+*/
+static void NET_EventBatch( SOCKET *socket )
+{
+	netadr_t from;
+	msg_t netmsg;
+	SOCKET sock;
+	int i, ret;
+
+	sock = *socket;
+
+	do {
+		for ( i = 0; i < NET_BATCH_RECV; i++ ) {
+			recv_iov[i].iov_base = recv_buf[i];
+			recv_iov[i].iov_len = MAX_MSGLEN;
+			memset( &recv_msgs[i].msg_hdr, 0, sizeof( recv_msgs[i].msg_hdr ) );
+			recv_msgs[i].msg_hdr.msg_name = &recv_addr[i];
+			recv_msgs[i].msg_hdr.msg_namelen = sizeof( recv_addr[i] );
+			recv_msgs[i].msg_hdr.msg_iov = &recv_iov[i];
+			recv_msgs[i].msg_hdr.msg_iovlen = 1;
+		}
+
+		ret = recvmmsg( sock, recv_msgs, NET_BATCH_RECV, MSG_DONTWAIT, NULL );
+
+		if ( ret == SOCKET_ERROR ) {
+			if ( socketError != EAGAIN && socketError != ECONNRESET && socketError != EINTR )
+				Com_Printf( "NET_GetPacket: %s\n", NET_ErrorString() );
+			return;
+		}
+
+		for ( i = 0; i < ret; i++ ) {
+			if ( recv_addr[i].ss.ss_family == AF_INET )
+				memset( &recv_addr[i].v4.sin_zero, 0, sizeof( recv_addr[i].v4.sin_zero ) );
+
+			from.type = NA_BAD;
+			SockadrToNetadr( &recv_addr[i], &from );
+
+			if ( recv_msgs[i].msg_len >= MAX_MSGLEN ) {
+				Com_Printf( "Oversize packet from %s\n", NET_AdrToString( &from ) );
+				continue;
 			}
 
-#ifdef DEDICATED
-			Com_RunAndTimeServerPacket( &from, &netmsg );
-#else
-			if ( com_sv_running->integer || com_dedicated->integer )
-				Com_RunAndTimeServerPacket( &from, &netmsg );
-			else
-				CL_PacketEvent( &from, &netmsg );
-#endif
+			MSG_Init( &netmsg, recv_buf[i], MAX_MSGLEN );
+			netmsg.cursize = recv_msgs[i].msg_len;
+
+			NET_DispatchPacket( &from, &netmsg );
+
+			// packet handlers may restart networking
+			if ( *socket != sock )
+				return;
 		}
-		else
+	} while ( ret == NET_BATCH_RECV );
+}
+
+
+/*
+====================
+NET_SleepBatch
+====================
+*/
+static qboolean NET_SleepBatch( int timeout )
+{
+	struct epoll_event events[ 4 ];
+	int i, n;
+
+	// round to nearest millisecond
+	n = epoll_wait( epoll_fd, events, ARRAY_LEN( events ), ( timeout + 500 ) / 1000 );
+
+	if ( n == SOCKET_ERROR ) {
+		if ( socketError != EINTR )
+			Com_Printf( S_COLOR_YELLOW "Warning: epoll_wait() syscall failed: %s\n", NET_ErrorString() );
+		return qtrue;
+	}
+
+	if ( n == 0 )
+		return qtrue;
+
+	for ( i = 0; i < n; i++ ) {
+		if ( ip_socket != INVALID_SOCKET && events[i].data.fd == ip_socket )
+			NET_EventBatch( &ip_socket );
+#ifdef USE_IPV6
+		else if ( ip6_socket != INVALID_SOCKET && events[i].data.fd == ip6_socket )
+			NET_EventBatch( &ip6_socket );
+		else if ( multicast6_socket != INVALID_SOCKET && events[i].data.fd == multicast6_socket )
+			NET_EventBatch( &multicast6_socket );
+#endif
+		if ( epoll_fd == -1 )
 			break;
 	}
+
+	return qfalse;
+}
+
+
+/*
+====================
+NET_AddBatchSocket
+====================
+*/
+static void NET_AddBatchSocket( SOCKET sock )
+{
+	struct epoll_event ev;
+
+	if ( sock == INVALID_SOCKET )
+		return;
+
+	memset( &ev, 0, sizeof( ev ) );
+	ev.events = EPOLLIN;
+	ev.data.fd = sock;
+
+	if ( epoll_ctl( epoll_fd, EPOLL_CTL_ADD, sock, &ev ) == SOCKET_ERROR )
+		Com_Printf( S_COLOR_YELLOW "WARNING: epoll_ctl: %s\n", NET_ErrorString() );
+}
+
+
+/*
+====================
+NET_OpenBatch
+====================
+*/
+static void NET_OpenBatch( void )
+{
+	if ( !net_batchIO->integer || usingSocks )
+		return;
+
+	epoll_fd = epoll_create1( EPOLL_CLOEXEC );
+	if ( epoll_fd == -1 ) {
+		Com_Printf( S_COLOR_YELLOW "WARNING: epoll_create1: %s, batched i/o disabled\n", NET_ErrorString() );
+		return;
+	}
+
+	NET_AddBatchSocket( ip_socket );
+#ifdef USE_IPV6
+	NET_AddBatchSocket( ip6_socket );
+	if ( multicast6_socket != ip6_socket )
+		NET_AddBatchSocket( multicast6_socket );
+#endif
+
+	Com_Printf( "Using batched network i/o\n" );
+}
+
+
+/*
+====================
+NET_CloseBatch
+====================
+*/
+static void NET_CloseBatch( void )
+{
+	NET_FlushBatch();
+
+	if ( epoll_fd != -1 ) {
+		close( epoll_fd );
+		epoll_fd = -1;
+	}
 }
+#endif // USE_NET_MMSG
 
 
 /*
@@ -1883,6 +2227,11 @@ qboolean NET_Sleep( int timeout )
 	if ( timeout < 0 )
 		timeout = 0;
 
+#ifdef USE_NET_MMSG
+	if ( epoll_fd != -1 )
+		return NET_SleepBatch( timeout );
+#endif
+
 	FD_ZERO( &fdr );
 
 	if ( ip_socket != INVALID_SOCKET )
@@ -196,6 +196,31 @@ unsigned long Com_GenerateHashValue( const char *fname, const unsigned int size
 }
 
 
+/*
+==================
+Com_HashNameNoCase
+
+case-insensitive 32-bit hash of a whole name, callers keep it
+next to the name and mask it down to their table size
+==================
+*/
+unsigned int Com_HashNameNoCase( const char *name )
+{
+	const byte *s;
+	unsigned int hash;
+	int		c;
+
+	s = (const byte*)name;
+	hash = 2166136261U;
+
+	while ( (c = locase[*s++]) != '\0' ) {
+		hash = ( hash ^ c ) * 16777619U;
+	}
+
+	return hash;
+}
+
+
 /*
 ============
 Com_Split
@@ -707,6 +707,7 @@ qboolean COM_CompareExtension(const char *in, const char *ext);
 void	COM_DefaultExtension( char *path, int maxSize, const char *extension );
 
 unsigned long Com_GenerateHashValue( const char *fname, const unsigned int size );
+unsigned int Com_HashNameNoCase( const char *name );
 
 void	COM_BeginParseSession( const char *name );
 int		COM_GetCurrentParseLine( void );
@@ -974,6 +975,8 @@ struct cvar_s {
 	cvar_t		*hashNext;
 	cvar_t		*hashPrev;
 	int			hashIndex;
+	unsigned int hashValue;			// Com_HashNameNoCase( name )
+	int			subscribers;		// Cvar_Subscribe callbacks for this cvar
 	cvarGroup_t	group;				// to track changes
 };
 
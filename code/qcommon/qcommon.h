@@ -91,6 +91,7 @@ struct entityState_s;
 struct playerState_s;
 
 void MSG_WriteBits( msg_t *msg, int value, int bits );
+void MSG_WriteBitstream( msg_t *msg, const byte *data, int numBits );
 
 void MSG_WriteChar (msg_t *sb, int c);
 void MSG_WriteByte (msg_t *sb, int c);
@@ -128,6 +129,7 @@ void MSG_WriteDeltaPlayerstate( msg_t *msg, const playerState_t *from, const pla
 void MSG_ReadDeltaPlayerstate( msg_t *msg, const playerState_t *from, playerState_t *to );
 
 void MSG_ReportChangeVectors_f( void );
+void MSG_Bench_f( void );
 
 // PureMultiView protocol
 
@@ -271,6 +273,8 @@ void		NET_Init( void );
 void		NET_Shutdown( void );
 void		NET_FlushPacketQueue(void);
 void		NET_SendPacket( netsrc_t sock, int length, const void *data, const netadr_t *to );
+void		NET_BeginBatch( void );
+void		NET_FlushBatch( void );
 void		QDECL NET_OutOfBandPrint( netsrc_t net_socket, const netadr_t *adr, const char *format, ...) __attribute__ ((format (printf, 3, 4)));
 void		NET_OutOfBandCompress( netsrc_t sock, const netadr_t *adr, const byte *data, int len );
 
@@ -477,7 +481,15 @@ typedef enum {
 	VM_COUNT
 } vmIndex_t;
 
+// system calls that compiled code may invoke without going through the
+// module dispatcher, handlers receive the same arguments as systemCalls
+typedef struct {
+	int			callNum;
+	syscall_t	func;
+} vmDirectCall_t;
+
 void	VM_Init( void );
+void	VM_SetDirectCalls( vmIndex_t index, const vmDirectCall_t *calls, int numCalls );
 vm_t	*VM_Create( vmIndex_t index, syscall_t systemCalls, dllSyscall_t dllSyscalls, vmInterpret_t interpret );
 
 // module should be bare: "cgame", not "cgame.dll" or "vm/cgame.qvm"
@@ -676,6 +688,22 @@ void	Cvar_VariableStringBufferSafe( const char *var_name, char *buffer, int bufs
 unsigned Cvar_Flags( const char *var_name );
 // returns CVAR_NONEXISTENT if cvar doesn't exist or the flags of that particular CVAR.
 
+#define CVAR_CACHE_SIZE 64
+
+typedef struct {
+	const char	*name;		// caller owned pointer the handle was resolved for
+	cvarHandle_t handle;
+} cvarCacheEntry_t;
+
+typedef struct {
+	cvarCacheEntry_t entry[ CVAR_CACHE_SIZE ];
+} cvarCache_t;
+
+cvar_t	*Cvar_FindCached( cvarCache_t *cache, const char *var_name );
+void	Cvar_ResetCache( cvarCache_t *cache );
+// name lookups for hot callers that keep passing the same name pointers,
+// returns NULL if not defined
+
 void	Cvar_CommandCompletion( void(*callback)(const char *s) );
 // callback with each valid string
 
@@ -708,6 +736,17 @@ void	Cvar_SetGroup( cvar_t *var, cvarGroup_t group );
 int		Cvar_CheckGroup( cvarGroup_t group );
 void	Cvar_ResetGroup( cvarGroup_t group, qboolean resetModifiedFlags );
 
+typedef void (*cvarCallback_t)( cvar_t *var );
+
+void	Cvar_Subscribe( cvar_t *var, cvarCallback_t callback );
+// callback runs right after every value change of the cvar
+
+void	Cvar_SubscribeFlags( int flags, cvarCallback_t callback );
+// callback runs after value changes of any cvar with one of the flags, and
+// with NULL when cvars with them are created, removed or get them added
+
+void	Cvar_Unsubscribe( cvarCallback_t callback );
+
 void	Cvar_Restart( qboolean unsetVM );
 
 void	Cvar_CompleteCvarName( char *args, int argNum );
@@ -864,6 +903,32 @@ void	FS_ForceFlush( fileHandle_t f );
 void	FS_FreeFile( void *buffer );
 // frees the memory returned by FS_ReadFile
 
+const void *FS_MapFile( const char *qpath, int *size );
+// maps a loose file read-only if the search path resolves it outside of pk3s,
+// returns NULL if the file is missing or inside a pk3
+
+void	FS_UnmapFile( const void *data, int size );
+// unmaps a file mapped by FS_MapFile
+
+typedef enum {
+	PREFETCH_NONE,
+	PREFETCH_LOADING,
+	PREFETCH_READY,
+	PREFETCH_FAILED,
+	PREFETCH_USED
+} prefetchState_t;
+
+typedef qboolean (*prefetchValidate_t)( const byte *data, int length );
+
+qboolean FS_PrefetchFile( const char *qpath, prefetchValidate_t validate, qboolean keep );
+// starts reading of a pk3 file in background, FS_ReadFile will return
+// its contents if it's kept and the file is still in the same pk3 by that time
+
+prefetchState_t FS_PrefetchState( const char *qpath, int *savedMsec );
+void	FS_CancelPrefetch( void );
+qboolean FS_PrefetchedChecksum( const void *buffer, unsigned *checksum );
+// Com_BlockChecksum of a FS_ReadFile buffer if it was computed in background
+
 void	FS_WriteFile( const char *qpath, const void *buffer, int size );
 // writes a complete file, creating any subdirectories needed
 
@@ -874,6 +939,7 @@ int		FS_FTell( fileHandle_t f );
 // where are we?
 
 void	FS_Flush( fileHandle_t f );
+FILE	*FS_FileStream( fileHandle_t f );
 
 void 	QDECL FS_Printf( fileHandle_t f, const char *fmt, ... ) __attribute__ ((format (printf, 2, 3)));
 // like fprintf
@@ -1407,6 +1473,44 @@ void *Sys_LoadFunction( void *handle, const char *name );
 int   Sys_LoadFunctionErrors( void );
 void  Sys_UnloadLibrary( void *handle );
 
+// background threads, only used for work that must not stall the frame:
+// thread functions may not touch Zone/Hunk memory, cvars or the filesystem
+void	*Sys_CreateThread( void (*func)( void *param ), void *param );
+void	Sys_JoinThread( void *thread );
+int		Sys_NumCPUs( void );
+
+void	*Sys_CreateMutex( void );
+void	Sys_DestroyMutex( void *mutex );
+void	Sys_LockMutex( void *mutex );
+void	Sys_UnlockMutex( void *mutex );
+
+// auto-reset events, Sys_WaitSignal() returns qfalse on timeout
+void	*Sys_CreateSignal( void );
+void	Sys_DestroySignal( void *signal );
+void	Sys_RaiseSignal( void *signal );
+qboolean Sys_WaitSignal( void *signal, int msec );
+
+// read-only file mappings, may be used from background threads,
+// files must be replaced by rename rather than rewritten while mapped
+const void *Sys_MapFile( const char *ospath, fileOffset_t *size );
+void	Sys_UnmapFile( const void *data, fileOffset_t size );
+// private copy-on-write view of a part of the file
+void	*Sys_MapFileRange( const char *ospath, fileOffset_t offset, int length );
+void	Sys_UnmapFileRange( void *data, int length );
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define Sys_AtomicLoad( p )				_InterlockedOr( (volatile long *)(p), 0 )
+#define Sys_AtomicStore( p, v )			(void)_InterlockedExchange( (volatile long *)(p), (v) )
+#define Sys_AtomicAdd( p, v )			_InterlockedExchangeAdd( (volatile long *)(p), (v) )
+#define Sys_AtomicCAS( p, o, n )		( _InterlockedCompareExchange( (volatile long *)(p), (n), (o) ) == (o) )
+#else
+#define Sys_AtomicLoad( p )				__atomic_load_n( (p), __ATOMIC_ACQUIRE )
+#define Sys_AtomicStore( p, v )			__atomic_store_n( (p), (v), __ATOMIC_RELEASE )
+#define Sys_AtomicAdd( p, v )			__atomic_fetch_add( (p), (v), __ATOMIC_ACQ_REL )
+#define Sys_AtomicCAS( p, o, n )		__sync_bool_compare_and_swap( (p), (o), (n) )
+#endif
+
 // adaptive huffman functions
 void Huff_Compress( msg_t *buf, int offset );
 void Huff_Decompress( msg_t *buf, int offset );
@@ -1416,6 +1520,8 @@ void HuffmanPutBit( byte* fout, int32_t bitIndex, int bit );
 int HuffmanPutSymbol( byte* fout, uint32_t offset, int symbol );
 int HuffmanGetBit( const byte* buffer, int bitIndex );
 int HuffmanGetSymbol( unsigned int* symbol, const byte* buffer, int bitIndex );
+int HuffmanPutBits( byte* fout, int32_t bitIndex, uint32_t value, int rawBits, int numSymbols );
+int HuffmanGetBits( uint32_t* value, const byte* buffer, int bitIndex, int rawBits, int numSymbols );
 
 #define	SV_ENCODE_START		4
 #define	SV_DECODE_START		12
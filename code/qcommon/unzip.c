@@ -1328,12 +1328,13 @@ extern unzFile unzReOpen (const char* path, unzFile file)
      Else, the return value is a unzFile Handle, usable with other function
 	   of this unzip package.
 */
-extern unzFile unzOpen (const char* path)
+/*
+  Locate and read the end of central directory record,
+  fills global info and central directory position in *us
+*/
+static int unzlocal_ReadGlobalInfo( FILE *fin, unz_s *us )
 {
-	unz_s us;
-	unz_s *s;
 	uLong central_pos,uL;
-	FILE * fin ;
 
 	uLong number_disk;          /* number of the current dist, used for 
 								   spaning ZIP, unsupported, always 0*/
@@ -1345,10 +1346,6 @@ extern unzFile unzOpen (const char* path)
 
 	int err=UNZ_OK;
 
-    fin=F_OPEN(path,"rb");
-	if (fin==NULL)
-		return NULL;
-
 	central_pos = unzlocal_SearchCentralDir(fin);
 	if (central_pos==0)
 		err=UNZ_ERRNO;
@@ -1369,45 +1366,63 @@ extern unzFile unzOpen (const char* path)
 		err=UNZ_ERRNO;
 
 	/* total number of entries in the central dir on this disk */
-	if (unzlocal_getShort(fin,&us.gi.number_entry)!=UNZ_OK)
+	if (unzlocal_getShort(fin,&us->gi.number_entry)!=UNZ_OK)
 		err=UNZ_ERRNO;
 
 	/* total number of entries in the central dir */
 	if (unzlocal_getShort(fin,&number_entry_CD)!=UNZ_OK)
 		err=UNZ_ERRNO;
 
-	if ((number_entry_CD!=us.gi.number_entry) ||
+	if ((number_entry_CD!=us->gi.number_entry) ||
 		(number_disk_with_CD!=0) ||
 		(number_disk!=0))
 		err=UNZ_BADZIPFILE;
 
 	/* size of the central directory */
-	if (unzlocal_getLong(fin,&us.size_central_dir)!=UNZ_OK)
+	if (unzlocal_getLong(fin,&us->size_central_dir)!=UNZ_OK)
 		err=UNZ_ERRNO;
 
 	/* offset of start of central directory with respect to the 
 	      starting disk number */
-	if (unzlocal_getLong(fin,&us.offset_central_dir)!=UNZ_OK)
+	if (unzlocal_getLong(fin,&us->offset_central_dir)!=UNZ_OK)
 		err=UNZ_ERRNO;
 
 	/* zipfile comment length */
-	if (unzlocal_getShort(fin,&us.gi.size_comment)!=UNZ_OK)
+	if (unzlocal_getShort(fin,&us->gi.size_comment)!=UNZ_OK)
 		err=UNZ_ERRNO;
 
-	if ((central_pos<us.offset_central_dir+us.size_central_dir) && 
+	if ((central_pos<us->offset_central_dir+us->size_central_dir) && 
 		(err==UNZ_OK))
 		err=UNZ_BADZIPFILE;
 
 	if (err!=UNZ_OK)
+		return err;
+
+	us->byte_before_the_zipfile = central_pos -
+		                    (us->offset_central_dir+us->size_central_dir);
+	us->central_pos = central_pos;
+
+	return UNZ_OK;
+}
+
+
+extern unzFile unzOpen (const char* path)
+{
+	unz_s us;
+	unz_s *s;
+	FILE * fin ;
+
+    fin=F_OPEN(path,"rb");
+	if (fin==NULL)
+		return NULL;
+
+	if (unzlocal_ReadGlobalInfo(fin,&us)!=UNZ_OK)
 	{
 		fclose(fin);
 		return NULL;
 	}
 
 	us.file=fin;
-	us.byte_before_the_zipfile = central_pos -
-		                    (us.offset_central_dir+us.size_central_dir);
-	us.central_pos = central_pos;
     us.pfile_in_zip_read = NULL;
 	
 	s=(unz_s*)ALLOC(sizeof(unz_s));
@@ -1472,6 +1487,30 @@ static void unzlocal_DosDateToTmuDate (uLong ulDosDate, tm_unz* ptm)
 /*
   Get Info about the current file in the zipfile, with internal only info
 */
+/*
+  Decode a central directory file header, signature is checked by the caller
+*/
+static void unzlocal_ParseFileInfo( const byte *buf, unz_file_info *pfile_info, unz_file_info_internal *pfile_info_internal )
+{
+	pfile_info->version = LittleShort( *(short*)(buf+4) );
+	pfile_info->version_needed  = LittleShort( *(short*)(buf+6) );
+	pfile_info->flag = LittleShort( *(short*)(buf+8) );
+	pfile_info->compression_method = LittleShort( *(short*)(buf+10) );
+	pfile_info->dosDate = LittleLong( *(int*)(buf+12) );
+	unzlocal_DosDateToTmuDate( pfile_info->dosDate, &pfile_info->tmu_date );
+	pfile_info->crc = LittleLong( *(int*)(buf+16) );
+	pfile_info->compressed_size = LittleLong( *(int*)(buf+20) );
+	pfile_info->uncompressed_size = LittleLong( *(int*)(buf+24) );
+	pfile_info->size_filename = LittleShort( *(short*)(buf+28) );
+	pfile_info->size_file_extra = LittleShort( *(short*)(buf+30) );
+	pfile_info->size_file_comment = LittleShort( *(short*)(buf+32) );
+	pfile_info->disk_num_start = LittleShort( *(short*)(buf+34) );
+	pfile_info->internal_fa = LittleShort( *(short*)(buf+36) );
+	pfile_info->external_fa = LittleLong( *(int*)(buf+38) );
+	pfile_info_internal->offset_curfile = LittleLong( *(int*)(buf+42) );
+}
+
+
 static int unzlocal_GetCurrentFileInfoInternal (unzFile file,
                                                   unz_file_info *pfile_info,
                                                   unz_file_info_internal 
@@ -1506,22 +1545,7 @@ static int unzlocal_GetCurrentFileInfoInternal (unzFile file,
 	//	return UNZ_BADZIPFILE;
 	if ( memcmp( buf, "\x50\x4b\x01\x02", 4 ) != 0 )
 		return UNZ_BADZIPFILE;
-	file_info.version = LittleShort( *(short*)(buf+4) );
-	file_info.version_needed  = LittleShort( *(short*)(buf+6) );
-	file_info.flag = LittleShort( *(short*)(buf+8) );
-	file_info.compression_method = LittleShort( *(short*)(buf+10) );
-	file_info.dosDate = LittleLong( *(int*)(buf+12) );
-	unzlocal_DosDateToTmuDate( file_info.dosDate, &file_info.tmu_date );
-	file_info.crc = LittleLong( *(int*)(buf+16) );
-	file_info.compressed_size = LittleLong( *(int*)(buf+20) );
-	file_info.uncompressed_size = LittleLong( *(int*)(buf+24) );
-	file_info.size_filename = LittleShort( *(short*)(buf+28) );
-	file_info.size_file_extra = LittleShort( *(short*)(buf+30) );
-	file_info.size_file_comment = LittleShort( *(short*)(buf+32) );
-	file_info.disk_num_start = LittleShort( *(short*)(buf+34) );
-	file_info.internal_fa = LittleShort( *(short*)(buf+36) );
-	file_info.external_fa = LittleLong( *(int*)(buf+38) );
-	file_info_internal.offset_curfile = LittleLong( *(int*)(buf+42) );
+	unzlocal_ParseFileInfo( buf, &file_info, &file_info_internal );
 #else
 
 	/* we check the magic */
@@ -1675,6 +1699,119 @@ extern int unzGetCurrentFileInfo (	unzFile file, unz_file_info *pfile_info,
 												szComment,commentBufferSize);
 }
 
+/*
+  Read the whole central directory of a zipfile into one malloc'ed block,
+  doesn't touch zone memory so it may be called from background threads
+*/
+extern unz_central_dir *unzReadCentralDir (const char *path)
+{
+	unz_s us;
+	unz_central_dir *cd;
+	uLong start, size_file;
+	FILE *fin;
+
+	fin=F_OPEN(path,"rb");
+	if (fin==NULL)
+		return NULL;
+
+	if (unzlocal_ReadGlobalInfo(fin,&us)!=UNZ_OK || fseek(fin,0,SEEK_END)!=0)
+	{
+		fclose(fin);
+		return NULL;
+	}
+
+	// keep everything up to the end of file, as unzGetCurrentFileInfo() would read it
+	start = us.offset_central_dir + us.byte_before_the_zipfile;
+	size_file = ftell(fin);
+
+	cd = (unz_central_dir*)malloc(sizeof(*cd) + size_file - start);
+	if (cd==NULL)
+	{
+		fclose(fin);
+		return NULL;
+	}
+
+	cd->gi = us.gi;
+	cd->offset_central_dir = us.offset_central_dir;
+	cd->size = size_file - start;
+	cd->data = (unsigned char*)(cd + 1);
+
+	if (fseek(fin,start,SEEK_SET)!=0 || (cd->size && fread(cd->data,cd->size,1,fin)!=1))
+	{
+		free(cd);
+		fclose(fin);
+		return NULL;
+	}
+
+	fclose(fin);
+	return cd;
+}
+
+
+extern void unzFreeCentralDir (unz_central_dir *cd)
+{
+	free(cd);
+}
+
+
+/*
+  Same as unzGetCurrentFileInfo() for the file at pos (absolute position in
+  the central directory, unzGetCurrentFileInfoPosition() compatible)
+*/
+extern int unzGetCentralDirFileInfo (const unz_central_dir *cd, unsigned long pos,
+                                     unz_file_info *pfile_info,
+                                     char *szFileName, unsigned long fileNameBufferSize)
+{
+	unz_file_info file_info;
+	unz_file_info_internal file_info_internal;
+	const byte *buf;
+	uLong offset, uSizeRead;
+
+	offset = pos - cd->offset_central_dir;
+	if (pos < cd->offset_central_dir || offset >= cd->size || cd->size - offset < SIZECENTRALDIRITEM)
+		return UNZ_ERRNO;
+
+	buf = cd->data + offset;
+	if ( memcmp( buf, "\x50\x4b\x01\x02", 4 ) != 0 )
+		return UNZ_BADZIPFILE;
+
+	unzlocal_ParseFileInfo( buf, &file_info, &file_info_internal );
+
+	if (szFileName!=NULL)
+	{
+		if (file_info.size_filename<fileNameBufferSize)
+		{
+			*(szFileName+file_info.size_filename)='\0';
+			uSizeRead = file_info.size_filename;
+		}
+		else
+			uSizeRead = fileNameBufferSize;
+
+		if ((file_info.size_filename>0) && (fileNameBufferSize>0))
+		{
+			if (cd->size - offset - SIZECENTRALDIRITEM < uSizeRead)
+				return UNZ_ERRNO;
+			Com_Memcpy( szFileName, buf + SIZECENTRALDIRITEM, uSizeRead );
+		}
+	}
+
+	if (pfile_info!=NULL)
+		*pfile_info=file_info;
+
+	return UNZ_OK;
+}
+
+
+/*
+  Position of the file following the one described by pfile_info
+*/
+extern unsigned long unzNextCentralDirFile (unsigned long pos, const unz_file_info *pfile_info)
+{
+	return pos + SIZECENTRALDIRITEM + pfile_info->size_filename +
+			pfile_info->size_file_extra + pfile_info->size_file_comment;
+}
+
+
 /*
   Set the current file of the zipfile to the first file.
   return UNZ_OK if there is no problem
@@ -2168,6 +2305,165 @@ extern int unzeof (unzFile file)
 }
 
 
+/*
+  Give the absolute offset of the data of the current stored file
+*/
+extern long unzGetStoredDataOffset (unzFile file)
+{
+	unz_s* s;
+	file_in_zip_read_info_s* pfile_in_zip_read_info;
+	if (file==NULL)
+		return UNZ_PARAMERROR;
+	s=(unz_s*)file;
+    pfile_in_zip_read_info=s->pfile_in_zip_read;
+
+	if (pfile_in_zip_read_info==NULL)
+		return UNZ_PARAMERROR;
+
+	if (pfile_in_zip_read_info->compression_method!=0 ||
+		pfile_in_zip_read_info->stream.total_out!=0 ||
+		pfile_in_zip_read_info->rest_read_compressed!=pfile_in_zip_read_info->rest_read_uncompressed)
+		return UNZ_PARAMERROR;
+
+	return (long)(pfile_in_zip_read_info->pos_in_zipfile +
+				  pfile_in_zip_read_info->byte_before_the_zipfile);
+}
+
+
+/*
+  Describe the current file so it can be read with unzReadFileData()
+*/
+extern int unzGetCurrentFileData (unzFile file, unz_file_data *pfile_data)
+{
+	unz_s* s;
+	if (file==NULL)
+		return UNZ_PARAMERROR;
+	s=(unz_s*)file;
+	if (!s->current_file_ok)
+		return UNZ_END_OF_LIST_OF_FILE;
+
+	pfile_data->offset_local_header = s->cur_file_info_internal.offset_curfile +
+									  s->byte_before_the_zipfile;
+	pfile_data->compression_method = s->cur_file_info.compression_method;
+	pfile_data->compressed_size = s->cur_file_info.compressed_size;
+	pfile_data->uncompressed_size = s->cur_file_info.uncompressed_size;
+
+	return UNZ_OK;
+}
+
+
+static void *unzlocal_malloc (void *opaque, unsigned items, unsigned size)
+{
+	return malloc(items*size);
+}
+
+
+static void unzlocal_free (void *opaque, void *ptr)
+{
+	free(ptr);
+}
+
+
+/*
+  Read and uncompress a whole file, thread-safe
+*/
+extern int unzReadFileData (const char *path, const unz_file_data *pfile_data, void *buf)
+{
+	unsigned char header[SIZEZIPLOCALHEADER];
+	unsigned char *compressed;
+	z_stream stream;
+	uLong offset;
+	FILE *fin;
+	int err;
+
+	if (pfile_data->compression_method!=0 &&
+		pfile_data->compression_method!=Z_DEFLATED)
+		return UNZ_BADZIPFILE;
+
+	fin=fopen(path,"rb");
+	if (fin==NULL)
+		return UNZ_ERRNO;
+
+	if (fseek(fin,pfile_data->offset_local_header,SEEK_SET)!=0 ||
+		fread(header,1,sizeof(header),fin)!=sizeof(header))
+	{
+		fclose(fin);
+		return UNZ_ERRNO;
+	}
+
+	if (LittleLong(*(unsigned*)header)!=0x04034b50)
+	{
+		fclose(fin);
+		return UNZ_BADZIPFILE;
+	}
+
+	// skip file name and extra field
+	offset = pfile_data->offset_local_header + SIZEZIPLOCALHEADER +
+			 (unsigned short)LittleShort(*(short*)(header+26)) +
+			 (unsigned short)LittleShort(*(short*)(header+28));
+
+	if (fseek(fin,offset,SEEK_SET)!=0)
+	{
+		fclose(fin);
+		return UNZ_ERRNO;
+	}
+
+	if (pfile_data->compression_method==0)
+	{
+		err = fread(buf,1,pfile_data->uncompressed_size,fin)==pfile_data->uncompressed_size ? UNZ_OK : UNZ_ERRNO;
+		fclose(fin);
+		return err;
+	}
+
+	// inflate requires an extra dummy byte after the compressed stream
+	compressed=(unsigned char*)malloc(pfile_data->compressed_size+1);
+	if (compressed==NULL)
+	{
+		fclose(fin);
+		return UNZ_INTERNALERROR;
+	}
+
+	if (fread(compressed,1,pfile_data->compressed_size,fin)!=pfile_data->compressed_size)
+	{
+		free(compressed);
+		fclose(fin);
+		return UNZ_ERRNO;
+	}
+	compressed[pfile_data->compressed_size]=0;
+	fclose(fin);
+
+	memset(&stream,0,sizeof(stream));
+	stream.zalloc = unzlocal_malloc;
+	stream.zfree = unzlocal_free;
+
+	err=inflateInit2(&stream,-MAX_WBITS);
+	if (err!=Z_OK)
+	{
+		free(compressed);
+		return UNZ_INTERNALERROR;
+	}
+
+	stream.next_in = compressed;
+	stream.avail_in = (uInt)pfile_data->compressed_size+1;
+	stream.next_out = (Byte*)buf;
+	stream.avail_out = (uInt)pfile_data->uncompressed_size;
+
+	do {
+		err=inflate(&stream,Z_SYNC_FLUSH);
+	} while (err==Z_OK && stream.avail_out!=0);
+
+	if (stream.total_out!=pfile_data->uncompressed_size)
+		err=UNZ_BADZIPFILE;
+	else
+		err=UNZ_OK;
+
+	inflateEnd(&stream);
+	free(compressed);
+
+	return err;
+}
+
+
 
 /*
   Read extra field from the current file (opened by unzOpenCurrentFile)
@@ -199,6 +199,35 @@ extern int unzClose (unzFile file);
     these files MUST be closed with unzipCloseCurrentFile before call unzipClose.
   return UNZ_OK if there is no problem. */
 
+/* central directory snapshot, see unzReadCentralDir() */
+typedef struct unz_central_dir_s
+{
+	unz_global_info gi;
+	unsigned long offset_central_dir;   /* absolute position of data[0] in the central dir */
+	unsigned long size;
+	unsigned char *data;                /* central dir up to the end of file */
+} unz_central_dir;
+
+extern unz_central_dir *unzReadCentralDir (const char *path);
+extern void unzFreeCentralDir (unz_central_dir *cd);
+
+/*
+  Read the whole central directory of a zipfile in one go, without any zone
+  allocations, so it may be called from background threads. Release it with
+  unzFreeCentralDir(). Returns NULL if the zipfile cannot be opened or is not valid.
+*/
+
+extern int unzGetCentralDirFileInfo (const unz_central_dir *cd, unsigned long pos,
+                                     unz_file_info *pfile_info,
+                                     char *szFileName, unsigned long fileNameBufferSize);
+extern unsigned long unzNextCentralDirFile (unsigned long pos, const unz_file_info *pfile_info);
+
+/*
+  Walk a central directory snapshot: the first file is at cd->offset_central_dir,
+  unzGetCentralDirFileInfo() behaves like unzGetCurrentFileInfo() and positions
+  are compatible with unzGetCurrentFileInfoPosition()
+*/
+
 extern int unzGetGlobalInfo (unzFile file, unz_global_info *pglobal_info);
 
 /*
@@ -320,6 +349,34 @@ extern int unzeof (unzFile file);
   return 1 if the end of file was reached, 0 elsewhere 
 */
 
+extern long unzGetStoredDataOffset (unzFile file);
+
+/*
+  Give the absolute offset of the data of the current file (opened by
+    unzOpenCurrentFile) in the zipfile, so it can be accessed directly
+  return <0 if the file is compressed or some data was already read
+*/
+
+/* location of a file in the zipfile, see unzGetCurrentFileData() */
+typedef struct unz_file_data_s
+{
+	unsigned long offset_local_header;  /* absolute position of the local header */
+	unsigned long compression_method;
+	unsigned long compressed_size;
+	unsigned long uncompressed_size;
+} unz_file_data;
+
+extern int unzGetCurrentFileData (unzFile file, unz_file_data *pfile_data);
+extern int unzReadFileData (const char *path, const unz_file_data *pfile_data, void *buf);
+
+/*
+  unzGetCurrentFileData() describes the current file of the zipfile,
+  unzReadFileData() then reads and uncompresses pfile_data->uncompressed_size
+    bytes of it into buf without any zone allocations, so it may be called
+    from background threads.
+  return UNZ_OK if there is no problem
+*/
+
 extern int unzGetLocalExtrafield (unzFile file, void* buf, unsigned len);
 
 /*
@@ -204,6 +204,8 @@ const char *opname[ 256 ] = {
 };
 
 cvar_t	*vm_rtChecks;
+cvar_t	*vm_optimize;
+cvar_t	*vm_profile;
 
 #ifdef DEBUG
 int		vm_debugLevel;
@@ -214,6 +216,18 @@ static int forced_unload;
 
 static struct vm_s vmTable[ VM_COUNT ];
 
+static const vmDirectCall_t *vmDirectCalls[ VM_COUNT ];
+static int vmNumDirectCalls[ VM_COUNT ];
+
+// cycles per call saved by "vmprofile <vm> baseline"
+typedef struct {
+	uint32_t	crc32sum;
+	int			numProfile;
+	double		*cyclesPerCall;
+} vmProfileBase_t;
+
+static vmProfileBase_t vmProfileBase[ VM_COUNT ];
+
 static const char *vmName[ VM_COUNT ] = {
 	"qagame",
 	"cgame",
@@ -282,8 +296,20 @@ void VM_Init( void ) {
 	cv =Cvar_Get( "vm_game", "2", CVAR_ARCHIVE | CVAR_PROTECTED );	// !@# SHIP WITH SET TO 2
     Cvar_SetDescription(cv, "Attempt to load the Game QVM and compile it to native assembly code\n2 - compile VM\n1 - interpreted VM\n0 - native VM using dynamic linking\nDefault: 2");
 
+	vm_optimize = Cvar_Get( "vm_optimize", "0", CVAR_ARCHIVE_ND | CVAR_PROTECTED );
+	Cvar_CheckRange( vm_optimize, "0", "1", CV_INTEGER );
+	Cvar_SetDescription( vm_optimize, "Optimization level of compiled vm code, applied on next vm load:\n"
+		" 0 - registers are flushed on every jump label, all system calls go through the module dispatcher\n"
+		" 1 - keep cached registers across forward jump labels, call hot system calls directly\nDefault: 0" );
+
+	vm_profile = Cvar_Get( "vm_profile", "0", 0 );
+	Cvar_CheckRange( vm_profile, "0", "1", CV_INTEGER );
+	Cvar_SetDescription( vm_profile, "Count calls and cycles of every compiled vm function, see vmprofile\n"
+		"Applied on next vm load\nDefault: 0" );
+
     Cmd_AddCommand( "vmprofile", VM_VmProfile_f );
-    Cmd_SetDescription( "vmprofile", "Show VM profiling information\nusage: vmprofile <game|cgame|ui>" );
+    Cmd_SetDescription( "vmprofile", "Show VM profiling information, with 'baseline' remember cycles per call\n"
+		"to compare the next report against\nusage: vmprofile <game|cgame|ui> [baseline]" );
 
     Cmd_AddCommand( "vminfo", VM_VmInfo_f );
     Cmd_SetDescription( "vminfo", "Show VM information\nusage: vminfo" );
@@ -1734,6 +1760,82 @@ static void * QDECL VM_LoadDll( const char *name, dllSyscall_t *entryPoint, dllS
 }
 
 
+/*
+================
+VM_SetDirectCalls
+
+Registers system calls which compiled code may call without going
+through the module dispatcher, takes effect on next VM_Create()
+================
+*/
+void VM_SetDirectCalls( vmIndex_t index, const vmDirectCall_t *calls, int numCalls ) {
+
+	if ( (unsigned)index >= VM_COUNT ) {
+		Com_Error( ERR_DROP, "VM_SetDirectCalls: bad vm index %i", index );
+	}
+
+	if ( numCalls > MAX_VM_DIRECT_CALLS ) {
+		Com_Error( ERR_DROP, "VM_SetDirectCalls: too many calls (%i > %i)", numCalls, MAX_VM_DIRECT_CALLS );
+	}
+
+	vmDirectCalls[ index ] = calls;
+	vmNumDirectCalls[ index ] = numCalls;
+}
+
+
+/*
+================
+VM_FindDirectCall
+
+Returns vm->callTable slot of the handler, 0 for regular dispatch
+================
+*/
+int VM_FindDirectCall( const vm_t *vm, int callNum ) {
+	int i;
+
+	if ( !vm_optimize->integer ) {
+		return 0;
+	}
+
+	for ( i = 0; i < vm->numDirectCalls; i++ ) {
+		if ( vm->directCalls[ i ].callNum == callNum ) {
+			return i + 1;
+		}
+	}
+
+	return 0;
+}
+
+
+/*
+================
+VM_AllocProfile
+
+Allocates per-function counters for instrumented compiled code
+================
+*/
+vmProfile_t *VM_AllocProfile( vm_t *vm, const instruction_t *buf, int instructionCount ) {
+	int i, n;
+
+	for ( i = 0, n = 0; i < instructionCount; i++ ) {
+		if ( buf[i].op == OP_ENTER ) {
+			n++;
+		}
+	}
+
+	vm->profile = Hunk_Alloc( n * sizeof( vmProfile_t ), h_high );
+	vm->numProfile = n;
+
+	for ( i = 0, n = 0; i < instructionCount; i++ ) {
+		if ( buf[i].op == OP_ENTER ) {
+			vm->profile[ n++ ].entry = i;
+		}
+	}
+
+	return vm->profile;
+}
+
+
 /*
 ================
 VM_Create
@@ -1744,6 +1846,7 @@ it will attempt to load as a system dll
 */
 vm_t *VM_Create( vmIndex_t index, syscall_t systemCalls, dllSyscall_t dllSyscalls, vmInterpret_t interpret ) {
 	int			remaining;
+	int			i;
 	const char	*name;
 	vmHeader_t	*header;
 	vm_t		*vm;
@@ -1776,6 +1879,13 @@ vm_t *VM_Create( vmIndex_t index, syscall_t systemCalls, dllSyscall_t dllSyscall
 	vm->systemCall = systemCalls;
 	vm->dllSyscall = dllSyscalls;
 	vm->privateFlag = CVAR_PRIVATE;
+	vm->directCalls = vmDirectCalls[ index ];
+	vm->numDirectCalls = vmNumDirectCalls[ index ];
+
+	vm->callTable[ 0 ] = systemCalls;
+	for ( i = 0; i < vm->numDirectCalls; i++ ) {
+		vm->callTable[ i + 1 ] = vm->directCalls[ i ].func;
+	}
 
 	// never allow dll loading with a demo
 	if ( interpret == VMI_NATIVE ) {
@@ -2049,6 +2159,104 @@ static vm_t *VM_NameToVM( const char *name )
 }
 
 
+static int QDECL VM_ProfileCyclesSort( const void *a, const void *b ) {
+	const vmProfile_t *pa, *pb;
+
+	pa = *(const vmProfile_t **)a;
+	pb = *(const vmProfile_t **)b;
+
+	if ( pa->cycles < pb->cycles ) {
+		return -1;
+	}
+	if ( pa->cycles > pb->cycles ) {
+		return 1;
+	}
+	return 0;
+}
+
+
+/*
+==============
+VM_FunctionProfile
+
+Prints counters of instrumented compiled functions, the most expensive last
+==============
+*/
+static void VM_FunctionProfile( vm_t *vm, qboolean baseline ) {
+	vmProfileBase_t *base;
+	vmProfile_t	**sorted, *prof;
+	const char	*name;
+	double		total, perCall;
+	int			i, n;
+
+	base = &vmProfileBase[ vm->index ];
+	if ( base->cyclesPerCall && ( base->crc32sum != vm->crc32sum || base->numProfile != vm->numProfile ) ) {
+		// baseline was taken from a different image
+		Z_Free( base->cyclesPerCall );
+		Com_Memset( base, 0, sizeof( *base ) );
+	}
+
+	if ( baseline ) {
+		if ( !base->cyclesPerCall ) {
+			base->cyclesPerCall = Z_Malloc( vm->numProfile * sizeof( double ) );
+			base->numProfile = vm->numProfile;
+			base->crc32sum = vm->crc32sum;
+		}
+		for ( i = 0; i < vm->numProfile; i++ ) {
+			prof = &vm->profile[ i ];
+			base->cyclesPerCall[ i ] = prof->calls ? (double)prof->cycles / prof->calls : 0.0;
+		}
+	}
+
+	sorted = Z_Malloc( vm->numProfile * sizeof( *sorted ) );
+	total = 0.0;
+	for ( i = 0, n = 0; i < vm->numProfile; i++ ) {
+		if ( vm->profile[ i ].calls ) {
+			sorted[ n++ ] = &vm->profile[ i ];
+		}
+		// only top-level vmMain calls are not nested into other functions
+		if ( vm->profile[ i ].entry == 0 ) {
+			total += vm->profile[ i ].cycles;
+		}
+	}
+
+	qsort( sorted, n, sizeof( *sorted ), VM_ProfileCyclesSort );
+
+	Com_Printf( "  %%      calls    kcycles  cycles/call  speedup  function\n" );
+
+	for ( i = 0; i < n; i++ ) {
+		prof = sorted[ i ];
+		perCall = (double)prof->cycles / prof->calls;
+
+		if ( vm->symbols ) {
+			name = VM_ValueToSymbol( vm, prof->entry );
+		} else {
+			name = va( "sub_%i", prof->entry );
+		}
+
+		Com_Printf( "%3i %10llu %10llu %12.1f ", total > 0.0 ? (int)( 100.0 * prof->cycles / total ) : 0,
+			(unsigned long long) prof->calls, (unsigned long long)( prof->cycles / 1000 ), perCall );
+
+		if ( !baseline && base->cyclesPerCall && base->cyclesPerCall[ prof - vm->profile ] > 0.0 ) {
+			Com_Printf( "%7.2fx  %s\n", base->cyclesPerCall[ prof - vm->profile ] / perCall, name );
+		} else {
+			Com_Printf( "%8s  %s\n", "-", name );
+		}
+
+		prof->cycles = 0;
+		prof->calls = 0;
+	}
+
+	Com_Printf( "    %10.0f kcycles in vmMain\n", total / 1000.0 );
+
+	if ( baseline ) {
+		Com_Printf( "baseline saved for %i functions\n", n );
+	}
+
+	Z_Free( sorted );
+}
+
+
 /*
 ==============
 VM_VmProfile_f
@@ -2062,7 +2270,7 @@ static void VM_VmProfile_f( void ) {
 	double		total;
 
 	if ( Cmd_Argc() < 2 ) {
-		Com_Printf( "usage: %s <game|cgame|ui>\n", Cmd_Argv( 0 ) );
+		Com_Printf( "usage: %s <game|cgame|ui> [baseline]\n", Cmd_Argv( 0 ) );
 		return;
 	}
 
@@ -2071,6 +2279,11 @@ static void VM_VmProfile_f( void ) {
 		return;
 	}
 
+	if ( vm->profile ) {
+		VM_FunctionProfile( vm, !Q_stricmp( Cmd_Argv( 2 ), "baseline" ) );
+		return;
+	}
+
 	if ( !vm->numSymbols ) {
 		return;
 	}
@@ -54,6 +54,11 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 #define VM_RTCHECK_JUMP    4
 #define VM_RTCHECK_DATA    8
 
+#define MAX_VM_DIRECT_CALLS 15
+
+extern cvar_t *vm_optimize;
+extern cvar_t *vm_profile;
+
 typedef enum {
 	OP_UNDEF,
 
@@ -162,6 +167,13 @@ typedef struct vmSymbol_s {
 	char	symName[1];		// variable sized
 } vmSymbol_t;
 
+// per-function counters maintained by instrumented compiled code
+typedef struct vmProfile_s {
+	uint64_t	cycles;		// inclusive, in timestamp counter ticks
+	uint64_t	calls;
+	int			entry;		// instruction number of OP_ENTER
+} vmProfile_t;
+
 //typedef void(*vmfunc_t)(void);
 
 typedef union vmFunc_u {
@@ -222,6 +234,13 @@ struct vm_s {
 	qboolean	forceDataMask;
 
 	int			privateFlag;
+
+	const vmDirectCall_t *directCalls;
+	int			numDirectCalls;
+	syscall_t	callTable[ MAX_VM_DIRECT_CALLS + 1 ]; // [0] is systemCall
+
+	vmProfile_t	*profile;
+	int			numProfile;
 };
 
 qboolean VM_Compile( vm_t *vm, vmHeader_t *header );
@@ -234,6 +253,8 @@ vmSymbol_t *VM_ValueToFunctionSymbol( vm_t *vm, int value );
 int VM_SymbolToValue( vm_t *vm, const char *symbol );
 const char *VM_ValueToSymbol( vm_t *vm, int value );
 void VM_LogSyscalls( int *args );
+int VM_FindDirectCall( const vm_t *vm, int callNum );
+vmProfile_t *VM_AllocProfile( vm_t *vm, const instruction_t *buf, int instructionCount );
 
 const char *VM_LoadInstructions( const byte *code_pos, int codeLength, int instructionCount, instruction_t *buf );
 const char *VM_CheckInstructions( instruction_t *buf, int instructionCount,
@@ -73,6 +73,7 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 #define CONST_CACHE_SX
 
 #define REGS_OPTIMIZE
+#define BLOCK_OPTIMIZE // keep cached registers across forward jump labels
 #define ADDR_OPTIMIZE
 #define LOAD_OPTIMIZE
 #define FPU_OPTIMIZE
@@ -122,7 +123,7 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
   r10   scratch
   r11   scratch - dataMask
   r12*  instructionPointers
-  r13*  systemCall
+  r13*  callTable ( systemCall, then direct handlers )
   r14*  stackBottom
   r15*  opStackTop
   xmm0  scratch
@@ -173,6 +174,7 @@ typedef enum
 	FUNC_ENTR = 0,
 	FUNC_CALL,
 	FUNC_SYSC,
+	FUNC_SYSD,
 	FUNC_BCPY,
 	FUNC_PSOF,
 	FUNC_OSOF,
@@ -2374,6 +2376,229 @@ static void flush_opstack( void )
 }
 
 
+#ifdef BLOCK_OPTIMIZE
+/*
+  Registers are normally wiped on every jump label as the label may be reached
+  from different places, but labels reached only by forward jumps with known
+  (direct) targets plus fall-through can start with the common part of all
+  incoming register states instead.
+*/
+
+#define MAX_LABEL_STATES 32
+
+typedef struct label_state_s {
+	reg_t rx[NUM_RX_REGS];
+	reg_t sx[NUM_SX_REGS];
+	int32_t target;	// label instruction, -1 for unused slot
+	int32_t count;	// number of merged jumps
+} label_state_t;
+
+static label_state_t labelStates[ MAX_LABEL_STATES ];
+static int32_t *labelJumps; // expected number of forward jumps to each instruction, -1 if unknown
+static int32_t inst_ip;     // first instruction of currently compiled sequence
+static qboolean blockOptimize;
+
+
+static void init_label_states( void )
+{
+	int i;
+
+	for ( i = 0; i < ARRAY_LEN( labelStates ); i++ ) {
+		labelStates[i].target = -1;
+	}
+}
+
+
+static label_state_t *find_label_state( int32_t target )
+{
+	int i;
+
+	for ( i = 0; i < ARRAY_LEN( labelStates ); i++ ) {
+		if ( labelStates[i].target == target ) {
+			return &labelStates[i];
+		}
+	}
+
+	return NULL;
+}
+
+
+static void merge_reg( reg_t *r, const reg_t *s )
+{
+	uint32_t i, n, c;
+
+	if ( r->type_mask & RTYPE_CONST ) {
+		if ( !( s->type_mask & RTYPE_CONST ) || s->cnst.value != r->cnst.value ) {
+			r->type_mask &= ~RTYPE_CONST;
+			r->cnst.value = 0;
+		}
+	}
+
+	if ( r->type_mask & RTYPE_VAR ) {
+		for ( c = 0, i = 0; i < ARRAY_LEN( r->vars.map ); i++ ) {
+			var_addr_t *var = &r->vars.map[i];
+			if ( var->size == 0 )
+				continue;
+			if ( s->type_mask & RTYPE_VAR ) {
+				for ( n = 0; n < ARRAY_LEN( s->vars.map ); n++ ) {
+					if ( s->vars.map[n].size == var->size && s->vars.map[n].addr == var->addr && s->vars.map[n].base == var->base ) {
+						break;
+					}
+				}
+				if ( n < ARRAY_LEN( s->vars.map ) ) {
+					c++;
+					continue;
+				}
+			}
+			memset( var, 0, sizeof( *var ) );
+		}
+		if ( c == 0 ) {
+			r->type_mask &= ~RTYPE_VAR;
+		}
+	}
+
+	if ( r->ext != s->ext ) {
+		r->ext = Z_NONE;
+	}
+
+	if ( r->type_mask == RTYPE_UNUSED ) {
+		memset( r, 0, sizeof( *r ) );
+	}
+}
+
+
+/*
+==============
+save_label_state
+
+merge current register state into the state of forward jump target
+==============
+*/
+static void save_label_state( const instruction_t *i, int32_t target )
+{
+	label_state_t *ls;
+	uint32_t n;
+
+	if ( !blockOptimize || i->op == OP_LEAVE || target <= inst_ip || labelJumps[ target ] <= 0 ) {
+		return;
+	}
+
+	ls = find_label_state( target );
+	if ( ls == NULL ) {
+		ls = find_label_state( -1 );
+		if ( ls == NULL ) {
+			// no free slots, target will be wiped due to missing jump
+			return;
+		}
+		ls->target = target;
+		ls->count = 0;
+	}
+
+	if ( opstack != 0 ) {
+		// should never happen with lcc-generated code
+		Com_Memset( ls->rx, 0, sizeof( ls->rx ) );
+		Com_Memset( ls->sx, 0, sizeof( ls->sx ) );
+	} else if ( ls->count == 0 ) {
+		Com_Memcpy( ls->rx, rx_regs, sizeof( ls->rx ) );
+		Com_Memcpy( ls->sx, sx_regs, sizeof( ls->sx ) );
+	} else {
+		for ( n = 0; n < ARRAY_LEN( rx_regs ); n++ )
+			merge_reg( &ls->rx[n], &rx_regs[n] );
+		for ( n = 0; n < ARRAY_LEN( sx_regs ); n++ )
+			merge_reg( &ls->sx[n], &sx_regs[n] );
+	}
+
+	ls->count++;
+}
+
+
+/*
+==============
+load_label_state
+
+setup register state at jump label, returns qfalse if registers must be wiped
+==============
+*/
+static qboolean load_label_state( const instruction_t *buf, int32_t target )
+{
+	label_state_t *ls;
+	qboolean fallthrough;
+	int32_t prev;
+	uint32_t n;
+
+	if ( !blockOptimize || labelJumps[ target ] <= 0 ) {
+		return qfalse;
+	}
+
+	ls = find_label_state( target );
+	if ( ls == NULL ) {
+		return qfalse;
+	}
+
+	ls->target = -1; // release slot
+
+	if ( ls->count != labelJumps[ target ] || opstack != 0 ) {
+		return qfalse;
+	}
+
+	// check if we can reach label from previous instruction
+	for ( prev = target - 1; prev > 0 && buf[ prev ].op == OP_IGNORE; prev-- )
+		;
+	fallthrough = ( buf[ prev ].op != OP_JUMP && buf[ prev ].op != OP_LEAVE );
+
+	if ( fallthrough ) {
+		for ( n = 0; n < ARRAY_LEN( rx_regs ); n++ )
+			merge_reg( &rx_regs[n], &ls->rx[n] );
+		for ( n = 0; n < ARRAY_LEN( sx_regs ); n++ )
+			merge_reg( &sx_regs[n], &ls->sx[n] );
+	} else {
+		Com_Memcpy( rx_regs, ls->rx, sizeof( rx_regs ) );
+		Com_Memcpy( sx_regs, ls->sx, sizeof( sx_regs ) );
+	}
+
+	return qtrue;
+}
+
+
+/*
+==============
+VM_CountLabelJumps
+
+count direct jumps to each instruction, labels in functions
+with indirect jumps (switch tables) are marked as unknown
+==============
+*/
+static void VM_CountLabelJumps( const instruction_t *buf, int instructionCount, int32_t *jumps )
+{
+	const instruction_t *ci;
+	int i, n, proc;
+
+	Com_Memset( jumps, 0, instructionCount * sizeof( jumps[0] ) );
+
+	for ( i = 0, ci = buf; i < instructionCount; i++, ci++ ) {
+		if ( ops[ ci->op ].flags & JUMP ) {
+			jumps[ ci->value ]++;
+		} else if ( ci->op == OP_JUMP ) {
+			for ( n = i - 1; n > 0 && buf[ n ].op == OP_IGNORE; n-- )
+				;
+			if ( buf[ n ].op == OP_CONST && (unsigned)buf[ n ].value < (unsigned)instructionCount ) {
+				jumps[ buf[ n ].value ]++;
+			}
+		}
+	}
+
+	for ( i = 0, proc = -1; i < instructionCount; i++ ) {
+		if ( buf[ i ].op == OP_ENTER ) {
+			proc = buf[ i ].swtch ? i : -1;
+		}
+		if ( proc != -1 ) {
+			jumps[ i ] = -1;
+		}
+	}
+}
+#endif // BLOCK_OPTIMIZE
+
+
 static void store_rx_opstack( uint32_t reg )
 {
 	opstack_t *it = opstackv + opstack;
@@ -2772,6 +2997,9 @@ static void( *const badDataWritePtr )( void ) = BadDataWrite;
 static void VM_FreeBuffers( void )
 {
 	// should be freed in reversed allocation order
+#ifdef BLOCK_OPTIMIZE
+	Z_Free( labelJumps );
+#endif
 	Z_Free( instructionOffsets );
 	Z_Free( inst );
 }
@@ -2963,6 +3191,10 @@ static void EmitJump( instruction_t *i, int op, int addr )
 	int v, jump_size = 0;
 	qboolean shouldNaNCheck = qfalse;
 
+#ifdef BLOCK_OPTIMIZE
+	save_label_state( i, addr );
+#endif
+
 	v = instructionOffsets[addr] - compiledOfs;
 
 	if ( HasFCOM() ) {
@@ -3143,6 +3375,47 @@ static void emit_CheckProc( vm_t *vm, instruction_t *ins )
 }
 
 
+/*
+=================
+EmitProfileEnter
+
+count function call and save timestamp counter in the reserved
+first 8 bytes of function frame, see layout above
+=================
+*/
+static void EmitProfileEnter( vmProfile_t *prof )
+{
+#if idx64
+	EmitString( "0F 31" );						// rdtsc
+	EmitString( "48 C1 E2 20" );				// shl rdx, 32
+	EmitString( "48 09 D0" );					// or rax, rdx
+	emit_store_rx( R_EAX | R_REX, R_PROCBASE, 0 );	// mov [procBase], rax
+	mov_rx_ptr( R_EDX, prof );					// mov rdx, prof
+	EmitString( "48 83 42 08 01" );				// add qword ptr [rdx+8], 1
+#endif
+}
+
+
+/*
+=================
+EmitProfileLeave
+
+accumulate cycles spent since EmitProfileEnter()
+=================
+*/
+static void EmitProfileLeave( vmProfile_t *prof )
+{
+#if idx64
+	EmitString( "0F 31" );						// rdtsc
+	EmitString( "48 C1 E2 20" );				// shl rdx, 32
+	EmitString( "48 09 D0" );					// or rax, rdx
+	EmitString( "48 2B 45 00" );				// sub rax, [procBase]
+	mov_rx_ptr( R_EDX, prof );					// mov rdx, prof
+	EmitString( "48 01 02" );					// add qword ptr [rdx], rax
+#endif
+}
+
+
 #ifdef _WIN32
 #define SHADOW_BASE 40
 #else // linux/*BSD ABI
@@ -3199,6 +3472,11 @@ static void EmitCallFunc( vm_t *vm )
 	funcOffset[FUNC_SYSC] = compiledOfs;
 
 #if idx64
+	emit_load4( R_R10 | R_REX, R_SYSCALL, 0 );	// mov r10, [r13]
+
+	// direct system calls from ConstOptimize() with handler in r10
+	funcOffset[FUNC_SYSD] = compiledOfs;
+
 	// allocate stack for shadow(win32)+parameters
 	emit_op_rx_imm32( X_SUB, R_ESP | R_REX, SHADOW_BASE + PUSH_STACK + PARAM_STACK ); // sub rsp, 200
 
@@ -3246,7 +3524,7 @@ static void EmitCallFunc( vm_t *vm )
 #endif
 
 	// currentVm->systemCall( param );
-	emit_call_rx( R_SYSCALL );					// call r12
+	emit_call_rx( R_R10 );						// call r10
 
 	// restore registers
 	emit_lea( R_EDX | R_REX, R_ESP, SHADOW_BASE ); // lea rdx, [rsp + SHADOW_BASE]
@@ -3670,14 +3948,23 @@ static qboolean ConstOptimize( vm_t *vm, instruction_t *ci, instruction_t *ni )
 			flush_volatile();
 
 			if ( ci->value < 0 ) { // syscall
+				func_t func = FUNC_SYSC;
+#if idx64
+				int slot = VM_FindDirectCall( vm, ~ci->value );
+				if ( slot ) {
+					// bypass module dispatcher
+					emit_load4( R_R10 | R_REX, R_SYSCALL, slot * sizeof( syscall_t ) ); // mov r10, [r13+slot*8]
+					func = FUNC_SYSD;
+				}
+#endif
 				mask_rx( R_EAX );
 				mov_rx_imm32( R_EAX, ~ci->value ); // eax - syscall number
 				if ( opstack != 1 ) {
 					emit_op_rx_imm32( X_ADD, R_OPSTACK | R_REX, (opstack-1) * sizeof( int32_t ) );
-					EmitCallOffset( FUNC_SYSC );
+					EmitCallOffset( func );
 					emit_op_rx_imm32( X_SUB, R_OPSTACK | R_REX, (opstack-1) * sizeof( int32_t ) );
 				} else {
-					EmitCallOffset( FUNC_SYSC );
+					EmitCallOffset( func );
 				}
 				ip += 1; // OP_CALL
 				store_syscall_opstack();
@@ -3901,9 +4188,14 @@ qboolean VM_Compile( vm_t *vm, vmHeader_t *header ) {
 #if JUMP_OPTIMIZE
 	int num_compress;
 #endif
+	vmProfile_t *prof;
+	int proc_num;
 
 	inst = (instruction_t*)Z_Malloc( (header->instructionCount + 8 ) * sizeof( instruction_t ) );
 	instructionOffsets = (int*)Z_Malloc( header->instructionCount * sizeof( int ) );
+#ifdef BLOCK_OPTIMIZE
+	labelJumps = (int32_t*)Z_Malloc( header->instructionCount * sizeof( int32_t ) );
+#endif
 
 	errMsg = VM_LoadInstructions( (byte *) header + header->codeOffset, header->codeLength, header->instructionCount, inst );
 	if ( !errMsg ) {
@@ -3919,6 +4211,12 @@ qboolean VM_Compile( vm_t *vm, vmHeader_t *header ) {
 
 	VM_FindMOps( inst, vm->instructionCount );
 
+#ifdef BLOCK_OPTIMIZE
+	// x87 compare paths may emit several branches per jump instruction
+	blockOptimize = vm_optimize->integer && HasSSEFP();
+	VM_CountLabelJumps( inst, vm->instructionCount, labelJumps );
+#endif
+
 #if JUMP_OPTIMIZE
 	for ( i = 0; i < header->instructionCount; i++ ) {
 		if ( ops[inst[i].op].flags & JUMP ) {
@@ -3942,6 +4240,15 @@ qboolean VM_Compile( vm_t *vm, vmHeader_t *header ) {
 
 	instructionCount = header->instructionCount;
 
+	vm->profile = NULL;
+	vm->numProfile = 0;
+#if idx64
+	if ( vm_profile->integer ) {
+		VM_AllocProfile( vm, inst, instructionCount );
+	}
+#endif
+	prof = NULL;
+
 	for( pass = 0; pass < NUM_PASSES; pass++ )
 	{
 __compile:
@@ -3958,8 +4265,12 @@ __compile:
 #ifdef RET_OPTIMIZE
 	proc_end = 0;
 #endif
+	proc_num = 0;
 
 	init_opstack();
+#ifdef BLOCK_OPTIMIZE
+	init_label_states();
+#endif
 
 #ifdef DEBUG_INT
 	emit_brk();
@@ -3988,7 +4299,7 @@ __compile:
 
 	emit_load4( R_OPSTACK | R_REX, R_EAX, 0 );		// mov rdi, [rax]
 
-	mov_rx_ptr( R_SYSCALL, vm->systemCall );		// mov r13, vm->systemCall
+	mov_rx_ptr( R_SYSCALL, vm->callTable );		// mov r13, vm->callTable
 
 	mov_rx_ptr( R_EAX, &vm->programStack );			// mov rax, &vm->programStack
 
@@ -4044,12 +4355,20 @@ __compile:
 	while ( ip < instructionCount ) {
 		ci = &inst[ip + 0];
 
+#ifdef BLOCK_OPTIMIZE
+		inst_ip = ip;
+#endif
+
 #ifdef REGS_OPTIMIZE
 		if ( ci->jused )
 #endif
 		{
 			// we can safely perform register optimizations only in case if
 			// we are 100% sure that current instruction is not a jump label
+			// or all the ways to reach this label are known
+#ifdef BLOCK_OPTIMIZE
+			if ( !load_label_state( inst, ip ) )
+#endif
 			flush_volatile();
 		}
 
@@ -4069,6 +4388,9 @@ __compile:
 				break;
 
 			case OP_ENTER:
+#ifdef BLOCK_OPTIMIZE
+				init_label_states();
+#endif
 				EmitAlign( FUNC_ALIGN );
 
 				instructionOffsets[ ip-1 ] = compiledOfs;
@@ -4086,6 +4408,9 @@ __compile:
 					}
 				}
 
+				prof = vm->profile ? &vm->profile[ proc_num ] : NULL;
+				proc_num++;
+
 				if ( proc_len == 0 ) {
 					// empty function, just return
 					emit_ret();
@@ -4101,6 +4426,10 @@ __compile:
 				emit_lea_base_index( R_PROCBASE | R_REX, R_DATABASE, R_PSTACK ); // procBase = dataBase + programStack
 
 				emit_CheckProc( vm, ci );
+
+				if ( prof ) {
+					EmitProfileEnter( prof );
+				}
 				break;
 
 			case OP_LEAVE:
@@ -4123,6 +4452,10 @@ __compile:
 				}
 #endif
 
+				if ( prof ) {
+					EmitProfileLeave( prof );
+				}
+
 				emit_pop( R_PSTACK );			// pop rsi // programStack
 				emit_pop( R_PROCBASE );			// pop rbp // procBase
 
@@ -38,15 +38,11 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 #define	MAX_ENT_CLUSTERS	16
 
 typedef struct svEntity_s {
-	struct worldSector_s *worldSector;
-	struct svEntity_s *nextEntityInWorldSector;
-
 	entityState_t	baseline;		// for delta compression of initial sighting
 	int			numClusters;		// if -1, use headnode instead
 	int			clusternums[MAX_ENT_CLUSTERS];
 	int			lastCluster;		// if all the clusters don't fit in clusternums
 	int			areanum, areanum2;
-	int			snapshotCounter;	// used to prevent double adding from portal views
 } svEntity_t;
 
 typedef enum {
@@ -75,7 +71,6 @@ typedef struct {
 	// https://zerowing.idsoftware.com/bugzilla/show_bug.cgi?id=475
 	// the serverId associated with the current checksumFeed (always <= serverId)
 	int				checksumFeedServerId;
-	int				snapshotCounter;	// incremented for each snapshot built
 	int				timeResidual;		// <= 1000 / sv_frame->value
 	int				nextFrameTime;		// when time > nextFrameTime, process world
 	char			*configstrings[MAX_CONFIGSTRINGS];
@@ -163,7 +158,9 @@ typedef struct rateLimit_s {
 
 typedef struct leakyBucket_s leakyBucket_t;
 struct leakyBucket_s {
-	netadrtype_t	type;
+	netadrtype_t	type;		// NA_BAD if unused
+	byte			bits;		// 0 for a single address, prefix length for subnet aggregates
+	byte			referenced;	// second chance for clock eviction
 
 	union {
 		byte	_4[4];
@@ -172,7 +169,8 @@ struct leakyBucket_s {
 
 	rateLimit_t rate;
 
-	int			hash;
+	int			period;		// used to tell if the bucket has expired
+	uint32_t	hash;
 	int			toxic;
 
 	leakyBucket_t *prev, *next;
@@ -275,7 +273,7 @@ typedef struct client_s {
 
 #ifdef USE_SERVER_DEMO
 	qboolean	demo_recording;	// are we currently recording this client?
-	fileHandle_t	demo_file;	// the file we are writing the demo to
+	int		demo_stream;	// demo writer stream the file belongs to
 	qboolean	demo_waiting;	// are we still waiting for the first non-delta frame?
 	int		demo_backoff;	// how many packets (-1 actually) between non-delta frames?
 	int		demo_deltas;	// how many delta frames did we let through so far?
@@ -435,6 +433,7 @@ qboolean SVC_RateLimitAddress( const netadr_t *from, int burst, int period );
 void SVC_RateRestoreBurstAddress( const netadr_t *from, int burst, int period );
 void SVC_RateRestoreToxicAddress( const netadr_t *from, int burst, int period );
 void SVC_RateDropAddress( const netadr_t *from, int burst, int period );
+void SVC_InitRateLimit( void );
 
 void SV_FinalMessage( const char *message );
 void QDECL SV_SendServerCommand( client_t *cl, const char *fmt, ...) __attribute__ ((format (printf, 2, 3)));
@@ -451,6 +450,8 @@ int SV_RateMsec( const client_t *client );
 //
 void SV_SetConfigstring( int index, const char *val );
 void SV_GetConfigstring( int index, char *buffer, int bufferSize );
+void SV_UpdateInfoConfigstrings( qboolean rebuild );
+void SV_UpdateRateSettings( void );
 void SV_UpdateConfigstrings( client_t *client );
 
 void SV_SetUserinfo( int index, const char *val );
@@ -458,6 +459,7 @@ void SV_GetUserinfo( int index, char *buffer, int bufferSize );
 
 void SV_ChangeMaxClients( void );
 void SV_SpawnServer( const char *mapname, qboolean killBots );
+void SV_MapPrefetchFrame( void );
 
 
 
@@ -486,7 +488,6 @@ void SV_ClientThink( client_t *cl, usercmd_t *cmd );
 int SV_SendDownloadMessages( void );
 int SV_SendQueuedMessages( void );
 
-void SV_FreeIP4DB( void );
 void SV_PrintLocations_f( client_t *client );
 
 #ifdef USE_MV
@@ -519,28 +520,43 @@ int SVM_OnServerCommand(client_t **pcl, char *message);
 //
 #define SUBNETS_CHUNK_SIZE  1024
 
+typedef struct svm_subnet_slot_s {
+	int       start;     // first node to visit for addresses in this slot
+	int       best;      // longest match among shorter prefixes
+} svm_subnet_slot_t;
+
+typedef struct svm_subnet_trie_s {
+	svm_subnet_slot_t  *table;  // indexed by leading address bits
+	byte      *nodes;
+	int       stride;    // node size in bytes
+	int       words;     // 32-bit words per key
+	int       numNodes, maxNodes;
+	int       freeNode;
+	int       root;
+	size_t    count;     // number of subnets
+} svm_subnet_trie_t;
+
 typedef struct svm_subnets_s {
-	netadr_t  *start, *cur;
+	svm_subnet_trie_t  ip4, ip6;
 	size_t    count;
-	size_t    cap;
 } svm_subnets_t;
 
 #define ERR_SVM_Subnets_SetFromString  1
 #define ERR_SVM_Subnets_Add            2
 
 void SVM_Subnets_Init(svm_subnets_t *subnets);
-netadr_t *SVM_Subnets_Add(svm_subnets_t *subnets);
-size_t SVM_Subnets_Remove(svm_subnets_t *subnets, netadr_t *adr);
-int SVM_Subnet_SetFromString(netadr_t *adr, char* string);
+int SVM_Subnet_SetFromString(netadr_t *adr, int *mask, char* string);
+int SVM_Subnets_Add(svm_subnets_t *subnets, const netadr_t *adr, int mask);
+int SVM_Subnets_Remove(svm_subnets_t *subnets, const netadr_t *adr, int mask);
 int SVM_Subnets_AddFromString(svm_subnets_t *subnets, char* string);
+int SVM_Subnets_RemoveFromString(svm_subnets_t *subnets, char* string);
 void SVM_Subnets_AddFromFile(svm_subnets_t *subnets, char *filename);
 void SVM_Subnets_Commit(svm_subnets_t *subnets);
-netadr_t *SVM_Subnets_FindByAdr(svm_subnets_t *subnets, netadr_t *adr);
-netadr_t *SVM_Subnets_FindByAdrString(svm_subnets_t *subnets, char* string);
-netadr_t *SVM_Subnets_FindByAdrUC(svm_subnets_t *subnets, netadr_t *adr);
-netadr_t *SVM_Subnets_FindByAdrStringUC(svm_subnets_t *subnets, char* string);
-size_t SVM_Subnets_RemoveNC(svm_subnets_t *subnets, netadr_t *adr);
+qboolean SVM_Subnets_FindByAdr(svm_subnets_t *subnets, const netadr_t *adr, netadr_t *subnet, int *mask);
+qboolean SVM_Subnets_FindByAdrString(svm_subnets_t *subnets, char* string);
+size_t SVM_Subnets_Memory(const svm_subnets_t *subnets);
 void SVM_Subnets_Free(svm_subnets_t *subnets);
+void SVM_Subnets_Benchmark(svm_subnets_t *subnets, int lookups);
 
 //
 // sv_ccmds.c
@@ -550,7 +566,7 @@ client_t *SV_GetPlayerByHandle( void );
 qboolean SV_ParseCIDRNotation(netadr_t *dest, int *mask, char *adrstr);
 
 #ifdef USE_SERVER_DEMO
-void SVD_WriteDemoFile(const client_t*, const msg_t*);
+void SVD_WriteDemoFile(client_t*, const msg_t*);
 #endif
 
 #ifdef USE_MV
@@ -558,6 +574,26 @@ void SV_LoadRecordCache( void );
 void SV_SaveRecordCache( void );
 #endif
 
+//
+// sv_demowriter.c
+//
+#ifdef USE_SERVER_DEMO
+void		SVD_InitDemoWriter( void );
+void		SVD_ShutdownDemoWriter( void );
+void		SVD_DemoWriterFrame( void );
+int			SVD_OpenStream( fileHandle_t file, int clientNum );
+qboolean	SVD_QueueFrame( int stream, int sequence, const byte *data, int length );
+void		SVD_CloseStream( int stream );
+#endif
+
+//
+// sv_ip4db.c
+//
+void SV_InitIP4DB( void );
+void SV_FreeIP4DB( void );
+void SV_IP4DBFrame( void );
+void SV_LookupIP4DB( const netadr_t *from, char *str );
+
 //
 // sv_snapshot.c
 //
@@ -571,6 +607,9 @@ void SV_SendClientSnapshot( client_t *client );
 void SV_InitSnapshotStorage( void );
 void SV_IssueNewSnapshot( void );
 
+void SV_InitSnapshotThreads( void );
+void SV_ShutdownSnapshotThreads( void );
+
 int SV_RemainingGameState( void );
 
 //
@@ -596,6 +635,13 @@ void		SV_BotFreeClient( int clientNum );
 void		SV_BotInitCvars(void);
 int			SV_BotLibSetup( void );
 int			SV_BotLibShutdown( void );
+void		SV_RouteBench_f( void );
+void		SV_RouteTable_f( void );
+void		SV_BotRouteCacheStats_f( void );
+void		SV_BotMoveBench_f( void );
+struct bot_movequery_s;
+void		SV_BotMoveQueries( struct bot_movequery_s *queries, int count );
+void		SV_ShutdownBotThreads( void );
 int			SV_BotGetSnapshotEntity( int client, int ent );
 int			SV_BotGetConsoleMessage( int client, char *buf, int size );
 
@@ -609,6 +655,7 @@ void SV_BotInitBotLib(void);
 // high level object sorting to reduce interaction tests
 //
 
+void SV_InitWorld( void );
 void SV_ClearWorld (void);
 // called after the world model has been loaded, before linking any entities
 
@@ -654,6 +701,21 @@ void SV_Trace( trace_t *results, const vec3_t start, const vec3_t mins, const ve
 
 // passEntityNum is explicitly excluded from clipping checks (normally ENTITYNUM_NONE)
 
+void SV_TraceBatch( trace_t *results, const traceRequest_t *requests, int count );
+// SV_Trace for each request, world collision is traced in packets
+
+void SV_TraceRecord_f( void );
+void SV_TraceBench_f( void );
+void SV_StopTraceLog( void );
+
+void SV_AreaRecord_f( void );
+void SV_AreaBench_f( void );
+void SV_StopAreaLog( void );
+
+void SV_InitTraceCache( void );
+void SV_TraceCacheFrame( void );
+// drops memoized SV_Trace and SV_PointContents results, called before each game frame
+
 void SV_TraceAtCrosshair( trace_t *results, playerState_t *ps, const vec3_t mins, const vec3_t maxs, int contentmask, qboolean capsule );
 
 void SV_ClipToEntity( trace_t *trace, const vec3_t start, const vec3_t mins, const vec3_t maxs, const vec3_t end, int entityNum, int contentmask, qboolean capsule );
@@ -674,3 +736,4 @@ void SV_LoadFilters( const char *filename );
 const char *SV_RunFilters( const char *userinfo, const netadr_t *addr );
 void SV_AddFilter_f( void );
 void SV_AddFilterCmd_f( void );
+void SV_FilterBench_f( void );
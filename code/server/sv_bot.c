@@ -38,6 +38,11 @@ static int bot_maxdebugpolys;
 extern botlib_export_t	*botlib_export;
 int	bot_enable;
 
+// set while bot move queries run on several threads,
+// the engine calls of the botlib are serialized then
+static void		*bot_importLock;
+static qboolean	bot_parallel;
+
 
 /*
 ==================
@@ -135,6 +140,28 @@ void BotDrawDebugPolygons(void (*drawPoly)(int color, int numPoints, float *poin
 	}
 }
 
+/*
+==================
+BotImport_Lock
+==================
+*/
+static void BotImport_Lock( void ) {
+	if ( bot_parallel ) {
+		Sys_LockMutex( bot_importLock );
+	}
+}
+
+/*
+==================
+BotImport_Unlock
+==================
+*/
+static void BotImport_Unlock( void ) {
+	if ( bot_parallel ) {
+		Sys_UnlockMutex( bot_importLock );
+	}
+}
+
 /*
 ==================
 BotImport_Print
@@ -149,6 +176,8 @@ static __attribute__ ((format (printf, 2, 3))) void QDECL BotImport_Print(int ty
 	Q_vsnprintf(str, sizeof(str), fmt, ap);
 	va_end(ap);
 
+	BotImport_Lock();
+
 	switch(type) {
 		case PRT_MESSAGE: {
 			Com_Printf("%s", str);
@@ -175,6 +204,8 @@ static __attribute__ ((format (printf, 2, 3))) void QDECL BotImport_Print(int ty
 			break;
 		}
 	}
+
+	BotImport_Unlock();
 }
 
 /*
@@ -185,7 +216,9 @@ BotImport_Trace
 static void BotImport_Trace(bsp_trace_t *bsptrace, vec3_t start, vec3_t mins, vec3_t maxs, vec3_t end, int passent, int contentmask) {
 	trace_t trace;
 
+	BotImport_Lock();
 	SV_Trace(&trace, start, mins, maxs, end, passent, contentmask, qfalse);
+	BotImport_Unlock();
 	//copy the trace information
 	bsptrace->allsolid = trace.allsolid;
 	bsptrace->startsolid = trace.startsolid;
@@ -211,7 +244,9 @@ BotImport_EntityTrace
 static void BotImport_EntityTrace(bsp_trace_t *bsptrace, vec3_t start, vec3_t mins, vec3_t maxs, vec3_t end, int entnum, int contentmask) {
 	trace_t trace;
 
+	BotImport_Lock();
 	SV_ClipToEntity(&trace, start, mins, maxs, end, entnum, contentmask, qfalse);
+	BotImport_Unlock();
 	//copy the trace information
 	bsptrace->allsolid = trace.allsolid;
 	bsptrace->startsolid = trace.startsolid;
@@ -236,7 +271,12 @@ BotImport_PointContents
 ==================
 */
 static int BotImport_PointContents(vec3_t point) {
-	return SV_PointContents(point, -1);
+	int contents;
+
+	BotImport_Lock();
+	contents = SV_PointContents(point, -1);
+	BotImport_Unlock();
+	return contents;
 }
 
 /*
@@ -245,7 +285,12 @@ BotImport_inPVS
 ==================
 */
 static int BotImport_inPVS(vec3_t p1, vec3_t p2) {
-	return SV_inPVS (p1, p2);
+	int visible;
+
+	BotImport_Lock();
+	visible = SV_inPVS (p1, p2);
+	BotImport_Unlock();
+	return visible;
 }
 
 /*
@@ -293,7 +338,9 @@ BotImport_GetMemory
 static void *BotImport_GetMemory(int size) {
 	void *ptr;
 
+	BotImport_Lock();
 	ptr = Z_TagMalloc( size, TAG_BOTLIB );
+	BotImport_Unlock();
 	return ptr;
 }
 
@@ -303,7 +350,9 @@ BotImport_FreeMemory
 ==================
 */
 static void BotImport_FreeMemory(void *ptr) {
+	BotImport_Lock();
 	Z_Free(ptr);
+	BotImport_Unlock();
 }
 
 /*
@@ -492,6 +541,438 @@ int SV_BotLibShutdown( void ) {
 	return botlib_export->BotLibShutdown();
 }
 
+/*
+==================
+SV_RouteBench_f
+
+Times the bot routing cache updates and the cache repairs
+after toggling areas on the AAS file of the current map
+==================
+*/
+void SV_RouteBench_f( void ) {
+	int numCaches, numToggles;
+
+	if ( !botlib_export || !botlib_export->aas.AAS_Initialized() ) {
+		Com_Printf( "No AAS file loaded, bots have to be enabled on the current map.\n" );
+		return;
+	}
+
+	numCaches = Cmd_Argc() > 1 ? atoi( Cmd_Argv( 1 ) ) : 256;
+	if ( numCaches <= 0 ) {
+		numCaches = 256;
+	}
+	numToggles = Cmd_Argc() > 2 ? atoi( Cmd_Argv( 2 ) ) : 32;
+	if ( numToggles < 0 ) {
+		numToggles = 0;
+	}
+
+	botlib_export->aas.AAS_RoutingBench( numCaches, numToggles );
+}
+
+/*
+==================
+SV_RouteTable_f
+
+Precomputes the bot route table of the current map and
+compares the first route queries with the routing cache
+==================
+*/
+void SV_RouteTable_f( void ) {
+
+	if ( !botlib_export || !botlib_export->aas.AAS_Initialized() ) {
+		Com_Printf( "No AAS file loaded, bots have to be enabled on the current map.\n" );
+		return;
+	}
+
+	botlib_export->aas.AAS_WriteRouteTable();
+}
+
+/*
+==================
+SV_BotRouteCacheStats_f
+
+Prints the bot routing cache hit, miss and eviction rates
+==================
+*/
+void SV_BotRouteCacheStats_f( void ) {
+
+	if ( !botlib_export || !botlib_export->aas.AAS_Initialized() ) {
+		Com_Printf( "No AAS file loaded, bots have to be enabled on the current map.\n" );
+		return;
+	}
+
+	botlib_export->aas.AAS_RoutingCacheStats( !Q_stricmp( Cmd_Argv( 1 ), "reset" ) );
+}
+
+/*
+=============================================================================
+
+PARALLEL BOT MOVE QUERIES
+
+The game passes route and visible position queries of all bots in one
+G_BOT_MOVE_QUERIES call, with sv_botThreads set they are spread over
+worker threads. The botlib guards its routing caches with locks between
+AAS_BeginParallelRouting and AAS_EndParallelRouting, traces, prints and
+memory allocations go through bot_importLock. The game VM itself always
+runs on the main thread.
+
+=============================================================================
+*/
+
+#define MAX_BOT_THREADS		16
+#define BOT_QUERY_CHUNK		4		// queries taken by a thread at once
+
+typedef struct {
+	void		*thread;
+	void		*start;
+	void		*done;
+} botWorker_t;
+
+static cvar_t			*sv_botThreads;
+
+static botWorker_t		bot_workers[ MAX_BOT_THREADS ];
+static int				bot_numWorkers;
+static volatile int		bot_shutdown;
+
+static bot_movequery_t	*bot_queries;
+static int				bot_numQueries;
+static volatile int		bot_nextQuery;
+
+
+/*
+==================
+SV_RunBotMoveQueries
+
+Called by the main thread and all workers, returns when no queries left
+==================
+*/
+static void SV_RunBotMoveQueries( void ) {
+	int n, count;
+
+	while ( ( n = Sys_AtomicAdd( &bot_nextQuery, BOT_QUERY_CHUNK ) ) < bot_numQueries ) {
+		count = bot_numQueries - n;
+		if ( count > BOT_QUERY_CHUNK ) {
+			count = BOT_QUERY_CHUNK;
+		}
+		botlib_export->ai.BotMoveQueries( &bot_queries[ n ], count );
+	}
+}
+
+/*
+==================
+SV_BotWorker
+==================
+*/
+static void SV_BotWorker( void *param ) {
+	botWorker_t *worker = (botWorker_t *)param;
+
+	for ( ;; ) {
+		if ( !Sys_WaitSignal( worker->start, 1000 ) ) {
+			if ( Sys_AtomicLoad( &bot_shutdown ) )
+				break;
+			continue;
+		}
+
+		if ( Sys_AtomicLoad( &bot_shutdown ) )
+			break;
+
+		SV_RunBotMoveQueries();
+
+		Sys_RaiseSignal( worker->done );
+	}
+}
+
+/*
+==================
+SV_StopBotThreads
+==================
+*/
+static void SV_StopBotThreads( void ) {
+	botWorker_t *worker;
+	int i;
+
+	if ( !bot_numWorkers ) {
+		return;
+	}
+
+	Sys_AtomicStore( &bot_shutdown, 1 );
+
+	for ( i = 0; i < bot_numWorkers; i++ ) {
+		worker = &bot_workers[ i ];
+		Sys_RaiseSignal( worker->start );
+		Sys_JoinThread( worker->thread );
+		Sys_DestroySignal( worker->start );
+		Sys_DestroySignal( worker->done );
+	}
+
+	Com_Memset( bot_workers, 0, sizeof( bot_workers ) );
+	bot_numWorkers = 0;
+
+	Sys_DestroyMutex( bot_importLock );
+	bot_importLock = NULL;
+}
+
+/*
+==================
+SV_StartBotThreads
+==================
+*/
+static void SV_StartBotThreads( int count ) {
+	botWorker_t *worker;
+
+	SV_StopBotThreads();
+
+	if ( count <= 0 ) {
+		return;
+	}
+
+	bot_importLock = Sys_CreateMutex();
+	if ( !bot_importLock ) {
+		Com_Printf( S_COLOR_YELLOW "WARNING: failed to create bot import lock\n" );
+		return;
+	}
+
+	Sys_AtomicStore( &bot_shutdown, 0 );
+
+	while ( bot_numWorkers < count && bot_numWorkers < MAX_BOT_THREADS ) {
+		worker = &bot_workers[ bot_numWorkers ];
+		worker->start = Sys_CreateSignal();
+		worker->done = Sys_CreateSignal();
+		if ( worker->start && worker->done ) {
+			worker->thread = Sys_CreateThread( SV_BotWorker, worker );
+		}
+		if ( !worker->thread ) {
+			if ( worker->start )
+				Sys_DestroySignal( worker->start );
+			if ( worker->done )
+				Sys_DestroySignal( worker->done );
+			Com_Memset( worker, 0, sizeof( *worker ) );
+			Com_Printf( S_COLOR_YELLOW "WARNING: failed to create bot thread\n" );
+			break;
+		}
+		bot_numWorkers++;
+	}
+
+	if ( !bot_numWorkers ) {
+		Sys_DestroyMutex( bot_importLock );
+		bot_importLock = NULL;
+	}
+}
+
+/*
+==================
+SV_CheckBotThreads
+==================
+*/
+static void SV_CheckBotThreads( void ) {
+
+	if ( !sv_botThreads->modified ) {
+		return;
+	}
+
+	sv_botThreads->modified = qfalse;
+
+	SV_StartBotThreads( sv_botThreads->integer );
+}
+
+/*
+==================
+SV_DispatchBotMoveQueries
+
+Runs the queries on the worker pool and waits for completion,
+must be called between AAS_BeginParallelRouting and AAS_EndParallelRouting
+==================
+*/
+static void SV_DispatchBotMoveQueries( bot_movequery_t *queries, int count ) {
+	int i;
+
+	bot_queries = queries;
+	bot_numQueries = count;
+	bot_parallel = qtrue;
+
+	Sys_AtomicStore( &bot_nextQuery, 0 );
+
+	for ( i = 0; i < bot_numWorkers; i++ ) {
+		Sys_RaiseSignal( bot_workers[ i ].start );
+	}
+
+	SV_RunBotMoveQueries();
+
+	for ( i = 0; i < bot_numWorkers; i++ ) {
+		while ( !Sys_WaitSignal( bot_workers[ i ].done, 1000 ) )
+			;
+	}
+
+	bot_parallel = qfalse;
+	bot_queries = NULL;
+	bot_numQueries = 0;
+}
+
+/*
+==================
+SV_BotMoveQueries
+
+Evaluates the bot move queries of G_BOT_MOVE_QUERIES, in parallel
+when bot threads are running, otherwise on the main thread
+==================
+*/
+void SV_BotMoveQueries( bot_movequery_t *queries, int count ) {
+
+	if ( !botlib_export || count <= 0 ) {
+		return;
+	}
+
+	SV_CheckBotThreads();
+
+	// developer mode prints from deep inside the routing code
+	if ( bot_numWorkers && count > 1 && !com_developer->integer
+		&& botlib_export->aas.AAS_BeginParallelRouting() ) {
+		SV_DispatchBotMoveQueries( queries, count );
+		botlib_export->aas.AAS_EndParallelRouting();
+		return;
+	}
+
+	botlib_export->ai.BotMoveQueries( queries, count );
+}
+
+/*
+==================
+SV_BotMoveBench_f
+
+Routes every active client to every other one, serial and
+parallel, compares the results and times both
+==================
+*/
+void SV_BotMoveBench_f( void ) {
+	static bot_movequery_t	queries[ MAX_MOVEQUERIES ];
+	static bot_movequery_t	reference[ MAX_MOVEQUERIES ];
+	int64_t		start, serial, parallel;
+	int			frames, threads, savedThreads;
+	int			i, j, n, count, mismatches, reachable;
+	client_t	*c, *goal;
+
+	if ( sv.state != SS_GAME ) {
+		Com_Printf( "Server is not running.\n" );
+		return;
+	}
+
+	if ( !botlib_export || !botlib_export->aas.AAS_Initialized() ) {
+		Com_Printf( "No AAS file loaded, bots have to be enabled on the current map.\n" );
+		return;
+	}
+
+	frames = 10;
+	if ( Cmd_Argc() > 1 ) {
+		frames = atoi( Cmd_Argv( 1 ) );
+		if ( frames < 1 )
+			frames = 1;
+	}
+
+	threads = sv_botThreads->integer;
+	if ( Cmd_Argc() > 2 ) {
+		threads = atoi( Cmd_Argv( 2 ) );
+	} else if ( threads <= 0 ) {
+		threads = Sys_NumCPUs() - 1;
+	}
+	if ( threads < 1 )
+		threads = 1;
+
+	count = 0;
+	for ( i = 0, c = svs.clients; i < sv_maxclients->integer; i++, c++ ) {
+		if ( c->state != CS_ACTIVE || !c->gentity )
+			continue;
+		for ( j = 0, goal = svs.clients; j < sv_maxclients->integer && count < MAX_MOVEQUERIES; j++, goal++ ) {
+			if ( j == i || goal->state != CS_ACTIVE || !goal->gentity )
+				continue;
+			Com_Memset( &queries[ count ], 0, sizeof( queries[0] ) );
+			VectorCopy( c->gentity->r.currentOrigin, queries[ count ].origin );
+			VectorCopy( goal->gentity->r.currentOrigin, queries[ count ].goalorigin );
+			queries[ count ].goalentitynum = j;
+			queries[ count ].flags = MOVEQUERY_PREDICTVISIBLE;
+			count++;
+		}
+	}
+
+	if ( count < 2 ) {
+		Com_Printf( "Not enough clients to route between, add some bots.\n" );
+		return;
+	}
+
+	// fills the routing caches and gives the reference results
+	Com_Memcpy( reference, queries, count * sizeof( queries[0] ) );
+	botlib_export->ai.BotMoveQueries( reference, count );
+
+	savedThreads = bot_numWorkers;
+	if ( bot_numWorkers != threads ) {
+		SV_StartBotThreads( threads );
+	}
+
+	if ( !bot_numWorkers ) {
+		Com_Printf( "Failed to start bot threads.\n" );
+		SV_StartBotThreads( savedThreads );
+		return;
+	}
+
+	// serial
+	start = Sys_Microseconds();
+	for ( n = 0; n < frames; n++ ) {
+		botlib_export->ai.BotMoveQueries( queries, count );
+	}
+	serial = Sys_Microseconds() - start;
+
+	// parallel
+	parallel = 0;
+	mismatches = 0;
+	if ( botlib_export->aas.AAS_BeginParallelRouting() ) {
+		start = Sys_Microseconds();
+		for ( n = 0; n < frames; n++ ) {
+			SV_DispatchBotMoveQueries( queries, count );
+		}
+		parallel = Sys_Microseconds() - start;
+		botlib_export->aas.AAS_EndParallelRouting();
+	} else {
+		Com_Printf( "Parallel routing is not available, bot_developer is set.\n" );
+	}
+
+	if ( bot_numWorkers != savedThreads ) {
+		SV_StartBotThreads( savedThreads );
+	}
+
+	reachable = 0;
+	for ( i = 0; i < count; i++ ) {
+		if ( reference[ i ].traveltime )
+			reachable++;
+		if ( queries[ i ].traveltime != reference[ i ].traveltime
+			|| queries[ i ].reachnum != reference[ i ].reachnum
+			|| queries[ i ].visible != reference[ i ].visible
+			|| !VectorCompare( queries[ i ].target, reference[ i ].target ) ) {
+			mismatches++;
+		}
+	}
+
+	Com_Printf( "%i queries, %i reachable, %i frames:\n", count, reachable, frames );
+	Com_Printf( "  serial:   %6i usec/frame\n", (int)( serial / frames ) );
+	if ( parallel ) {
+		Com_Printf( "  parallel: %6i usec/frame (%i+1 threads), %.2fx, %i mismatches\n", (int)( parallel / frames ),
+			threads, (double)serial / (double)parallel, mismatches );
+	}
+}
+
+/*
+==================
+SV_ShutdownBotThreads
+==================
+*/
+void SV_ShutdownBotThreads( void ) {
+
+	SV_StopBotThreads();
+
+	// restart the pool on next bot move queries
+	if ( sv_botThreads ) {
+		sv_botThreads->modified = qtrue;
+	}
+}
+
 /*
 ==================
 SV_BotInitCvars
@@ -529,6 +1010,11 @@ void SV_BotInitCvars(void) {
 	Cvar_Get("bot_interbreedbots", "10", CVAR_CHEAT);	//number of bots used for interbreeding
 	Cvar_Get("bot_interbreedcycle", "20", CVAR_CHEAT);	//bot interbreeding cycle
 	Cvar_Get("bot_interbreedwrite", "", CVAR_CHEAT);	//write interbreeded bots to this file
+
+	sv_botThreads = Cvar_Get( "sv_botThreads", "0", CVAR_ARCHIVE_ND );
+	Cvar_CheckRange( sv_botThreads, "0", XSTRING(MAX_BOT_THREADS), CV_INTEGER );
+	Cvar_SetDescription( sv_botThreads, "Number of worker threads used to evaluate bot move queries of the game in parallel with the main thread, 0 evaluates them on the main thread\nDefault: 0" );
+	sv_botThreads->modified = qtrue;
 }
 
 /*
@@ -564,6 +1050,8 @@ void SV_BotInitBotLib(void) {
 	botlib_import.FS_Write = FS_Write;
 	botlib_import.FS_FCloseFile = FS_FCloseFile;
 	botlib_import.FS_Seek = FS_Seek;
+	botlib_import.FS_MapFile = FS_MapFile;
+	botlib_import.FS_UnmapFile = FS_UnmapFile;
 
 	//debug lines
 	botlib_import.DebugLineCreate = BotImport_DebugLineCreate;
@@ -575,6 +1063,12 @@ void SV_BotInitBotLib(void) {
 	botlib_import.DebugPolygonDelete = BotImport_DebugPolygonDelete;
 
 	botlib_import.Sys_Milliseconds = Sys_Milliseconds;
+	botlib_import.Sys_Microseconds = Sys_Microseconds;
+
+	botlib_import.CreateMutex = Sys_CreateMutex;
+	botlib_import.DestroyMutex = Sys_DestroyMutex;
+	botlib_import.LockMutex = Sys_LockMutex;
+	botlib_import.UnlockMutex = Sys_UnlockMutex;
 
 	botlib_export = (botlib_export_t *)GetBotLibAPI( BOTLIB_API_VERSION, &botlib_import );
 	assert(botlib_export); 	// somehow we end up with a zero import.
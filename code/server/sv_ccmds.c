@@ -1449,7 +1449,7 @@ and cl_main.c/CL_Record_f.
 */
 static void SVD_StartDemoFile(client_t *client, const char *path) {
 
-    int             i, len;
+    int             i, len, stream;
     entityState_t   *base, nullstate;
     msg_t           msg;
     byte            buffer[MAX_MSGLEN];
@@ -1530,9 +1530,16 @@ static void SVD_StartDemoFile(client_t *client, const char *path) {
 
     FS_Flush(file);
 
+    // from now on the file is written by the demo writer
+    stream = SVD_OpenStream(file, client - svs.clients);
+    if (stream < 0) {
+        FS_FCloseFile(file);
+        return;
+    }
+
     // adjust client_t to reflect demo started
     client->demo_recording = qtrue;
-    client->demo_file = file;
+    client->demo_stream = stream;
     client->demo_waiting = qtrue;
     client->demo_backoff = 1;
     client->demo_deltas = 0;
@@ -1540,13 +1547,14 @@ static void SVD_StartDemoFile(client_t *client, const char *path) {
 
 /*
 Write a message to a server-side demo file.
+
+The frame is only queued here, if the writer can't keep up it is dropped
+and recording continues from the next non-delta frame.
 */
-void SVD_WriteDemoFile(const client_t *client, const msg_t *msg) {
+void SVD_WriteDemoFile(client_t *client, const msg_t *msg) {
 
-    int len;
     msg_t cmsg;
     byte cbuf[MAX_MSGLEN];
-    fileHandle_t file = client->demo_file;
 
     if (*(int *)msg->data == -1) { // TODO: do we need this?
         Com_DPrintf("Ignored connectionless packet, not written to demo!\n");
@@ -1562,20 +1570,11 @@ void SVD_WriteDemoFile(const client_t *client, const msg_t *msg) {
     // here because we get the packet *before* the netchan has it's way
     // with it; just not sure that's really true :-/
 
-    len = LittleLong(client->netchan.outgoingSequence);
-    FS_Write(&len, 4, file);
-
-    len = LittleLong(cmsg.cursize);
-    FS_Write(&len, 4, file);
-
-    FS_Write(cmsg.data, cmsg.cursize, file); // XXX don't use len!
-
-    #ifdef USE_URT_DEMO
-        // add size of packet in the end for backward play /* holblin */
-        FS_Write(&len, 4, file);
-    #endif
-
-    FS_Flush(file);
+    if (!SVD_QueueFrame(client->demo_stream, client->netchan.outgoingSequence, cmsg.data, cmsg.cursize)) {
+        Com_DPrintf("Dropped a frame for %s, waiting for non-delta frame\n", client->name);
+        client->demo_waiting = qtrue;
+        client->demo_deltas = 0;
+    }
 }
 
 /*
@@ -1586,21 +1585,15 @@ in client_t again.
 */
 static void SVD_StopDemoFile(client_t *client) {
 
-    int marker = -1;
-    fileHandle_t file = client->demo_file;
-
     Com_DPrintf("SVD_StopDemoFile\n");
     assert(client->demo_recording);
 
-    // write the necessary trailer and close the demo file
-    FS_Write(&marker, 4, file);
-    FS_Write(&marker, 4, file);
-    FS_Flush(file);
-    FS_FCloseFile(file);
+    // write the necessary trailer, demo file is closed once it's drained
+    SVD_CloseStream(client->demo_stream);
 
     // adjust client_t to reflect demo stopped
     client->demo_recording = qfalse;
-    client->demo_file = -1;
+    client->demo_stream = -1;
     client->demo_waiting = qfalse;
     client->demo_backoff = 1;
     client->demo_deltas = 0;
@@ -2575,6 +2568,30 @@ void SV_AddOperatorCommands( void ) {
 
 	Cmd_AddCommand( "filtercmd", SV_AddFilterCmd_f );
     Cmd_SetDescription( "filtercmd", "Run a command while filtering\nusage: %s <filter format string>" );
+
+	Cmd_AddCommand( "filterbench", SV_FilterBench_f );
+    Cmd_SetDescription( "filterbench", "Checks compiled filters against the filter tree and times both\nusage: filterbench [iterations]" );
+
+	Cmd_AddCommand( "tracerecord", SV_TraceRecord_f );
+    Cmd_SetDescription( "tracerecord", "Records all game traces to a file for tracebench\nusage: tracerecord <filename>|stop" );
+
+	Cmd_AddCommand( "tracebench", SV_TraceBench_f );
+    Cmd_SetDescription( "tracebench", "Replays a trace log through scalar and batched world traces, compares and times both\nusage: tracebench <filename> [batchsize] [iterations]" );
+
+	Cmd_AddCommand( "arearecord", SV_AreaRecord_f );
+    Cmd_SetDescription( "arearecord", "Records entity links and area queries to a file for areabench\nusage: arearecord <filename>|stop" );
+
+	Cmd_AddCommand( "areabench", SV_AreaBench_f );
+    Cmd_SetDescription( "areabench", "Replays an area log through the sector tree and the loose grid, compares and times both\nusage: areabench <filename> [iterations]" );
+
+	Cmd_AddCommand( "routebench", SV_RouteBench_f );
+    Cmd_SetDescription( "routebench", "Times bot routing cache updates and cache repairs after toggling areas on the current AAS file\nusage: routebench [caches] [toggles]" );
+	Cmd_AddCommand( "routetable", SV_RouteTable_f );
+    Cmd_SetDescription( "routetable", "Precomputes the bot route table of the current map into maps/<mapname>.rtb and compares the first route queries with the routing cache\nusage: routetable" );
+	Cmd_AddCommand( "bot_routecachestats", SV_BotRouteCacheStats_f );
+    Cmd_SetDescription( "bot_routecachestats", "Prints bot routing cache size, hit, miss and eviction rates since the last reset\nusage: bot_routecachestats [reset]" );
+	Cmd_AddCommand( "botmovebench", SV_BotMoveBench_f );
+    Cmd_SetDescription( "botmovebench", "Routes every active client to every other one serial and on sv_botThreads workers, compares and times both\nusage: botmovebench [frames] [threads]" );
 #ifdef USE_MV
 	Cmd_AddCommand( "mvrecord", SV_MultiViewRecord_f );
     Cmd_SetDescription( "mvrecord", "Start a multiview recording\nusage: mvrecord <filename>" );
@@ -188,29 +188,6 @@ static qboolean SV_IsBanned( const netadr_t *from, qboolean isexception )
 #endif
 
 
-/*
-==================
-SV_SetClientTLD
-==================
-*/
-#pragma pack(push,1)
-
-typedef struct iprange_s {
-	uint32_t from;
-	uint32_t to;
-} iprange_t;
-
-typedef struct iprange_tld_s {
-	char tld[2];
-} iprange_tld_t;
-
-#pragma pack(pop)
-
-static qboolean ipdb_loaded;
-static iprange_t *ipdb_range;
-static iprange_tld_t *ipdb_tld;
-static int num_tlds;
-
 typedef struct tld_info_s {
 	const char *tld;
 	const char *country;
@@ -220,104 +197,14 @@ static const tld_info_t tld_info[] = {
 #include "tlds.h"
 };
 
-/*
-==================
-SV_FreeIP4DB
-==================
-*/
-void SV_FreeIP4DB( void )
-{
-	if ( ipdb_range )
-		Z_Free( ipdb_range );
-
-	ipdb_loaded = qfalse;
-	ipdb_range = NULL;
-	ipdb_tld = NULL;
-}
-
 
 /*
 ==================
-SV_LoadIP4DB
-
-Loads geoip database into memory
+SV_SetTLD
 ==================
 */
-static qboolean SV_LoadIP4DB( const char *filename )
-{
-	fileHandle_t fh = FS_INVALID_HANDLE;
-	uint32_t last_ip;
-	void *buf;
-	int len, i;
-
-	len = FS_SV_FOpenFileRead( filename, &fh );
-
-	if ( len <= 0 )
-	{
-		if ( fh != FS_INVALID_HANDLE )
-			FS_FCloseFile( fh );
-		return qfalse;
-	}
-
-	if ( len % 10 ) // should be a power of IP4:IP4:TLD2
-	{
-		Com_DPrintf( "%s(%s): invalid file size %i\n", __func__, filename, len );
-		if ( fh != FS_INVALID_HANDLE )
-			FS_FCloseFile( fh );
-		return qfalse;
-	}
-
-	SV_FreeIP4DB();
-
-	buf = Z_Malloc( len );
-
-	FS_Read( buf, len, fh );
-	FS_FCloseFile( fh );
-
-	// check integrity of loaded databse
-	last_ip = 0;
-	num_tlds = len / 10;
-
-	// database format:
-	// [range1][range2]...[rangeN]
-	// [tld1][tld2]...[tldN]
-
-	ipdb_range = (iprange_t*)buf;
-	ipdb_tld = (iprange_tld_t*)(ipdb_range + num_tlds);
-
-	for ( i = 0; i < num_tlds; i++ )
-	{
-#ifdef Q3_LITTLE_ENDIAN
-		ipdb_range[i].from = LongSwap( ipdb_range[i].from );
-		ipdb_range[i].to = LongSwap( ipdb_range[i].to );
-#endif
-		if ( last_ip && last_ip >= ipdb_range[i].from )
-			break;
-		if ( ipdb_range[i].from > ipdb_range[i].to )
-			break;
-		if ( ipdb_tld[i].tld[0] < 'A' || ipdb_tld[i].tld[0] > 'Z' || ipdb_tld[i].tld[1] < 'A' || ipdb_tld[i].tld[1] > 'Z' )
-			break;
-		last_ip = ipdb_range[i].to;
-	}
-
-	if ( i != num_tlds ) {
-			Com_Printf( S_COLOR_YELLOW "invalid ip4db entry #%i: range=[%08x..%08x], tld=%c%c\n",
-				i, ipdb_range[i].from, ipdb_range[i].to, ipdb_tld[i].tld[0], ipdb_tld[i].tld[1] );
-			SV_FreeIP4DB();
-			return qtrue; // to not try to load it again
-	}
-
-	Com_Printf( "ip4db: %i entries loaded\n", num_tlds );
-	return qtrue;
-}
-
-
 static void SV_SetTLD( char *str, const netadr_t *from, qboolean isLAN )
 {
-	const iprange_t *e;
-	int lo, hi, m;
-	uint32_t ip;
-
 	str[0] = '\0';
 
 	if ( sv_clientTLD->integer == 0 )
@@ -329,44 +216,7 @@ static void SV_SetTLD( char *str, const netadr_t *from, qboolean isLAN )
 		return;
 	}
 
-	if ( from->type != NA_IP ) // ipv4-only
-		return;
-
-	if ( !ipdb_loaded )
-		ipdb_loaded = SV_LoadIP4DB( "ip4db.dat" );
-
-	if ( !ipdb_range )
-		return;
-
-	lo = 0;
-	hi = num_tlds;
-
-	// big-endian to host-endian
-#ifdef Q3_LITTLE_ENDIAN
-	ip =  from->ipv._4[3] | from->ipv._4[2] << 8 | from->ipv._4[1] << 16 | from->ipv._4[0] << 24;
-#else
-	ip =  from->ipv._4[0] | from->ipv._4[1] << 8 | from->ipv._4[2] << 16 | from->ipv._4[3] << 24;
-#endif
-
-	// binary search
-	while ( lo <= hi )
-	{
-		m = ( lo + hi ) / 2;
-		e = ipdb_range + m;
-		if ( ip >= e->from && ip <= e->to )
-		{
-			const iprange_tld_t *tld = ipdb_tld + m;
-			str[0] = tld->tld[0];
-			str[1] = tld->tld[1];
-			str[2] = '\0';
-			return;
-		}
-
-		if ( e->from > ip )
-			hi = m - 1;
-		else
-			lo = m + 1;
-	}
+	SV_LookupIP4DB( from, str );
 }
 
 
@@ -715,7 +565,7 @@ gotnewcl:
 #ifdef USE_SERVER_DEMO
     // clear server-side demo recording
     newcl->demo_recording = qfalse;
-    newcl->demo_file = -1;
+    newcl->demo_stream = -1;
     newcl->demo_waiting = qfalse;
     newcl->demo_backoff = 1;
     newcl->demo_deltas = 0;
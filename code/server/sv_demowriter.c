@@ -0,0 +1,500 @@
+/*
+===========================================================================
+Copyright (C) 1999-2005 Id Software, Inc.
+
+This file is part of Quake III Arena source code.
+
+Quake III Arena source code is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the License,
+or (at your option) any later version.
+
+Quake III Arena source code is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Quake III Arena source code; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+===========================================================================
+*/
+// sv_demowriter.c -- background writer for per-client server-side demos
+
+#include "server.h"
+
+#ifdef USE_SERVER_DEMO
+
+/*
+Every recording client owns a single-producer/single-consumer byte ring:
+the main thread appends complete demo records from SV_SendMessageToClient()
+and a background thread drains them into the demo file with large writes,
+flushing the stdio stream only every sv_demoFlushInterval milliseconds.
+
+Records are queued all-or-nothing, if a ring is full the frame is dropped
+and the client goes back to waiting for a non-delta frame, so the demo
+stays playable and the game frame never blocks on disk i/o.
+
+Streams are reaped (file closed, ring freed) by the main thread only.
+*/
+
+#define DW_MIN_QUEUE_KB		64
+#define DW_MAX_QUEUE_KB		8192
+#define DW_TRAILER_SIZE		8		// end-of-demo marker is always reserved
+#define DW_WAKEUP_MSEC		20
+
+typedef enum {
+	DS_FREE,
+	DS_OPEN,		// producer is still queueing records
+	DS_CLOSING,		// trailer queued, writer will drain and flush
+	DS_CLOSED		// drained, waiting for the main thread to close file
+} demoStreamState_t;
+
+typedef struct {
+	volatile int	state;
+	fileHandle_t	file;
+	FILE			*fp;
+	byte			*ring;
+	unsigned int	mask;
+
+	volatile unsigned int head;		// producer position
+	volatile unsigned int tail;		// consumer position
+
+	int				lastFlush;		// writer thread only
+	qboolean		dirty;			// writer thread only
+
+	// statistics
+	int				clientNum;
+	int				framesQueued;
+	int				framesDropped;
+	unsigned int	peakDepth;
+	int64_t			bytesQueued;
+	int64_t			bytesWritten;
+	volatile int	writeErrors;
+} demoStream_t;
+
+static demoStream_t	dw_streams[ MAX_CLIENTS ];
+
+static void			*dw_thread;
+static void			*dw_wakeup;
+static volatile int	dw_shutdown;
+static volatile int	dw_flushInterval = 1000;
+
+// totals of already reaped streams
+static int			dw_totalFrames;
+static int			dw_totalDropped;
+static int64_t		dw_totalBytes;
+static int			dw_totalErrors;
+
+static cvar_t		*sv_demoQueueSize;
+static cvar_t		*sv_demoFlushInterval;
+
+
+/*
+==================
+SVD_DrainStream
+
+Writes all queued bytes of the stream to its file, returns qtrue
+when stream became empty. Called from writer thread only, or from the
+main thread when there is no writer thread at all.
+==================
+*/
+static qboolean SVD_DrainStream( demoStream_t *ds, int now, qboolean flush )
+{
+	unsigned int head, tail, ofs, len, size;
+
+	head = Sys_AtomicLoad( &ds->head );
+	tail = ds->tail;
+	size = ds->mask + 1;
+
+	while ( head != tail ) {
+		ofs = tail & ds->mask;
+		len = head - tail;
+		if ( len > size - ofs ) {
+			len = size - ofs; // up to the end of ring, wrapped part goes next
+		}
+		if ( fwrite( ds->ring + ofs, 1, len, ds->fp ) != len ) {
+			Sys_AtomicAdd( &ds->writeErrors, 1 );
+		}
+		tail += len;
+		ds->bytesWritten += len;
+		ds->dirty = qtrue;
+	}
+
+	Sys_AtomicStore( &ds->tail, tail );
+
+	if ( ds->dirty && ( flush || now - ds->lastFlush >= dw_flushInterval ) ) {
+		fflush( ds->fp );
+		ds->lastFlush = now;
+		ds->dirty = qfalse;
+	}
+
+	return ( head == Sys_AtomicLoad( &ds->head ) );
+}
+
+
+/*
+==================
+SVD_DrainStreams
+==================
+*/
+static void SVD_DrainStreams( void )
+{
+	demoStream_t *ds;
+	int i, state, now;
+
+	now = Sys_Milliseconds();
+
+	for ( i = 0, ds = dw_streams; i < ARRAY_LEN( dw_streams ); i++, ds++ ) {
+		state = Sys_AtomicLoad( &ds->state );
+		if ( state == DS_OPEN ) {
+			SVD_DrainStream( ds, now, qfalse );
+		} else if ( state == DS_CLOSING ) {
+			// trailer is queued before state change so nothing can follow it
+			if ( SVD_DrainStream( ds, now, qtrue ) ) {
+				Sys_AtomicStore( &ds->state, DS_CLOSED );
+			}
+		}
+	}
+}
+
+
+/*
+==================
+SVD_WriterThread
+==================
+*/
+static void SVD_WriterThread( void *param )
+{
+	int wait;
+
+	while ( !Sys_AtomicLoad( &dw_shutdown ) ) {
+		wait = dw_flushInterval;
+		if ( wait > DW_WAKEUP_MSEC || wait <= 0 ) {
+			wait = DW_WAKEUP_MSEC;
+		}
+		Sys_WaitSignal( dw_wakeup, wait );
+		SVD_DrainStreams();
+	}
+
+	// final pass, main thread will reap everything after join
+	SVD_DrainStreams();
+}
+
+
+/*
+==================
+SVD_ReapStreams
+
+Closes files of completely drained streams, main thread only.
+==================
+*/
+static void SVD_ReapStreams( void )
+{
+	demoStream_t *ds;
+	int i;
+
+	for ( i = 0, ds = dw_streams; i < ARRAY_LEN( dw_streams ); i++, ds++ ) {
+		if ( Sys_AtomicLoad( &ds->state ) != DS_CLOSED ) {
+			continue;
+		}
+
+		FS_FCloseFile( ds->file );
+		free( ds->ring );
+
+		dw_totalFrames += ds->framesQueued;
+		dw_totalDropped += ds->framesDropped;
+		dw_totalBytes += ds->bytesWritten;
+		dw_totalErrors += ds->writeErrors;
+
+		if ( ds->writeErrors ) {
+			Com_Printf( S_COLOR_YELLOW "WARNING: %i write errors on server demo of client %i\n",
+				ds->writeErrors, ds->clientNum );
+		}
+
+		Com_Memset( ds, 0, sizeof( *ds ) );
+		ds->state = DS_FREE;
+	}
+}
+
+
+/*
+==================
+SVD_QueueBytes
+==================
+*/
+static void SVD_QueueBytes( demoStream_t *ds, unsigned int *head, const void *data, unsigned int len )
+{
+	unsigned int ofs, n;
+
+	ofs = *head & ds->mask;
+	n = ds->mask + 1 - ofs;
+	if ( n > len ) {
+		n = len;
+	}
+
+	Com_Memcpy( ds->ring + ofs, data, n );
+	if ( n < len ) {
+		Com_Memcpy( ds->ring, (const byte *)data + n, len - n );
+	}
+
+	*head += len;
+}
+
+
+/*
+==================
+SVD_OpenStream
+
+Takes ownership of the demo file, header must be already written.
+Returns stream number or -1 on failure.
+==================
+*/
+int SVD_OpenStream( fileHandle_t file, int clientNum )
+{
+	demoStream_t *ds;
+	int i, size;
+
+	for ( i = 0, ds = dw_streams; i < ARRAY_LEN( dw_streams ); i++, ds++ ) {
+		if ( ds->state == DS_FREE ) {
+			break;
+		}
+	}
+
+	if ( i == ARRAY_LEN( dw_streams ) ) {
+		// all slots are still draining
+		Com_Printf( "Too many server demos are still being written.\n" );
+		return -1;
+	}
+
+	// round queue size down to power of two
+	size = 1;
+	while ( size * 2 <= sv_demoQueueSize->integer )
+		size *= 2;
+	size *= 1024;
+
+	Com_Memset( ds, 0, sizeof( *ds ) );
+
+	// queues of several recording clients could exhaust the zone
+	ds->ring = malloc( size );
+	if ( !ds->ring ) {
+		Com_Printf( S_COLOR_YELLOW "WARNING: out of memory for %i KB server demo queue\n", size / 1024 );
+		return -1;
+	}
+
+	ds->file = file;
+	ds->fp = FS_FileStream( file );
+	ds->mask = size - 1;
+	ds->clientNum = clientNum;
+	ds->lastFlush = Sys_Milliseconds();
+
+	if ( !dw_thread && !dw_wakeup ) {
+		dw_wakeup = Sys_CreateSignal();
+		dw_shutdown = 0;
+		if ( dw_wakeup )
+			dw_thread = Sys_CreateThread( SVD_WriterThread, NULL );
+		if ( !dw_thread ) {
+			Com_Printf( S_COLOR_YELLOW "WARNING: server demos will be written synchronously\n" );
+		}
+	}
+
+	Sys_AtomicStore( &ds->state, DS_OPEN );
+
+	return i;
+}
+
+
+/*
+==================
+SVD_QueueFrame
+
+Queues a complete demo record, returns qfalse if it was dropped.
+==================
+*/
+qboolean SVD_QueueFrame( int stream, int sequence, const byte *data, int length )
+{
+	demoStream_t *ds;
+	unsigned int head, depth, need;
+	int v;
+
+	ds = &dw_streams[ stream ];
+
+	need = length + 8;
+#ifdef USE_URT_DEMO
+	need += 4;
+#endif
+
+	head = ds->head;
+	depth = head - Sys_AtomicLoad( &ds->tail );
+
+	if ( depth + need + DW_TRAILER_SIZE > ds->mask + 1 ) {
+		ds->framesDropped++;
+		if ( dw_thread ) {
+			Sys_RaiseSignal( dw_wakeup );
+		}
+		return qfalse;
+	}
+
+	v = LittleLong( sequence );
+	SVD_QueueBytes( ds, &head, &v, 4 );
+
+	v = LittleLong( length );
+	SVD_QueueBytes( ds, &head, &v, 4 );
+	SVD_QueueBytes( ds, &head, data, length );
+
+#ifdef USE_URT_DEMO
+	// add size of packet in the end for backward play /* holblin */
+	SVD_QueueBytes( ds, &head, &v, 4 );
+#endif
+
+	Sys_AtomicStore( &ds->head, head );
+
+	ds->framesQueued++;
+	ds->bytesQueued += need;
+
+	depth += need;
+	if ( depth > ds->peakDepth ) {
+		ds->peakDepth = depth;
+	}
+
+	// don't let the writer sleep when ring is filling up
+	if ( dw_thread && depth > ( ds->mask + 1 ) / 2 ) {
+		Sys_RaiseSignal( dw_wakeup );
+	}
+
+	return qtrue;
+}
+
+
+/*
+==================
+SVD_CloseStream
+
+Queues end-of-demo marker, file is closed as soon as the stream is drained.
+==================
+*/
+void SVD_CloseStream( int stream )
+{
+	demoStream_t *ds;
+	unsigned int head;
+	int marker = -1;
+
+	ds = &dw_streams[ stream ];
+
+	head = ds->head;
+	SVD_QueueBytes( ds, &head, &marker, 4 );
+	SVD_QueueBytes( ds, &head, &marker, 4 );
+	Sys_AtomicStore( &ds->head, head );
+
+	Sys_AtomicStore( &ds->state, DS_CLOSING );
+
+	if ( dw_thread ) {
+		Sys_RaiseSignal( dw_wakeup );
+	}
+}
+
+
+/*
+==================
+SVD_DemoWriterFrame
+
+Called once per server frame.
+==================
+*/
+void SVD_DemoWriterFrame( void )
+{
+	Sys_AtomicStore( &dw_flushInterval, sv_demoFlushInterval->integer );
+
+	if ( !dw_thread ) {
+		SVD_DrainStreams();
+	}
+
+	SVD_ReapStreams();
+}
+
+
+/*
+==================
+SVD_ShutdownDemoWriter
+==================
+*/
+void SVD_ShutdownDemoWriter( void )
+{
+	demoStream_t *ds;
+	int i;
+
+	if ( dw_thread ) {
+		Sys_AtomicStore( &dw_shutdown, 1 );
+		Sys_RaiseSignal( dw_wakeup );
+		Sys_JoinThread( dw_thread );
+		dw_thread = NULL;
+	}
+
+	// streams which are still open at this point are closed without trailer
+	for ( i = 0, ds = dw_streams; i < ARRAY_LEN( dw_streams ); i++, ds++ ) {
+		if ( ds->state != DS_FREE ) {
+			SVD_DrainStream( ds, 0, qtrue );
+			ds->state = DS_CLOSED;
+		}
+	}
+
+	SVD_ReapStreams();
+
+	if ( dw_wakeup ) {
+		Sys_DestroySignal( dw_wakeup );
+		dw_wakeup = NULL;
+	}
+}
+
+
+/*
+==================
+SVD_DemoWriterStats_f
+==================
+*/
+static void SVD_DemoWriterStats_f( void )
+{
+	const demoStream_t *ds;
+	int i, count;
+
+	Com_Printf( "cl  state    depth     peak   frames  dropped    queued(kb) written(kb)\n" );
+	Com_Printf( "--  -------- --------- -------- -------- -------- ---------- ----------\n" );
+
+	count = 0;
+	for ( i = 0, ds = dw_streams; i < ARRAY_LEN( dw_streams ); i++, ds++ ) {
+		if ( ds->state == DS_FREE ) {
+			continue;
+		}
+		Com_Printf( "%2i  %-8s %9u %8u %8i %8i %10i %10i\n", ds->clientNum,
+			ds->state == DS_OPEN ? "open" : "closing",
+			ds->head - ds->tail, ds->peakDepth, ds->framesQueued, ds->framesDropped,
+			(int)( ds->bytesQueued / 1024 ), (int)( ds->bytesWritten / 1024 ) );
+		count++;
+	}
+
+	Com_Printf( "%i active streams, writer thread: %s\n", count, dw_thread ? "running" : "none" );
+	Com_Printf( "finished: %i frames, %i dropped, %i kb written, %i write errors\n",
+		dw_totalFrames, dw_totalDropped, (int)( dw_totalBytes / 1024 ), dw_totalErrors );
+}
+
+
+/*
+==================
+SVD_InitDemoWriter
+==================
+*/
+void SVD_InitDemoWriter( void )
+{
+	sv_demoQueueSize = Cvar_Get( "sv_demoQueueSize", "512", CVAR_ARCHIVE );
+	Cvar_CheckRange( sv_demoQueueSize, XSTRING(DW_MIN_QUEUE_KB), XSTRING(DW_MAX_QUEUE_KB), CV_INTEGER );
+	Cvar_SetDescription( sv_demoQueueSize, "Size of per-client server demo write queue, in kilobytes, frames which don't fit are dropped\nDefault: 512" );
+
+	sv_demoFlushInterval = Cvar_Get( "sv_demoFlushInterval", "1000", CVAR_ARCHIVE );
+	Cvar_CheckRange( sv_demoFlushInterval, "0", "60000", CV_INTEGER );
+	Cvar_SetDescription( sv_demoFlushInterval, "How often server demo files are flushed to disk, in milliseconds\nDefault: 1000" );
+
+	Cmd_AddCommand( "serverdemostats", SVD_DemoWriterStats_f );
+	Cmd_SetDescription( "serverdemostats", "Show server demo writer queue statistics\nusage: serverdemostats" );
+}
+
+#endif // USE_SERVER_DEMO
@@ -113,90 +113,101 @@ static void free_nodes( filter_node_t *node )
 }
 
 
-static int eval_node( const filter_node_t *node )
+// resolves left value of a test node
+static const char *node_value( const filter_node_t *node )
 {
-	if ( node->fop == FOP_DROP )
+	if ( node->is_date )
 	{
-		Q_strncpyz( filterMessage, node->p1, sizeof( filterMessage ) );
-		return -1; // will break *->next node walk in parent
+		if ( filterCurrMsec != filterDateMsec ) // update date string
+		{
+			qtime_t t;
+			Com_RealTime( &t );
+			sprintf( node->p1, "%04i-%02i-%02i %02i:%02i",
+				t.tm_year + 1900, t.tm_mon + 1, t.tm_mday,
+				t.tm_hour, t.tm_min );
+			filterDateMsec = filterCurrMsec;
+		}
+		return node->p1;
 	}
 	else
+	if ( node->is_fname )
 	{
-		const char *value, *value2;
-		int res = 0, v1, v2;
-
-		if ( node->is_date )
+		if ( filterName[0] == '\0' )
 		{
-			if ( filterCurrMsec != filterDateMsec ) // update date string
-			{
-				qtime_t t;
-				Com_RealTime( &t );
-				sprintf( node->p1, "%04i-%02i-%02i %02i:%02i",
-					t.tm_year + 1900, t.tm_mon + 1, t.tm_mday,
-					t.tm_hour, t.tm_min );
-				filterDateMsec = filterCurrMsec;
-			}
-			value = node->p1;
+			CleanStr( filterName, sizeof( filterName ), Info_ValueForKeyToken( "name" ) );
 		}
-		else
-		if ( node->is_fname )
+		//value = node->p1; // p1 points on filterName
+		return filterName;
+	}
+	else
+	{
+		return Info_ValueForKeyToken( node->p1 );
+	}
+}
+
+
+static int compare_node( const filter_node_t *node, const char *value )
+{
+	const char *value2;
+	int res = 0, v1, v2;
+
+	if ( node->is_string )
+	{
+		value2 = node->p2.string;
+		if ( node->is_cvar ) // dereference value2 
 		{
-			if ( filterName[0] == '\0' )
-			{
-				CleanStr( filterName, sizeof( filterName ), Info_ValueForKeyToken( "name" ) );
-			}
-			//value = node->p1; // p1 points on filterName
-			value = filterName;
+			value2 = Cvar_VariableString( value2 + 1 );
 		}
-		else
+
+		if ( node->fop == FOP_MATCH )
 		{
-			value = Info_ValueForKeyToken( node->p1 ); 
+			res = Com_FilterExt( value2, value );
+			return res; // early exit, just to silent compiler warnings about uninitialized v1 & v2
 		}
-
-		if ( node->is_string )
+		else
 		{
-			value2 = node->p2.string;
-			if ( node->is_cvar ) // dereference value2 
-			{
-				value2 = Cvar_VariableString( value2 + 1 );
-			}
-
-			if ( node->fop == FOP_MATCH )
+			if ( node->is_quoted ) // forced string comparison
 			{
-				res = Com_FilterExt( value2, value );
-				return res; // early exit, just to silent compiler warnings about uninitialized v1 & v2
+				v1 = Q_stricmp( value, value2 );
+				v2 = 0;
 			}
-			else
+			else // integer comparison
 			{
-				if ( node->is_quoted ) // forced string comparison
-				{
-					v1 = Q_stricmp( value, value2 );
-					v2 = 0;
-				}
-				else // integer comparison
-				{
-					v1 = atoi( value );
-					v2 = atoi( value2 );
-				}
+				v1 = atoi( value );
+				v2 = atoi( value2 );
 			}
 		}
-		else
-		{
-			v1 = atoi( value );
-			v2 = node->p2.integer;
-		}
+	}
+	else
+	{
+		v1 = atoi( value );
+		v2 = node->p2.integer;
+	}
 
-		switch ( node->fop )
-		{
-			//case FOP_MATCH:res = Com_FilterExt( value2, value ); break;
-			case FOP_EQ:   res = (v1 == v2); break;
-			case FOP_NEQ:  res = (v1 != v2); break;
-			case FOP_LT:   res = (v1 <  v2); break;
-			case FOP_LTE:  res = (v1 <= v2); break;
-			case FOP_GT:   res = (v1 >  v2); break;
-			case FOP_GTE:  res = (v1 >= v2); break;
-		}
-		return res;
+	switch ( node->fop )
+	{
+		//case FOP_MATCH:res = Com_FilterExt( value2, value ); break;
+		case FOP_EQ:   res = (v1 == v2); break;
+		case FOP_NEQ:  res = (v1 != v2); break;
+		case FOP_LT:   res = (v1 <  v2); break;
+		case FOP_LTE:  res = (v1 <= v2); break;
+		case FOP_GT:   res = (v1 >  v2); break;
+		case FOP_GTE:  res = (v1 >= v2); break;
+	}
+	return res;
+}
+
+
+static int eval_node( const filter_node_t *node )
+{
+	if ( node->fop == FOP_DROP )
+	{
+		Q_strncpyz( filterMessage, node->p1, sizeof( filterMessage ) );
+		return -1; // will break *->next node walk in parent
+	}
+	else
+	{
+		return compare_node( node, node_value( node ) );
 	}
 }
 
@@ -300,6 +311,411 @@ static int walk_nodes( const filter_node_t *node )
 }
 
 
+/*
+ * Compiled filters: the node tree is flattened into an instruction array in
+ * pre-order, so a test that fails jumps over its children to the next sibling
+ * and a test that passes simply falls through into them. Runs of sibling
+ * equality tests on the same key are replaced by a single hashed lookup.
+ * The tree itself is kept for tagging expired nodes and for dumping.
+ */
+
+#define FILTER_GROUP_MIN 4	// shortest run of equality tests worth hashing
+#define MAX_FILTER_KEYS 64
+
+typedef enum
+{
+	FI_DROP,
+	FI_TEST,
+	FI_GROUP,
+} filter_opcode;
+
+typedef struct
+{
+	filter_opcode opcode;
+	int next;					// first instruction after this node/group and all its children
+	int key;					// key slot
+	int group;
+	const filter_node_t *node;
+} filter_insn_t;
+
+typedef struct
+{
+	int key;
+	int numeric;				// compare atoi() values instead of strings
+	int first;					// first entry
+	int heads;					// first hash head
+	unsigned mask;
+} filter_group_t;
+
+typedef struct
+{
+	unsigned hash;
+	int value;
+	const char *string;
+	int body;					// children of the original node
+	int end;
+	int next;					// next entry in the hash chain, in source order
+} filter_entry_t;
+
+typedef struct
+{
+	const char *name;			// lowercased userinfo key, NULL for virtual keys
+	const filter_node_t *node;	// first node using this key, for virtual keys
+	const char *value;
+	unsigned generation;
+} filter_key_t;
+
+static filter_insn_t *program;
+static filter_group_t *groups;
+static filter_entry_t *entries;
+static int *heads;
+static filter_key_t filterKeys[ MAX_FILTER_KEYS ];
+static int numKeys;
+static int numInsns, numGroups, numEntries, numHeads;
+static unsigned evalGeneration;
+static qboolean programValid;
+
+
+static void free_program( void )
+{
+	if ( program )
+	{
+		Z_Free( program );
+		Z_Free( groups );
+		Z_Free( entries );
+		Z_Free( heads );
+	}
+	program = NULL;
+	groups = NULL;
+	entries = NULL;
+	heads = NULL;
+	numKeys = numInsns = numGroups = numEntries = numHeads = 0;
+	programValid = qfalse;
+}
+
+
+static unsigned hash_string( const char *s )
+{
+	unsigned hash = 2166136261U;
+	unsigned c;
+
+	while ( (c = (byte)*s++) != '\0' )
+	{
+		if ( c <= 'Z' && c >= 'A' ) // same folding as Q_stricmp
+			c += 'a' - 'A';
+		hash = ( hash ^ c ) * 16777619U;
+	}
+
+	return hash;
+}
+
+
+static unsigned hash_integer( int v )
+{
+	unsigned hash = (unsigned)v * 0x9E3779B1U;
+	return hash ^ ( hash >> 15 );
+}
+
+
+static int count_nodes( const filter_node_t *node )
+{
+	int n = 0;
+	while ( node != NULL )
+	{
+		n += 1 + count_nodes( node->child );
+		node = node->next;
+	}
+	return n;
+}
+
+
+static int key_slot( const filter_node_t *node )
+{
+	int i;
+
+	for ( i = 0; i < numKeys; i++ )
+	{
+		if ( node->is_date || node->is_fname )
+		{
+			if ( filterKeys[ i ].name == NULL && filterKeys[ i ].node->is_date == node->is_date )
+				return i;
+		}
+		else if ( filterKeys[ i ].name != NULL && strcmp( filterKeys[ i ].name, node->p1 ) == 0 )
+		{
+			return i;
+		}
+	}
+
+	if ( numKeys >= MAX_FILTER_KEYS )
+		return -1; // resolved by the node itself
+
+	filterKeys[ numKeys ].name = ( node->is_date || node->is_fname ) ? NULL : node->p1;
+	filterKeys[ numKeys ].node = node;
+	filterKeys[ numKeys ].value = "";
+	filterKeys[ numKeys ].generation = 0;
+
+	return numKeys++;
+}
+
+
+// 0 - not groupable, 1 - case-insensitive string equality, 2 - integer equality
+static int group_class( const filter_node_t *node )
+{
+	if ( node->fop != FOP_EQ || node->is_date || node->is_cvar )
+		return 0;
+
+	if ( node->is_string && node->is_quoted )
+		return 1;
+	else
+		return 2;
+}
+
+
+static int same_group( const filter_node_t *a, const filter_node_t *b )
+{
+	if ( b->fop != FOP_EQ || b->is_date || b->is_cvar )
+		return 0;
+
+	if ( group_class( a ) != ( ( b->is_string && b->is_quoted ) ? 1 : 2 ) )
+		return 0;
+
+	if ( a->is_fname || b->is_fname )
+		return a->is_fname && b->is_fname;
+
+	return strcmp( a->p1, b->p1 ) == 0;
+}
+
+
+static int group_value( const filter_node_t *node )
+{
+	return node->is_string ? atoi( node->p2.string ) : node->p2.integer;
+}
+
+
+static void compile_scope( const filter_node_t *node );
+
+static void compile_group( const filter_node_t *node, int count )
+{
+	filter_insn_t *insn;
+	filter_group_t *group;
+	filter_entry_t *e;
+	unsigned size;
+	int pc, i;
+
+	pc = numInsns++;
+	insn = &program[ pc ];
+	insn->opcode = FI_GROUP;
+	insn->node = node;
+	insn->key = key_slot( node );
+	insn->group = numGroups++;
+
+	group = &groups[ insn->group ];
+	group->key = insn->key;
+	group->numeric = ( group_class( node ) == 2 );
+	group->first = numEntries;
+	numEntries += count;
+
+	for ( size = 1; size < (unsigned)count * 2; size <<= 1 )
+		;
+	group->heads = numHeads;
+	group->mask = size - 1;
+	numHeads += size;
+	for ( i = 0; i < (int)size; i++ )
+		heads[ group->heads + i ] = -1;
+
+	for ( i = 0; i < count; i++, node = node->next )
+	{
+		e = &entries[ group->first + i ];
+		if ( group->numeric )
+		{
+			e->value = group_value( node );
+			e->string = NULL;
+			e->hash = hash_integer( e->value );
+		}
+		else
+		{
+			e->value = 0;
+			e->string = node->p2.string;
+			e->hash = hash_string( e->string );
+		}
+		e->body = numInsns;
+		compile_scope( node->child );
+		e->end = numInsns;
+	}
+
+	// link in reverse so that every chain is walked in source order
+	for ( i = count - 1; i >= 0; i-- )
+	{
+		e = &entries[ group->first + i ];
+		e->next = heads[ group->heads + ( e->hash & group->mask ) ];
+		heads[ group->heads + ( e->hash & group->mask ) ] = group->first + i;
+	}
+
+	program[ pc ].next = numInsns;
+}
+
+
+static void compile_scope( const filter_node_t *node )
+{
+	const filter_node_t *last;
+	filter_insn_t *insn;
+	int count, pc;
+
+	while ( node != NULL )
+	{
+		if ( group_class( node ) )
+		{
+			count = 1;
+			for ( last = node->next; last && same_group( node, last ); last = last->next )
+				count++;
+			if ( count >= FILTER_GROUP_MIN && key_slot( node ) >= 0 )
+			{
+				compile_group( node, count );
+				node = last;
+				continue;
+			}
+		}
+
+		pc = numInsns++;
+		insn = &program[ pc ];
+		insn->node = node;
+		insn->group = -1;
+		if ( node->fop == FOP_DROP )
+		{
+			insn->opcode = FI_DROP;
+			insn->key = -1;
+		}
+		else
+		{
+			insn->opcode = FI_TEST;
+			insn->key = key_slot( node );
+			compile_scope( node->child );
+		}
+		program[ pc ].next = numInsns;
+
+		node = node->next;
+	}
+}
+
+
+static void compile_program( void )
+{
+	int count;
+
+	free_program();
+
+	count = count_nodes( nodes );
+	if ( count == 0 )
+	{
+		programValid = qtrue;
+		return;
+	}
+
+	program = (filter_insn_t *) Z_Malloc( count * sizeof( program[0] ) );
+	groups = (filter_group_t *) Z_Malloc( count * sizeof( groups[0] ) );
+	entries = (filter_entry_t *) Z_Malloc( count * sizeof( entries[0] ) );
+	heads = (int *) Z_Malloc( count * 4 * sizeof( heads[0] ) );
+
+	compile_scope( nodes );
+
+	programValid = qtrue;
+}
+
+
+static const char *key_value( const filter_insn_t *insn )
+{
+	filter_key_t *key;
+
+	if ( insn->key < 0 )
+		return node_value( insn->node );
+
+	key = &filterKeys[ insn->key ];
+	if ( key->generation != evalGeneration )
+	{
+		key->value = node_value( key->node );
+		key->generation = evalGeneration;
+	}
+
+	return key->value;
+}
+
+
+static int run_group( const filter_insn_t *insn );
+
+static int run_program( int pc, int end )
+{
+	const filter_insn_t *insn;
+
+	while ( pc < end )
+	{
+		insn = &program[ pc ];
+		switch ( insn->opcode )
+		{
+			case FI_DROP:
+				Q_strncpyz( filterMessage, insn->node->p1, sizeof( filterMessage ) );
+				return -1;
+
+			case FI_TEST:
+				if ( compare_node( insn->node, key_value( insn ) ) )
+					pc++;
+				else
+					pc = insn->next;
+				break;
+
+			case FI_GROUP:
+				if ( run_group( insn ) < 0 )
+					return -1;
+				pc = insn->next;
+				break;
+		}
+	}
+
+	return 0;
+}
+
+
+static int run_group( const filter_insn_t *insn )
+{
+	const filter_group_t *group = &groups[ insn->group ];
+	const filter_entry_t *e;
+	const char *value;
+	unsigned hash;
+	int v, i;
+
+	value = key_value( insn );
+
+	if ( group->numeric )
+	{
+		v = atoi( value );
+		hash = hash_integer( v );
+		for ( i = heads[ group->heads + ( hash & group->mask ) ]; i >= 0; i = e->next )
+		{
+			e = &entries[ i ];
+			if ( e->hash == hash && e->value == v && e->body < e->end )
+			{
+				if ( run_program( e->body, e->end ) < 0 )
+					return -1;
+			}
+		}
+	}
+	else
+	{
+		hash = hash_string( value );
+		for ( i = heads[ group->heads + ( hash & group->mask ) ]; i >= 0; i = e->next )
+		{
+			e = &entries[ i ];
+			if ( e->hash == hash && e->body < e->end && Q_stricmp( value, e->string ) == 0 )
+			{
+				if ( run_program( e->body, e->end ) < 0 )
+					return -1;
+			}
+		}
+	}
+
+	return 0;
+}
+
+
 // marks specified node and its kids as expired
 static void tag_from( filter_node_t *node )
 {
@@ -671,6 +1087,7 @@ static qboolean parse_file( const char *filename )
 	int size;
 	
 	// unconditionally release old filters
+	free_program();
 	free_nodes( nodes );
 	nodes = NULL;
 
@@ -707,6 +1124,7 @@ static qboolean parse_file( const char *filename )
 
 	if ( text == NULL ) // error
 	{
+		free_program();
 		free_nodes( nodes );
 		nodes = NULL;
 	}
@@ -772,6 +1190,7 @@ static void SV_ReloadFilters( const char *filename, filter_node_t *new_node )
 			// link new new node
 			new_node->next = nodes;
 			nodes = new_node;
+			free_program();
 			dump = qtrue;
 		}
 
@@ -832,10 +1251,9 @@ void SV_LoadFilters( const char *filename )
 }
 
 
-const char *SV_RunFilters( const char *userinfo, const netadr_t *addr )
+static const char *run_filters( const char *userinfo, qboolean compiled )
 {
-	if ( addr->type <= NA_LOOPBACK ) // cannot kick host player/bot
-		return "";
+	int res;
 
 	Info_Tokenize( userinfo );
 
@@ -843,7 +1261,19 @@ const char *SV_RunFilters( const char *userinfo, const netadr_t *addr )
 	filterMessage[0] = '\0';
 	filterCurrMsec = Sys_Milliseconds();
 
-	if ( walk_nodes( nodes ) != 0 )
+	if ( compiled )
+	{
+		if ( !programValid )
+			compile_program();
+		evalGeneration++;
+		res = run_program( 0, numInsns );
+	}
+	else
+	{
+		res = walk_nodes( nodes );
+	}
+
+	if ( res != 0 )
 	{
 		if ( filterMessage[0] )
 			return filterMessage;
@@ -855,6 +1285,129 @@ const char *SV_RunFilters( const char *userinfo, const netadr_t *addr )
 }
 
 
+const char *SV_RunFilters( const char *userinfo, const netadr_t *addr )
+{
+	if ( addr->type <= NA_LOOPBACK ) // cannot kick host player/bot
+		return "";
+
+	return run_filters( userinfo, qtrue );
+}
+
+
+#define MAX_BENCH_USERINFOS 1024
+
+// matching and non-matching userinfo for every stride-th test node
+static void collect_samples( const filter_node_t *node, char *samples, int *count, int *index, int stride )
+{
+	const char *key, *value;
+	char *info;
+	int i;
+
+	while ( node != NULL && *count < MAX_BENCH_USERINFOS - 1 )
+	{
+		if ( node->fop != FOP_DROP && !node->is_date && ( (*index)++ % stride ) == 0 )
+		{
+			key = node->is_fname ? "name" : node->p1;
+			value = node->is_string ? node->p2.string : va( "%i", node->p2.integer );
+			for ( i = 0; i < 2; i++ )
+			{
+				info = samples + *count * MAX_INFO_STRING;
+				Q_strncpyz( info, "\\name\\^1Unnamed^7Player\\ip\\10.0.0.1:27960\\rate\\25000\\snaps\\20\\cl_guid\\00000000000000000000000000000000", MAX_INFO_STRING );
+				Info_SetValueForKey( info, key, i ? va( "%s0", value ) : value );
+				( *count )++;
+			}
+		}
+		collect_samples( node->child, samples, count, index, stride );
+		node = node->next;
+	}
+}
+
+
+/*
+===============
+SV_FilterBench_f
+
+Checks compiled filters against the tree interpreter on userinfo of
+connected clients and on samples built from the filter values
+===============
+*/
+void SV_FilterBench_f( void )
+{
+	char result[ MAX_FILTER_MESSAGE ];
+	const char *res;
+	char *samples;
+	int64_t start, tree, compiled;
+	int count, iterations, mismatches, dropped;
+	int i, n;
+
+	if ( sv_filter->string[0] )
+		SV_LoadFilters( sv_filter->string );
+
+	if ( nodes == NULL )
+	{
+		Com_Printf( "No filters loaded.\n" );
+		return;
+	}
+
+	iterations = Cmd_Argc() > 1 ? atoi( Cmd_Argv( 1 ) ) : 100;
+	if ( iterations <= 0 )
+		iterations = 100;
+
+	samples = (char *) Z_Malloc( MAX_BENCH_USERINFOS * MAX_INFO_STRING );
+	count = 0;
+
+	if ( svs.clients )
+	{
+		for ( i = 0; i < sv_maxclients->integer && count < MAX_BENCH_USERINFOS; i++ )
+		{
+			if ( svs.clients[ i ].state >= CS_CONNECTED )
+				Q_strncpyz( samples + count++ * MAX_INFO_STRING, svs.clients[ i ].userinfo, MAX_INFO_STRING );
+		}
+	}
+
+	i = 0;
+	collect_samples( nodes, samples, &count, &i, count_nodes( nodes ) / ( MAX_BENCH_USERINFOS / 2 ) + 1 );
+
+	if ( !programValid )
+		compile_program();
+
+	mismatches = dropped = 0;
+	for ( i = 0; i < count; i++ )
+	{
+		Q_strncpyz( result, run_filters( samples + i * MAX_INFO_STRING, qfalse ), sizeof( result ) );
+		res = run_filters( samples + i * MAX_INFO_STRING, qtrue );
+		if ( strcmp( result, res ) != 0 )
+		{
+			if ( mismatches++ < 8 )
+				Com_Printf( S_COLOR_YELLOW "mismatch: tree \"%s\" compiled \"%s\" for %s\n", result, res, samples + i * MAX_INFO_STRING );
+		}
+		if ( *result )
+			dropped++;
+	}
+
+	start = Sys_Microseconds();
+	for ( n = 0; n < iterations; n++ )
+		for ( i = 0; i < count; i++ )
+			run_filters( samples + i * MAX_INFO_STRING, qfalse );
+	tree = Sys_Microseconds() - start;
+
+	start = Sys_Microseconds();
+	for ( n = 0; n < iterations; n++ )
+		for ( i = 0; i < count; i++ )
+			run_filters( samples + i * MAX_INFO_STRING, qtrue );
+	compiled = Sys_Microseconds() - start;
+
+	Z_Free( samples );
+
+	Com_Printf( "%i nodes: %i instructions, %i groups with %i entries, %i keys\n",
+		count_nodes( nodes ), numInsns, numGroups, numEntries, numKeys );
+	Com_Printf( "%i userinfos, %i dropped, %i mismatches\n", count, dropped, mismatches );
+	n = count * iterations;
+	Com_Printf( "tree: %.3f usec, compiled: %.3f usec per userinfo, x%.2f\n",
+		(double)tree / n, (double)compiled / n, compiled > 0 ? (double)tree / compiled : 0.0 );
+}
+
+
 #define IS_LEAP(year) ( ( ( (year) % 4 == 0 ) && ( (year) % 100 != 0 ) ) || ( (year) % 400 == 0 ) )
 
 /* Add hours to specified date */
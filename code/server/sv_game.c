@@ -27,6 +27,9 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 
 botlib_export_t	*botlib_export;
 
+// cvar names the game keeps asking for
+static cvarCache_t sv_gameCvars;
+
 // these functions must be used instead of pointer arithmetic, because
 // the game allocates gentities with private information after the server shared part
 int	SV_NumForGentity( sharedEntity_t *ent ) {
@@ -362,10 +365,99 @@ static qboolean SV_GetValue( char* value, int valueSize, const char* key )
 		return qtrue;
 	}
 
+	if ( !Q_stricmp( key, "trap_TraceBatch_Q3E" ) )
+	{
+		Com_sprintf( value, valueSize, "%i", G_TRACE_BATCH );
+		return qtrue;
+	}
+
+	if ( !Q_stricmp( key, "trap_BotMoveQueries_Q3E" ) )
+	{
+		Com_sprintf( value, valueSize, "%i", G_BOT_MOVE_QUERIES );
+		return qtrue;
+	}
+
 	return qfalse;
 }
 
 
+/*
+====================
+SV_GameTrace and friends
+
+Frequently used system calls, compiled game code
+calls these directly without SV_GameSystemCalls()
+====================
+*/
+static intptr_t SV_GameTrace( intptr_t *args ) {
+	SV_Trace( VMA(1), VMA(2), VMA(3), VMA(4), VMA(5), args[6], args[7], /*int capsule*/ qfalse );
+	return 0;
+}
+
+static intptr_t SV_GameTraceCapsule( intptr_t *args ) {
+	SV_Trace( VMA(1), VMA(2), VMA(3), VMA(4), VMA(5), args[6], args[7], /*int capsule*/ qtrue );
+	return 0;
+}
+
+static intptr_t SV_GamePointContents( intptr_t *args ) {
+	return SV_PointContents( VMA(1), args[2] );
+}
+
+static intptr_t SV_GameLinkEntity( intptr_t *args ) {
+	SV_LinkEntity( VMA(1) );
+	return 0;
+}
+
+static intptr_t SV_GameUnlinkEntity( intptr_t *args ) {
+	SV_UnlinkEntity( VMA(1) );
+	return 0;
+}
+
+static intptr_t SV_GameGetUsercmd( intptr_t *args ) {
+	SV_GetUsercmd( args[1], VMA(2) );
+	return 0;
+}
+
+static intptr_t SV_GameSin( intptr_t *args ) {
+	return FloatAsInt( sin( VMF(1) ) );
+}
+
+static intptr_t SV_GameCos( intptr_t *args ) {
+	return FloatAsInt( cos( VMF(1) ) );
+}
+
+static intptr_t SV_GameAtan2( intptr_t *args ) {
+	return FloatAsInt( atan2( VMF(1), VMF(2) ) );
+}
+
+static intptr_t SV_GameSqrt( intptr_t *args ) {
+	return FloatAsInt( sqrt( VMF(1) ) );
+}
+
+static intptr_t SV_GameFloor( intptr_t *args ) {
+	return FloatAsInt( floor( VMF(1) ) );
+}
+
+static intptr_t SV_GameCeil( intptr_t *args ) {
+	return FloatAsInt( ceil( VMF(1) ) );
+}
+
+static const vmDirectCall_t sv_gameDirectCalls[] = {
+	{ G_TRACE, SV_GameTrace },
+	{ G_TRACECAPSULE, SV_GameTraceCapsule },
+	{ G_POINT_CONTENTS, SV_GamePointContents },
+	{ G_LINKENTITY, SV_GameLinkEntity },
+	{ G_UNLINKENTITY, SV_GameUnlinkEntity },
+	{ G_GET_USERCMD, SV_GameGetUsercmd },
+	{ TRAP_SIN, SV_GameSin },
+	{ TRAP_COS, SV_GameCos },
+	{ TRAP_ATAN2, SV_GameAtan2 },
+	{ TRAP_SQRT, SV_GameSqrt },
+	{ G_FLOOR, SV_GameFloor },
+	{ G_CEIL, SV_GameCeil }
+};
+
+
 /*
 ====================
 SV_GameSystemCalls
@@ -395,12 +487,23 @@ static intptr_t SV_GameSystemCalls( intptr_t *args ) {
 	case G_CVAR_SET:
 		Cvar_SetSafe( (const char *)VMA(1), (const char *)VMA(2) );
 		return 0;
-	case G_CVAR_VARIABLE_INTEGER_VALUE:
-		return Cvar_VariableIntegerValue( (const char *)VMA(1) );
-	case G_CVAR_VARIABLE_STRING_BUFFER:
+	case G_CVAR_VARIABLE_INTEGER_VALUE: {
+		const cvar_t *cv = Cvar_FindCached( &sv_gameCvars, (const char *)VMA(1) );
+		return cv ? cv->integer : 0;
+		}
+	case G_CVAR_VARIABLE_STRING_BUFFER: {
+		const cvar_t *cv;
 		VM_CHECKBOUNDS( gvm, args[2], args[3] );
-		Cvar_VariableStringBufferSafe( VMA(1), VMA(2), args[3], gvm->privateFlag );
+		cv = Cvar_FindCached( &sv_gameCvars, (const char *)VMA(1) );
+		if ( !cv || cv->flags & gvm->privateFlag ) {
+			if ( args[3] > 0 ) {
+				*(char *)VMA(2) = '\0';
+			}
+		} else {
+			Q_strncpyz( VMA(2), cv->string, args[3] );
+		}
 		return 0;
+		}
 	case G_ARGC:
 		return Cmd_Argc();
 	case G_ARGV:
@@ -449,11 +552,9 @@ static intptr_t SV_GameSystemCalls( intptr_t *args ) {
 		SV_GameSendServerCommand( args[1], VMA(2) );
 		return 0;
 	case G_LINKENTITY:
-		SV_LinkEntity( VMA(1) );
-		return 0;
+		return SV_GameLinkEntity( args );
 	case G_UNLINKENTITY:
-		SV_UnlinkEntity( VMA(1) );
-		return 0;
+		return SV_GameUnlinkEntity( args );
 	case G_ENTITIES_IN_BOX:
 		VM_CHECKBOUNDS( gvm, args[3], args[4] * sizeof( int ) );
 		return SV_AreaEntities( VMA(1), VMA(2), VMA(3), args[4] );
@@ -462,13 +563,11 @@ static intptr_t SV_GameSystemCalls( intptr_t *args ) {
 	case G_ENTITY_CONTACTCAPSULE:
 		return SV_EntityContact( VMA(1), VMA(2), VMA(3), /*int capsule*/ qtrue );
 	case G_TRACE:
-		SV_Trace( VMA(1), VMA(2), VMA(3), VMA(4), VMA(5), args[6], args[7], /*int capsule*/ qfalse );
-		return 0;
+		return SV_GameTrace( args );
 	case G_TRACECAPSULE:
-		SV_Trace( VMA(1), VMA(2), VMA(3), VMA(4), VMA(5), args[6], args[7], /*int capsule*/ qtrue );
-		return 0;
+		return SV_GameTraceCapsule( args );
 	case G_POINT_CONTENTS:
-		return SV_PointContents( VMA(1), args[2] );
+		return SV_GamePointContents( args );
 	case G_SET_BRUSH_MODEL:
 		SV_SetBrushModel( VMA(1), VMA(2) );
 		return 0;
@@ -508,8 +607,7 @@ static intptr_t SV_GameSystemCalls( intptr_t *args ) {
 		return 0;
 
 	case G_GET_USERCMD:
-		SV_GetUsercmd( args[1], VMA(2) );
-		return 0;
+		return SV_GameGetUsercmd( args );
 	case G_GET_ENTITY_TOKEN:
 		{
 			const char *s = COM_Parse( &sv.entityParsePoint );
@@ -977,16 +1075,16 @@ static intptr_t SV_GameSystemCalls( intptr_t *args ) {
 		return args[1];
 
 	case TRAP_SIN:
-		return FloatAsInt( sin( VMF(1) ) );
+		return SV_GameSin( args );
 
 	case TRAP_COS:
-		return FloatAsInt( cos( VMF(1) ) );
+		return SV_GameCos( args );
 
 	case TRAP_ATAN2:
-		return FloatAsInt( atan2( VMF(1), VMF(2) ) );
+		return SV_GameAtan2( args );
 
 	case TRAP_SQRT:
-		return FloatAsInt( sqrt( VMF(1) ) );
+		return SV_GameSqrt( args );
 
 	case G_MATRIXMULTIPLY:
 		MatrixMultiply( VMA(1), VMA(2), VMA(3) );
@@ -1001,10 +1099,10 @@ static intptr_t SV_GameSystemCalls( intptr_t *args ) {
 		return 0;
 
 	case G_FLOOR:
-		return FloatAsInt( floor( VMF(1) ) );
+		return SV_GameFloor( args );
 
 	case G_CEIL:
-		return FloatAsInt( ceil( VMF(1) ) );
+		return SV_GameCeil( args );
 
 	case G_TESTPRINTINT:
 		return sprintf( VMA(1), "%i", (int)args[2] );
@@ -1012,6 +1110,23 @@ static intptr_t SV_GameSystemCalls( intptr_t *args ) {
 	case G_TESTPRINTFLOAT:
 		return sprintf( VMA(1), "%f", VMF(2) );
 
+	case G_TRACE_BATCH:
+		if ( (unsigned)args[3] > MAX_TRACE_BATCH ) {
+			Com_Error( ERR_DROP, "trap_TraceBatch: bad count %i", (int)args[3] );
+		}
+		VM_CHECKBOUNDS( gvm, args[1], args[3] * sizeof( trace_t ) );
+		VM_CHECKBOUNDS( gvm, args[2], args[3] * sizeof( traceRequest_t ) );
+		SV_TraceBatch( VMA(1), VMA(2), args[3] );
+		return 0;
+
+	case G_BOT_MOVE_QUERIES:
+		if ( (unsigned)args[2] > MAX_MOVEQUERIES ) {
+			Com_Error( ERR_DROP, "trap_BotMoveQueries: bad count %i", (int)args[2] );
+		}
+		VM_CHECKBOUNDS( gvm, args[1], args[2] * sizeof( bot_movequery_t ) );
+		SV_BotMoveQueries( VMA(1), args[2] );
+		return 0;
+
 	case G_TRAP_GETVALUE:
 		VM_CHECKBOUNDS( gvm, args[1], args[2] );
 		return SV_GetValue( VMA(1), args[2], VMA(3) );
@@ -1078,6 +1193,8 @@ static void SV_InitGameVM( qboolean restart ) {
 	// start the entity parsing at the beginning
 	sv.entityParsePoint = CM_EntityString();
 
+	Cvar_ResetCache( &sv_gameCvars );
+
 	// clear all gentity pointers that might still be set from
 	// a previous level
 	// https://zerowing.idsoftware.com/bugzilla/show_bug.cgi?id=522
@@ -1139,6 +1256,7 @@ void SV_InitGameProgs( void ) {
 	}
 
 	// load the dll or bytecode
+	VM_SetDirectCalls( VM_GAME, sv_gameDirectCalls, ARRAY_LEN( sv_gameDirectCalls ) );
 	gvm = VM_Create( VM_GAME, SV_GameSystemCalls, SV_DllSyscall, Cvar_VariableIntegerValue( "vm_game" ) );
 	if ( !gvm ) {
 		Com_Error( ERR_DROP, "VM_Create on game failed" );
@@ -189,6 +189,150 @@ void SV_GetConfigstring( int index, char *buffer, int bufferSize ) {
 }
 
 
+/*
+==============================================================================
+
+Serverinfo and systeminfo tracking
+
+Cvar subscriptions collect serverinfo/systeminfo cvars whose value changed,
+so the configstrings can be patched key by key instead of walking all cvars.
+Creating or removing such cvars, or adding the flags, forces a full rebuild.
+==============================================================================
+*/
+
+#define MAX_INFO_CHANGES 32
+
+typedef struct {
+	int			bit;		// CVAR_SERVERINFO or CVAR_SYSTEMINFO
+	int			index;		// configstring to keep up to date
+	int			size;
+	qboolean	rebuild;
+	int			numChanged;
+	cvar_t		*changed[ MAX_INFO_CHANGES ];
+} infoTrack_t;
+
+static infoTrack_t sv_serverinfo = { CVAR_SERVERINFO, CS_SERVERINFO, MAX_INFO_STRING };
+static infoTrack_t sv_systeminfo = { CVAR_SYSTEMINFO, CS_SYSTEMINFO, BIG_INFO_STRING };
+
+
+static void SV_InfoCvarChanged( infoTrack_t *track, cvar_t *var ) {
+	int i;
+
+	if ( var == NULL || track->numChanged >= MAX_INFO_CHANGES ) {
+		track->rebuild = qtrue;
+		return;
+	}
+
+	for ( i = 0; i < track->numChanged; i++ ) {
+		if ( track->changed[ i ] == var ) {
+			return;
+		}
+	}
+
+	track->changed[ track->numChanged++ ] = var;
+}
+
+
+static void SV_ServerinfoChanged( cvar_t *var ) {
+	SV_InfoCvarChanged( &sv_serverinfo, var );
+}
+
+
+static void SV_SysteminfoChanged( cvar_t *var ) {
+	SV_InfoCvarChanged( &sv_systeminfo, var );
+}
+
+
+/*
+===============
+SV_UpdateInfoConfigstring
+===============
+*/
+static void SV_UpdateInfoConfigstring( infoTrack_t *track, qboolean rebuild ) {
+	char info[ BIG_INFO_STRING ];
+	const cvar_t *var;
+	int i;
+
+	if ( !rebuild && !track->rebuild && !track->numChanged ) {
+		return;
+	}
+
+	if ( !rebuild && !track->rebuild && sv.configstrings[ track->index ] ) {
+		// patch only the keys that changed
+		Q_strncpyz( info, sv.configstrings[ track->index ], sizeof( info ) );
+		for ( i = 0; i < track->numChanged; i++ ) {
+			var = track->changed[ i ];
+			if ( !var->name || !( var->flags & track->bit ) ||
+				!Info_SetValueForKey_s( info, track->size, var->name, var->string ) ) {
+				rebuild = qtrue;
+				break;
+			}
+		}
+	} else {
+		rebuild = qtrue;
+	}
+
+	if ( rebuild ) {
+		if ( track->bit == CVAR_SYSTEMINFO ) {
+			Q_strncpyz( info, Cvar_InfoString_Big( track->bit, NULL ), sizeof( info ) );
+		} else {
+			Q_strncpyz( info, Cvar_InfoString( track->bit, NULL ), sizeof( info ) );
+		}
+	}
+
+	SV_SetConfigstring( track->index, info );
+
+	track->rebuild = qfalse;
+	track->numChanged = 0;
+	cvar_modifiedFlags &= ~track->bit;
+}
+
+
+/*
+===============
+SV_UpdateInfoConfigstrings
+
+Brings CS_SYSTEMINFO and CS_SERVERINFO up to date with the cvars
+===============
+*/
+void SV_UpdateInfoConfigstrings( qboolean rebuild ) {
+	SV_UpdateInfoConfigstring( &sv_systeminfo, rebuild );
+	SV_UpdateInfoConfigstring( &sv_serverinfo, rebuild );
+}
+
+
+static qboolean sv_rateChanged;
+
+/*
+===============
+SV_RateCvarChanged
+
+Cvars may be set from VM calls or rcon, clients
+are updated on next server frame instead
+===============
+*/
+static void SV_RateCvarChanged( cvar_t *var ) {
+	sv_rateChanged = qtrue;
+}
+
+
+/*
+===============
+SV_UpdateRateSettings
+===============
+*/
+void SV_UpdateRateSettings( void ) {
+	if ( !sv_rateChanged ) {
+		return;
+	}
+
+	SV_TrackCvarChanges(); // update rate settings, etc.
+
+	// clamping above may set the rate cvars again
+	sv_rateChanged = qfalse;
+}
+
+
 /*
 ===============
 SV_SetUserinfo
@@ -465,6 +609,193 @@ static void SV_ClearServer( void ) {
 }
 
 
+/*
+================
+Map prefetch
+
+The next map (g_nextmap, g_nextCycleMap or "mapprefetch <map>") is read,
+uncompressed and validated by a background thread while the current map
+is still running, CM_LoadMap() then picks up the ready buffer.
+================
+*/
+static cvar_t *sv_mapPrefetch;
+
+static struct {
+	char	mapname[ MAX_QPATH ];	// what we are prefetching
+	char	nextmap[ MAX_QPATH ];	// last seen value of the next map cvar
+	int		hits;
+	int		misses;
+	int		failed;
+	int		savedMsec;
+	int		lastSavedMsec;
+} mapPrefetch;
+
+
+/*
+================
+SV_ValidateMap
+
+Same checks as in CM_LoadMap(), called from the prefetch thread
+================
+*/
+static qboolean SV_ValidateMap( const byte *data, int length ) {
+	const dheader_t *header = (const dheader_t *)data;
+	int32_t ofs, len;
+	int i;
+
+	if ( length < sizeof( dheader_t ) || LittleLong( header->version ) != BSP_VERSION ) {
+		return qfalse;
+	}
+
+	for ( i = 0; i < HEADER_LUMPS; i++ ) {
+		ofs = LittleLong( header->lumps[i].fileofs );
+		len = LittleLong( header->lumps[i].filelen );
+		if ( (uint32_t)ofs > MAX_QINT || (uint32_t)len > MAX_QINT || ofs + len > length || ofs + len < 0 ) {
+			return qfalse;
+		}
+	}
+
+	return qtrue;
+}
+
+
+/*
+================
+SV_PrefetchMap
+================
+*/
+static qboolean SV_PrefetchMap( const char *mapname ) {
+	char name[ MAX_QPATH ];
+
+	// drop whatever was prefetched before
+	FS_CancelPrefetch();
+	mapPrefetch.mapname[0] = '\0';
+
+	Com_sprintf( name, sizeof( name ), "maps/%s.bsp", mapname );
+	if ( !FS_PrefetchFile( name, SV_ValidateMap, qtrue ) ) {
+		Com_DPrintf( "Map prefetch: %s is not in a pk3 file\n", name );
+		return qfalse;
+	}
+
+	// bot navigation, botlib reads it through FS_Read() so the data isn't kept,
+	// reading it only warms up the OS file cache
+	if ( Cvar_VariableIntegerValue( "bot_enable" ) ) {
+		Com_sprintf( name, sizeof( name ), "maps/%s.aas", mapname );
+		FS_PrefetchFile( name, NULL, qfalse );
+	}
+
+	Q_strncpyz( mapPrefetch.mapname, mapname, sizeof( mapPrefetch.mapname ) );
+	Com_DPrintf( "Map prefetch: started for %s\n", mapname );
+
+	return qtrue;
+}
+
+
+/*
+================
+SV_MapPrefetchFrame
+
+Starts prefetch as soon as the next map is known
+================
+*/
+void SV_MapPrefetchFrame( void ) {
+	const char *nextmap;
+
+	if ( !sv_mapPrefetch->integer || sv.state != SS_GAME ) {
+		return;
+	}
+
+	nextmap = Cvar_VariableString( "g_nextmap" );
+	if ( !*nextmap ) {
+		nextmap = Cvar_VariableString( "g_nextCycleMap" );
+	}
+
+	if ( !strcmp( nextmap, mapPrefetch.nextmap ) ) {
+		return;
+	}
+
+	Q_strncpyz( mapPrefetch.nextmap, nextmap, sizeof( mapPrefetch.nextmap ) );
+
+	if ( *nextmap && Q_stricmp( nextmap, sv_mapname->string ) && Q_stricmp( nextmap, mapPrefetch.mapname ) ) {
+		SV_PrefetchMap( nextmap );
+	}
+}
+
+
+/*
+================
+SV_MapPrefetchResult
+
+Called right after CM_LoadMap()
+================
+*/
+static void SV_MapPrefetchResult( const char *mapname ) {
+	prefetchState_t state;
+
+	if ( !mapPrefetch.mapname[0] ) {
+		return;
+	}
+
+	state = FS_PrefetchState( va( "maps/%s.bsp", mapname ), &mapPrefetch.lastSavedMsec );
+	if ( state == PREFETCH_USED ) {
+		mapPrefetch.hits++;
+		mapPrefetch.savedMsec += mapPrefetch.lastSavedMsec;
+		Com_DPrintf( "Map prefetch: hit for %s, %i msec saved\n", mapname, mapPrefetch.lastSavedMsec );
+	} else if ( state == PREFETCH_FAILED ) {
+		mapPrefetch.failed++;
+		Com_DPrintf( "Map prefetch: %s failed\n", mapname );
+	} else {
+		mapPrefetch.misses++;
+		Com_DPrintf( "Map prefetch: miss for %s, prefetched %s\n", mapname, mapPrefetch.mapname );
+	}
+}
+
+
+/*
+================
+SV_MapPrefetch_f
+================
+*/
+static void SV_MapPrefetch_f( void ) {
+	static const char *stateNames[] = { "none", "loading", "ready", "failed", "used" };
+	prefetchState_t state;
+
+	if ( Cmd_Argc() > 1 ) {
+		if ( SV_PrefetchMap( Cmd_Argv( 1 ) ) ) {
+			Com_Printf( "Prefetching %s\n", mapPrefetch.mapname );
+		} else {
+			Com_Printf( "Can't prefetch %s\n", Cmd_Argv( 1 ) );
+		}
+		return;
+	}
+
+	if ( mapPrefetch.mapname[0] ) {
+		state = FS_PrefetchState( va( "maps/%s.bsp", mapPrefetch.mapname ), NULL );
+		Com_Printf( "next map: %s (%s)\n", mapPrefetch.mapname, stateNames[ state ] );
+	} else {
+		Com_Printf( "next map: none\n" );
+	}
+
+	Com_Printf( "hits: %i, misses: %i, failed: %i\n", mapPrefetch.hits, mapPrefetch.misses, mapPrefetch.failed );
+	Com_Printf( "time saved: %i msec total, %i msec last map\n", mapPrefetch.savedMsec, mapPrefetch.lastSavedMsec );
+}
+
+
+/*
+================
+SV_InitMapPrefetch
+================
+*/
+static void SV_InitMapPrefetch( void ) {
+	sv_mapPrefetch = Cvar_Get( "sv_mapPrefetch", "1", CVAR_ARCHIVE_ND );
+	Cvar_CheckRange( sv_mapPrefetch, "0", "1", CV_INTEGER );
+	Cvar_SetDescription( sv_mapPrefetch, "Read the next map in background as soon as g_nextmap is known.\nDefault: 1" );
+
+	Cmd_AddCommand( "mapprefetch", SV_MapPrefetch_f );
+	Cmd_SetDescription( "mapprefetch", "Show map prefetch statistics or start prefetching a map\nusage: mapprefetch [mapname]" );
+}
+
+
 /*
 ================
 SV_SpawnServer
@@ -483,6 +814,10 @@ void SV_SpawnServer( const char *mapname, qboolean killBots ) {
 	// shut down the existing game if it is running
 	SV_ShutdownGameProgs();
 
+	// trace and area logs are bound to the map they were recorded on
+	SV_StopTraceLog();
+	SV_StopAreaLog();
+
 	Com_Printf( "------ Server Initialization ------\n" );
 	Com_Printf( "Server: %s\n", mapname );
 
@@ -604,6 +939,7 @@ void SV_SpawnServer( const char *mapname, qboolean killBots ) {
 
 	Sys_SetStatus( "Loading map %s", mapname );
 	CM_LoadMap( va( "maps/%s.bsp", mapname ), qfalse, &checksum );
+	SV_MapPrefetchResult( mapname );
 
 	// set serverinfo visible name
 	Cvar_Set( "mapname", mapname );
@@ -760,11 +1096,7 @@ void SV_SpawnServer( const char *mapname, qboolean killBots ) {
 	}
 
 	// save systeminfo and serverinfo strings
-	SV_SetConfigstring( CS_SYSTEMINFO, Cvar_InfoString_Big( CVAR_SYSTEMINFO, NULL ) );
-	cvar_modifiedFlags &= ~CVAR_SYSTEMINFO;
-
-	SV_SetConfigstring( CS_SERVERINFO, Cvar_InfoString( CVAR_SERVERINFO, NULL ) );
-	cvar_modifiedFlags &= ~CVAR_SERVERINFO;
+	SV_UpdateInfoConfigstrings( qtrue );
 
 	// any media configstring setting now should issue a warning
 	// and any configstring changes should be reliably transmitted
@@ -776,6 +1108,11 @@ void SV_SpawnServer( const char *mapname, qboolean killBots ) {
 
 	Hunk_SetMark();
 
+	// release prefetched data the new map did not use
+	FS_CancelPrefetch();
+	mapPrefetch.mapname[0] = '\0';
+	mapPrefetch.nextmap[0] = '\0';
+
 	Com_Printf ("-----------------------------------\n");
 
 	Sys_SetStatus( "Running map %s", mapname );
@@ -964,8 +1301,16 @@ void SV_Init( void )
 #ifdef USE_SERVER_DEMO
     sv_demonotice = Cvar_Get ( "sv_demonotice", "", CVAR_ARCHIVE );
 	sv_demofolder = Cvar_Get ( "sv_demofolder", "serverdemos", CVAR_ARCHIVE );
+	SVD_InitDemoWriter();
 #endif
 
+	SV_InitSnapshotThreads();
+	SV_InitIP4DB();
+	SVC_InitRateLimit();
+	SV_InitMapPrefetch();
+	SV_InitTraceCache();
+	SV_InitWorld();
+
 #ifdef USE_AUTH
     sv_authServerIP = Cvar_Get( "sv_authServerIP", "", CVAR_TEMP | CVAR_ROM );
 	sv_auth_engine = Cvar_Get( "sv_auth_engine", "1", CVAR_ROM );
@@ -1008,11 +1353,14 @@ void SV_Init( void )
 	Cbuf_AddText("rehashbans\n");
 #endif
 
-	// track group cvar changes
-	Cvar_SetGroup( sv_lanForceRate, CVG_SERVER );
-	Cvar_SetGroup( sv_minRate, CVG_SERVER );
-	Cvar_SetGroup( sv_maxRate, CVG_SERVER );
-	Cvar_SetGroup( sv_fps, CVG_SERVER );
+	// track cvar changes
+	Cvar_Subscribe( sv_lanForceRate, SV_RateCvarChanged );
+	Cvar_Subscribe( sv_minRate, SV_RateCvarChanged );
+	Cvar_Subscribe( sv_maxRate, SV_RateCvarChanged );
+	Cvar_Subscribe( sv_fps, SV_RateCvarChanged );
+
+	Cvar_SubscribeFlags( CVAR_SERVERINFO, SV_ServerinfoChanged );
+	Cvar_SubscribeFlags( CVAR_SYSTEMINFO, SV_SysteminfoChanged );
 
 	// force initial check
 	SV_TrackCvarChanges();
@@ -1075,6 +1423,7 @@ void SV_Shutdown( const char *finalmsg ) {
 #if USE_SERVER_DEMO
     if (com_dedicated->integer)
 		Cbuf_ExecuteText(EXEC_NOW, "stopserverdemo all");
+	SVD_ShutdownDemoWriter();
 #endif
 
 #ifdef USE_IPV6
@@ -1101,6 +1450,12 @@ void SV_Shutdown( const char *finalmsg ) {
 	SV_MasterShutdown();
 	SV_ShutdownGameProgs();
 	SV_InitChallenger();
+	SV_ShutdownSnapshotThreads();
+	SV_ShutdownBotThreads();
+	SV_StopTraceLog();
+	SV_StopAreaLog();
+	FS_CancelPrefetch();
+	mapPrefetch.mapname[0] = '\0';
 
 	// free current level
 	SV_ClearServer();
@@ -0,0 +1,904 @@
+/*
+===========================================================================
+Copyright (C) 1999-2005 Id Software, Inc.
+
+This file is part of Quake III Arena source code.
+
+Quake III Arena source code is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the License,
+or (at your option) any later version.
+
+Quake III Arena source code is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Quake III Arena source code; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+===========================================================================
+*/
+// sv_ip4db.c -- geoip database used to set client tld/country
+
+#include "server.h"
+
+/*
+ip4db.dat comes in two formats:
+
+Native (version 1), mapped read-only and used in place. All values are in
+the byte order of the machine that wrote the file, tables are 8-byte aligned
+and ranges are sorted and don't overlap:
+
+	ipdbHeader_t
+	ipdbRange4_t	ranges4[ numRanges4 ];
+	ipdbRange6_t	ranges6[ numRanges6 ];
+	char			tlds4[ numRanges4 ][ 2 ];
+	char			tlds6[ numRanges6 ][ 2 ];
+
+Legacy, IPv4 only: big-endian [from][to] ranges followed by two-letter tlds,
+read and converted in memory. ip4db_convert writes the native format from
+whatever is loaded, optionally adding IPv6 ranges from a text file.
+
+Databases are loaded on a background thread by ip4db_reload and swapped in
+by the main thread once ready, the previous one is released at that point.
+The loader uses plain OS file access and malloc only.
+*/
+
+#define IPDB_IDENT			"IPDB"
+#define IPDB_VERSION		1
+#define IPDB_BYTEORDER		0x01020304
+#define IPDB_FILENAME		"ip4db.dat"
+#define IPDB_MAX_RANGES		( 16 * 1024 * 1024 )
+
+#define IPDB_CACHE_SIZE		256		// power of two
+
+typedef struct {
+	char		ident[4];
+	int32_t		version;
+	uint32_t	byteOrder;
+	uint32_t	numRanges4;
+	uint32_t	numRanges6;
+	uint32_t	ofsRanges4;
+	uint32_t	ofsRanges6;
+	uint32_t	ofsTLDs4;
+	uint32_t	ofsTLDs6;
+	uint32_t	reserved[7];
+} ipdbHeader_t;
+
+typedef struct {
+	uint32_t	from;
+	uint32_t	to;
+} ipdbRange4_t;
+
+typedef struct {
+	uint64_t	from[2];	// [0] holds the most significant bits
+	uint64_t	to[2];
+} ipdbRange6_t;
+
+typedef struct {
+	const void			*mapping;	// mapped native database
+	fileOffset_t		mapSize;
+	void				*memory;	// converted legacy database
+
+	const ipdbRange4_t	*ranges4;
+	const ipdbRange6_t	*ranges6;
+	const char			*tlds4;
+	const char			*tlds6;
+	int					numRanges4;
+	int					numRanges6;
+
+	char				source[ MAX_OSPATH ];
+} ipdb_t;
+
+typedef struct {
+	byte		addr[16];	// IPv4 addresses use first 4 bytes
+	int			type;		// NA_BAD if empty
+	char		tld[3];
+} ipdbCache_t;
+
+static ipdb_t		*ipdb;
+static qboolean		ipdb_loaded;	// tried to load at least once
+
+static ipdbCache_t	ipdb_cache[ IPDB_CACHE_SIZE ];
+
+// background loader
+static void			*ipdb_thread;
+static volatile int	ipdb_threadDone;
+static ipdb_t		*ipdb_pending;
+static char			ipdb_paths[3][ MAX_OSPATH ];
+static char			ipdb_error[ MAX_STRING_CHARS ];
+
+
+/*
+==================
+SV_FreeIPDB
+==================
+*/
+static void SV_FreeIPDB( ipdb_t *db )
+{
+	if ( db == NULL )
+		return;
+
+	if ( db->mapping )
+		Sys_UnmapFile( db->mapping, db->mapSize );
+
+	free( db->memory );
+	free( db );
+}
+
+
+/*
+==================
+SV_ValidateIPDB
+
+Checks loaded tables, may be called from the loader thread
+==================
+*/
+static qboolean SV_ValidateIPDB( const ipdb_t *db, char *error, int errorSize )
+{
+	const ipdbRange4_t *r4;
+	const ipdbRange6_t *r6;
+	const char *tld;
+	int i;
+
+	for ( i = 0; i < db->numRanges4; i++ )
+	{
+		r4 = &db->ranges4[i];
+		tld = db->tlds4 + i * 2;
+		if ( r4->from > r4->to || ( i && db->ranges4[i-1].to >= r4->from ) ||
+			tld[0] < 'A' || tld[0] > 'Z' || tld[1] < 'A' || tld[1] > 'Z' )
+		{
+			Com_sprintf( error, errorSize, "invalid IPv4 entry #%i: range=[%08x..%08x], tld=%c%c",
+				i, r4->from, r4->to, tld[0], tld[1] );
+			return qfalse;
+		}
+	}
+
+	for ( i = 0; i < db->numRanges6; i++ )
+	{
+		r6 = &db->ranges6[i];
+		tld = db->tlds6 + i * 2;
+		if ( r6->from[0] > r6->to[0] || ( r6->from[0] == r6->to[0] && r6->from[1] > r6->to[1] ) ||
+			tld[0] < 'A' || tld[0] > 'Z' || tld[1] < 'A' || tld[1] > 'Z' )
+			break;
+		if ( i ) {
+			const ipdbRange6_t *prev = &db->ranges6[i-1];
+			if ( prev->to[0] > r6->from[0] || ( prev->to[0] == r6->from[0] && prev->to[1] >= r6->from[1] ) )
+				break;
+		}
+	}
+
+	if ( i != db->numRanges6 )
+	{
+		Com_sprintf( error, errorSize, "invalid IPv6 entry #%i", i );
+		return qfalse;
+	}
+
+	return qtrue;
+}
+
+
+/*
+==================
+SV_MapIPDB
+
+Maps native database, returns NULL with empty error if there is no such file
+==================
+*/
+static ipdb_t *SV_MapIPDB( const char *ospath, char *error, int errorSize )
+{
+	const ipdbHeader_t *h;
+	const byte *base;
+	fileOffset_t size;
+	ipdb_t *db;
+
+	base = Sys_MapFile( ospath, &size );
+	if ( base == NULL )
+		return NULL;
+
+	h = (const ipdbHeader_t *)base;
+	if ( size < sizeof( *h ) || memcmp( h->ident, IPDB_IDENT, 4 ) != 0 )
+	{
+		// legacy database
+		Sys_UnmapFile( base, size );
+		return NULL;
+	}
+
+	if ( h->version != IPDB_VERSION || h->byteOrder != IPDB_BYTEORDER )
+	{
+		Com_sprintf( error, errorSize, "%s: unsupported version %i or byte order", ospath, h->version );
+		Sys_UnmapFile( base, size );
+		return NULL;
+	}
+
+	if ( h->numRanges4 > IPDB_MAX_RANGES || h->numRanges6 > IPDB_MAX_RANGES
+		|| ( h->ofsRanges4 & 7 ) || ( h->ofsRanges6 & 7 )
+		|| h->ofsRanges4 + (fileOffset_t)h->numRanges4 * sizeof( ipdbRange4_t ) > size
+		|| h->ofsRanges6 + (fileOffset_t)h->numRanges6 * sizeof( ipdbRange6_t ) > size
+		|| h->ofsTLDs4 + (fileOffset_t)h->numRanges4 * 2 > size
+		|| h->ofsTLDs6 + (fileOffset_t)h->numRanges6 * 2 > size )
+	{
+		Com_sprintf( error, errorSize, "%s: truncated or corrupted file", ospath );
+		Sys_UnmapFile( base, size );
+		return NULL;
+	}
+
+	db = calloc( 1, sizeof( *db ) );
+	if ( db == NULL )
+	{
+		Sys_UnmapFile( base, size );
+		return NULL;
+	}
+
+	db->mapping = base;
+	db->mapSize = size;
+	db->ranges4 = (const ipdbRange4_t *)( base + h->ofsRanges4 );
+	db->ranges6 = (const ipdbRange6_t *)( base + h->ofsRanges6 );
+	db->tlds4 = (const char *)( base + h->ofsTLDs4 );
+	db->tlds6 = (const char *)( base + h->ofsTLDs6 );
+	db->numRanges4 = h->numRanges4;
+	db->numRanges6 = h->numRanges6;
+	Q_strncpyz( db->source, ospath, sizeof( db->source ) );
+
+	return db;
+}
+
+
+/*
+==================
+SV_ReadLegacyIPDB
+
+Reads and converts legacy big-endian IPv4 database
+==================
+*/
+static ipdb_t *SV_ReadLegacyIPDB( const char *ospath, char *error, int errorSize )
+{
+	ipdbRange4_t *ranges;
+	ipdb_t *db;
+	byte *buf, *p;
+	long len;
+	int i, num;
+	FILE *f;
+
+	f = Sys_FOpen( ospath, "rb" );
+	if ( f == NULL )
+		return NULL;
+
+	fseek( f, 0, SEEK_END );
+	len = ftell( f );
+	fseek( f, 0, SEEK_SET );
+
+	if ( len <= 0 || len % 10 || len / 10 > IPDB_MAX_RANGES ) // should be a power of IP4:IP4:TLD2
+	{
+		Com_sprintf( error, errorSize, "%s: invalid file size %li", ospath, len );
+		fclose( f );
+		return NULL;
+	}
+
+	num = len / 10;
+	db = calloc( 1, sizeof( *db ) );
+	buf = malloc( len );
+	ranges = malloc( num * sizeof( ranges[0] ) + num * 2 );
+
+	if ( db == NULL || buf == NULL || ranges == NULL || fread( buf, 1, len, f ) != (size_t)len )
+	{
+		Com_sprintf( error, errorSize, "%s: read error", ospath );
+		fclose( f );
+		free( db );
+		free( buf );
+		free( ranges );
+		return NULL;
+	}
+
+	fclose( f );
+
+	// [range1][range2]...[rangeN]
+	// [tld1][tld2]...[tldN]
+	for ( i = 0, p = buf; i < num; i++, p += 8 )
+	{
+		ranges[i].from = p[0] << 24 | p[1] << 16 | p[2] << 8 | p[3];
+		ranges[i].to = p[4] << 24 | p[5] << 16 | p[6] << 8 | p[7];
+	}
+	memcpy( ranges + num, buf + num * 8, num * 2 );
+	free( buf );
+
+	db->memory = ranges;
+	db->ranges4 = ranges;
+	db->tlds4 = (const char *)( ranges + num );
+	db->numRanges4 = num;
+	Q_strncpyz( db->source, ospath, sizeof( db->source ) );
+
+	return db;
+}
+
+
+/*
+==================
+SV_LoadIPDB
+
+Tries all search paths, may be called from the loader thread
+==================
+*/
+static ipdb_t *SV_LoadIPDB( char paths[][ MAX_OSPATH ], int numPaths, char *error, int errorSize )
+{
+	ipdb_t *db;
+	int i;
+
+	error[0] = '\0';
+
+	for ( i = 0; i < numPaths; i++ )
+	{
+		if ( !paths[i][0] )
+			continue;
+
+		db = SV_MapIPDB( paths[i], error, errorSize );
+		if ( db == NULL && !error[0] )
+			db = SV_ReadLegacyIPDB( paths[i], error, errorSize );
+
+		if ( db != NULL )
+		{
+			if ( !SV_ValidateIPDB( db, error, errorSize ) )
+			{
+				SV_FreeIPDB( db );
+				return NULL;
+			}
+			return db;
+		}
+
+		if ( error[0] )
+			return NULL;
+	}
+
+	return NULL;
+}
+
+
+/*
+==================
+SV_GetIPDBPaths
+
+Same search order as FS_SV_FOpenFileRead
+==================
+*/
+static void SV_GetIPDBPaths( char paths[][ MAX_OSPATH ] )
+{
+	const char *bases[3];
+	int i;
+
+	bases[0] = Cvar_VariableString( "fs_homepath" );
+	bases[1] = Cvar_VariableString( "fs_basepath" );
+	bases[2] = Cvar_VariableString( "fs_steampath" );
+
+	for ( i = 0; i < 3; i++ )
+	{
+		paths[i][0] = '\0';
+		if ( !bases[i][0] || ( i && !Q_stricmp( bases[i], bases[0] ) ) )
+			continue;
+		Q_strncpyz( paths[i], FS_BuildOSPath( bases[i], IPDB_FILENAME, NULL ), MAX_OSPATH );
+	}
+}
+
+
+/*
+==================
+SV_SetIPDB
+==================
+*/
+static void SV_SetIPDB( ipdb_t *db, const char *error )
+{
+	SV_FreeIPDB( ipdb );
+	ipdb = db;
+
+	Com_Memset( ipdb_cache, 0, sizeof( ipdb_cache ) );
+
+	if ( error && error[0] )
+		Com_Printf( S_COLOR_YELLOW "ip4db: %s\n", error );
+
+	if ( db )
+		Com_Printf( "ip4db: %i IPv4 and %i IPv6 entries loaded from %s%s\n", db->numRanges4, db->numRanges6,
+			db->source, db->mapping ? " (mapped)" : "" );
+}
+
+
+/*
+==================
+SV_IPDBLoaderThread
+==================
+*/
+static void SV_IPDBLoaderThread( void *param )
+{
+	ipdb_pending = SV_LoadIPDB( ipdb_paths, ARRAY_LEN( ipdb_paths ), ipdb_error, sizeof( ipdb_error ) );
+	Sys_AtomicStore( &ipdb_threadDone, 1 );
+}
+
+
+/*
+==================
+SV_FinishIPDBReload
+==================
+*/
+static void SV_FinishIPDBReload( void )
+{
+	Sys_JoinThread( ipdb_thread );
+	ipdb_thread = NULL;
+
+	SV_SetIPDB( ipdb_pending, ipdb_error );
+	ipdb_pending = NULL;
+	ipdb_loaded = qtrue;
+}
+
+
+/*
+==================
+SV_IP4DBFrame
+
+Swaps in database loaded by ip4db_reload
+==================
+*/
+void SV_IP4DBFrame( void )
+{
+	if ( ipdb_thread && Sys_AtomicLoad( &ipdb_threadDone ) )
+		SV_FinishIPDBReload();
+}
+
+
+/*
+==================
+SV_FreeIP4DB
+==================
+*/
+void SV_FreeIP4DB( void )
+{
+	if ( ipdb_thread )
+	{
+		Sys_JoinThread( ipdb_thread );
+		ipdb_thread = NULL;
+		SV_FreeIPDB( ipdb_pending );
+		ipdb_pending = NULL;
+	}
+
+	SV_FreeIPDB( ipdb );
+	ipdb = NULL;
+	ipdb_loaded = qfalse;
+}
+
+
+/*
+==================
+SV_ReloadIP4DB_f
+==================
+*/
+static void SV_ReloadIP4DB_f( void )
+{
+	if ( ipdb_thread )
+	{
+		Com_Printf( "ip4db: reload already in progress\n" );
+		return;
+	}
+
+	SV_GetIPDBPaths( ipdb_paths );
+	ipdb_error[0] = '\0';
+	ipdb_pending = NULL;
+	Sys_AtomicStore( &ipdb_threadDone, 0 );
+
+	ipdb_thread = Sys_CreateThread( SV_IPDBLoaderThread, NULL );
+	if ( ipdb_thread == NULL )
+	{
+		// load in place
+		SV_IPDBLoaderThread( NULL );
+		SV_SetIPDB( ipdb_pending, ipdb_error );
+		ipdb_pending = NULL;
+		ipdb_loaded = qtrue;
+		return;
+	}
+
+	Com_Printf( "ip4db: reloading in background\n" );
+}
+
+
+/*
+==================
+SV_ParseIPv6Range
+==================
+*/
+static qboolean SV_ParseIPv6Range( char *line, ipdbRange6_t *range, char *tld )
+{
+	char *fields[3];
+	netadr_t adr;
+	uint64_t v[2];
+	int i, n, k;
+	char *s;
+
+	// from,to,CC
+	for ( n = 0, s = line; n < 3; n++ )
+	{
+		while ( *s == ' ' || *s == '\t' || *s == '"' )
+			s++;
+		fields[n] = s;
+		while ( *s && *s != ',' && *s != '"' && *s != ' ' && *s != '\t' && *s != '\r' && *s != '\n' )
+			s++;
+		if ( *s == '"' )
+			*s++ = '\0';
+		while ( *s == ' ' || *s == '\t' )
+			*s++ = '\0';
+		if ( *s == ',' )
+			*s++ = '\0';
+		else if ( n < 2 )
+			return qfalse;
+		else
+			*s = '\0';
+	}
+
+	if ( strlen( fields[2] ) != 2 )
+		return qfalse;
+
+	for ( n = 0; n < 2; n++ )
+	{
+		if ( !strchr( fields[n], ':' ) || !NET_StringToAdr( fields[n], &adr, NA_IP6 ) || adr.type != NA_IP6 )
+			return qfalse;
+		for ( k = 0; k < 2; k++ )
+		{
+			v[k] = 0;
+			for ( i = 0; i < 8; i++ )
+				v[k] = ( v[k] << 8 ) | adr.ipv._6[ k * 8 + i ];
+		}
+		if ( n == 0 ) {
+			range->from[0] = v[0]; range->from[1] = v[1];
+		} else {
+			range->to[0] = v[0]; range->to[1] = v[1];
+		}
+	}
+
+	tld[0] = toupper( fields[2][0] );
+	tld[1] = toupper( fields[2][1] );
+
+	return qtrue;
+}
+
+
+static int SV_CompareRange6( const void *a, const void *b )
+{
+	const ipdbRange6_t *r1 = (const ipdbRange6_t *)a;
+	const ipdbRange6_t *r2 = (const ipdbRange6_t *)b;
+
+	if ( r1->from[0] != r2->from[0] )
+		return r1->from[0] < r2->from[0] ? -1 : 1;
+	if ( r1->from[1] != r2->from[1] )
+		return r1->from[1] < r2->from[1] ? -1 : 1;
+	return 0;
+}
+
+
+/*
+==================
+SV_ConvertIP4DB_f
+
+Writes loaded database in native format, optionally replacing IPv6 table
+with ranges from a "from,to,CC" text file
+==================
+*/
+static void SV_ConvertIP4DB_f( void )
+{
+	ipdbHeader_t header;
+	ipdbRange6_t *ranges6;	// followed by 2-byte tlds
+	const ipdbRange6_t *out6;
+	const char *out6tlds;
+	char *text, *line, *next, *tlds6;
+	char tmpPath[1][ MAX_OSPATH ];
+	char error[ MAX_STRING_CHARS ];
+	ipdb_t check, *db;
+	fileHandle_t fh;
+	int numRanges6, maxRanges6, len, ofs, i;
+	static const byte pad[8] = { 0 };
+
+	if ( ipdb_thread )
+	{
+		Com_Printf( "ip4db: reload in progress\n" );
+		return;
+	}
+
+	if ( !ipdb_loaded )
+	{
+		SV_GetIPDBPaths( ipdb_paths );
+		SV_SetIPDB( SV_LoadIPDB( ipdb_paths, ARRAY_LEN( ipdb_paths ), ipdb_error, sizeof( ipdb_error ) ), ipdb_error );
+		ipdb_loaded = qtrue;
+	}
+
+	if ( ipdb == NULL && Cmd_Argc() < 2 )
+	{
+		Com_Printf( "usage: ip4db_convert [ipv6 ranges file]\n" );
+		return;
+	}
+
+	ranges6 = NULL;
+	tlds6 = NULL;
+	numRanges6 = 0;
+
+	out6 = ipdb ? ipdb->ranges6 : NULL;
+	out6tlds = ipdb ? ipdb->tlds6 : NULL;
+	if ( ipdb )
+		numRanges6 = ipdb->numRanges6;
+
+	if ( Cmd_Argc() >= 2 )
+	{
+		len = FS_SV_FOpenFileRead( Cmd_Argv( 1 ), &fh );
+		if ( len <= 0 )
+		{
+			if ( fh != FS_INVALID_HANDLE )
+				FS_FCloseFile( fh );
+			Com_Printf( "ip4db: couldn't read %s\n", Cmd_Argv( 1 ) );
+			return;
+		}
+
+		text = Z_Malloc( len + 1 );
+		FS_Read( text, len, fh );
+		FS_FCloseFile( fh );
+		text[ len ] = '\0';
+
+		maxRanges6 = 1024;
+		numRanges6 = 0;
+		ranges6 = Z_Malloc( maxRanges6 * ( sizeof( ranges6[0] ) + 2 ) );
+
+		for ( line = text; line && *line; line = next )
+		{
+			next = strchr( line, '\n' );
+			if ( next )
+				*next++ = '\0';
+
+			if ( numRanges6 == maxRanges6 )
+			{
+				ipdbRange6_t *grow = Z_Malloc( maxRanges6 * 2 * ( sizeof( ranges6[0] ) + 2 ) );
+				memcpy( grow, ranges6, maxRanges6 * sizeof( ranges6[0] ) );
+				memcpy( (byte *)( grow + maxRanges6 * 2 ), ranges6 + maxRanges6, maxRanges6 * 2 );
+				Z_Free( ranges6 );
+				ranges6 = grow;
+				maxRanges6 *= 2;
+			}
+
+			tlds6 = (char *)( ranges6 + maxRanges6 );
+			if ( SV_ParseIPv6Range( line, &ranges6[ numRanges6 ], tlds6 + numRanges6 * 2 ) )
+				numRanges6++;
+		}
+
+		Z_Free( text );
+
+		// input is usually sorted already
+		for ( i = 1; i < numRanges6; i++ )
+		{
+			if ( SV_CompareRange6( &ranges6[i-1], &ranges6[i] ) > 0 )
+				break;
+		}
+		if ( i < numRanges6 )
+		{
+			Com_Printf( S_COLOR_YELLOW "ip4db: %s is not sorted\n", Cmd_Argv( 1 ) );
+			Z_Free( ranges6 );
+			return;
+		}
+
+		// overlapping or inverted ranges would be rejected by the loader
+		Com_Memset( &check, 0, sizeof( check ) );
+		check.ranges6 = ranges6;
+		check.tlds6 = tlds6;
+		check.numRanges6 = numRanges6;
+		if ( !SV_ValidateIPDB( &check, error, sizeof( error ) ) )
+		{
+			Com_Printf( S_COLOR_YELLOW "ip4db: %s: %s\n", Cmd_Argv( 1 ), error );
+			Z_Free( ranges6 );
+			return;
+		}
+
+		out6 = ranges6;
+		out6tlds = tlds6;
+	}
+
+	Com_Memset( &header, 0, sizeof( header ) );
+	memcpy( header.ident, IPDB_IDENT, 4 );
+	header.version = IPDB_VERSION;
+	header.byteOrder = IPDB_BYTEORDER;
+	header.numRanges4 = ipdb ? ipdb->numRanges4 : 0;
+	header.numRanges6 = numRanges6;
+
+	ofs = sizeof( header );
+	header.ofsRanges4 = ofs;
+	ofs += header.numRanges4 * sizeof( ipdbRange4_t );
+	header.ofsRanges6 = ofs;
+	ofs += header.numRanges6 * sizeof( ipdbRange6_t );
+	header.ofsTLDs4 = ofs;
+	ofs += header.numRanges4 * 2;
+	header.ofsTLDs6 = ofs;
+
+	fh = FS_SV_FOpenFileWrite( IPDB_FILENAME ".tmp" );
+	if ( fh == FS_INVALID_HANDLE )
+	{
+		Com_Printf( "ip4db: couldn't write %s.tmp\n", IPDB_FILENAME );
+		if ( ranges6 )
+			Z_Free( ranges6 );
+		return;
+	}
+
+	FS_Write( &header, sizeof( header ), fh );
+	if ( header.numRanges4 )
+		FS_Write( ipdb->ranges4, header.numRanges4 * sizeof( ipdbRange4_t ), fh );
+	if ( header.numRanges6 )
+		FS_Write( out6, header.numRanges6 * sizeof( ipdbRange6_t ), fh );
+	if ( header.numRanges4 )
+		FS_Write( ipdb->tlds4, header.numRanges4 * 2, fh );
+	if ( header.numRanges6 )
+		FS_Write( out6tlds, header.numRanges6 * 2, fh );
+	FS_Write( pad, sizeof( pad ), fh );
+	FS_FCloseFile( fh );
+
+	if ( ranges6 )
+		Z_Free( ranges6 );
+
+	// current database stays in use unless the new one loads
+	Q_strncpyz( tmpPath[0], FS_BuildOSPath( Cvar_VariableString( "fs_homepath" ), IPDB_FILENAME ".tmp", NULL ), sizeof( tmpPath[0] ) );
+	db = SV_LoadIPDB( tmpPath, ARRAY_LEN( tmpPath ), error, sizeof( error ) );
+	if ( db == NULL )
+	{
+		Com_Printf( S_COLOR_YELLOW "ip4db: couldn't load written %s.tmp: %s\n", IPDB_FILENAME, error[0] ? error : "not found" );
+		FS_Remove( tmpPath[0] );
+		return;
+	}
+
+	Com_Printf( "ip4db: wrote %i IPv4 and %i IPv6 entries\n", header.numRanges4, header.numRanges6 );
+
+	// release mapping of the old file before replacing it,
+	// the new mapping stays valid when its file is renamed
+	Q_strncpyz( db->source, FS_BuildOSPath( Cvar_VariableString( "fs_homepath" ), IPDB_FILENAME, NULL ), sizeof( db->source ) );
+	SV_SetIPDB( db, NULL );
+	FS_SV_Rename( IPDB_FILENAME ".tmp", IPDB_FILENAME );
+}
+
+
+/*
+==================
+SV_LookupIP4DB
+
+Sets two-letter country code for address, empty string if not found
+==================
+*/
+void SV_LookupIP4DB( const netadr_t *from, char *str )
+{
+	static const byte v4mapped[12] = { 0,0,0,0, 0,0,0,0, 0,0,0xFF,0xFF };
+	ipdbCache_t *c;
+	const char *tld;
+	const byte *a;
+	uint64_t ip6[2];
+	uint32_t ip, hash;
+	int type, lo, hi, m, i;
+
+	str[0] = '\0';
+
+	if ( from->type == NA_IP6 && !memcmp( from->ipv._6, v4mapped, sizeof( v4mapped ) ) ) {
+		a = from->ipv._6 + 12;
+		type = NA_IP;
+	} else if ( from->type == NA_IP ) {
+		a = from->ipv._4;
+		type = NA_IP;
+	} else if ( from->type == NA_IP6 ) {
+		a = from->ipv._6;
+		type = NA_IP6;
+	} else {
+		return;
+	}
+
+	SV_IP4DBFrame();
+
+	if ( !ipdb_loaded && !ipdb_thread ) {
+		SV_GetIPDBPaths( ipdb_paths );
+		SV_SetIPDB( SV_LoadIPDB( ipdb_paths, ARRAY_LEN( ipdb_paths ), ipdb_error, sizeof( ipdb_error ) ), ipdb_error );
+		ipdb_loaded = qtrue;
+	}
+
+	if ( ipdb == NULL )
+		return;
+
+	// check recent lookups
+	hash = 0;
+	for ( i = 0; i < ( type == NA_IP ? 4 : 16 ); i++ )
+		hash = hash * 31 + a[i];
+	c = &ipdb_cache[ ( hash ^ ( hash >> 16 ) ) & ( IPDB_CACHE_SIZE - 1 ) ];
+	if ( c->type == type && !memcmp( c->addr, a, type == NA_IP ? 4 : 16 ) ) {
+		strcpy( str, c->tld );
+		return;
+	}
+
+	tld = NULL;
+
+	if ( type == NA_IP ) {
+		const ipdbRange4_t *r;
+		ip = a[0] << 24 | a[1] << 16 | a[2] << 8 | a[3];
+		lo = 0;
+		hi = ipdb->numRanges4 - 1;
+		while ( lo <= hi ) {
+			m = ( lo + hi ) / 2;
+			r = ipdb->ranges4 + m;
+			if ( r->from > ip ) {
+				hi = m - 1;
+			} else if ( r->to < ip ) {
+				lo = m + 1;
+			} else {
+				tld = ipdb->tlds4 + m * 2;
+				break;
+			}
+		}
+	} else {
+		const ipdbRange6_t *r;
+		ip6[0] = ip6[1] = 0;
+		for ( i = 0; i < 8; i++ ) {
+			ip6[0] = ( ip6[0] << 8 ) | a[i];
+			ip6[1] = ( ip6[1] << 8 ) | a[i + 8];
+		}
+		lo = 0;
+		hi = ipdb->numRanges6 - 1;
+		while ( lo <= hi ) {
+			m = ( lo + hi ) / 2;
+			r = ipdb->ranges6 + m;
+			if ( r->from[0] > ip6[0] || ( r->from[0] == ip6[0] && r->from[1] > ip6[1] ) ) {
+				hi = m - 1;
+			} else if ( r->to[0] < ip6[0] || ( r->to[0] == ip6[0] && r->to[1] < ip6[1] ) ) {
+				lo = m + 1;
+			} else {
+				tld = ipdb->tlds6 + m * 2;
+				break;
+			}
+		}
+	}
+
+	if ( tld ) {
+		str[0] = tld[0];
+		str[1] = tld[1];
+		str[2] = '\0';
+	}
+
+	memcpy( c->addr, a, type == NA_IP ? 4 : 16 );
+	c->type = type;
+	strcpy( c->tld, str );
+}
+
+
+/*
+==================
+SV_LookupIP4DB_f
+==================
+*/
+static void SV_LookupIP4DB_f( void )
+{
+	netadr_t adr;
+	char tld[3];
+
+	if ( Cmd_Argc() != 2 )
+	{
+		Com_Printf( "usage: ip4db_lookup <address>\n" );
+		return;
+	}
+
+	if ( !NET_StringToAdr( Cmd_Argv( 1 ), &adr, strchr( Cmd_Argv( 1 ), ':' ) ? NA_IP6 : NA_IP ) )
+	{
+		Com_Printf( "Bad address: %s\n", Cmd_Argv( 1 ) );
+		return;
+	}
+
+	SV_LookupIP4DB( &adr, tld );
+	Com_Printf( "%s: %s\n", NET_AdrToString( &adr ), tld[0] ? tld : "not found" );
+}
+
+
+/*
+==================
+SV_InitIP4DB
+==================
+*/
+void SV_InitIP4DB( void )
+{
+	Cmd_AddCommand( "ip4db_reload", SV_ReloadIP4DB_f );
+	Cmd_SetDescription( "ip4db_reload", "Reloads geoip database " IPDB_FILENAME " in background\nusage: ip4db_reload" );
+
+	Cmd_AddCommand( "ip4db_lookup", SV_LookupIP4DB_f );
+	Cmd_SetDescription( "ip4db_lookup", "Prints country code found in geoip database for an address\nusage: ip4db_lookup <address>" );
+
+	Cmd_AddCommand( "ip4db_convert", SV_ConvertIP4DB_f );
+	Cmd_SetDescription( "ip4db_convert", "Writes loaded geoip database in native mappable format, optionally with IPv6 ranges from a \"from,to,CC\" text file\nusage: ip4db_convert [ipv6 ranges file]" );
+}
@@ -399,38 +399,61 @@ CONNECTIONLESS COMMANDS
 */
 
 // This is deliberately quite large to make it more of an effort to DoS
-#define MAX_BUCKETS        16384
-#define MAX_HASHES          1024
+#define MAX_BUCKETS        32768
+#define MAX_HASHES         65536
+
+// give up on second chances after this many clock steps so allocation stays O(1)
+#define MAX_CLOCK_STEPS       64
+
+// aggregate bucket prefix lengths
+#define SUBNET_BITS_IP4       24
+#define SUBNET_BITS_IP6       64
 
 static leakyBucket_t buckets[ MAX_BUCKETS ];
 static leakyBucket_t *bucketHashes[ MAX_HASHES ];
+static int bucketsUsed;
+static int bucketClock;
+static uint32_t bucketSeed;
 static rateLimit_t outboundRateLimit;
 
+static cvar_t *sv_rateLimitSubnet;
+
+static struct {
+	uint32_t	lookups;
+	uint32_t	collisions;		// chain entries compared without a match
+	uint32_t	allocs;
+	uint32_t	reclaimed;		// expired buckets reused by the clock
+	uint32_t	evicted;		// live buckets pushed out by the clock
+	uint32_t	passed;
+	uint32_t	limitedAddress;
+	uint32_t	limitedSubnet;
+} rateStats;
+
+
 /*
 ================
-SVC_HashForAddress
+SVC_HashForKey
+
+FNV-1a over the (masked) address, seeded per process so that
+colliding source addresses cannot be precomputed, then mixed
+with murmur3's finalizer so that the low bits are well spread
 ================
 */
-static int SVC_HashForAddress( const netadr_t *address ) {
-	const byte	*ip = NULL;
-	int			size = 0;
-	int			hash = 0;
+static uint32_t SVC_HashForKey( netadrtype_t type, int bits, const byte *ip, int size ) {
+	uint32_t	hash = bucketSeed ^ 2166136261U;
 	int			i;
 
-	switch ( address->type ) {
-		case NA_IP:  ip = address->ipv._4; size = 4;  break;
-#ifdef USE_IPV6
-		case NA_IP6: ip = address->ipv._6; size = 16; break;
-#endif
-		default: break;
-	}
-
+	hash = ( hash ^ (uint32_t)type ) * 16777619U;
+	hash = ( hash ^ (uint32_t)bits ) * 16777619U;
 	for ( i = 0; i < size; i++ ) {
-		hash += (int)( ip[ i ] ) * ( i + 119 );
+		hash = ( hash ^ ip[ i ] ) * 16777619U;
 	}
 
-	hash = ( hash ^ ( hash >> 10 ) ^ ( hash >> 20 ) );
-	hash &= ( MAX_HASHES - 1 );
+	hash ^= hash >> 16;
+	hash *= 0x85EBCA6BU;
+	hash ^= hash >> 13;
+	hash *= 0xC2B2AE35U;
+	hash ^= hash >> 16;
 
 	return hash;
 }
@@ -438,124 +461,188 @@ static int SVC_HashForAddress( const netadr_t *address ) {
 
 /*
 ================
-SVC_RelinkToHead
+SVC_UnlinkBucket
 ================
 */
-static void SVC_RelinkToHead( leakyBucket_t *bucket, int hash ) {
+static void SVC_UnlinkBucket( leakyBucket_t *bucket ) {
 
 	if ( bucket->prev != NULL ) {
 		bucket->prev->next = bucket->next;
 	} else {
-		return;
+		bucketHashes[ bucket->hash & ( MAX_HASHES - 1 ) ] = bucket->next;
 	}
 
 	if ( bucket->next != NULL ) {
 		bucket->next->prev = bucket->prev;
 	}
 
-	bucket->next = bucketHashes[ hash ];
-	if ( bucketHashes[ hash ] != NULL ) {
-		bucketHashes[ hash ]->prev = bucket;
-	}
-
-	bucket->prev = NULL;
-	bucketHashes[ hash ] = bucket;
+	bucket->prev = bucket->next = NULL;
+	bucket->type = NA_BAD;
 }
 
 
 /*
 ================
-SVC_BucketForAddress
+SVC_AllocBucket
 
-Find or allocate a bucket for an address
+Takes a never used bucket while there are any, then runs a clock
+over the pool: expired buckets are reused at once, recently used
+ones get a second chance, and after MAX_CLOCK_STEPS the bucket
+under the hand is evicted no matter what
 ================
 */
-static leakyBucket_t *SVC_BucketForAddress( const netadr_t *address, int burst, int period ) {
-	static leakyBucket_t dummy = { 0 };
-	static int		start = 0;
-	const int		hash = SVC_HashForAddress( address );
-	const int		now = Sys_Milliseconds();
+static leakyBucket_t *SVC_AllocBucket( int now ) {
 	leakyBucket_t	*bucket;
-	int				i, n;
-
-	for ( bucket = bucketHashes[ hash ], n = 0; bucket; bucket = bucket->next, n++ ) {
-		switch ( bucket->type ) {
-			case NA_IP:
-				if ( memcmp( bucket->ipv._4, address->ipv._4, 4 ) == 0 ) {
-					if ( n > 8 ) {
-						SVC_RelinkToHead( bucket, hash );
-					}
-					return bucket;
-				}
-				break;
-#ifdef USE_IPV6
-			case NA_IP6:
-				if ( memcmp( bucket->ipv._6, address->ipv._6, 16 ) == 0 ) {
-					if ( n > 8 ) {
-						SVC_RelinkToHead( bucket, hash );
-					}
-					return bucket;
-				}
-				break;
-#endif
-			default:
-				return &dummy;
-		}
+	int				interval;
+	int				steps;
+
+	rateStats.allocs++;
+
+	if ( bucketsUsed < MAX_BUCKETS ) {
+		return &buckets[ bucketsUsed++ ];
 	}
 
-	for ( i = 0; i < MAX_BUCKETS; i++ ) {
-		int interval;
+	for ( steps = 0; ; steps++ ) {
+		bucket = &buckets[ bucketClock ];
+		bucketClock = ( bucketClock + 1 ) & ( MAX_BUCKETS - 1 );
 
-		if ( start >= MAX_BUCKETS )
-			start = 0;
-		bucket = &buckets[ start++ ];
 		interval = now - bucket->rate.lastTime;
+		if ( bucket->type == NA_BAD || (unsigned)interval > (unsigned)( bucket->rate.burst * bucket->period ) ) {
+			rateStats.reclaimed++;
+			break;
+		}
 
-		// Reclaim expired buckets
-		if ( bucket->type != NA_BAD && (unsigned)interval > ( bucket->rate.burst * period ) ) {
-			if ( bucket->prev != NULL ) {
-				bucket->prev->next = bucket->next;
-			} else {
-				bucketHashes[ bucket->hash ] = bucket->next;
-			}
-			
-			if ( bucket->next != NULL ) {
-				bucket->next->prev = bucket->prev;
-			}
-
-			bucket->type = NA_BAD;
+		if ( bucket->referenced && steps < MAX_CLOCK_STEPS ) {
+			bucket->referenced = 0;
+			continue;
 		}
 
-		if ( bucket->type == NA_BAD ) {
-			bucket->type = address->type;
-			switch ( address->type ) {
-				case NA_IP:  Com_Memcpy( bucket->ipv._4, address->ipv._4, 4 );  break;
+		rateStats.evicted++;
+		break;
+	}
+
+	if ( bucket->type != NA_BAD ) {
+		SVC_UnlinkBucket( bucket );
+	}
+
+	return bucket;
+}
+
+
+/*
+================
+SVC_BucketForKey
+
+Find or allocate a bucket for an address or, with bits > 0,
+for the subnet containing it
+================
+*/
+static leakyBucket_t *SVC_BucketForKey( const netadr_t *address, int bits, int period ) {
+	leakyBucket_t	*bucket;
+	byte			key[ 16 ];
+	uint32_t		hash;
+	int				size, now, i;
+
+	switch ( address->type ) {
+		case NA_IP:  size = 4;  Com_Memcpy( key, address->ipv._4, 4 );  break;
 #ifdef USE_IPV6
-				case NA_IP6: Com_Memcpy( bucket->ipv._6, address->ipv._6, 16 ); break;
+		case NA_IP6: size = 16; Com_Memcpy( key, address->ipv._6, 16 ); break;
 #endif
-				default: break;
-			}
-
-			bucket->rate.lastTime = now;
-			bucket->rate.burst = 0;
-			bucket->hash = hash;
-			bucket->toxic = 0;
+		default:     size = 0;  break;
+	}
 
-			// Add to the head of the relevant hash chain
-			bucket->next = bucketHashes[ hash ];
-			if ( bucketHashes[ hash ] != NULL ) {
-				bucketHashes[ hash ]->prev = bucket;
+	if ( bits > 0 ) {
+		for ( i = bits >> 3; i < size; i++ ) {
+			if ( i == ( bits >> 3 ) && ( bits & 7 ) ) {
+				key[ i ] &= 0xFF << ( 8 - ( bits & 7 ) );
+			} else {
+				key[ i ] = 0;
 			}
+		}
+	}
 
-			bucket->prev = NULL;
-			bucketHashes[ hash ] = bucket;
+	rateStats.lookups++;
 
+	hash = SVC_HashForKey( address->type, bits, key, size );
+
+	for ( bucket = bucketHashes[ hash & ( MAX_HASHES - 1 ) ]; bucket; bucket = bucket->next ) {
+		if ( bucket->hash == hash && bucket->type == address->type && bucket->bits == bits
+			&& memcmp( bucket->ipv._6, key, size ) == 0 ) {
+			bucket->referenced = 1;
+			bucket->period = period;
 			return bucket;
 		}
+		rateStats.collisions++;
 	}
 
-	// Couldn't allocate a bucket for this address
-	return NULL;
+	now = Sys_Milliseconds();
+	bucket = SVC_AllocBucket( now );
+
+	bucket->type = address->type;
+	bucket->bits = bits;
+	bucket->referenced = 0;
+	Com_Memset( bucket->ipv._6, 0, sizeof( bucket->ipv._6 ) );
+	Com_Memcpy( bucket->ipv._6, key, size );
+
+	bucket->rate.lastTime = now;
+	bucket->rate.burst = 0;
+	bucket->period = period;
+	bucket->hash = hash;
+	bucket->toxic = 0;
+
+	// Add to the head of the relevant hash chain
+	bucket->prev = NULL;
+	bucket->next = bucketHashes[ hash & ( MAX_HASHES - 1 ) ];
+	if ( bucket->next != NULL ) {
+		bucket->next->prev = bucket;
+	}
+	bucketHashes[ hash & ( MAX_HASHES - 1 ) ] = bucket;
+
+	return bucket;
+}
+
+
+/*
+================
+SVC_BucketForAddress
+
+Find or allocate a bucket for an address
+================
+*/
+static leakyBucket_t *SVC_BucketForAddress( const netadr_t *address, int burst, int period ) {
+	return SVC_BucketForKey( address, 0, period );
+}
+
+
+/*
+================
+SVC_BucketForSubnet
+
+Find or allocate the aggregate bucket for the /24 or /64 containing address,
+NULL for non-ip addresses
+================
+*/
+static leakyBucket_t *SVC_BucketForSubnet( const netadr_t *address, int period ) {
+	switch ( address->type ) {
+		case NA_IP:  return SVC_BucketForKey( address, SUBNET_BITS_IP4, period );
+#ifdef USE_IPV6
+		case NA_IP6: return SVC_BucketForKey( address, SUBNET_BITS_IP6, period );
+#endif
+		default:     return NULL;
+	}
+}
+
+
+/*
+================
+SVC_ClearRateLimits
+================
+*/
+static void SVC_ClearRateLimits( void ) {
+	Com_Memset( buckets, 0, sizeof( buckets ) );
+	Com_Memset( bucketHashes, 0, sizeof( bucketHashes ) );
+	bucketsUsed = 0;
+	bucketClock = 0;
 }
 
 
@@ -634,13 +721,28 @@ static void SVC_RateRestoreToxic( leakyBucket_t *bucket ) {
 ================
 SVC_RateLimitAddress
 
-Rate limit for a particular address
+Rate limit for a particular address and, with sv_rateLimitSubnet,
+for the /24 or /64 it belongs to
 ================
 */
 qboolean SVC_RateLimitAddress( const netadr_t *from, int burst, int period ) {
 	leakyBucket_t *bucket = SVC_BucketForAddress( from, burst, period );
 
-	return bucket ? SVC_RateLimit( &bucket->rate, burst, period ) : qtrue;
+	if ( SVC_RateLimit( &bucket->rate, burst, period ) ) {
+		rateStats.limitedAddress++;
+		return qtrue;
+	}
+
+	if ( sv_rateLimitSubnet && sv_rateLimitSubnet->integer > 0 ) {
+		bucket = SVC_BucketForSubnet( from, period );
+		if ( bucket && SVC_RateLimit( &bucket->rate, burst * sv_rateLimitSubnet->integer, period ) ) {
+			rateStats.limitedSubnet++;
+			return qtrue;
+		}
+	}
+
+	rateStats.passed++;
+	return qfalse;
 }
 
 
@@ -1052,6 +1154,187 @@ static void SV_ConnectionlessPacket( const netadr_t *from, msg_t *msg ) {
 	}
 }
 
+/*
+=================
+SVC_RateLimitStats_f
+=================
+*/
+static void SVC_RateLimitStats_f( void ) {
+	const leakyBucket_t *bucket;
+	int chains, longest, subnets, len, i;
+
+	chains = longest = subnets = 0;
+	for ( i = 0; i < MAX_HASHES; i++ ) {
+		if ( bucketHashes[ i ] == NULL )
+			continue;
+		for ( bucket = bucketHashes[ i ], len = 0; bucket; bucket = bucket->next, len++ ) {
+			if ( bucket->bits )
+				subnets++;
+		}
+		if ( len > longest )
+			longest = len;
+		chains++;
+	}
+
+	Com_Printf( "buckets: %i/%i used, %i subnet aggregates, %i/%i chains, longest %i\n",
+		bucketsUsed, MAX_BUCKETS, subnets, chains, MAX_HASHES, longest );
+	Com_Printf( "lookups: %u, collisions: %u (%.3f per lookup)\n", rateStats.lookups, rateStats.collisions,
+		rateStats.lookups ? (double)rateStats.collisions / rateStats.lookups : 0.0 );
+	Com_Printf( "allocs: %u, reclaimed: %u, evicted: %u\n", rateStats.allocs, rateStats.reclaimed, rateStats.evicted );
+	Com_Printf( "passed: %u, limited per-address: %u, limited per-subnet: %u\n",
+		rateStats.passed, rateStats.limitedAddress, rateStats.limitedSubnet );
+}
+
+
+/*
+=================
+SVC_BenchAddress
+
+Spoofed source for the flood benchmark, taken from ranges
+reserved for benchmarking and documentation
+=================
+*/
+static void SVC_BenchAddress( netadr_t *from, uint32_t r1, uint32_t r2 ) {
+
+	Com_Memset( from, 0, sizeof( *from ) );
+	from->port = (uint16_t)( r2 >> 16 );
+
+#ifdef USE_IPV6
+	if ( r2 & 1 ) {
+		// 2001:db8::/32
+		from->type = NA_IP6;
+		from->ipv._6[0] = 0x20; from->ipv._6[1] = 0x01;
+		from->ipv._6[2] = 0x0D; from->ipv._6[3] = 0xB8;
+		from->ipv._6[4] = (byte)( r1 >> 24 );
+		from->ipv._6[5] = (byte)( r1 >> 16 );
+		from->ipv._6[6] = (byte)( r1 >> 8 );
+		from->ipv._6[7] = (byte)( r2 >> 8 );
+		from->ipv._6[15] = (byte)r1;
+		return;
+	}
+#endif
+
+	// 198.18.0.0/15
+	from->type = NA_IP;
+	from->ipv._4[0] = 198;
+	from->ipv._4[1] = 18 | ( r1 & 1 );
+	from->ipv._4[2] = (byte)( r1 >> 1 );
+	from->ipv._4[3] = (byte)( r1 >> 9 );
+}
+
+
+/*
+=================
+SVC_RateLimitBench_f
+
+Pushes spoofed getstatus requests through SV_ConnectionlessPacket,
+or straight into the limiter when no server is running
+=================
+*/
+static void SVC_RateLimitBench_f( void ) {
+	static const char query[] = "\xff\xff\xff\xffgetstatus";
+	byte		data[ sizeof( query ) ];
+	rateLimit_t	outbound;
+	qboolean	full;
+	msg_t		msg;
+	netadr_t	from;
+	uint32_t	rnd, r1, r2;
+	uint32_t	passed, limitedAddress, limitedSubnet, reclaimed, evicted;
+	int64_t		start, usec;
+	int			packets, sources, i;
+
+	if ( com_developer->integer ) {
+		Com_Printf( "ratelimitbench: disable developer mode first\n" );
+		return;
+	}
+
+	packets = Cmd_Argc() > 1 ? atoi( Cmd_Argv( 1 ) ) : 1000000;
+	sources = Cmd_Argc() > 2 ? atoi( Cmd_Argv( 2 ) ) : 0;
+	if ( packets <= 0 ) {
+		packets = 1000000;
+	}
+
+	full = com_sv_running->integer ? qtrue : qfalse;
+
+	MSG_InitOOB( &msg, data, sizeof( data ) );
+	Com_Memcpy( data, query, sizeof( query ) - 1 );
+	msg.cursize = sizeof( query ) - 1;
+
+	// keep every reply behind the outbound limit, nothing must reach the spoofed sources
+	outbound = outboundRateLimit;
+	outboundRateLimit.lastTime = Sys_Milliseconds();
+	outboundRateLimit.burst = 0x3FFFFFFF;
+
+	SVC_ClearRateLimits();
+
+	passed = rateStats.passed;
+	limitedAddress = rateStats.limitedAddress;
+	limitedSubnet = rateStats.limitedSubnet;
+	reclaimed = rateStats.reclaimed;
+	evicted = rateStats.evicted;
+
+	rnd = 0x9E3779B9U;
+	start = Sys_Microseconds();
+
+	for ( i = 0; i < packets; i++ ) {
+		rnd ^= rnd << 13; rnd ^= rnd >> 17; rnd ^= rnd << 5;
+		if ( sources > 0 ) {
+			// a fixed set of sources, derived from the source index
+			r1 = (uint32_t)( rnd % sources ) * 0x9E3779B1U;
+			r1 ^= r1 >> 15;
+			r2 = r1 * 0x85EBCA6BU;
+		} else {
+			r1 = rnd;
+			r2 = rnd * 0x85EBCA6BU;
+		}
+		SVC_BenchAddress( &from, r1, r2 );
+		if ( full ) {
+			SV_ConnectionlessPacket( &from, &msg );
+		} else {
+			SVC_RateLimitAddress( &from, 10, 1000 );
+		}
+	}
+
+	usec = Sys_Microseconds() - start;
+
+	outboundRateLimit = outbound;
+	SVC_ClearRateLimits();
+
+	if ( usec <= 0 ) {
+		usec = 1;
+	}
+
+	Com_Printf( "%i packets from %s sources through %s: %.1f msec, %.2f Mpps\n",
+		packets, sources > 0 ? va( "%i", sources ) : "unique", full ? "SV_ConnectionlessPacket" : "SVC_RateLimitAddress",
+		usec / 1000.0, (double)packets / (double)usec );
+	Com_Printf( "passed: %u, limited per-address: %u, limited per-subnet: %u, reclaimed: %u, evicted: %u\n",
+		rateStats.passed - passed, rateStats.limitedAddress - limitedAddress, rateStats.limitedSubnet - limitedSubnet,
+		rateStats.reclaimed - reclaimed, rateStats.evicted - evicted );
+}
+
+
+/*
+=================
+SVC_InitRateLimit
+=================
+*/
+void SVC_InitRateLimit( void ) {
+
+	if ( bucketsUsed == 0 && !Sys_RandomBytes( (byte *)&bucketSeed, sizeof( bucketSeed ) ) ) {
+		bucketSeed = (uint32_t)Sys_Microseconds() ^ (uint32_t)Com_Milliseconds();
+	}
+
+	sv_rateLimitSubnet = Cvar_Get( "sv_rateLimitSubnet", "8", CVAR_ARCHIVE_ND );
+	Cvar_CheckRange( sv_rateLimitSubnet, "0", "1000", CV_INTEGER );
+	Cvar_SetDescription( sv_rateLimitSubnet, "Connectionless requests allowed from a whole /24 (IPv4) or /64 (IPv6) subnet, as a multiple of the per-address limit, 0 disables subnet limits\nDefault: 8" );
+
+	Cmd_AddCommand( "ratelimitstats", SVC_RateLimitStats_f );
+	Cmd_SetDescription( "ratelimitstats", "Prints connectionless rate limiter counters" );
+
+	Cmd_AddCommand( "ratelimitbench", SVC_RateLimitBench_f );
+	Cmd_SetDescription( "ratelimitbench", "Floods the connectionless packet handler with spoofed getstatus requests, clears rate limiter state\nusage: ratelimitbench [packets] [sources]" );
+}
+
 //============================================================================
 
 /*
@@ -1317,8 +1600,6 @@ void SV_TrackCvarChanges( void )
 		Com_DPrintf( "sv_minRate adjusted to 1000\n" );
 	}
 
-	Cvar_ResetGroup( CVG_SERVER, qfalse );
-
 	if ( sv.state == SS_DEAD || !svs.clients )
 		return;
 
@@ -1376,8 +1657,7 @@ void SV_Frame( int msec ) {
 	int		startTime;
 	int		i, n;
 
-	if ( Cvar_CheckGroup( CVG_SERVER ) )
-		SV_TrackCvarChanges(); // update rate settings, etc.
+	SV_UpdateRateSettings();
 
 	// the menu kills the server with this cvar
 	if ( sv_killserver->integer ) {
@@ -1466,14 +1746,7 @@ void SV_Frame( int msec ) {
 	}
 
 	// update infostrings if anything has been changed
-	if ( cvar_modifiedFlags & CVAR_SERVERINFO ) {
-		SV_SetConfigstring( CS_SERVERINFO, Cvar_InfoString( CVAR_SERVERINFO, NULL ) );
-		cvar_modifiedFlags &= ~CVAR_SERVERINFO;
-	}
-	if ( cvar_modifiedFlags & CVAR_SYSTEMINFO ) {
-		SV_SetConfigstring( CS_SYSTEMINFO, Cvar_InfoString_Big( CVAR_SYSTEMINFO, NULL ) );
-		cvar_modifiedFlags &= ~CVAR_SYSTEMINFO;
-	}
+	SV_UpdateInfoConfigstrings( qfalse );
 
 	if ( com_speeds->integer ) {
 		startTime = Sys_Milliseconds();
@@ -1496,6 +1769,8 @@ void SV_Frame( int msec ) {
 		svs.time += frameMsec;
 		sv.time += frameMsec;
 
+		SV_TraceCacheFrame();
+
 		// let everything in the world think and move
 		VM_Call( gvm, 1, GAME_RUN_FRAME, sv.time );
 #ifdef USE_MV
@@ -1516,6 +1791,17 @@ void SV_Frame( int msec ) {
 	// send messages back to the clients
 	SV_SendClientMessages();
 
+#ifdef USE_SERVER_DEMO
+	// close finished server demos, drain them if there is no writer thread
+	SVD_DemoWriterFrame();
+#endif
+
+	// swap in geoip database reloaded in background
+	SV_IP4DBFrame();
+
+	// read the next map in background once it is known
+	SV_MapPrefetchFrame();
+
 #ifdef USE_MV
     svs.emptyFrame = qfalse;
     if ( sv_autoRecord->integer > 0 ) {
@@ -184,7 +184,7 @@ char* SVM_ClientConnect(client_t *cl) {
 		// if auth works allow to play with it:
 		//TODO: !(auth->integer && (value = Info_ValueForKey(cl->userinfo, "authl")) && *value) ||
 
-		SVM_Subnets_FindByAdr(&bannedSubnets, &cl->netchan.remoteAddress)
+		SVM_Subnets_FindByAdr(&bannedSubnets, &cl->netchan.remoteAddress, NULL, NULL)
 	) {
 		return unescape_string((char *) va("%s", sv_banned_subnet_message->string));
 	}
@@ -266,6 +266,19 @@ static void SVM_SetPresent_f( void ) {
 
 //==================================================================================
 
+static void SVM_SubnetBench_f( void ) {
+	int lookups = 1000000;
+
+	if (Cmd_Argc() > 1) {
+		lookups = atoi(Cmd_Argv(1));
+		if (lookups < 1) lookups = 1;
+	}
+
+	SVM_Subnets_Benchmark(&bannedSubnets, lookups);
+}
+
+//==================================================================================
+
 /**
  * Log in the same file as the game module.
  */
@@ -421,5 +434,8 @@ void SVM_Init( void ) {
 	SVM_Subnets_Init(&bannedSubnets);
 	SVM_Subnets_AddFromFile(&bannedSubnets, sv_banned_subnets_file->string);
 	SVM_Subnets_Commit(&bannedSubnets);
-	Com_Printf("Subnet blocker: Retrieved %ld VPN subnets\n", bannedSubnets.count);
+	Com_Printf("Subnet blocker: Retrieved %ld VPN subnets\n", (long) bannedSubnets.count);
+
+	Cmd_AddCommand(     "subnetbench", SVM_SubnetBench_f );
+	Cmd_SetDescription( "subnetbench", "Measure banned subnet lookups per second against a sorted array\nusage: subnetbench [lookups]" );
 }
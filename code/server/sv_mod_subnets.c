@@ -1,133 +1,393 @@
 #include "server.h"
 
+// Banned subnets are kept in two path-compressed binary tries (one for IPv4,
+// one for IPv6) that answer longest-prefix-match queries, so nested and
+// overlapping CIDRs are handled correctly and prefixes can be added and
+// removed one by one.
+//
+// Nodes live in a single growable pool per trie and refer to each other by
+// index, the key is stored inline as host-order 32-bit words: 16 bytes per
+// IPv4 node and 28 bytes per IPv6 node. Deleted nodes go to a free list.
+//
+// Lookups skip the first SUBNET_TABLE_BITS levels through a slot table that
+// is patched for the affected slots on every insert and delete.
+
+#define SUBNET_NONE  -1
+
+#define SUBNET_TABLE_BITS  16
+#define SUBNET_TABLE_SIZE  (1 << SUBNET_TABLE_BITS)
+
+typedef struct svm_subnet_node_s {
+	int       child[2];  // SUBNET_NONE if absent, child[0] links free nodes
+	byte      bits;      // prefix length of key
+	byte      terminal;  // key/bits is a banned subnet, otherwise a branch node
+	uint16_t  pad;
+	uint32_t  key[1];    // trie->words words, bits past prefix length are zero
+} svm_subnet_node_t;
+
+#define SUBNET_NODE(trie, n)  ((svm_subnet_node_t *)((trie)->nodes + (size_t)(n) * (trie)->stride))
+
 //==================================================================================
 
-static int subnets_compare(const void *_a, const void *_b) {
-	netadr_t *a, *b;
-	int diff;
+static void subnet_key_from_adr(uint32_t *key, const netadr_t *adr) {
+	const byte *p;
+	int i, words;
 
-	a = (netadr_t *) _a;
-	b = (netadr_t *) _b;
+	if (adr->type == NA_IP) {
+		p = adr->ipv._4;
+		words = 1;
+	} else {
+		p = adr->ipv._6;
+		words = 4;
+	}
 
-	diff = a->type - b->type;
-	if (diff) return diff;
+	for (i = 0; i < words; ++i, p += 4)
+		key[i] = ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
 
-	switch (a->type) {
-		case NA_IP:
-			diff = memcmp(&a->ipv._4, &b->ipv._4, sizeof(a->ipv._4));
-			if (diff) return diff;
-			break;
-		case NA_IP6: 
-			diff = memcmp(&a->ipv._6, &b->ipv._6, sizeof(a->ipv._6));
-			if (diff) return diff;
-			break;
-		default:
-			break;
+static void subnet_adr_from_key(netadr_t *adr, netadrtype_t type, const uint32_t *key) {
+	byte *p;
+	int i, words;
+
+	memset(adr, 0, sizeof(*adr));
+	adr->type = type;
+
+	if (type == NA_IP) {
+		p = adr->ipv._4;
+		words = 1;
+	} else {
+		p = adr->ipv._6;
+		words = 4;
 	}
 
-	diff = a->port - b->port;
-	if (diff) return diff;
+	for (i = 0; i < words; ++i, p += 4) {
+		p[0] = key[i] >> 24; p[1] = key[i] >> 16; p[2] = key[i] >> 8; p[3] = key[i];
+	}
+}
 
-	return 0;
+static int subnet_key_bit(const uint32_t *key, int bit) {
+	return (key[bit >> 5] >> (31 - (bit & 31))) & 1;
 }
 
-static int subnet_adr_diff(const void *_adr, const void *_subnet) {
-	netadr_t *adr, *subnet;
-	int diff, cmpbytes, cmpbits;
-	unsigned char adrtail, subnettail;
-	char cmpmask;
+static void subnet_key_mask(uint32_t *key, int words, int bits) {
+	int i;
+	for (i = 0; i < words; ++i, bits -= 32) {
+		if (bits <= 0) key[i] = 0;
+		else if (bits < 32) key[i] &= ~(0xFFFFFFFFu >> bits);
+	}
+}
 
-	adr = (netadr_t *) _adr;
-	subnet = (netadr_t *) _subnet;
+// number of leading bits equal in a and b, up to limit
+static int subnet_key_common(const uint32_t *a, const uint32_t *b, int limit) {
+	uint32_t diff;
+	int i, n;
 
-	diff = adr->type - subnet->type;
-	if (diff) return diff;
+	for (i = 0, n = 0; n < limit; ++i, n += 32) {
+		diff = a[i] ^ b[i];
+		if (diff) {
+			while (!(diff & 0x80000000u)) { diff <<= 1; ++n; }
+			return n < limit ? n : limit;
+		}
+	}
 
-	cmpbytes = subnet->port / CHAR_BIT;
-	cmpbits = subnet->port & (CHAR_BIT - 1);
+	return limit;
+}
 
-	switch (adr->type) {
-		case NA_IP:
-			if (cmpbytes > sizeof(adr->ipv._4)) cmpbytes = sizeof(adr->ipv._4);
-			if (cmpbytes >= 0) {
-				diff = memcmp(&adr->ipv._4, &subnet->ipv._4, cmpbytes);
-				if (diff) return diff;
-			}
-			if (cmpbits) {
-				adrtail = adr->ipv._4[cmpbytes];
-				subnettail = subnet->ipv._4[cmpbytes];
+//==================================================================================
+
+static void subnet_trie_init(svm_subnet_trie_t *trie, int words) {
+	trie->table = 0;
+	trie->nodes = 0;
+	trie->words = words;
+	trie->stride = sizeof(svm_subnet_node_t) + (words - 1) * sizeof(uint32_t);
+	trie->numNodes = trie->maxNodes = 0;
+	trie->freeNode = SUBNET_NONE;
+	trie->root = SUBNET_NONE;
+	trie->count = 0;
+}
+
+static void subnet_trie_free(svm_subnet_trie_t *trie) {
+	if (trie->table) free(trie->table);
+	if (trie->nodes) free(trie->nodes);
+	subnet_trie_init(trie, trie->words);
+}
+
+// make sure next two node allocations won't move the pool
+static int subnet_trie_reserve(svm_subnet_trie_t *trie) {
+	svm_subnet_node_t *n;
+	byte *nodes;
+	int max;
+
+	if (trie->freeNode != SUBNET_NONE) {
+		n = SUBNET_NODE(trie, trie->freeNode);
+		if (n->child[0] != SUBNET_NONE || trie->numNodes < trie->maxNodes) return 1;
+	}
+	if (trie->numNodes + 2 <= trie->maxNodes) return 1;
+
+	max = trie->maxNodes + SUBNETS_CHUNK_SIZE + trie->maxNodes / 2;
+	nodes = (byte *) realloc(trie->nodes, (size_t) max * trie->stride);
+	if (!nodes) return 0;
+
+	trie->nodes = nodes;
+	trie->maxNodes = max;
+	return 1;
+}
+
+static int subnet_trie_alloc(svm_subnet_trie_t *trie, const uint32_t *key, int bits, int terminal) {
+	svm_subnet_node_t *n;
+	int index;
+
+	if (trie->freeNode != SUBNET_NONE) {
+		index = trie->freeNode;
+		trie->freeNode = SUBNET_NODE(trie, index)->child[0];
+	} else {
+		index = trie->numNodes++;
+	}
+
+	n = SUBNET_NODE(trie, index);
+	n->child[0] = n->child[1] = SUBNET_NONE;
+	n->bits = bits;
+	n->terminal = terminal;
+	n->pad = 0;
+	memcpy(n->key, key, trie->words * sizeof(uint32_t));
+	subnet_key_mask(n->key, trie->words, bits);
+
+	return index;
+}
+
+static void subnet_trie_release(svm_subnet_trie_t *trie, int index) {
+	SUBNET_NODE(trie, index)->child[0] = trie->freeNode;
+	trie->freeNode = index;
+}
+
+// recompute table slots covered by key/bits
+static void subnet_trie_update_slots(svm_subnet_trie_t *trie, const uint32_t *key, int bits) {
+	const svm_subnet_node_t *n;
+	svm_subnet_slot_t *slot;
+	uint32_t slotkey[4];
+	int first, last, e, index;
+
+	first = key[0] >> (32 - SUBNET_TABLE_BITS);
+	last = first;
+	if (bits < SUBNET_TABLE_BITS) {
+		first &= ~((1 << (SUBNET_TABLE_BITS - bits)) - 1);
+		last = first + (1 << (SUBNET_TABLE_BITS - bits)) - 1;
+	}
+
+	memset(slotkey, 0, sizeof(slotkey));
+
+	for (e = first; e <= last; ++e) {
+		slot = &trie->table[e];
+		slot->start = slot->best = SUBNET_NONE;
+		slotkey[0] = (uint32_t) e << (32 - SUBNET_TABLE_BITS);
+
+		for (index = trie->root; index != SUBNET_NONE; index = n->child[subnet_key_bit(slotkey, n->bits)]) {
+			n = SUBNET_NODE(trie, index);
+			if (n->bits >= SUBNET_TABLE_BITS) {
+				if (subnet_key_common(slotkey, n->key, SUBNET_TABLE_BITS) == SUBNET_TABLE_BITS) slot->start = index;
+				break;
 			}
+			if (subnet_key_common(slotkey, n->key, n->bits) != n->bits) break;
+			if (n->terminal) slot->best = index;
+		}
+	}
+}
+
+// returns 1 if inserted, 0 if already present, -1 on allocation failure
+static int subnet_trie_insert(svm_subnet_trie_t *trie, const uint32_t *key, int bits) {
+	svm_subnet_node_t *n, *glue;
+	int *link, index, common, b;
+
+	if (!trie->table) {
+		trie->table = (svm_subnet_slot_t *) malloc(SUBNET_TABLE_SIZE * sizeof(svm_subnet_slot_t));
+		if (!trie->table) return -1;
+		memset(trie->table, 0xFF, SUBNET_TABLE_SIZE * sizeof(svm_subnet_slot_t));  // all SUBNET_NONE
+	}
+
+	if (!subnet_trie_reserve(trie)) return -1;
+
+	link = &trie->root;
+
+	for (;;) {
+		if (*link == SUBNET_NONE) {
+			*link = subnet_trie_alloc(trie, key, bits, 1);
 			break;
-		case NA_IP6:
-			if (cmpbytes > sizeof(adr->ipv._6)) cmpbytes = sizeof(adr->ipv._6);
-			if (cmpbytes >= 0) {
-				diff = memcmp(&adr->ipv._6, &subnet->ipv._6, cmpbytes);
-				if (diff) return diff;
-			}
-			if (cmpbits) {
-				adrtail = adr->ipv._6[cmpbytes];
-				subnettail = subnet->ipv._6[cmpbytes];
+		}
+
+		n = SUBNET_NODE(trie, *link);
+		common = subnet_key_common(key, n->key, bits < n->bits ? bits : n->bits);
+
+		if (common == n->bits) {
+			if (bits == n->bits) {
+				if (n->terminal) return 0;
+				n->terminal = 1;
+				break;
 			}
-			break;
-		default:
-			return 0;
+			link = &n->child[subnet_key_bit(key, n->bits)];
+			continue;
+		}
+
+		// key diverges inside this node's prefix, split it
+		if (common == bits) {
+			index = subnet_trie_alloc(trie, key, bits, 1);
+			SUBNET_NODE(trie, index)->child[subnet_key_bit(n->key, bits)] = *link;
+		} else {
+			index = subnet_trie_alloc(trie, key, common, 0);
+			glue = SUBNET_NODE(trie, index);
+			b = subnet_key_bit(key, common);
+			glue->child[b ^ 1] = *link;
+			glue->child[b] = subnet_trie_alloc(trie, key, bits, 1);
+		}
+		*link = index;
+		break;
 	}
 
-	if (cmpbits) {
-		cmpmask = (char) -1 << (CHAR_BIT - cmpbits);
-		diff = (int)(adrtail & cmpmask) - (int)(subnettail & cmpmask);
-		if (diff) return diff;
+	subnet_trie_update_slots(trie, key, bits);
+
+	++trie->count;
+	return 1;
+}
+
+// returns 1 if removed, 0 if not found
+static int subnet_trie_remove(svm_subnet_trie_t *trie, const uint32_t *key, int bits) {
+	svm_subnet_node_t *n;
+	int *path[129 + 1];
+	int *link, depth, index;
+
+	link = &trie->root;
+	depth = 0;
+
+	for (;;) {
+		if (*link == SUBNET_NONE) return 0;
+		n = SUBNET_NODE(trie, *link);
+		if (n->bits > bits || subnet_key_common(key, n->key, n->bits) != n->bits) return 0;
+		path[depth++] = link;
+		if (n->bits == bits) break;
+		link = &n->child[subnet_key_bit(key, n->bits)];
 	}
 
-	return 0;
+	if (!n->terminal) return 0;
+	n->terminal = 0;
+	--trie->count;
+
+	// drop nodes that don't branch anymore, bottom-up
+	while (depth > 0) {
+		link = path[--depth];
+		index = *link;
+		n = SUBNET_NODE(trie, index);
+		if (n->terminal || (n->child[0] != SUBNET_NONE && n->child[1] != SUBNET_NONE)) break;
+		*link = n->child[0] != SUBNET_NONE ? n->child[0] : n->child[1];
+		subnet_trie_release(trie, index);
+	}
+
+	subnet_trie_update_slots(trie, key, bits);
+
+	return 1;
 }
 
-void SVM_Subnets_Init(svm_subnets_t *subnets) {
-	subnets->cap = SUBNETS_CHUNK_SIZE;
-	subnets->start = subnets->cur = (netadr_t *) malloc(subnets->cap * sizeof(netadr_t));
-	subnets->count = 0;
-	if (!subnets->start) { Com_DPrintf("ERROR: Subnet blocker: Can't allocate memory!\n"); }
+// longest matching prefix, or SUBNET_NONE
+static int subnet_trie_lookup(const svm_subnet_trie_t *trie, const uint32_t *key) {
+	const svm_subnet_node_t *n;
+	int index, best;
+
+	if (!trie->table) return SUBNET_NONE;
+
+	best = trie->table[key[0] >> (32 - SUBNET_TABLE_BITS)].best;
+	index = trie->table[key[0] >> (32 - SUBNET_TABLE_BITS)].start;
+
+	while (index != SUBNET_NONE) {
+		n = SUBNET_NODE(trie, index);
+		if (subnet_key_common(key, n->key, n->bits) != n->bits) break;
+		if (n->terminal) best = index;
+		if (n->bits == trie->words * 32) break;
+		index = n->child[subnet_key_bit(key, n->bits)];
+	}
+
+	return best;
 }
 
-netadr_t *SVM_Subnets_Add(svm_subnets_t *subnets) {
-	netadr_t *new_adr;
-	size_t count;
+// shrink the pool after bulk loading
+static void subnet_trie_compact(svm_subnet_trie_t *trie) {
+	byte *nodes;
 
-	count = subnets->cur - subnets->start;
+	if (trie->freeNode != SUBNET_NONE || trie->numNodes == trie->maxNodes) return;
 
-	if (count >= subnets->cap) {
-		subnets->cap += SUBNETS_CHUNK_SIZE;
-		new_adr = (netadr_t *) realloc(subnets->start, subnets->cap * sizeof(netadr_t));
-		if (!new_adr) { subnets->cap -= SUBNETS_CHUNK_SIZE; return 0; }
-		subnets->cur = new_adr + count;
-		subnets->start = new_adr;
+	if (!trie->numNodes) {
+		subnet_trie_free(trie);
+		return;
 	}
 
-	++subnets->count;
-	return subnets->cur++;
+	nodes = (byte *) realloc(trie->nodes, (size_t) trie->numNodes * trie->stride);
+	if (!nodes) return;
+
+	trie->nodes = nodes;
+	trie->maxNodes = trie->numNodes;
 }
 
-size_t SVM_Subnets_Remove(svm_subnets_t *subnets, netadr_t *adr) {  // adr must point inside subnets (found inside it)
-	netadr_t *last = subnets->cur - 1;
-	if (adr != last) *adr = *last;
-	--subnets->cur;
-	return --subnets->count;
+static svm_subnet_trie_t *subnet_trie_for_adr(svm_subnets_t *subnets, const netadr_t *adr) {
+	switch (adr->type) {
+		case NA_IP: return &subnets->ip4;
+		case NA_IP6: return &subnets->ip6;
+		default: return 0;
+	}
 }
 
-int SVM_Subnet_SetFromString(netadr_t *adr, char* string) {
-	int mask;
-	if (SV_ParseCIDRNotation(adr, &mask, string)) return 1;
-	adr->port = (uint16_t) mask;
+//==================================================================================
+
+void SVM_Subnets_Init(svm_subnets_t *subnets) {
+	subnet_trie_init(&subnets->ip4, 1);
+	subnet_trie_init(&subnets->ip6, 4);
+	subnets->count = 0;
+}
+
+int SVM_Subnet_SetFromString(netadr_t *adr, int *mask, char* string) {
+	if (SV_ParseCIDRNotation(adr, mask, string)) return 1;
+	if (adr->type != NA_IP && adr->type != NA_IP6) return 1;
+	return 0;
+}
+
+int SVM_Subnets_Add(svm_subnets_t *subnets, const netadr_t *adr, int mask) {
+	svm_subnet_trie_t *trie;
+	uint32_t key[4];
+	int res;
+
+	trie = subnet_trie_for_adr(subnets, adr);
+	if (!trie || mask < 0 || mask > trie->words * 32) return ERR_SVM_Subnets_SetFromString;
+
+	subnet_key_from_adr(key, adr);
+	res = subnet_trie_insert(trie, key, mask);
+	if (res < 0) return ERR_SVM_Subnets_Add;
+
+	subnets->count += res;
 	return 0;
 }
 
+int SVM_Subnets_Remove(svm_subnets_t *subnets, const netadr_t *adr, int mask) {
+	svm_subnet_trie_t *trie;
+	uint32_t key[4];
+
+	trie = subnet_trie_for_adr(subnets, adr);
+	if (!trie || mask < 0 || mask > trie->words * 32) return 0;
+
+	subnet_key_from_adr(key, adr);
+	if (!subnet_trie_remove(trie, key, mask)) return 0;
+
+	--subnets->count;
+	return 1;
+}
+
 int SVM_Subnets_AddFromString(svm_subnets_t *subnets, char* string) {
-	netadr_t adr, *p;
-	if (SVM_Subnet_SetFromString(&adr, string)) return ERR_SVM_Subnets_SetFromString;
-	p = SVM_Subnets_Add(subnets);
-	if (!p) return ERR_SVM_Subnets_Add;
-	*p = adr;
-  return 0;
+	netadr_t adr;
+	int mask;
+	if (SVM_Subnet_SetFromString(&adr, &mask, string)) return ERR_SVM_Subnets_SetFromString;
+	return SVM_Subnets_Add(subnets, &adr, mask);
+}
+
+int SVM_Subnets_RemoveFromString(svm_subnets_t *subnets, char* string) {
+	netadr_t adr;
+	int mask;
+	if (SVM_Subnet_SetFromString(&adr, &mask, string)) return 0;
+	return SVM_Subnets_Remove(subnets, &adr, mask);
 }
 
 void SVM_Subnets_AddFromFile(svm_subnets_t *subnets, char *filename) {
@@ -144,7 +404,10 @@ void SVM_Subnets_AddFromFile(svm_subnets_t *subnets, char *filename) {
 	while (fgets(subnet, MAX_INFO_VALUE, f)) {
 		switch (SVM_Subnets_AddFromString(subnets, subnet)) {
 			case ERR_SVM_Subnets_SetFromString: continue;
-			case ERR_SVM_Subnets_Add: fclose(f); return;
+			case ERR_SVM_Subnets_Add:
+				Com_DPrintf("ERROR: Subnet blocker: Can't allocate memory!\n");
+				fclose(f);
+				return;
 			default: break;
 		}
 	}
@@ -153,58 +416,174 @@ void SVM_Subnets_AddFromFile(svm_subnets_t *subnets, char *filename) {
 }
 
 void SVM_Subnets_Commit(svm_subnets_t *subnets) {
-	if (!subnets->count) return;
-	// TODO: deduplicate if (count < cur - start)
-	qsort(subnets->start, subnets->count, sizeof(netadr_t), subnets_compare);
+	subnet_trie_compact(&subnets->ip4);
+	subnet_trie_compact(&subnets->ip6);
 }
 
-netadr_t *SVM_Subnets_FindByAdr(svm_subnets_t *subnets, netadr_t *adr) {
-	if (!subnets->count) return 0;
-	return bsearch(adr, subnets->start, subnets->count, sizeof(netadr_t), subnet_adr_diff);
+qboolean SVM_Subnets_FindByAdr(svm_subnets_t *subnets, const netadr_t *adr, netadr_t *subnet, int *mask) {
+	svm_subnet_trie_t *trie;
+	const svm_subnet_node_t *n;
+	uint32_t key[4];
+	int index;
+
+	trie = subnet_trie_for_adr(subnets, adr);
+	if (!trie || !trie->count) return qfalse;
+
+	subnet_key_from_adr(key, adr);
+	index = subnet_trie_lookup(trie, key);
+	if (index == SUBNET_NONE) return qfalse;
+
+	n = SUBNET_NODE(trie, index);
+	if (subnet) subnet_adr_from_key(subnet, adr->type, n->key);
+	if (mask) *mask = n->bits;
+	return qtrue;
 }
 
-netadr_t *SVM_Subnets_FindByAdrString(svm_subnets_t *subnets, char* string) {
+qboolean SVM_Subnets_FindByAdrString(svm_subnets_t *subnets, char* string) {
 	netadr_t adr;
-	if (SVM_Subnet_SetFromString(&adr, string)) return 0;
-	return SVM_Subnets_FindByAdr(subnets, &adr);
+	int mask;
+	if (SVM_Subnet_SetFromString(&adr, &mask, string)) return qfalse;
+	return SVM_Subnets_FindByAdr(subnets, &adr, 0, 0);
+}
+
+static size_t subnet_trie_memory(const svm_subnet_trie_t *trie) {
+	return (size_t) trie->maxNodes * trie->stride + (trie->table ? SUBNET_TABLE_SIZE * sizeof(svm_subnet_slot_t) : 0);
+}
+
+size_t SVM_Subnets_Memory(const svm_subnets_t *subnets) {
+	return subnet_trie_memory(&subnets->ip4) + subnet_trie_memory(&subnets->ip6);
+}
+
+void SVM_Subnets_Free(svm_subnets_t *subnets) {
+	subnet_trie_free(&subnets->ip4);
+	subnet_trie_free(&subnets->ip6);
+	subnets->count = 0;
+}
+
+//==================================================================================
+// Benchmark against the former sorted array + bsearch lookup
+
+static int bench_subnets_compare(const void *_a, const void *_b) {
+	const netadr_t *a = (const netadr_t *) _a, *b = (const netadr_t *) _b;
+	int diff;
+
+	diff = a->type - b->type;
+	if (diff) return diff;
+
+	if (a->type == NA_IP) diff = memcmp(a->ipv._4, b->ipv._4, sizeof(a->ipv._4));
+	else diff = memcmp(a->ipv._6, b->ipv._6, sizeof(a->ipv._6));
+	if (diff) return diff;
+
+	return a->port - b->port;
 }
 
-netadr_t *SVM_Subnets_FindByAdrUC(svm_subnets_t *subnets, netadr_t *adr) {  // find in uncommitted array
-	size_t c = subnets->count;
-	netadr_t *p = subnets->start + c - 1;
-	for (; c; --c, --p) {
-		if (!subnet_adr_diff(adr, p)) return p;
+static int bench_subnet_adr_diff(const void *_adr, const void *_subnet) {
+	const netadr_t *adr = (const netadr_t *) _adr, *subnet = (const netadr_t *) _subnet;
+	const byte *a, *s;
+	int diff, cmpbytes, cmpbits, size;
+	byte cmpmask;
+
+	diff = adr->type - subnet->type;
+	if (diff) return diff;
+
+	if (adr->type == NA_IP) { a = adr->ipv._4; s = subnet->ipv._4; size = 4; }
+	else { a = adr->ipv._6; s = subnet->ipv._6; size = 16; }
+
+	cmpbytes = subnet->port / CHAR_BIT;
+	cmpbits = subnet->port & (CHAR_BIT - 1);
+	if (cmpbytes > size) cmpbytes = size;
+
+	diff = memcmp(a, s, cmpbytes);
+	if (diff) return diff;
+
+	if (cmpbits && cmpbytes < size) {
+		cmpmask = (byte)(0xFF << (CHAR_BIT - cmpbits));
+		diff = (int)(a[cmpbytes] & cmpmask) - (int)(s[cmpbytes] & cmpmask);
 	}
-	return 0;
+
+	return diff;
 }
 
-netadr_t *SVM_Subnets_FindByAdrStringUC(svm_subnets_t *subnets, char* string) {
-	netadr_t adr;
-	if (SVM_Subnet_SetFromString(&adr, string)) return 0;
-	return SVM_Subnets_FindByAdrUC(subnets, &adr);
-}
-
-size_t SVM_Subnets_RemoveNC(svm_subnets_t *subnets, netadr_t *adr) {  // remove by duplication, preserve order, no need to commit after
-	netadr_t *last, *s, *p;
-	last = subnets->cur - 1;
-	for (s = adr, p = s + 1; p <= last && !memcmp(p, s, sizeof(netadr_t)); ++p, ++s);  // find last duplicate
-	if (s == last) {  // if item is the last
-		++last;
-		do {
-			--s;
-			--last;
-			--subnets->cur;
-		} while (!memcmp(s, last, sizeof(netadr_t)));  // remove all duplicates
-	} else {
-		last = s + 1;
-		for (s = adr, p = s - 1; p >= subnets->start && !memcmp(p, s, sizeof(netadr_t)); --p, --s);  // find first duplicate
-		for (p = s; p < last; ++p) *p = *last; // latch all duplicates with subsequent item
+static void bench_collect(const svm_subnet_trie_t *trie, netadrtype_t type, int index, netadr_t *list, size_t *count) {
+	const svm_subnet_node_t *n;
+
+	while (index != SUBNET_NONE) {
+		n = SUBNET_NODE(trie, index);
+		if (n->terminal) {
+			subnet_adr_from_key(&list[*count], type, n->key);
+			list[(*count)++].port = n->bits;
+		}
+		bench_collect(trie, type, n->child[0], list, count);
+		index = n->child[1];
 	}
-	return --subnets->count;
 }
 
-void SVM_Subnets_Free(svm_subnets_t *subnets) {
-	if (!subnets->start) return;
-	free(subnets->start);
-	subnets->start = 0;
+static uint32_t bench_random(uint32_t *state) {
+	uint32_t x = *state;
+	x ^= x << 13; x ^= x >> 17; x ^= x << 5;
+	return *state = x;
+}
+
+void SVM_Subnets_Benchmark(svm_subnets_t *subnets, int lookups) {
+	netadr_t *list, *queries;
+	size_t count;
+	int64_t start, trieTime, arrayTime;
+	int trieHits, arrayHits, mismatches, j;
+	uint32_t seed;
+	qboolean t, a;
+
+	count = 0;
+	list = (netadr_t *) malloc((subnets->count ? subnets->count : 1) * sizeof(netadr_t));
+	queries = (netadr_t *) malloc(lookups * sizeof(netadr_t));
+	if (!list || !queries) {
+		Com_Printf("Subnet blocker: Can't allocate benchmark memory\n");
+		free(list);
+		free(queries);
+		return;
+	}
+
+	bench_collect(&subnets->ip4, NA_IP, subnets->ip4.root, list, &count);
+	bench_collect(&subnets->ip6, NA_IP6, subnets->ip6.root, list, &count);
+	qsort(list, count, sizeof(netadr_t), bench_subnets_compare);
+
+	// half of the queries inside known subnets, the rest random IPv4
+	seed = 0x9E3779B9u;
+	for (j = 0; j < lookups; ++j) {
+		netadr_t *q = &queries[j];
+		if (count && (j & 1)) {
+			*q = list[bench_random(&seed) % count];
+			if (q->type == NA_IP) q->ipv._4[3] ^= bench_random(&seed);
+			else q->ipv._6[15] ^= bench_random(&seed);
+		} else {
+			memset(q, 0, sizeof(*q));
+			q->type = NA_IP;
+			*(uint32_t *) q->ipv._4 = bench_random(&seed);
+		}
+		q->port = 0;
+	}
+
+	trieHits = arrayHits = mismatches = 0;
+
+	start = Sys_Microseconds();
+	for (j = 0; j < lookups; ++j)
+		trieHits += SVM_Subnets_FindByAdr(subnets, &queries[j], 0, 0);
+	trieTime = Sys_Microseconds() - start;
+
+	start = Sys_Microseconds();
+	for (j = 0; j < lookups; ++j)
+		arrayHits += count && bsearch(&queries[j], list, count, sizeof(netadr_t), bench_subnet_adr_diff) != 0;
+	arrayTime = Sys_Microseconds() - start;
+
+	for (j = 0; j < lookups; ++j) {
+		t = SVM_Subnets_FindByAdr(subnets, &queries[j], 0, 0);
+		a = count && bsearch(&queries[j], list, count, sizeof(netadr_t), bench_subnet_adr_diff) != 0;
+		if (t != a) ++mismatches;
+	}
+
+	Com_Printf("Subnet blocker: %ld subnets, %ld KB trie, %i lookups\n", (long) count, (long)(SVM_Subnets_Memory(subnets) / 1024), lookups);
+	Com_Printf("  trie:    %10.0f lookups/s, %i hits\n", trieTime > 0 ? lookups * 1e6 / trieTime : 0.0, trieHits);
+	Com_Printf("  bsearch: %10.0f lookups/s, %i hits, %i disagree with trie\n", arrayTime > 0 ? lookups * 1e6 / arrayTime : 0.0, arrayHits, mismatches);
+
+	free(list);
+	free(queries);
 }
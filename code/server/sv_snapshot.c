@@ -45,6 +45,147 @@ A normal server packet will look like:
 =============================================================================
 */
 
+/*
+=============================================================================
+
+Entity delta cache
+
+All clients refer to the same shared copies of entity states, so clients that
+delta from the same old state produce exactly the same entity bitstream. The
+first client to need a delta encodes it, everybody else copies the bits. The
+cache is keyed on the from/to pointers and emptied whenever a new common
+snapshot may reuse snapshot entity storage. Snapshot worker threads share it,
+slots are claimed with a compare-and-swap and published when filled.
+
+=============================================================================
+*/
+
+#define DELTA_CACHE_SLOTS	8192	// must be a power of two
+#define DELTA_CACHE_PROBES	8
+#define DELTA_CACHE_BYTES	0x80000
+#define MAX_DELTA_BYTES		640		// all fields changed as full floats is ~330 bytes
+
+typedef struct {
+	int			stamp;		// generation*2+1 while filled, generation*2+2 when ready
+	const entityState_t	*from;
+	const entityState_t	*to;
+	qboolean	force;
+	int			mergeMask;
+	int			offset;		// into dc_data
+	int			numBits;
+} deltaCacheSlot_t;
+
+static cvar_t			*sv_deltaCache;
+
+static deltaCacheSlot_t	dc_slots[ DELTA_CACHE_SLOTS ];
+static byte				dc_data[ DELTA_CACHE_BYTES ];
+static int				dc_used;
+static int				dc_generation;
+
+
+/*
+=============
+SV_ResetDeltaCache
+
+Must not be called while snapshot jobs run
+=============
+*/
+static void SV_ResetDeltaCache( void ) {
+
+	dc_used = 0;
+	dc_generation++;
+
+	if ( dc_generation >= 0x3FFFFFFF ) {
+		Com_Memset( dc_slots, 0, sizeof( dc_slots ) );
+		dc_generation = 1;
+	}
+}
+
+
+/*
+=============
+SV_WriteDeltaEntity
+
+Same as MSG_WriteDeltaEntity, through the delta cache
+=============
+*/
+static void SV_WriteDeltaEntity( msg_t *msg, const entityState_t *from, const entityState_t *to, qboolean force ) {
+	byte		buf[ MAX_DELTA_BYTES ];
+	msg_t		delta;
+	deltaCacheSlot_t	*slot, *freeSlot;
+	unsigned int	hash;
+	int			i, stamp, freeStamp, ready, mergeMask, size, offset;
+
+	if ( !sv_deltaCache->integer || !dc_generation ) {
+		MSG_WriteDeltaEntity( msg, from, to, force );
+		return;
+	}
+
+#ifdef USE_MV
+	mergeMask = MSG_entMergeMask;
+#else
+	mergeMask = 0;
+#endif
+
+	ready = dc_generation * 2 + 2;
+
+	hash = (unsigned int)( (intptr_t)from / sizeof( *from ) ) * 0x9E3779B1U;
+	hash ^= (unsigned int)( (intptr_t)to / sizeof( *to ) ) + force;
+	hash ^= hash >> 13;
+
+	freeSlot = NULL;
+	freeStamp = 0;
+	for ( i = 0; i < DELTA_CACHE_PROBES; i++ ) {
+		slot = &dc_slots[ ( hash + i ) & ( DELTA_CACHE_SLOTS - 1 ) ];
+		stamp = Sys_AtomicLoad( &slot->stamp );
+		if ( stamp == ready ) {
+			if ( slot->from == from && slot->to == to && slot->force == force && slot->mergeMask == mergeMask ) {
+				MSG_WriteBitstream( msg, dc_data + slot->offset, slot->numBits );
+				return;
+			}
+		} else if ( stamp != ready - 1 ) {
+			// not used in this generation, nothing after it either
+			freeSlot = slot;
+			freeStamp = stamp;
+			break;
+		}
+	}
+
+	MSG_Init( &delta, buf, sizeof( buf ) );
+	MSG_WriteDeltaEntity( &delta, from, to, force );
+	if ( delta.overflowed ) {
+		MSG_WriteDeltaEntity( msg, from, to, force );
+		return;
+	}
+
+	MSG_WriteBitstream( msg, buf, delta.bit );
+
+	if ( freeSlot == NULL ) {
+		return;
+	}
+
+	size = ( delta.bit + 7 ) >> 3;
+	offset = Sys_AtomicAdd( &dc_used, size );
+	if ( offset + size > DELTA_CACHE_BYTES ) {
+		return;
+	}
+
+	if ( !Sys_AtomicCAS( &freeSlot->stamp, freeStamp, ready - 1 ) ) {
+		return; // taken by another thread
+	}
+
+	Com_Memcpy( dc_data + offset, buf, size );
+	freeSlot->from = from;
+	freeSlot->to = to;
+	freeSlot->force = force;
+	freeSlot->mergeMask = mergeMask;
+	freeSlot->offset = offset;
+	freeSlot->numBits = delta.bit;
+
+	Sys_AtomicStore( &freeSlot->stamp, ready );
+}
+
+
 /*
 =============
 SV_EmitPacketEntities
@@ -88,7 +229,7 @@ static void SV_EmitPacketEntities( const clientSnapshot_t *from, const clientSna
 			// delta update from old position
 			// because the force parm is qfalse, this will not result
 			// in any bytes being emitted if the entity has not changed at all
-			MSG_WriteDeltaEntity (msg, oldent, newent, qfalse );
+			SV_WriteDeltaEntity( msg, oldent, newent, qfalse );
 			oldindex++;
 			newindex++;
 			continue;
@@ -96,7 +237,7 @@ static void SV_EmitPacketEntities( const clientSnapshot_t *from, const clientSna
 
 		if ( newnum < oldnum ) {
 			// this is a new entity, send it from the baseline
-			MSG_WriteDeltaEntity (msg, &sv.svEntities[newnum].baseline, newent, qtrue );
+			SV_WriteDeltaEntity( msg, &sv.svEntities[newnum].baseline, newent, qtrue );
 			newindex++;
 			continue;
 		}
@@ -643,6 +784,8 @@ typedef struct clientPVS_s {
     byte	entMask[MAX_GENTITIES/8];
     qboolean entMaskBuilt;
 
+    byte	entAdded[MAX_GENTITIES/8];	// used to prevent double adding from portal views
+
 } clientPVS_t;
 
 static clientPVS_t client_pvs[ MAX_CLIENTS ];
@@ -680,9 +823,10 @@ static void SV_SortEntityNumbers( entityNum_t *num, const int size ) {
 SV_AddIndexToSnapshot
 ===============
 */
-static void SV_AddIndexToSnapshot( svEntity_t *svEnt, int index, snapshotEntityNumbers_t *eNums ) {
+static void SV_AddIndexToSnapshot( clientPVS_t *pvs, int entityNum, int index ) {
+	snapshotEntityNumbers_t *eNums = &pvs->numbers;
 
-	svEnt->snapshotCounter = sv.snapshotCounter;
+	SET_ABIT( pvs->entAdded, entityNum );
 
 	// if we are full, silently discard entities
 	if ( eNums->numSnapshotEntities >= MAX_SNAPSHOT_ENTITIES ) {
@@ -753,13 +897,13 @@ static void SV_AddEntitiesVisibleFromPoint(const vec3_t origin, clientPVS_t* pvs
 		svEnt = &sv.svEntities[ es->number ];
 
 		// don't double add an entity through portals
-		if ( svEnt->snapshotCounter == sv.snapshotCounter ) {
+		if ( GET_ABIT( pvs->entAdded, es->number ) ) {
 			continue;
 		}
 
 		// broadcast entities are always sent
 		if ( ent->r.svFlags & SVF_BROADCAST ) {
-            SV_AddIndexToSnapshot( svEnt, e, &pvs->numbers );
+            SV_AddIndexToSnapshot( pvs, es->number, e );
 			continue;
 		}
 
@@ -805,7 +949,7 @@ static void SV_AddEntitiesVisibleFromPoint(const vec3_t origin, clientPVS_t* pvs
 		}
 
 		// add it
-        SV_AddIndexToSnapshot( svEnt, e, &pvs->numbers );
+        SV_AddIndexToSnapshot( pvs, es->number, e );
 
 		// if it's a portal entity, add everything visible from its camera position
 		if ( ent->r.svFlags & SVF_PORTAL && !portal ) {
@@ -849,6 +993,8 @@ void SV_InitSnapshotStorage( void )
 	svs.currFrame = NULL;
 
     Com_Memset( client_pvs, 0, sizeof( client_pvs ) );
+
+	SV_ResetDeltaCache();
 }
 
 
@@ -912,12 +1058,9 @@ static void SV_BuildCommonSnapshot( void )
 			}
 
 			list[ count++ ] = ent;
-			sv.svEntities[ num ].snapshotCounter = -1;
 		}
 	}
 
-	sv.snapshotCounter = -1;
-
 	sf = &svs.snapFrames[ svs.snapshotFrame % NUM_SNAPSHOT_FRAMES ];
 	
 	// track last valid frame
@@ -952,6 +1095,9 @@ static void SV_BuildCommonSnapshot( void )
 	sf->frameNum = svs.snapshotFrame;
 	svs.snapshotFrame++;
 
+	// storage of old frames may be reused
+	SV_ResetDeltaCache();
+
 	svs.currFrame = sf; // clients can refer to this
 
 	// setup start index
@@ -965,7 +1111,6 @@ static void SV_BuildCommonSnapshot( void )
 
 static clientPVS_t *SV_BuildClientPVS( int clientSlot, const playerState_t *ps, qboolean buildEntityMask )
 {
-    svEntity_t	*svEnt;
     clientPVS_t	*pvs;
     vec3_t	org;
     int i;
@@ -979,13 +1124,10 @@ static clientPVS_t *SV_BuildClientPVS( int clientSlot, const playerState_t *ps,
         VectorCopy( ps->origin, org );
         org[2] += ps->viewheight;
 
-        // bump the counter used to prevent double adding
-        sv.snapshotCounter++;
-
         // never send client's own entity, because it can
         // be regenerated from the playerstate
-        svEnt = &sv.svEntities[ ps->clientNum ];
-        svEnt->snapshotCounter = sv.snapshotCounter;
+        memset( pvs->entAdded, 0, sizeof( pvs->entAdded ) );
+        SET_ABIT( pvs->entAdded, ps->clientNum );
 
         // add all the entities directly visible to the eye, which
         // may include portal entities that merge other viewpoints
@@ -1349,6 +1491,28 @@ void SV_SendMessageToClient( msg_t *msg, client_t *client )
 }
 
 
+/*
+=======================
+SV_EncodeClientSnapshot
+
+Writes reliable commands and the snapshot built by SV_BuildClientSnapshot
+=======================
+*/
+static void SV_EncodeClientSnapshot( client_t *client, msg_t *msg ) {
+
+	// NOTE, MRE: all server->client messages now acknowledge
+	// let the client know which reliable clientCommands we have received
+	MSG_WriteLong( msg, client->lastClientCommand );
+
+	// (re)send any reliable server commands
+	SV_UpdateServerCommandsToClient( client, msg );
+
+	// send over all the relevant entityState_t
+	// and the playerState_t
+	SV_WriteSnapshotToClient( client, msg );
+}
+
+
 /*
 =======================
 SV_SendClientSnapshot
@@ -1373,16 +1537,7 @@ void SV_SendClientSnapshot( client_t *client ) {
 	MSG_Init( &msg, msg_buf, MAX_MSGLEN );
 	msg.allowoverflow = qtrue;
 
-	// NOTE, MRE: all server->client messages now acknowledge
-	// let the client know which reliable clientCommands we have received
-	MSG_WriteLong( &msg, client->lastClientCommand );
-
-	// (re)send any reliable server commands
-	SV_UpdateServerCommandsToClient( client, &msg );
-
-	// send over all the relevant entityState_t
-	// and the playerState_t
-	SV_WriteSnapshotToClient( client, &msg );
+	SV_EncodeClientSnapshot( client, &msg );
 
 	// check for overflow
 	if ( msg.overflowed ) {
@@ -1394,6 +1549,279 @@ void SV_SendClientSnapshot( client_t *client ) {
 }
 
 
+/*
+=============================================================================
+
+Parallel snapshot building
+
+With sv_snapshotThreads > 0 visibility culling and delta encoding of client
+snapshots is spread over a pool of worker threads, the main thread takes a
+share of jobs as well. Jobs only touch their own client_t and clientPVS_t,
+everything else - multiview and recorder slots, console output, demo
+recording and netchan transmit - stays on the main thread, finished messages
+are sent in client slot order after all jobs are done.
+
+=============================================================================
+*/
+
+#define MAX_SNAPSHOT_THREADS	16
+
+typedef struct {
+	client_t	*client;
+	qboolean	encode;			// bots don't need a message
+	msg_t		msg;
+	byte		msg_buf[ MAX_MSGLEN_BUF ];
+} snapshotJob_t;
+
+typedef struct {
+	void		*thread;
+	void		*start;
+	void		*done;
+} snapshotWorker_t;
+
+static cvar_t			*sv_snapshotThreads;
+
+static snapshotWorker_t	sn_workers[ MAX_SNAPSHOT_THREADS ];
+static int				sn_numWorkers;
+static volatile int		sn_shutdown;
+
+static snapshotJob_t	*sn_jobs;			// MAX_CLIENTS entries
+static int				sn_numJobs;
+static volatile int		sn_nextJob;
+
+
+/*
+=======================
+SV_RunSnapshotJobs
+
+Called by the main thread and all workers, returns when no jobs left
+=======================
+*/
+static void SV_RunSnapshotJobs( void ) {
+	snapshotJob_t *job;
+	int n;
+
+	while ( ( n = Sys_AtomicAdd( &sn_nextJob, 1 ) ) < sn_numJobs ) {
+		job = &sn_jobs[ n ];
+
+		SV_BuildClientSnapshot( job->client );
+
+		if ( !job->encode ) {
+			continue;
+		}
+
+		MSG_Init( &job->msg, job->msg_buf, MAX_MSGLEN );
+		job->msg.allowoverflow = qtrue;
+
+		SV_EncodeClientSnapshot( job->client, &job->msg );
+	}
+}
+
+
+/*
+=======================
+SV_SnapshotWorker
+=======================
+*/
+static void SV_SnapshotWorker( void *param ) {
+	snapshotWorker_t *worker = (snapshotWorker_t *)param;
+
+	for ( ;; ) {
+		if ( !Sys_WaitSignal( worker->start, 1000 ) ) {
+			if ( Sys_AtomicLoad( &sn_shutdown ) )
+				break;
+			continue;
+		}
+
+		if ( Sys_AtomicLoad( &sn_shutdown ) )
+			break;
+
+		SV_RunSnapshotJobs();
+
+		Sys_RaiseSignal( worker->done );
+	}
+}
+
+
+/*
+=======================
+SV_StopSnapshotThreads
+=======================
+*/
+static void SV_StopSnapshotThreads( void ) {
+	snapshotWorker_t *worker;
+	int i;
+
+	if ( !sn_numWorkers ) {
+		return;
+	}
+
+	Sys_AtomicStore( &sn_shutdown, 1 );
+
+	for ( i = 0; i < sn_numWorkers; i++ ) {
+		worker = &sn_workers[ i ];
+		Sys_RaiseSignal( worker->start );
+		Sys_JoinThread( worker->thread );
+		Sys_DestroySignal( worker->start );
+		Sys_DestroySignal( worker->done );
+	}
+
+	Com_Memset( sn_workers, 0, sizeof( sn_workers ) );
+	sn_numWorkers = 0;
+
+	Z_Free( sn_jobs );
+	sn_jobs = NULL;
+}
+
+
+/*
+=======================
+SV_StartSnapshotThreads
+=======================
+*/
+static void SV_StartSnapshotThreads( int count ) {
+	snapshotWorker_t *worker;
+
+	SV_StopSnapshotThreads();
+
+	if ( count <= 0 ) {
+		return;
+	}
+
+	Sys_AtomicStore( &sn_shutdown, 0 );
+
+	sn_jobs = Z_Malloc( MAX_CLIENTS * sizeof( sn_jobs[0] ) );
+
+	while ( sn_numWorkers < count && sn_numWorkers < MAX_SNAPSHOT_THREADS ) {
+		worker = &sn_workers[ sn_numWorkers ];
+		worker->start = Sys_CreateSignal();
+		worker->done = Sys_CreateSignal();
+		if ( worker->start && worker->done ) {
+			worker->thread = Sys_CreateThread( SV_SnapshotWorker, worker );
+		}
+		if ( !worker->thread ) {
+			if ( worker->start )
+				Sys_DestroySignal( worker->start );
+			if ( worker->done )
+				Sys_DestroySignal( worker->done );
+			Com_Memset( worker, 0, sizeof( *worker ) );
+			Com_Printf( S_COLOR_YELLOW "WARNING: failed to create snapshot thread\n" );
+			break;
+		}
+		sn_numWorkers++;
+	}
+
+	if ( !sn_numWorkers ) {
+		Z_Free( sn_jobs );
+		sn_jobs = NULL;
+	}
+}
+
+
+/*
+=======================
+SV_CheckSnapshotThreads
+=======================
+*/
+static void SV_CheckSnapshotThreads( void ) {
+
+	if ( !sv_snapshotThreads->modified ) {
+		return;
+	}
+
+	sv_snapshotThreads->modified = qfalse;
+
+	SV_StartSnapshotThreads( sv_snapshotThreads->integer );
+}
+
+
+/*
+=======================
+SV_DispatchSnapshotJobs
+
+Runs all queued jobs on the worker pool and waits for completion
+=======================
+*/
+static void SV_DispatchSnapshotJobs( void ) {
+	int i;
+
+	// shared frame is built once, before any job may refer to it
+	if ( svs.currFrame == NULL ) {
+		SV_BuildCommonSnapshot();
+	}
+
+	Sys_AtomicStore( &sn_nextJob, 0 );
+
+	for ( i = 0; i < sn_numWorkers; i++ ) {
+		Sys_RaiseSignal( sn_workers[ i ].start );
+	}
+
+	SV_RunSnapshotJobs();
+
+	for ( i = 0; i < sn_numWorkers; i++ ) {
+		while ( !Sys_WaitSignal( sn_workers[ i ].done, 1000 ) )
+			;
+	}
+}
+
+
+/*
+=======================
+SV_ParallelSnapshotAllowed
+
+Returns qfalse for clients which must be handled on the main thread
+=======================
+*/
+static qboolean SV_ParallelSnapshotAllowed( const client_t *client, qboolean clientMask ) {
+	const playerState_t *ps;
+
+#ifdef USE_MV
+	// multiview snapshots read other client slots
+	if ( client->multiview.protocol ) {
+		return qfalse;
+	}
+#endif
+
+	if ( client->state == CS_ZOMBIE || !client->gentity ) {
+		return qtrue;
+	}
+
+	// let SV_BuildClientSnapshot raise errors on the main thread
+	ps = SV_GameClientNum( client - svs.clients );
+	if ( ps->clientNum < 0 || ps->clientNum >= MAX_GENTITIES-1 ) {
+		return qfalse;
+	}
+
+	if ( clientMask && ps->clientNum >= 32 ) {
+		return qfalse;
+	}
+
+	return qtrue;
+}
+
+
+/*
+=======================
+SV_HaveClientMaskEntities
+=======================
+*/
+static qboolean SV_HaveClientMaskEntities( void ) {
+	int i;
+
+	if ( svs.currFrame == NULL ) {
+		SV_BuildCommonSnapshot();
+	}
+
+	for ( i = 0; i < svs.currFrame->count; i++ ) {
+		if ( SV_GentityNum( svs.currFrame->ents[ i ]->number )->r.svFlags & SVF_CLIENTMASK ) {
+			return qtrue;
+		}
+	}
+
+	return qfalse;
+}
+
+
 /*
 =======================
 SV_SendClientMessages
@@ -1401,11 +1829,17 @@ SV_SendClientMessages
 */
 void SV_SendClientMessages( void )
 {
-	int		i;
+	client_t	*list[ MAX_CLIENTS ];
+	snapshotJob_t	*jobs[ MAX_CLIENTS ];
+	snapshotJob_t	*job;
+	qboolean	clientMask;
+	int		i, count;
 	client_t	*c;
 
 	svs.msgTime = Sys_Milliseconds();
 
+	SV_CheckSnapshotThreads();
+
 #ifdef USE_MV
     if ( sv_demoFile != FS_INVALID_HANDLE )
     {
@@ -1422,7 +1856,8 @@ void SV_SendClientMessages( void )
     }
 #endif // USE_MV
 
-	// send a message to each connected client
+	// pick clients that need a new message
+	count = 0;
 	for( i = 0; i < sv_maxclients->integer; i++ )
 	{
 		c = &svs.clients[ i ];
@@ -1452,9 +1887,203 @@ void SV_SendClientMessages( void )
 			continue;
 		}
 
-		// generate and send a new message
-		SV_SendClientSnapshot( c );
+		list[ count ] = c;
+		jobs[ count ] = NULL;
+		count++;
+	}
+
+	// build and encode as many snapshots as possible in parallel,
+	// developer mode prints from the snapshot code so it stays serial
+	if ( sn_numWorkers && count > 1 && !com_developer->integer ) {
+		clientMask = SV_HaveClientMaskEntities();
+		sn_numJobs = 0;
+		for ( i = 0; i < count; i++ ) {
+			c = list[ i ];
+			if ( SV_ParallelSnapshotAllowed( c, clientMask ) ) {
+				job = &sn_jobs[ sn_numJobs++ ];
+				job->client = c;
+				job->encode = ( c->netchan.remoteAddress.type != NA_BOT );
+				jobs[ i ] = job;
+			}
+		}
+		if ( sn_numJobs ) {
+			SV_DispatchSnapshotJobs();
+		}
+	}
+
+	// gather all snapshots into a single batch, if supported
+	NET_BeginBatch();
+
+	// send a message to each connected client
+	for ( i = 0; i < count; i++ )
+	{
+		c = list[ i ];
+		job = jobs[ i ];
+
+		if ( job == NULL ) {
+			// generate and send a new message
+			SV_SendClientSnapshot( c );
+		} else if ( job->encode ) {
+			// check for overflow
+			if ( job->msg.overflowed ) {
+				Com_Printf( "WARNING: msg overflowed for %s\n", c->name );
+				MSG_Clear( &job->msg );
+			}
+			SV_SendMessageToClient( &job->msg, c );
+		}
+
 		c->lastSnapshotTime = svs.time;
 		c->rateDelayed = qfalse;
 	}
+
+	NET_FlushBatch();
+}
+
+
+/*
+=======================
+SV_SnapshotBench_f
+
+Measures serial and parallel snapshot building for all current clients
+=======================
+*/
+static void SV_SnapshotBench_f( void ) {
+	client_t	*list[ MAX_CLIENTS ];
+	int			reliableSent[ MAX_CLIENTS ];
+	int64_t		start, serial, parallel;
+	qboolean	clientMask;
+	int			frames, threads, savedThreads;
+	int			i, n, count;
+	client_t	*c;
+
+	if ( sv.state != SS_GAME ) {
+		Com_Printf( "Server is not running.\n" );
+		return;
+	}
+
+	frames = 100;
+	if ( Cmd_Argc() > 1 ) {
+		frames = atoi( Cmd_Argv( 1 ) );
+		if ( frames < 1 )
+			frames = 1;
+	}
+
+	threads = sv_snapshotThreads->integer;
+	if ( Cmd_Argc() > 2 ) {
+		threads = atoi( Cmd_Argv( 2 ) );
+	} else if ( threads <= 0 ) {
+		threads = Sys_NumCPUs() - 1;
+	}
+	if ( threads < 1 )
+		threads = 1;
+
+	clientMask = SV_HaveClientMaskEntities();
+
+	// the recorder and demo recording clients carry state between snapshots
+	count = 0;
+	for ( i = 0, c = svs.clients; i < sv_maxclients->integer; i++, c++ ) {
+		if ( c->state < CS_PRIMED || !c->gentity )
+			continue;
+#ifdef USE_SERVER_DEMO
+		if ( c->demo_recording )
+			continue;
+#endif
+		if ( !SV_ParallelSnapshotAllowed( c, clientMask ) )
+			continue;
+		reliableSent[ count ] = c->reliableSent;
+		list[ count++ ] = c;
+	}
+
+	if ( !count ) {
+		Com_Printf( "No clients to build snapshots for, add some bots.\n" );
+		return;
+	}
+
+	savedThreads = sn_numWorkers;
+	if ( sn_numWorkers != threads ) {
+		SV_StartSnapshotThreads( threads );
+	}
+
+	if ( !sn_numWorkers ) {
+		Com_Printf( "Failed to start snapshot threads.\n" );
+		SV_StartSnapshotThreads( savedThreads );
+		return;
+	}
+
+	sn_numJobs = count;
+	for ( i = 0; i < count; i++ ) {
+		sn_jobs[ i ].client = list[ i ];
+		sn_jobs[ i ].encode = qtrue;
+	}
+
+	// serial
+	start = Sys_Microseconds();
+	for ( n = 0; n < frames; n++ ) {
+		for ( i = 0; i < count; i++ ) {
+			client_pvs[ list[ i ] - svs.clients ].snapshotFrame = -1;
+		}
+		Sys_AtomicStore( &sn_nextJob, 0 );
+		SV_RunSnapshotJobs();
+	}
+	serial = Sys_Microseconds() - start;
+
+	// parallel
+	start = Sys_Microseconds();
+	for ( n = 0; n < frames; n++ ) {
+		for ( i = 0; i < count; i++ ) {
+			client_pvs[ list[ i ] - svs.clients ].snapshotFrame = -1;
+		}
+		SV_DispatchSnapshotJobs();
+	}
+	parallel = Sys_Microseconds() - start;
+
+	for ( i = 0; i < count; i++ ) {
+		list[ i ]->reliableSent = reliableSent[ i ];
+	}
+
+	if ( sn_numWorkers != savedThreads ) {
+		SV_StartSnapshotThreads( savedThreads );
+	}
+
+	Com_Printf( "%i clients, %i entities, %i frames:\n", count, svs.currFrame->count, frames );
+	Com_Printf( "  serial:   %6i usec/frame\n", (int)( serial / frames ) );
+	Com_Printf( "  parallel: %6i usec/frame (%i+1 threads), %.2fx\n", (int)( parallel / frames ),
+		threads, parallel > 0 ? (double)serial / (double)parallel : 0.0 );
+}
+
+
+/*
+=======================
+SV_InitSnapshotThreads
+=======================
+*/
+void SV_InitSnapshotThreads( void ) {
+
+	sv_snapshotThreads = Cvar_Get( "sv_snapshotThreads", "0", CVAR_ARCHIVE_ND );
+	Cvar_CheckRange( sv_snapshotThreads, "0", XSTRING(MAX_SNAPSHOT_THREADS), CV_INTEGER );
+	Cvar_SetDescription( sv_snapshotThreads, "Number of worker threads used to build client snapshots in parallel with the main thread, 0 builds all snapshots on the main thread\nDefault: 0" );
+	sv_snapshotThreads->modified = qtrue;
+
+	sv_deltaCache = Cvar_Get( "sv_deltaCache", "1", CVAR_ARCHIVE_ND );
+	Cvar_CheckRange( sv_deltaCache, "0", "1", CV_INTEGER );
+	Cvar_SetDescription( sv_deltaCache, "Encode entity deltas once per snapshot and reuse them for all clients with the same delta base\nDefault: 1" );
+
+	Cmd_AddCommand( "snapshotbench", SV_SnapshotBench_f );
+	Cmd_SetDescription( "snapshotbench", "Compares serial and parallel snapshot building for all current clients\nusage: snapshotbench [frames] [threads]" );
+}
+
+
+/*
+=======================
+SV_ShutdownSnapshotThreads
+=======================
+*/
+void SV_ShutdownSnapshotThreads( void ) {
+
+	SV_StopSnapshotThreads();
+
+	// restart the pool on next server start
+	if ( sv_snapshotThreads ) {
+		sv_snapshotThreads->modified = qtrue;
+	}
 }
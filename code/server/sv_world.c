@@ -59,43 +59,80 @@ the world is carved up with an evenly spaced, axially aligned bsp tree.  Entitie
 are kept in chains either at the final leafs, or at the first node that splits
 them, which prevents having to deal with multiple fragments of a single entity.
 
+With sv_broadphase 1 a hierarchy of loose grids is used instead.  Entities
+are kept in the xy cell that holds the center of their box, on the finest
+level with cells at least as large as the box.  Cells are searched as if they
+were half a cell larger on each side, so no entity has to be stored twice.
+The finest cell size follows from the world bounds, each next level has cells
+four times larger and the last one is a single cell.  Boxes are stored in
+structure of arrays order and rejected four at a time.
+
 ===============================================================================
 */
 
+#if idx64 && ( defined(__SSE2__) || defined(_MSC_VER) )
+#include <emmintrin.h>
+#define USE_SSE2_AREA
+#endif
+
 typedef struct worldSector_s {
 	int		axis;		// -1 = leaf node
 	float	dist;
 	struct worldSector_s	*children[2];
-	svEntity_t	*entities;
+	int		entities;	// first entity of the chain, -1 if empty
 } worldSector_t;
 
 #define	AREA_DEPTH	4
 #define	AREA_NODES	64
 
-worldSector_t	sv_worldSectors[AREA_NODES];
-int			sv_numworldSectors;
+#define	AREA_GRID_CELLS		64			// max number of cells along x and y
+#define	AREA_GRID_MINSIZE	128.0f		// smallest cell size
+#define	AREA_GRID_LEVELS	4			// enough to reach a single cell from AREA_GRID_CELLS
+#define	AREA_BOX_EMPTY		1.0e30f		// box of unused bucket lanes, never touches a query
 
+typedef enum {
+	AREA_SECTORS,
+	AREA_GRID
+} areaIndexType_t;
 
-/*
-===============
-SV_SectorList_f
-===============
-*/
-void SV_SectorList_f( void ) {
-	int				i, c;
-	worldSector_t	*sec;
-	svEntity_t		*ent;
+typedef struct {
+	int		count;
+	int		capacity;	// multiple of four, lanes past count hold empty boxes
+	float	*bounds;	// minx, miny, minz, maxx, maxy, maxz arrays of capacity floats each
+	int		*nums;
+} areaBucket_t;
 
-	for ( i = 0 ; i < AREA_NODES ; i++ ) {
-		sec = &sv_worldSectors[i];
+typedef struct {
+	float			cellSize;
+	float			scale;			// 1 / cellSize
+	int				size[2];
+	int				first;			// index of the first cell in areaIndex_t.buckets
+	int				count;			// entities in all cells
+} areaGridLevel_t;
+
+typedef struct {
+	areaIndexType_t	type;
+
+	worldSector_t	sectors[AREA_NODES];
+	int				numSectors;
+
+	vec2_t			gridOrigin;
+	areaGridLevel_t	levels[AREA_GRID_LEVELS];
+	int				numLevels;
+	areaBucket_t	*buckets;		// cells of all levels
+	int				numBuckets;
+	uint64_t		occupied[AREA_GRID_LEVELS][AREA_GRID_CELLS];	// bits of non-empty cells in each row
+
+	short			node[MAX_GENTITIES];	// sector or bucket of a linked entity, -1 if not linked
+	short			link[MAX_GENTITIES];	// next entity in the sector chain or slot in the bucket
+	vec3_t			absmin[MAX_GENTITIES];
+	vec3_t			absmax[MAX_GENTITIES];
+} areaIndex_t;
+
+static areaIndex_t	sv_area;
+
+static cvar_t	*sv_broadphase;
 
-		c = 0;
-		for ( ent = sec->entities ; ent ; ent = ent->nextEntityInWorldSector ) {
-			c++;
-		}
-		Com_Printf( "sector %i: %i entities\n", i, c );
-	}
-}
 
 /*
 ===============
@@ -104,13 +141,15 @@ SV_CreateworldSector
 Builds a uniformly subdivided tree for the given world size
 ===============
 */
-static worldSector_t *SV_CreateworldSector( int depth, vec3_t mins, vec3_t maxs ) {
+static worldSector_t *SV_CreateworldSector( areaIndex_t *ai, int depth, vec3_t mins, vec3_t maxs ) {
 	worldSector_t	*anode;
 	vec3_t		size;
 	vec3_t		mins1, maxs1, mins2, maxs2;
 
-	anode = &sv_worldSectors[sv_numworldSectors];
-	sv_numworldSectors++;
+	anode = &ai->sectors[ai->numSectors];
+	ai->numSectors++;
+
+	anode->entities = -1;
 
 	if (depth == AREA_DEPTH) {
 		anode->axis = -1;
@@ -133,12 +172,315 @@ static worldSector_t *SV_CreateworldSector( int depth, vec3_t mins, vec3_t maxs
 	
 	maxs1[anode->axis] = mins2[anode->axis] = anode->dist;
 	
-	anode->children[0] = SV_CreateworldSector (depth+1, mins2, maxs2);
-	anode->children[1] = SV_CreateworldSector (depth+1, mins1, maxs1);
+	anode->children[0] = SV_CreateworldSector (ai, depth+1, mins2, maxs2);
+	anode->children[1] = SV_CreateworldSector (ai, depth+1, mins1, maxs1);
 
 	return anode;
 }
 
+
+/*
+===============
+SV_CreateAreaGrid
+
+Picks the finest cell size so that the grid covers the world
+with at most AREA_GRID_CELLS cells along the longer axis
+===============
+*/
+static void SV_CreateAreaGrid( areaIndex_t *ai, const vec3_t mins, const vec3_t maxs ) {
+	areaGridLevel_t *level;
+	float	size;
+	int		i;
+
+	size = MAX( maxs[0] - mins[0], maxs[1] - mins[1] ) / AREA_GRID_CELLS;
+	if ( size < AREA_GRID_MINSIZE ) {
+		size = AREA_GRID_MINSIZE;
+	}
+
+	ai->gridOrigin[0] = mins[0];
+	ai->gridOrigin[1] = mins[1];
+
+	for ( ai->numLevels = 0; ai->numLevels < AREA_GRID_LEVELS; size *= 4.0f ) {
+		level = &ai->levels[ ai->numLevels++ ];
+		level->cellSize = size;
+		level->scale = 1.0f / size;
+		level->first = ai->numBuckets;
+		for ( i = 0; i < 2; i++ ) {
+			level->size[i] = (int)ceil( ( maxs[i] - mins[i] ) / size );
+			if ( level->size[i] < 1 || ai->numLevels == AREA_GRID_LEVELS ) {
+				level->size[i] = 1;
+			} else if ( level->size[i] > AREA_GRID_CELLS ) {
+				level->size[i] = AREA_GRID_CELLS;
+			}
+		}
+		ai->numBuckets += level->size[0] * level->size[1];
+		if ( level->size[0] * level->size[1] == 1 ) {
+			break;
+		}
+	}
+
+	ai->buckets = Z_Malloc( ai->numBuckets * sizeof( areaBucket_t ) );
+}
+
+
+/*
+===============
+SV_InitAreaIndex
+===============
+*/
+static void SV_InitAreaIndex( areaIndex_t *ai, areaIndexType_t type, vec3_t mins, vec3_t maxs ) {
+
+	Com_Memset( ai, 0, sizeof( *ai ) );
+	Com_Memset( ai->node, -1, sizeof( ai->node ) );
+
+	ai->type = type;
+
+	if ( type == AREA_GRID ) {
+		SV_CreateAreaGrid( ai, mins, maxs );
+	} else {
+		SV_CreateworldSector( ai, 0, mins, maxs );
+	}
+}
+
+
+/*
+===============
+SV_FreeAreaIndex
+===============
+*/
+static void SV_FreeAreaIndex( areaIndex_t *ai ) {
+	int i;
+
+	if ( ai->buckets ) {
+		for ( i = 0; i < ai->numBuckets; i++ ) {
+			if ( ai->buckets[i].bounds ) {
+				Z_Free( ai->buckets[i].bounds );
+			}
+		}
+		Z_Free( ai->buckets );
+		ai->buckets = NULL;
+	}
+}
+
+
+/*
+===============
+SV_AreaBucketAdd
+===============
+*/
+static void SV_AreaBucketAdd( areaIndex_t *ai, areaBucket_t *b, int num ) {
+	float	*bounds;
+	int		i, j, capacity;
+
+	if ( b->count == b->capacity ) {
+		capacity = b->capacity ? b->capacity * 2 : 4;
+		bounds = Z_Malloc( capacity * ( 6 * sizeof( float ) + sizeof( int ) ) );
+		for ( j = 0; j < 6; j++ ) {
+			if ( b->count ) {
+				Com_Memcpy( bounds + j * capacity, b->bounds + j * b->capacity, b->count * sizeof( float ) );
+			}
+			for ( i = b->count; i < capacity; i++ ) {
+				bounds[ j * capacity + i ] = j < 3 ? AREA_BOX_EMPTY : -AREA_BOX_EMPTY;
+			}
+		}
+		if ( b->bounds ) {
+			Com_Memcpy( bounds + 6 * capacity, b->nums, b->count * sizeof( int ) );
+			Z_Free( b->bounds );
+		}
+		b->bounds = bounds;
+		b->nums = (int *)( bounds + 6 * capacity );
+		b->capacity = capacity;
+	}
+
+	i = b->count++;
+	for ( j = 0; j < 3; j++ ) {
+		b->bounds[ j * b->capacity + i ] = ai->absmin[num][j];
+		b->bounds[ ( j + 3 ) * b->capacity + i ] = ai->absmax[num][j];
+	}
+	b->nums[i] = num;
+	ai->link[num] = i;
+}
+
+
+/*
+===============
+SV_AreaBucketRemove
+
+Moves the last entity of the bucket into the freed slot
+===============
+*/
+static void SV_AreaBucketRemove( areaIndex_t *ai, areaBucket_t *b, int slot ) {
+	int		last, j;
+
+	last = --b->count;
+	for ( j = 0; j < 6; j++ ) {
+		b->bounds[ j * b->capacity + slot ] = b->bounds[ j * b->capacity + last ];
+		b->bounds[ j * b->capacity + last ] = j < 3 ? AREA_BOX_EMPTY : -AREA_BOX_EMPTY;
+	}
+	b->nums[slot] = b->nums[last];
+	ai->link[ b->nums[slot] ] = slot;
+}
+
+
+/*
+===============
+SV_AreaGridCell
+
+Returns the cell index for a coordinate, positions
+outside of the world go to the border cells
+===============
+*/
+static int SV_AreaGridCell( const areaIndex_t *ai, const areaGridLevel_t *level, int axis, float v ) {
+	int c;
+
+	v = ( v - ai->gridOrigin[axis] ) * level->scale;
+	if ( v < 0.0f ) {
+		return 0;
+	}
+	if ( v >= level->size[axis] ) {
+		return level->size[axis] - 1;
+	}
+	c = (int)v;
+	return MIN( c, level->size[axis] - 1 );
+}
+
+
+/*
+===============
+SV_AreaIndexUnlink
+
+Returns qfalse if the entity was not linked
+===============
+*/
+static qboolean SV_AreaIndexUnlink( areaIndex_t *ai, int num ) {
+	worldSector_t	*ws;
+	int				node, scan, l;
+
+	node = ai->node[num];
+	if ( node < 0 ) {
+		return qfalse;		// not linked in anywhere
+	}
+	ai->node[num] = -1;
+
+	if ( ai->type == AREA_GRID ) {
+		SV_AreaBucketRemove( ai, &ai->buckets[node], ai->link[num] );
+		for ( l = 0; node >= ai->levels[l].first + ai->levels[l].size[0] * ai->levels[l].size[1]; l++ )
+			;
+		ai->levels[l].count--;
+		if ( !ai->buckets[node].count ) {
+			node -= ai->levels[l].first;
+			ai->occupied[l][ node / ai->levels[l].size[0] ] &= ~( 1ULL << ( node % ai->levels[l].size[0] ) );
+		}
+		return qtrue;
+	}
+
+	ws = &ai->sectors[node];
+	if ( ws->entities == num ) {
+		ws->entities = ai->link[num];
+		return qtrue;
+	}
+
+	for ( scan = ws->entities ; scan != -1 ; scan = ai->link[scan] ) {
+		if ( ai->link[scan] == num ) {
+			ai->link[scan] = ai->link[num];
+			return qtrue;
+		}
+	}
+
+	Com_Printf( "WARNING: SV_UnlinkEntity: not found in worldSector\n" );
+	return qtrue;
+}
+
+
+/*
+===============
+SV_AreaIndexLink
+
+Entity must not be linked
+===============
+*/
+static void SV_AreaIndexLink( areaIndex_t *ai, int num, const vec3_t absmin, const vec3_t absmax ) {
+	areaGridLevel_t	*level;
+	worldSector_t	*node;
+	int				x, y, cell;
+
+	VectorCopy( absmin, ai->absmin[num] );
+	VectorCopy( absmax, ai->absmax[num] );
+
+	if ( ai->type == AREA_GRID ) {
+		// the last level takes everything
+		for ( level = ai->levels; level < ai->levels + ai->numLevels - 1; level++ ) {
+			if ( absmax[0] - absmin[0] <= level->cellSize && absmax[1] - absmin[1] <= level->cellSize ) {
+				break;
+			}
+		}
+		x = SV_AreaGridCell( ai, level, 0, 0.5f * ( absmin[0] + absmax[0] ) );
+		y = SV_AreaGridCell( ai, level, 1, 0.5f * ( absmin[1] + absmax[1] ) );
+		cell = level->first + y * level->size[0] + x;
+		ai->node[num] = cell;
+		ai->occupied[ level - ai->levels ][y] |= 1ULL << x;
+		level->count++;
+		SV_AreaBucketAdd( ai, &ai->buckets[cell], num );
+		return;
+	}
+
+	// find the first world sector node that the ent's box crosses
+	node = ai->sectors;
+	while (1)
+	{
+		if (node->axis == -1)
+			break;
+		if ( absmin[node->axis] > node->dist)
+			node = node->children[0];
+		else if ( absmax[node->axis] < node->dist)
+			node = node->children[1];
+		else
+			break;		// crosses the node
+	}
+
+	// link it in
+	ai->node[num] = node - ai->sectors;
+	ai->link[num] = node->entities;
+	node->entities = num;
+}
+
+
+/*
+===============
+SV_SectorList_f
+===============
+*/
+void SV_SectorList_f( void ) {
+	const areaGridLevel_t *level;
+	int				i, c, l, ent;
+	worldSector_t	*sec;
+
+	if ( sv_area.type == AREA_GRID ) {
+		for ( l = 0 ; l < sv_area.numLevels ; l++ ) {
+			level = &sv_area.levels[l];
+			Com_Printf( "level %i: %ix%i cells of %.0f units\n", l, level->size[0], level->size[1], level->cellSize );
+			for ( i = 0 ; i < level->size[0] * level->size[1] ; i++ ) {
+				c = sv_area.buckets[ level->first + i ].count;
+				if ( c ) {
+					Com_Printf( "cell %i %i: %i entities\n", i % level->size[0], i / level->size[0], c );
+				}
+			}
+		}
+		return;
+	}
+
+	for ( i = 0 ; i < AREA_NODES ; i++ ) {
+		sec = &sv_area.sectors[i];
+
+		c = 0;
+		for ( ent = sec->entities ; ent != -1 ; ent = sv_area.link[ent] ) {
+			c++;
+		}
+		Com_Printf( "sector %i: %i entities\n", i, c );
+	}
+}
+
+
 /*
 ===============
 SV_ClearWorld
@@ -149,16 +491,35 @@ void SV_ClearWorld( void ) {
 	clipHandle_t	h;
 	vec3_t			mins, maxs;
 
-	Com_Memset( sv_worldSectors, 0, sizeof(sv_worldSectors) );
-	sv_numworldSectors = 0;
+	SV_FreeAreaIndex( &sv_area );
 
 	// get world map bounds
 	h = CM_InlineModel( 0 );
 	CM_ModelBounds( h, mins, maxs );
-	SV_CreateworldSector( 0, mins, maxs );
+	SV_InitAreaIndex( &sv_area, sv_broadphase->integer ? AREA_GRID : AREA_SECTORS, mins, maxs );
+
+	SV_TraceCacheFrame();
 }
 
 
+/*
+===============
+SV_InitWorld
+===============
+*/
+void SV_InitWorld( void ) {
+	sv_broadphase = Cvar_Get( "sv_broadphase", "0", CVAR_ARCHIVE_ND );
+	Cvar_CheckRange( sv_broadphase, "0", "1", CV_INTEGER );
+	Cvar_SetDescription( sv_broadphase, "Structure used to find entities in an area, applied on next map load:\n"
+		" 0 - fixed depth sector tree\n"
+		" 1 - loose grid sized from the world bounds\nDefault: 0" );
+}
+
+
+static void SV_TraceCacheDirty( const sharedEntity_t *gEnt );
+static void SV_RecordAreaLink( int num, const vec3_t absmin, const vec3_t absmax );
+static void SV_RecordAreaUnlink( int num );
+
 /*
 ===============
 SV_UnlinkEntity
@@ -167,32 +528,20 @@ SV_UnlinkEntity
 */
 void SV_UnlinkEntity( sharedEntity_t *gEnt ) {
 	svEntity_t		*ent;
-	svEntity_t		*scan;
-	worldSector_t	*ws;
+	int				num;
 
 	ent = SV_SvEntityForGentity( gEnt );
 
 	gEnt->r.linked = qfalse;
 
-	ws = ent->worldSector;
-	if ( !ws ) {
+	num = ent - sv.svEntities;
+	if ( !SV_AreaIndexUnlink( &sv_area, num ) ) {
 		return;		// not linked in anywhere
 	}
-	ent->worldSector = NULL;
-
-	if ( ws->entities == ent ) {
-		ws->entities = ent->nextEntityInWorldSector;
-		return;
-	}
 
-	for ( scan = ws->entities ; scan ; scan = scan->nextEntityInWorldSector ) {
-		if ( scan->nextEntityInWorldSector == ent ) {
-			scan->nextEntityInWorldSector = ent->nextEntityInWorldSector;
-			return;
-		}
-	}
+	SV_TraceCacheDirty( gEnt );
 
-	Com_Printf( "WARNING: SV_UnlinkEntity: not found in worldSector\n" );
+	SV_RecordAreaUnlink( num );
 }
 
 
@@ -204,7 +553,6 @@ SV_LinkEntity
 */
 #define MAX_TOTAL_ENT_LEAFS		128
 void SV_LinkEntity( sharedEntity_t *gEnt ) {
-	worldSector_t	*node;
 	int			leafs[MAX_TOTAL_ENT_LEAFS];
 	int			cluster;
 	int			num_leafs;
@@ -213,10 +561,12 @@ void SV_LinkEntity( sharedEntity_t *gEnt ) {
 	int			lastLeaf;
 	float		*origin, *angles;
 	svEntity_t	*ent;
+	int			num;
 
 	ent = SV_SvEntityForGentity( gEnt );
+	num = ent - sv.svEntities;
 
-	if ( ent->worldSector ) {
+	if ( sv_area.node[num] != -1 ) {
 		SV_UnlinkEntity( gEnt );	// unlink from old position
 	}
 
@@ -333,26 +683,13 @@ void SV_LinkEntity( sharedEntity_t *gEnt ) {
 
 	gEnt->r.linkcount++;
 
-	// find the first world sector node that the ent's box crosses
-	node = sv_worldSectors;
-	while (1)
-	{
-		if (node->axis == -1)
-			break;
-		if ( gEnt->r.absmin[node->axis] > node->dist)
-			node = node->children[0];
-		else if ( gEnt->r.absmax[node->axis] < node->dist)
-			node = node->children[1];
-		else
-			break;		// crosses the node
-	}
-	
-	// link it in
-	ent->worldSector = node;
-	ent->nextEntityInWorldSector = node->entities;
-	node->entities = ent;
+	SV_AreaIndexLink( &sv_area, num, gEnt->r.absmin, gEnt->r.absmax );
 
 	gEnt->r.linked = qtrue;
+
+	SV_TraceCacheDirty( gEnt );
+
+	SV_RecordAreaLink( num, gEnt->r.absmin, gEnt->r.absmax );
 }
 
 /*
@@ -370,6 +707,7 @@ typedef struct {
 	const float	*maxs;
 	int			*list;
 	int			count, maxcount;
+	int			tested;		// entity boxes compared against the area
 } areaParms_t;
 
 
@@ -379,87 +717,259 @@ SV_AreaEntities_r
 
 ====================
 */
-static void SV_AreaEntities_r( worldSector_t *node, areaParms_t *ap ) {
-	svEntity_t	*check, *next;
-	sharedEntity_t *gcheck;
-
-	for ( check = node->entities  ; check ; check = next ) {
-		next = check->nextEntityInWorldSector;
-
-		gcheck = SV_GEntityForSvEntity( check );
-
-		if ( gcheck->r.absmin[0] > ap->maxs[0]
-		|| gcheck->r.absmin[1] > ap->maxs[1]
-		|| gcheck->r.absmin[2] > ap->maxs[2]
-		|| gcheck->r.absmax[0] < ap->mins[0]
-		|| gcheck->r.absmax[1] < ap->mins[1]
-		|| gcheck->r.absmax[2] < ap->mins[2]) {
+static qboolean SV_AreaEntities_r( const areaIndex_t *ai, const worldSector_t *node, areaParms_t *ap ) {
+	int		check;
+
+	for ( check = node->entities ; check != -1 ; check = ai->link[check] ) {
+		ap->tested++;
+
+		if ( ai->absmin[check][0] > ap->maxs[0]
+		|| ai->absmin[check][1] > ap->maxs[1]
+		|| ai->absmin[check][2] > ap->maxs[2]
+		|| ai->absmax[check][0] < ap->mins[0]
+		|| ai->absmax[check][1] < ap->mins[1]
+		|| ai->absmax[check][2] < ap->mins[2]) {
 			continue;
 		}
 
 		if ( ap->count == ap->maxcount ) {
-			Com_Printf ("SV_AreaEntities: MAXCOUNT\n");
-			return;
+			return qfalse;
 		}
 
-		ap->list[ap->count] = check - sv.svEntities;
+		ap->list[ap->count] = check;
 		ap->count++;
 	}
 	
 	if (node->axis == -1) {
-		return;		// terminal node
+		return qtrue;		// terminal node
 	}
 
 	// recurse down both sides
 	if ( ap->maxs[node->axis] > node->dist ) {
-		SV_AreaEntities_r ( node->children[0], ap );
+		if ( !SV_AreaEntities_r ( ai, node->children[0], ap ) ) {
+			return qfalse;
+		}
 	}
 	if ( ap->mins[node->axis] < node->dist ) {
-		SV_AreaEntities_r ( node->children[1], ap );
+		if ( !SV_AreaEntities_r ( ai, node->children[1], ap ) ) {
+			return qfalse;
+		}
 	}
-}
-
-/*
-================
-SV_AreaEntities
-================
-*/
-int SV_AreaEntities( const vec3_t mins, const vec3_t maxs, int *entityList, int maxcount ) {
-	areaParms_t		ap;
-
-	ap.mins = mins;
-	ap.maxs = maxs;
-	ap.list = entityList;
-	ap.count = 0;
-	ap.maxcount = maxcount;
 
-	SV_AreaEntities_r( sv_worldSectors, &ap );
-
-	return ap.count;
+	return qtrue;
 }
 
 
+/*
+====================
+SV_AreaBucketEntities
 
-//===========================================================================
+Same overlap test as SV_AreaEntities_r
+====================
+*/
+static qboolean SV_AreaBucketEntities( const areaBucket_t *b, areaParms_t *ap ) {
+	const float	*bmin0, *bmin1, *bmin2, *bmax0, *bmax1, *bmax2;
+	int			i, k, lanes;
+#ifdef USE_SSE2_AREA
+	__m128		qmin0, qmin1, qmin2, qmax0, qmax1, qmax2, out;
+#endif
+
+	if ( !b->count ) {
+		return qtrue;
+	}
 
+	ap->tested += b->count;
+
+	bmin0 = b->bounds;
+	bmin1 = bmin0 + b->capacity;
+	bmin2 = bmin1 + b->capacity;
+	bmax0 = bmin2 + b->capacity;
+	bmax1 = bmax0 + b->capacity;
+	bmax2 = bmax1 + b->capacity;
+
+#ifdef USE_SSE2_AREA
+	qmin0 = _mm_set1_ps( ap->mins[0] );
+	qmin1 = _mm_set1_ps( ap->mins[1] );
+	qmin2 = _mm_set1_ps( ap->mins[2] );
+	qmax0 = _mm_set1_ps( ap->maxs[0] );
+	qmax1 = _mm_set1_ps( ap->maxs[1] );
+	qmax2 = _mm_set1_ps( ap->maxs[2] );
+#endif
+
+	// lanes past count hold empty boxes
+	for ( i = 0; i < b->count; i += 4 ) {
+#ifdef USE_SSE2_AREA
+		out = _mm_cmpgt_ps( _mm_loadu_ps( bmin0 + i ), qmax0 );
+		out = _mm_or_ps( out, _mm_cmpgt_ps( _mm_loadu_ps( bmin1 + i ), qmax1 ) );
+		out = _mm_or_ps( out, _mm_cmpgt_ps( _mm_loadu_ps( bmin2 + i ), qmax2 ) );
+		out = _mm_or_ps( out, _mm_cmplt_ps( _mm_loadu_ps( bmax0 + i ), qmin0 ) );
+		out = _mm_or_ps( out, _mm_cmplt_ps( _mm_loadu_ps( bmax1 + i ), qmin1 ) );
+		out = _mm_or_ps( out, _mm_cmplt_ps( _mm_loadu_ps( bmax2 + i ), qmin2 ) );
+		lanes = ~_mm_movemask_ps( out ) & 15;
+#else
+		lanes = 0;
+		for ( k = 0; k < 4; k++ ) {
+			if ( bmin0[i+k] > ap->maxs[0] || bmin1[i+k] > ap->maxs[1] || bmin2[i+k] > ap->maxs[2]
+				|| bmax0[i+k] < ap->mins[0] || bmax1[i+k] < ap->mins[1] || bmax2[i+k] < ap->mins[2] ) {
+				continue;
+			}
+			lanes |= 1 << k;
+		}
+#endif
+		for ( k = 0; lanes; k++, lanes >>= 1 ) {
+			if ( !( lanes & 1 ) ) {
+				continue;
+			}
+			if ( ap->count == ap->maxcount ) {
+				return qfalse;
+			}
+			ap->list[ap->count] = b->nums[i+k];
+			ap->count++;
+		}
+	}
 
-typedef struct {
-	vec3_t		boxmins, boxmaxs;// enclose the test object along entire move
-	const float	*mins;
-	const float *maxs;	// size of the moving object
-	const float	*start;
-	vec3_t		end;
-	trace_t		trace;
-	int			passEntityNum;
-	int			contentmask;
-	int			capsule;
-} moveclip_t;
+	return qtrue;
+}
 
 
 /*
 ====================
-SV_ClipToEntity
-
+SV_LowestCell
+====================
+*/
+static ID_INLINE int SV_LowestCell( uint64_t mask ) {
+#if defined(__GNUC__) || defined(__clang__)
+	return __builtin_ctzll( mask );
+#elif defined(_MSC_VER) && defined(_WIN64)
+	unsigned long n;
+	_BitScanForward64( &n, mask );
+	return (int)n;
+#else
+	int n;
+	for ( n = 0; !( mask & 1 ); n++ ) {
+		mask >>= 1;
+	}
+	return n;
+#endif
+}
+
+
+/*
+====================
+SV_AreaGridEntities
+====================
+*/
+static qboolean SV_AreaGridEntities( const areaIndex_t *ai, areaParms_t *ap ) {
+	const areaGridLevel_t *level;
+	const areaBucket_t *row;
+	uint64_t	cols, bits;
+	float		half;
+	int			l, y, x0, x1, y0, y1;
+
+	for ( l = 0; l < ai->numLevels; l++ ) {
+		level = &ai->levels[l];
+		if ( !level->count ) {
+			continue;
+		}
+
+		// cells are searched as if they were half a cell larger on each side
+		half = level->cellSize * 0.5f;
+		x0 = SV_AreaGridCell( ai, level, 0, ap->mins[0] - half );
+		x1 = SV_AreaGridCell( ai, level, 0, ap->maxs[0] + half );
+		y0 = SV_AreaGridCell( ai, level, 1, ap->mins[1] - half );
+		y1 = SV_AreaGridCell( ai, level, 1, ap->maxs[1] + half );
+
+		cols = ( ~0ULL >> ( 63 - x1 ) ) & ( ~0ULL << x0 );
+
+		for ( y = y0; y <= y1; y++ ) {
+			row = ai->buckets + level->first + y * level->size[0];
+			for ( bits = ai->occupied[l][y] & cols; bits; bits &= bits - 1 ) {
+				if ( !SV_AreaBucketEntities( row + SV_LowestCell( bits ), ap ) ) {
+					return qfalse;
+				}
+			}
+		}
+	}
+
+	return qtrue;
+}
+
+
+/*
+================
+SV_AreaIndexEntities
+
+Returns the number of entities found, tested receives
+the number of entity boxes that were compared
+================
+*/
+static int SV_AreaIndexEntities( const areaIndex_t *ai, const vec3_t mins, const vec3_t maxs, int *entityList, int maxcount, int *tested ) {
+	areaParms_t		ap;
+	qboolean		done;
+
+	ap.mins = mins;
+	ap.maxs = maxs;
+	ap.list = entityList;
+	ap.count = 0;
+	ap.maxcount = maxcount;
+	ap.tested = 0;
+
+	if ( ai->type == AREA_GRID ) {
+		done = SV_AreaGridEntities( ai, &ap );
+	} else {
+		done = SV_AreaEntities_r( ai, ai->sectors, &ap );
+	}
+
+	if ( !done ) {
+		Com_Printf ("SV_AreaEntities: MAXCOUNT\n");
+	}
+
+	if ( tested ) {
+		*tested = ap.tested;
+	}
+
+	return ap.count;
+}
+
+
+static void SV_RecordAreaQuery( const vec3_t mins, const vec3_t maxs );
+
+/*
+================
+SV_AreaEntities
+================
+*/
+int SV_AreaEntities( const vec3_t mins, const vec3_t maxs, int *entityList, int maxcount ) {
+
+	SV_RecordAreaQuery( mins, maxs );
+
+	return SV_AreaIndexEntities( &sv_area, mins, maxs, entityList, maxcount, NULL );
+}
+
+
+
+//===========================================================================
+
+
+typedef struct {
+	vec3_t		boxmins, boxmaxs;// enclose the test object along entire move
+	const float	*mins;
+	const float *maxs;	// size of the moving object
+	const float	*start;
+	vec3_t		end;
+	trace_t		trace;
+	int			passEntityNum;
+	int			contentmask;
+	int			capsule;
+	int			*touchlist;		// MAX_GENTITIES entries, entities found in the box
+	int			numTouch;
+} moveclip_t;
+
+
+/*
+====================
+SV_ClipToEntity
+
 ====================
 */
 void SV_ClipToEntity( trace_t *trace, const vec3_t start, const vec3_t mins, const vec3_t maxs, const vec3_t end, int entityNum, int contentmask, qboolean capsule ) {
@@ -506,14 +1016,16 @@ SV_ClipMoveToEntities
 */
 static void SV_ClipMoveToEntities( moveclip_t *clip ) {
 	int			i, num;
-	int			touchlist[MAX_GENTITIES];
+	int			*touchlist;
 	sharedEntity_t *touch;
 	int			passOwnerNum;
 	trace_t		trace;
 	clipHandle_t	clipHandle;
 	float		*origin, *angles;
 
+	touchlist = clip->touchlist;
 	num = SV_AreaEntities( clip->boxmins, clip->boxmaxs, touchlist, MAX_GENTITIES);
+	clip->numTouch = num;
 
 	if ( clip->passEntityNum != ENTITYNUM_NONE ) {
 		passOwnerNum = ( SV_GentityNum( clip->passEntityNum ) )->r.ownerNum;
@@ -587,126 +1099,1146 @@ static void SV_ClipMoveToEntities( moveclip_t *clip ) {
 
 
 /*
-==================
-SV_Trace
+===============================================================================
 
-Moves the given mins/maxs volume through the world from start to end.
-passEntityNum and entities owned by passEntityNum are explicitly not checked.
+TRACE LOG
+
+===============================================================================
+*/
+
+#define	TRACELOG_IDENT		( ('G'<<24)+('L'<<16)+('R'<<8)+'T' )
+#define	TRACELOG_VERSION	1
+
+typedef struct {
+	int			ident;
+	int			version;
+	char		mapname[MAX_QPATH];
+	int			checksum;
+} traceLogHeader_t;
+
+static fileHandle_t traceLog = FS_INVALID_HANDLE;
+static int traceLogCount;
+
+
+/*
+==================
+SV_RecordTrace
 ==================
 */
-void SV_Trace( trace_t *results, const vec3_t start, const vec3_t mins, const vec3_t maxs, const vec3_t end, int passEntityNum, int contentmask, qboolean capsule ) {
-	moveclip_t	clip;
-	int			i;
+static void SV_RecordTrace( const vec3_t start, const vec3_t mins, const vec3_t maxs, const vec3_t end, int passEntityNum, int contentmask, qboolean capsule ) {
+	traceRequest_t	req;
+
+	VectorCopy( start, req.start );
+	VectorCopy( mins, req.mins );
+	VectorCopy( maxs, req.maxs );
+	VectorCopy( end, req.end );
+	req.passEntityNum = passEntityNum;
+	req.contentmask = contentmask;
+	req.capsule = capsule;
+
+	FS_Write( &req, sizeof( req ), traceLog );
+	traceLogCount++;
+}
 
-	if ( !mins ) {
-		mins = vec3_origin;
+
+/*
+==================
+SV_StopTraceLog
+==================
+*/
+void SV_StopTraceLog( void ) {
+	if ( traceLog != FS_INVALID_HANDLE ) {
+		FS_FCloseFile( traceLog );
+		traceLog = FS_INVALID_HANDLE;
+		Com_Printf( "Stopped trace log, %i traces recorded.\n", traceLogCount );
 	}
-	if ( !maxs ) {
-		maxs = vec3_origin;
+}
+
+
+/*
+==================
+SV_TraceRecord_f
+
+Writes every following SV_Trace call to a file for tracebench
+==================
+*/
+void SV_TraceRecord_f( void ) {
+	traceLogHeader_t header;
+	char		filename[MAX_OSPATH];
+
+	if ( Cmd_Argc() != 2 ) {
+		Com_Printf( "usage: tracerecord <filename>|stop\n" );
+		return;
 	}
 
-	Com_Memset ( &clip, 0, sizeof ( clip ) );
+	SV_StopTraceLog();
 
-	// clip to world
-	CM_BoxTrace( &clip.trace, start, end, mins, maxs, 0, contentmask, capsule );
-	clip.trace.entityNum = clip.trace.fraction != 1.0 ? ENTITYNUM_WORLD : ENTITYNUM_NONE;
-	if ( clip.trace.fraction == 0 ) {
-		*results = clip.trace;
-		return;		// blocked immediately by the world
+	if ( !Q_stricmp( Cmd_Argv( 1 ), "stop" ) ) {
+		return;
 	}
 
-	clip.contentmask = contentmask;
-	clip.start = start;
-//	VectorCopy( clip.trace.endpos, clip.end );
-	VectorCopy( end, clip.end );
-	clip.mins = mins;
-	clip.maxs = maxs;
-	clip.passEntityNum = passEntityNum;
-	clip.capsule = capsule;
+	if ( sv.state != SS_GAME ) {
+		Com_Printf( "Server is not running.\n" );
+		return;
+	}
 
-	// create the bounding box of the entire move
-	// we can limit it to the part of the move not
-	// already clipped off by the world, which can be
-	// a significant savings for line of sight and shot traces
-	for ( i=0 ; i<3 ; i++ ) {
-		if ( end[i] > start[i] ) {
-			clip.boxmins[i] = clip.start[i] + clip.mins[i] - 1;
-			clip.boxmaxs[i] = clip.end[i] + clip.maxs[i] + 1;
-		} else {
-			clip.boxmins[i] = clip.end[i] + clip.mins[i] - 1;
-			clip.boxmaxs[i] = clip.start[i] + clip.maxs[i] + 1;
-		}
+	Q_strncpyz( filename, Cmd_Argv( 1 ), sizeof( filename ) );
+	COM_DefaultExtension( filename, sizeof( filename ), ".trl" );
+
+	traceLog = FS_FOpenFileWrite( filename );
+	if ( traceLog == FS_INVALID_HANDLE ) {
+		Com_Printf( "Couldn't open %s for writing.\n", filename );
+		return;
 	}
 
-	// clip to other solid entities
-	SV_ClipMoveToEntities ( &clip );
+	Com_Memset( &header, 0, sizeof( header ) );
+	header.ident = TRACELOG_IDENT;
+	header.version = TRACELOG_VERSION;
+	Q_strncpyz( header.mapname, sv_mapname->string, sizeof( header.mapname ) );
+	header.checksum = sv_mapChecksum->integer;
+	FS_Write( &header, sizeof( header ), traceLog );
 
-	*results = clip.trace;
+	traceLogCount = 0;
+
+	Com_Printf( "Recording traces to %s.\n", filename );
 }
 
 
+/*
+===============================================================================
+
+TRACE CACHE
+
+Game code repeats the same traces and point contents queries many times
+within a frame. Results are kept until the next game frame, the world part
+stays valid for the whole frame and the entity part is dropped when an
+entity is linked or unlinked inside the area the query looked at, or when
+the game changed contents or owner of an entity in that area without
+relinking it.
+
+===============================================================================
+*/
+
+#define	TRACE_CACHE_DIRTY	64		// entity boxes remembered for invalidation, power of two
+#define	TRACE_CACHE_POINT	-1		// capsule field of point contents queries
+#define	TRACE_CACHE_ENTITIES	8	// entities checked per entry, entity part isn't kept for more
+
+typedef struct {
+	vec3_t		start;
+	vec3_t		end;
+	vec3_t		mins;
+	vec3_t		maxs;
+	int			passEntityNum;
+	int			contentmask;
+	int			capsule;
+} traceCacheKey_t;
+
+typedef struct {
+	int			number;
+	int			contents;
+	int			ownerNum;
+} traceCacheEntity_t;
+
+typedef struct {
+	traceCacheKey_t	key;
+	int			frame;			// entry is unused unless equal to traceCache.frame
+	qboolean	entitiesValid;	// trace below includes the entities
+	int			linkCount;		// traceCache.linkCount when entitiesValid was last checked
+	vec3_t		boxmins;		// area searched for entities
+	vec3_t		boxmaxs;
+	int			passOwnerNum;	// r.ownerNum of the pass entity
+	int			numEntities;
+	traceCacheEntity_t entities[ TRACE_CACHE_ENTITIES ];	// entities found in the box
+	trace_t		world;			// point contents keep the world contents in world.contents
+	trace_t		trace;
+} traceCacheEntry_t;
+
+typedef enum {
+	TC_MISS,
+	TC_WORLD,
+	TC_HIT
+} traceCacheState_t;
+
+static struct {
+	traceCacheEntry_t *entries;
+	int			mask;
+	int			frame;
+
+	int			linkCount;
+	vec3_t		dirtyMins[ TRACE_CACHE_DIRTY ];
+	vec3_t		dirtyMaxs[ TRACE_CACHE_DIRTY ];
+
+	// statistics
+	unsigned int lookups;
+	unsigned int hits;
+	unsigned int worldHits;
+	unsigned int invalidated;
+} traceCache;
+
+static cvar_t *sv_traceCache;
+
+
 /*
 ==================
-SV_TraceAtCrosshair
+SV_TraceCacheFrame
+
+Drops all cached results, called before each game frame
 ==================
 */
-void SV_TraceAtCrosshair( trace_t *results, playerState_t *ps, const vec3_t mins, const vec3_t maxs, int contentmask, qboolean capsule ) {
-	vec3_t            vector;
-	vec_t             *pvec;
-	struct vec        epos, pos, ang;
-	struct quat       qang;
+void SV_TraceCacheFrame( void ) {
+	int size;
 
-	pvec = (vec_t *) &ps->viewangles;
-	ang = mkvec(radians(pvec[2]), radians(pvec[0]), radians(pvec[1]));
-	qang = rpy2quat(ang);
-	pos = mkvec(4000.0f, 0.0f, 0.0f);
-	epos = qvrot(qang, pos);
-	memcpy(vector, ps->origin, sizeof(vector));
-	vector[2] += ps->viewheight;
-	epos.x += vector[0];
-	epos.y += vector[1];
-	epos.z += vector[2];
-	SV_Trace(results, vector, mins, maxs, *(vec3_t *) &epos, ENTITYNUM_NONE, contentmask, capsule);
+	traceCache.frame++;
+
+	if ( !sv_traceCache->modified ) {
+		return;
+	}
+	sv_traceCache->modified = qfalse;
+
+	if ( traceCache.entries ) {
+		free( traceCache.entries );
+		traceCache.entries = NULL;
+		traceCache.mask = 0;
+	}
+
+	if ( sv_traceCache->integer <= 0 ) {
+		return;
+	}
+
+	for ( size = 1; size * 2 <= sv_traceCache->integer; size *= 2 )
+		;
+
+	// kept out of the zone, the largest table is a big share of it
+	traceCache.entries = calloc( size, sizeof( traceCacheEntry_t ) );
+	if ( !traceCache.entries ) {
+		Com_Printf( S_COLOR_YELLOW "WARNING: out of memory for %i trace cache slots, cache disabled\n", size );
+		return;
+	}
+	traceCache.mask = size - 1;
+	traceCache.frame = 1;
 }
 
 
 /*
-=============
-SV_PointContents
-=============
-*/
-int SV_PointContents( const vec3_t p, int passEntityNum ) {
-	int			touch[MAX_GENTITIES];
-	sharedEntity_t *hit;
-	int			i, num;
-	int			contents, c2;
-	clipHandle_t	clipHandle;
-	float		*angles;
+==================
+SV_TraceCacheDirty
 
-	// get base contents from world
-	contents = CM_PointContents( p, 0 );
+Called with the absolute box of an entity that
+is linked or unlinked from the world sectors
+==================
+*/
+static void SV_TraceCacheDirty( const sharedEntity_t *gEnt ) {
+	int i;
 
-	// or in contents from all the other entities
-	num = SV_AreaEntities( p, p, touch, MAX_GENTITIES );
+	if ( !traceCache.entries ) {
+		return;
+	}
 
-	for ( i=0 ; i<num ; i++ ) {
-		if ( touch[i] == passEntityNum ) {
-			continue;
-		}
-		hit = SV_GentityNum( touch[i] );
-		// might intersect, so do an exact clip
-		clipHandle = SV_ClipHandleForEntity( hit );
-		angles = hit->r.currentAngles;
-		if ( !hit->r.bmodel ) {
-			angles = vec3_origin;	// boxes don't rotate
-		}
+	i = traceCache.linkCount++ & ( TRACE_CACHE_DIRTY - 1 );
+	VectorCopy( gEnt->r.absmin, traceCache.dirtyMins[i] );
+	VectorCopy( gEnt->r.absmax, traceCache.dirtyMaxs[i] );
+}
 
-		c2 = CM_TransformedPointContents (p, clipHandle, hit->r.currentOrigin, angles);
 
-		contents |= c2;
+/*
+==================
+SV_TraceCachePassOwner
+==================
+*/
+static int SV_TraceCachePassOwner( int passEntityNum ) {
+	if ( (unsigned)passEntityNum >= MAX_GENTITIES ) {
+		return ENTITYNUM_NONE;
 	}
-
-	return contents;
+	return SV_GentityNum( passEntityNum )->r.ownerNum;
 }
 
 
+/*
+==================
+SV_TraceCacheEntitiesValid
+
+Checks entity boxes linked since the entry was stored against the area
+searched by the query, and contents and owners of the entities found there,
+the game may change them without relinking
+==================
+*/
+static qboolean SV_TraceCacheEntitiesValid( traceCacheEntry_t *entry ) {
+	const traceCacheEntity_t *e;
+	const sharedEntity_t *ent;
+	int i, n;
+
+	if ( !entry->entitiesValid ) {
+		return qfalse;
+	}
+
+	if ( SV_TraceCachePassOwner( entry->key.passEntityNum ) != entry->passOwnerNum ) {
+		entry->entitiesValid = qfalse;
+		traceCache.invalidated++;
+		return qfalse;
+	}
+
+	for ( i = 0, e = entry->entities; i < entry->numEntities; i++, e++ ) {
+		ent = SV_GentityNum( e->number );
+		if ( ent->r.contents != e->contents || ent->r.ownerNum != e->ownerNum ) {
+			entry->entitiesValid = qfalse;
+			traceCache.invalidated++;
+			return qfalse;
+		}
+	}
+
+	if ( traceCache.linkCount - entry->linkCount > TRACE_CACHE_DIRTY ) {
+		entry->entitiesValid = qfalse;
+		traceCache.invalidated++;
+		return qfalse;
+	}
+
+	for ( n = entry->linkCount; n != traceCache.linkCount; n++ ) {
+		i = n & ( TRACE_CACHE_DIRTY - 1 );
+		// same overlap test as in SV_AreaEntities_r
+		if ( traceCache.dirtyMins[i][0] > entry->boxmaxs[0]
+			|| traceCache.dirtyMins[i][1] > entry->boxmaxs[1]
+			|| traceCache.dirtyMins[i][2] > entry->boxmaxs[2]
+			|| traceCache.dirtyMaxs[i][0] < entry->boxmins[0]
+			|| traceCache.dirtyMaxs[i][1] < entry->boxmins[1]
+			|| traceCache.dirtyMaxs[i][2] < entry->boxmins[2] ) {
+			continue;
+		}
+		entry->entitiesValid = qfalse;
+		traceCache.invalidated++;
+		return qfalse;
+	}
+
+	entry->linkCount = traceCache.linkCount;
+	return qtrue;
+}
+
+
+/*
+==================
+SV_TraceCacheLookup
+
+Returns the slot for the query and how much of it is still valid,
+keys are compared exactly so cached results never differ from a new query
+==================
+*/
+static traceCacheEntry_t *SV_TraceCacheLookup( const traceCacheKey_t *key, traceCacheState_t *state ) {
+	traceCacheEntry_t *entry;
+	const int	*k;
+	unsigned int hash;
+	int			i;
+
+	k = (const int *)key;
+	hash = 0;
+	for ( i = 0; i < (int)( sizeof( *key ) / sizeof( int ) ); i++ ) {
+		hash = ( hash ^ k[i] ) * 0x01000193;
+	}
+	hash ^= hash >> 15;
+
+	entry = &traceCache.entries[ hash & traceCache.mask ];
+
+	traceCache.lookups++;
+
+	if ( entry->frame != traceCache.frame || memcmp( &entry->key, key, sizeof( *key ) ) != 0 ) {
+		entry->key = *key;
+		entry->frame = traceCache.frame;
+		entry->entitiesValid = qfalse;
+		*state = TC_MISS;
+		return entry;
+	}
+
+	if ( SV_TraceCacheEntitiesValid( entry ) ) {
+		traceCache.hits++;
+		*state = TC_HIT;
+	} else {
+		traceCache.worldHits++;
+		*state = TC_WORLD;
+	}
+
+	return entry;
+}
+
+
+/*
+==================
+SV_TraceCacheStore
+
+Keeps the entity part of the result, touch holds the entities found in the box
+==================
+*/
+static void SV_TraceCacheStore( traceCacheEntry_t *entry, const vec3_t boxmins, const vec3_t boxmaxs, const int *touch, int numTouch ) {
+	const sharedEntity_t *ent;
+	traceCacheEntity_t *e;
+	int i;
+
+	if ( numTouch > TRACE_CACHE_ENTITIES ) {
+		// too many to check on each hit, keep the world part only
+		entry->entitiesValid = qfalse;
+		return;
+	}
+
+	for ( i = 0, e = entry->entities; i < numTouch; i++, e++ ) {
+		ent = SV_GentityNum( touch[i] );
+		e->number = touch[i];
+		e->contents = ent->r.contents;
+		e->ownerNum = ent->r.ownerNum;
+	}
+	entry->numEntities = numTouch;
+	entry->passOwnerNum = SV_TraceCachePassOwner( entry->key.passEntityNum );
+
+	VectorCopy( boxmins, entry->boxmins );
+	VectorCopy( boxmaxs, entry->boxmaxs );
+	entry->linkCount = traceCache.linkCount;
+	entry->entitiesValid = qtrue;
+}
+
+
+/*
+==================
+SV_TraceCache_f
+==================
+*/
+static void SV_TraceCache_f( void ) {
+	unsigned int lookups;
+
+	if ( Cmd_Argc() > 1 && !Q_stricmp( Cmd_Argv( 1 ), "reset" ) ) {
+		traceCache.lookups = traceCache.hits = traceCache.worldHits = traceCache.invalidated = 0;
+		return;
+	}
+
+	if ( !traceCache.entries ) {
+		Com_Printf( "Trace cache is disabled, set sv_traceCache to the number of slots.\n" );
+		return;
+	}
+
+	lookups = traceCache.lookups ? traceCache.lookups : 1;
+
+	Com_Printf( "%i slots, %u lookups\n", traceCache.mask + 1, traceCache.lookups );
+	Com_Printf( "hits: %u (%.1f%%)\n", traceCache.hits, traceCache.hits * 100.0 / lookups );
+	Com_Printf( "world only hits: %u (%.1f%%)\n", traceCache.worldHits, traceCache.worldHits * 100.0 / lookups );
+	Com_Printf( "entity invalidations: %u, entity links: %i\n", traceCache.invalidated, traceCache.linkCount );
+}
+
+
+/*
+==================
+SV_InitTraceCache
+==================
+*/
+void SV_InitTraceCache( void ) {
+	sv_traceCache = Cvar_Get( "sv_traceCache", "0", CVAR_ARCHIVE_ND );
+	Cvar_CheckRange( sv_traceCache, "0", "65536", CV_INTEGER );
+	Cvar_SetDescription( sv_traceCache, "Number of slots for memoized game traces and point contents within a server frame, 0 disables.\nDefault: 0" );
+	sv_traceCache->modified = qtrue;
+
+	Cmd_AddCommand( "tracecache", SV_TraceCache_f );
+	Cmd_SetDescription( "tracecache", "Show trace cache hit rates\nusage: tracecache [reset]" );
+}
+
+
+/*
+==================
+SV_ClipTraceToEntities
+
+Continues a finished world trace against other solid entities
+==================
+*/
+static void SV_ClipTraceToEntities( trace_t *results, const trace_t *worldTrace, const vec3_t start, const vec3_t mins, const vec3_t maxs, const vec3_t end, int passEntityNum, int contentmask, qboolean capsule, traceCacheEntry_t *entry ) {
+	int			touchlist[MAX_GENTITIES];
+	moveclip_t	clip;
+	int			i;
+
+	Com_Memset ( &clip, 0, sizeof ( clip ) );
+
+	clip.trace = *worldTrace;
+	clip.trace.entityNum = clip.trace.fraction != 1.0 ? ENTITYNUM_WORLD : ENTITYNUM_NONE;
+	if ( clip.trace.fraction == 0 ) {
+		*results = clip.trace;
+		if ( entry ) {
+			// entities can't change the result, store an empty box
+			static const vec3_t emptyMins = { 1, 1, 1 }, emptyMaxs = { -1, -1, -1 };
+			entry->trace = *results;
+			SV_TraceCacheStore( entry, emptyMins, emptyMaxs, NULL, 0 );
+		}
+		return;		// blocked immediately by the world
+	}
+
+	clip.contentmask = contentmask;
+	clip.start = start;
+//	VectorCopy( clip.trace.endpos, clip.end );
+	VectorCopy( end, clip.end );
+	clip.mins = mins;
+	clip.maxs = maxs;
+	clip.passEntityNum = passEntityNum;
+	clip.capsule = capsule;
+	clip.touchlist = touchlist;
+
+	// create the bounding box of the entire move
+	// we can limit it to the part of the move not
+	// already clipped off by the world, which can be
+	// a significant savings for line of sight and shot traces
+	for ( i=0 ; i<3 ; i++ ) {
+		if ( end[i] > start[i] ) {
+			clip.boxmins[i] = clip.start[i] + clip.mins[i] - 1;
+			clip.boxmaxs[i] = clip.end[i] + clip.maxs[i] + 1;
+		} else {
+			clip.boxmins[i] = clip.end[i] + clip.mins[i] - 1;
+			clip.boxmaxs[i] = clip.start[i] + clip.maxs[i] + 1;
+		}
+	}
+
+	// clip to other solid entities
+	SV_ClipMoveToEntities ( &clip );
+
+	*results = clip.trace;
+
+	if ( entry ) {
+		entry->trace = clip.trace;
+		SV_TraceCacheStore( entry, clip.boxmins, clip.boxmaxs, clip.touchlist, clip.numTouch );
+	}
+}
+
+
+/*
+==================
+SV_Trace
+
+Moves the given mins/maxs volume through the world from start to end.
+passEntityNum and entities owned by passEntityNum are explicitly not checked.
+==================
+*/
+void SV_Trace( trace_t *results, const vec3_t start, const vec3_t mins, const vec3_t maxs, const vec3_t end, int passEntityNum, int contentmask, qboolean capsule ) {
+	traceCacheEntry_t *entry;
+	traceCacheState_t state;
+	traceCacheKey_t	key;
+	trace_t		trace;
+
+	if ( !mins ) {
+		mins = vec3_origin;
+	}
+	if ( !maxs ) {
+		maxs = vec3_origin;
+	}
+
+	if ( traceLog != FS_INVALID_HANDLE ) {
+		SV_RecordTrace( start, mins, maxs, end, passEntityNum, contentmask, capsule );
+	}
+
+	if ( !traceCache.entries ) {
+		// clip to world
+		CM_BoxTrace( &trace, start, end, mins, maxs, 0, contentmask, capsule );
+		SV_ClipTraceToEntities( results, &trace, start, mins, maxs, end, passEntityNum, contentmask, capsule, NULL );
+		return;
+	}
+
+	Com_Memset( &key, 0, sizeof( key ) );
+	VectorCopy( start, key.start );
+	VectorCopy( end, key.end );
+	VectorCopy( mins, key.mins );
+	VectorCopy( maxs, key.maxs );
+	key.passEntityNum = passEntityNum;
+	key.contentmask = contentmask;
+	key.capsule = capsule ? qtrue : qfalse;
+
+	entry = SV_TraceCacheLookup( &key, &state );
+
+	if ( state == TC_HIT ) {
+		*results = entry->trace;
+		return;
+	}
+
+	if ( state == TC_MISS ) {
+		// clip to world
+		CM_BoxTrace( &entry->world, start, end, mins, maxs, 0, contentmask, capsule );
+	}
+
+	SV_ClipTraceToEntities( results, &entry->world, start, mins, maxs, end, passEntityNum, contentmask, capsule, entry );
+}
+
+
+/*
+==================
+SV_TraceBatch
+
+Same as calling SV_Trace for each request, but the world
+part of the traces is done in packets by CM_BoxTraceBatch
+==================
+*/
+#define TRACE_BATCH_CHUNK	64
+void SV_TraceBatch( trace_t *results, const traceRequest_t *requests, int count ) {
+	cmTraceRay_t	rays[ TRACE_BATCH_CHUNK ];
+	trace_t			world[ TRACE_BATCH_CHUNK ];
+	const traceRequest_t *req;
+	int				base, i, n;
+
+	for ( base = 0; base < count; base += n ) {
+		n = count - base;
+		if ( n > TRACE_BATCH_CHUNK ) {
+			n = TRACE_BATCH_CHUNK;
+		}
+
+		for ( i = 0; i < n; i++ ) {
+			req = &requests[ base + i ];
+			if ( traceLog != FS_INVALID_HANDLE ) {
+				SV_RecordTrace( req->start, req->mins, req->maxs, req->end, req->passEntityNum, req->contentmask, req->capsule );
+			}
+			VectorCopy( req->start, rays[i].start );
+			VectorCopy( req->end, rays[i].end );
+			VectorCopy( req->mins, rays[i].mins );
+			VectorCopy( req->maxs, rays[i].maxs );
+			rays[i].brushmask = req->contentmask;
+			rays[i].capsule = req->capsule ? qtrue : qfalse;
+		}
+
+		CM_BoxTraceBatch( world, rays, n, 0 );
+
+		for ( i = 0; i < n; i++ ) {
+			SV_ClipTraceToEntities( &results[ base + i ], &world[i], rays[i].start, rays[i].mins, rays[i].maxs, rays[i].end,
+				requests[ base + i ].passEntityNum, rays[i].brushmask, rays[i].capsule, NULL );
+		}
+	}
+}
+
+
+/*
+==================
+SV_TraceAtCrosshair
+==================
+*/
+void SV_TraceAtCrosshair( trace_t *results, playerState_t *ps, const vec3_t mins, const vec3_t maxs, int contentmask, qboolean capsule ) {
+	vec3_t            vector;
+	vec_t             *pvec;
+	struct vec        epos, pos, ang;
+	struct quat       qang;
+
+	pvec = (vec_t *) &ps->viewangles;
+	ang = mkvec(radians(pvec[2]), radians(pvec[0]), radians(pvec[1]));
+	qang = rpy2quat(ang);
+	pos = mkvec(4000.0f, 0.0f, 0.0f);
+	epos = qvrot(qang, pos);
+	memcpy(vector, ps->origin, sizeof(vector));
+	vector[2] += ps->viewheight;
+	epos.x += vector[0];
+	epos.y += vector[1];
+	epos.z += vector[2];
+	SV_Trace(results, vector, mins, maxs, *(vec3_t *) &epos, ENTITYNUM_NONE, contentmask, capsule);
+}
+
+
+/*
+=============
+SV_PointContents
+=============
+*/
+int SV_PointContents( const vec3_t p, int passEntityNum ) {
+	int			touch[MAX_GENTITIES];
+	sharedEntity_t *hit;
+	int			i, num;
+	int			contents, c2;
+	clipHandle_t	clipHandle;
+	float		*angles;
+	traceCacheEntry_t *entry;
+	traceCacheState_t state;
+	traceCacheKey_t	key;
+
+	entry = NULL;
+	if ( traceCache.entries ) {
+		Com_Memset( &key, 0, sizeof( key ) );
+		VectorCopy( p, key.start );
+		key.passEntityNum = passEntityNum;
+		key.capsule = TRACE_CACHE_POINT;
+
+		entry = SV_TraceCacheLookup( &key, &state );
+		if ( state == TC_HIT ) {
+			return entry->trace.contents;
+		}
+		if ( state == TC_MISS ) {
+			entry->world.contents = CM_PointContents( p, 0 );
+		}
+		// get base contents from world
+		contents = entry->world.contents;
+	} else {
+		// get base contents from world
+		contents = CM_PointContents( p, 0 );
+	}
+
+	// or in contents from all the other entities
+	num = SV_AreaEntities( p, p, touch, MAX_GENTITIES );
+
+	for ( i=0 ; i<num ; i++ ) {
+		if ( touch[i] == passEntityNum ) {
+			continue;
+		}
+		hit = SV_GentityNum( touch[i] );
+		// might intersect, so do an exact clip
+		clipHandle = SV_ClipHandleForEntity( hit );
+		angles = hit->r.currentAngles;
+		if ( !hit->r.bmodel ) {
+			angles = vec3_origin;	// boxes don't rotate
+		}
+
+		c2 = CM_TransformedPointContents (p, clipHandle, hit->r.currentOrigin, angles);
+
+		contents |= c2;
+	}
+
+	if ( entry ) {
+		entry->trace.contents = contents;
+		SV_TraceCacheStore( entry, p, p, touch, num );
+	}
+
+	return contents;
+}
+
+
+
+
+/*
+==================
+SV_TraceBench_f
+
+Replays the world part of a recorded trace log through CM_BoxTrace
+and CM_BoxTraceBatch, compares the results and times both
+==================
+*/
+void SV_TraceBench_f( void ) {
+	const traceLogHeader_t *header;
+	const traceRequest_t *reqs;
+	cmTraceRay_t	*rays;
+	trace_t		*scalar, *batched;
+	char		filename[MAX_OSPATH];
+	char		mapname[MAX_QPATH];
+	void		*buffer;
+	int64_t		start, scalarTime, batchTime;
+	int			len, count, batchSize, iterations, checksum;
+	int			i, n, mismatches;
+
+	if ( Cmd_Argc() < 2 ) {
+		Com_Printf( "usage: tracebench <filename> [batchsize] [iterations]\n" );
+		return;
+	}
+
+	Q_strncpyz( filename, Cmd_Argv( 1 ), sizeof( filename ) );
+	COM_DefaultExtension( filename, sizeof( filename ), ".trl" );
+
+	batchSize = Cmd_Argc() > 2 ? atoi( Cmd_Argv( 2 ) ) : 32;
+	if ( batchSize <= 0 ) {
+		batchSize = 32;
+	}
+	iterations = Cmd_Argc() > 3 ? atoi( Cmd_Argv( 3 ) ) : 10;
+	if ( iterations <= 0 ) {
+		iterations = 10;
+	}
+
+	len = FS_ReadFile( filename, &buffer );
+	if ( !buffer ) {
+		Com_Printf( "Couldn't read %s.\n", filename );
+		return;
+	}
+
+	header = (const traceLogHeader_t *)buffer;
+	if ( len < (int)sizeof( *header ) || header->ident != TRACELOG_IDENT || header->version != TRACELOG_VERSION ) {
+		Com_Printf( "%s is not a trace log.\n", filename );
+		FS_FreeFile( buffer );
+		return;
+	}
+
+	Q_strncpyz( mapname, header->mapname, sizeof( mapname ) );
+
+	// the collision map is shared with the client, only replay on the map of the running server
+	if ( sv.state == SS_DEAD ) {
+		Com_Printf( "Server is not running, start %s first.\n", mapname );
+		FS_FreeFile( buffer );
+		return;
+	}
+
+	if ( Q_stricmp( mapname, sv_mapname->string ) ) {
+		Com_Printf( "%s was recorded on %s, but %s is running.\n", filename, mapname, sv_mapname->string );
+		FS_FreeFile( buffer );
+		return;
+	}
+	checksum = sv_mapChecksum->integer;
+
+	if ( checksum != header->checksum ) {
+		Com_Printf( S_COLOR_YELLOW "WARNING: map checksum %i differs from recorded %i\n", checksum, header->checksum );
+	}
+
+	reqs = (const traceRequest_t *)( header + 1 );
+	count = ( len - (int)sizeof( *header ) ) / (int)sizeof( *reqs );
+	if ( count <= 0 ) {
+		Com_Printf( "No traces in %s.\n", filename );
+		FS_FreeFile( buffer );
+		return;
+	}
+
+	rays = (cmTraceRay_t *) Z_Malloc( count * sizeof( *rays ) );
+	scalar = (trace_t *) Z_Malloc( count * sizeof( *scalar ) );
+	batched = (trace_t *) Z_Malloc( count * sizeof( *batched ) );
+
+	for ( i = 0; i < count; i++ ) {
+		VectorCopy( reqs[i].start, rays[i].start );
+		VectorCopy( reqs[i].end, rays[i].end );
+		VectorCopy( reqs[i].mins, rays[i].mins );
+		VectorCopy( reqs[i].maxs, rays[i].maxs );
+		rays[i].brushmask = reqs[i].contentmask;
+		rays[i].capsule = reqs[i].capsule ? qtrue : qfalse;
+	}
+
+	FS_FreeFile( buffer );
+
+	// interleave the passes so that clock changes affect both the same way
+	scalarTime = batchTime = 0;
+	for ( n = 0; n < iterations; n++ ) {
+		start = Sys_Microseconds();
+		for ( i = 0; i < count; i++ ) {
+			CM_BoxTrace( &scalar[i], rays[i].start, rays[i].end, rays[i].mins, rays[i].maxs, 0, rays[i].brushmask, rays[i].capsule );
+		}
+		scalarTime += Sys_Microseconds() - start;
+
+		start = Sys_Microseconds();
+		for ( i = 0; i < count; i += batchSize ) {
+			CM_BoxTraceBatch( &batched[i], &rays[i], MIN( batchSize, count - i ), 0 );
+		}
+		batchTime += Sys_Microseconds() - start;
+	}
+
+	mismatches = 0;
+	for ( i = 0; i < count; i++ ) {
+		if ( memcmp( &scalar[i], &batched[i], sizeof( trace_t ) ) != 0 ) {
+			if ( mismatches++ < 8 ) {
+				Com_Printf( S_COLOR_YELLOW "mismatch at trace %i: fraction %f/%f, startsolid %i/%i, allsolid %i/%i\n", i,
+					scalar[i].fraction, batched[i].fraction, scalar[i].startsolid, batched[i].startsolid,
+					scalar[i].allsolid, batched[i].allsolid );
+			}
+		}
+	}
+
+	Com_Printf( "%i traces from %s on %s, batch size %i, %i iterations\n", count, filename, mapname, batchSize, iterations );
+	Com_Printf( "scalar: %.3f usec/trace\n", (double)scalarTime / ( (double)count * iterations ) );
+	Com_Printf( "batch:  %.3f usec/trace\n", (double)batchTime / ( (double)count * iterations ) );
+	Com_Printf( "%i mismatches\n", mismatches );
+
+	Z_Free( batched );
+	Z_Free( scalar );
+	Z_Free( rays );
+}
+
+
+/*
+===============================================================================
+
+AREA LOG
+
+Entity links, unlinks and area queries can be recorded to a file and
+replayed by areabench through both broadphase structures.
+
+===============================================================================
+*/
+
+#define	AREALOG_IDENT		( ('G'<<24)+('L'<<16)+('R'<<8)+'A' )
+#define	AREALOG_VERSION		1
+
+typedef struct {
+	int			ident;
+	int			version;
+	char		mapname[MAX_QPATH];
+	vec3_t		mins;		// world bounds
+	vec3_t		maxs;
+} areaLogHeader_t;
+
+typedef enum {
+	AREALOG_LINK,
+	AREALOG_UNLINK,
+	AREALOG_QUERY
+} areaLogType_t;
+
+typedef struct {
+	int			type;
+	int			num;
+	vec3_t		mins;
+	vec3_t		maxs;
+} areaLogEvent_t;
+
+static fileHandle_t areaLog = FS_INVALID_HANDLE;
+static int areaLogCount;
+
+
+/*
+==================
+SV_RecordAreaEvent
+==================
+*/
+static void SV_RecordAreaEvent( areaLogType_t type, int num, const vec3_t mins, const vec3_t maxs ) {
+	areaLogEvent_t	ev;
+
+	ev.type = type;
+	ev.num = num;
+	VectorCopy( mins, ev.mins );
+	VectorCopy( maxs, ev.maxs );
+
+	FS_Write( &ev, sizeof( ev ), areaLog );
+	areaLogCount++;
+}
+
+
+static void SV_RecordAreaLink( int num, const vec3_t absmin, const vec3_t absmax ) {
+	if ( areaLog != FS_INVALID_HANDLE ) {
+		SV_RecordAreaEvent( AREALOG_LINK, num, absmin, absmax );
+	}
+}
+
+
+static void SV_RecordAreaUnlink( int num ) {
+	if ( areaLog != FS_INVALID_HANDLE ) {
+		SV_RecordAreaEvent( AREALOG_UNLINK, num, vec3_origin, vec3_origin );
+	}
+}
+
+
+static void SV_RecordAreaQuery( const vec3_t mins, const vec3_t maxs ) {
+	if ( areaLog != FS_INVALID_HANDLE ) {
+		SV_RecordAreaEvent( AREALOG_QUERY, -1, mins, maxs );
+	}
+}
+
+
+/*
+==================
+SV_StopAreaLog
+==================
+*/
+void SV_StopAreaLog( void ) {
+	if ( areaLog != FS_INVALID_HANDLE ) {
+		FS_FCloseFile( areaLog );
+		areaLog = FS_INVALID_HANDLE;
+		Com_Printf( "Stopped area log, %i events recorded.\n", areaLogCount );
+	}
+}
+
+
+/*
+==================
+SV_AreaRecord_f
+
+Writes currently linked entities and every following
+link, unlink and area query to a file for areabench
+==================
+*/
+void SV_AreaRecord_f( void ) {
+	areaLogHeader_t header;
+	char		filename[MAX_OSPATH];
+	int			i;
+
+	if ( Cmd_Argc() != 2 ) {
+		Com_Printf( "usage: arearecord <filename>|stop\n" );
+		return;
+	}
+
+	SV_StopAreaLog();
+
+	if ( !Q_stricmp( Cmd_Argv( 1 ), "stop" ) ) {
+		return;
+	}
+
+	if ( sv.state != SS_GAME ) {
+		Com_Printf( "Server is not running.\n" );
+		return;
+	}
+
+	Q_strncpyz( filename, Cmd_Argv( 1 ), sizeof( filename ) );
+	COM_DefaultExtension( filename, sizeof( filename ), ".arl" );
+
+	areaLog = FS_FOpenFileWrite( filename );
+	if ( areaLog == FS_INVALID_HANDLE ) {
+		Com_Printf( "Couldn't open %s for writing.\n", filename );
+		return;
+	}
+
+	Com_Memset( &header, 0, sizeof( header ) );
+	header.ident = AREALOG_IDENT;
+	header.version = AREALOG_VERSION;
+	Q_strncpyz( header.mapname, sv_mapname->string, sizeof( header.mapname ) );
+	CM_ModelBounds( CM_InlineModel( 0 ), header.mins, header.maxs );
+	FS_Write( &header, sizeof( header ), areaLog );
+
+	areaLogCount = 0;
+
+	for ( i = 0; i < MAX_GENTITIES; i++ ) {
+		if ( sv_area.node[i] != -1 ) {
+			SV_RecordAreaEvent( AREALOG_LINK, i, sv_area.absmin[i], sv_area.absmax[i] );
+		}
+	}
+
+	Com_Printf( "Recording entity links and area queries to %s.\n", filename );
+}
+
+
+/*
+==================
+SV_AreaReplay
+==================
+*/
+static void SV_AreaReplay( areaIndex_t *ai, const areaLogEvent_t *events, int count ) {
+	int			list[MAX_GENTITIES];
+	int			i;
+
+	for ( i = 0; i < count; i++ ) {
+		switch ( events[i].type ) {
+		case AREALOG_LINK:
+			SV_AreaIndexUnlink( ai, events[i].num );
+			SV_AreaIndexLink( ai, events[i].num, events[i].mins, events[i].maxs );
+			break;
+		case AREALOG_UNLINK:
+			SV_AreaIndexUnlink( ai, events[i].num );
+			break;
+		default:
+			SV_AreaIndexEntities( ai, events[i].mins, events[i].maxs, list, MAX_GENTITIES, NULL );
+			break;
+		}
+	}
+}
+
+
+static int QDECL SV_AreaCompareNums( const void *a, const void *b ) {
+	return *(const int *)a - *(const int *)b;
+}
+
+
+/*
+==================
+SV_AreaBench_f
+
+Replays a recorded area log through the sector tree
+and the loose grid, compares query results and times both
+==================
+*/
+void SV_AreaBench_f( void ) {
+	static const char *typeNames[2] = { "sector tree", "loose grid" };
+	const areaLogHeader_t *header;
+	const areaLogEvent_t *events;
+	areaIndex_t	*ai[2];
+	int			list[2][MAX_GENTITIES];
+	int			num[2];
+	int64_t		tested[2], time[2], found, start;
+	char		filename[MAX_OSPATH];
+	char		mapname[MAX_QPATH];
+	vec3_t		mins, maxs;
+	void		*buffer;
+	int			len, count, queries, links, iterations;
+	int			i, t, n, mismatches;
+
+	if ( Cmd_Argc() < 2 ) {
+		Com_Printf( "usage: areabench <filename> [iterations]\n" );
+		return;
+	}
+
+	Q_strncpyz( filename, Cmd_Argv( 1 ), sizeof( filename ) );
+	COM_DefaultExtension( filename, sizeof( filename ), ".arl" );
+
+	iterations = Cmd_Argc() > 2 ? atoi( Cmd_Argv( 2 ) ) : 10;
+	if ( iterations <= 0 ) {
+		iterations = 10;
+	}
+
+	len = FS_ReadFile( filename, &buffer );
+	if ( !buffer ) {
+		Com_Printf( "Couldn't read %s.\n", filename );
+		return;
+	}
+
+	header = (const areaLogHeader_t *)buffer;
+	if ( len < (int)sizeof( *header ) || header->ident != AREALOG_IDENT || header->version != AREALOG_VERSION ) {
+		Com_Printf( "%s is not an area log.\n", filename );
+		FS_FreeFile( buffer );
+		return;
+	}
+
+	Q_strncpyz( mapname, header->mapname, sizeof( mapname ) );
+	VectorCopy( header->mins, mins );
+	VectorCopy( header->maxs, maxs );
+
+	count = ( len - (int)sizeof( *header ) ) / (int)sizeof( *events );
+	events = (const areaLogEvent_t *)( header + 1 );
+
+	for ( i = 0, queries = links = 0; i < count; i++ ) {
+		if ( (unsigned)events[i].type > AREALOG_QUERY || ( events[i].type != AREALOG_QUERY && (unsigned)events[i].num >= MAX_GENTITIES ) ) {
+			Com_Printf( "Bad event %i in %s.\n", i, filename );
+			FS_FreeFile( buffer );
+			return;
+		}
+		if ( events[i].type == AREALOG_QUERY ) {
+			queries++;
+		} else if ( events[i].type == AREALOG_LINK ) {
+			links++;
+		}
+	}
+
+	if ( !queries ) {
+		Com_Printf( "No area queries in %s.\n", filename );
+		FS_FreeFile( buffer );
+		return;
+	}
+
+	ai[0] = Z_Malloc( sizeof( areaIndex_t ) );
+	ai[1] = Z_Malloc( sizeof( areaIndex_t ) );
+	SV_InitAreaIndex( ai[0], AREA_SECTORS, mins, maxs );
+	SV_InitAreaIndex( ai[1], AREA_GRID, mins, maxs );
+
+	// both structures must return the same set of entities for each query
+	mismatches = 0;
+	found = 0;
+	tested[0] = tested[1] = 0;
+	for ( i = 0; i < count; i++ ) {
+		for ( t = 0; t < 2; t++ ) {
+			switch ( events[i].type ) {
+			case AREALOG_LINK:
+				SV_AreaIndexUnlink( ai[t], events[i].num );
+				SV_AreaIndexLink( ai[t], events[i].num, events[i].mins, events[i].maxs );
+				break;
+			case AREALOG_UNLINK:
+				SV_AreaIndexUnlink( ai[t], events[i].num );
+				break;
+			default:
+				num[t] = SV_AreaIndexEntities( ai[t], events[i].mins, events[i].maxs, list[t], MAX_GENTITIES, &n );
+				tested[t] += n;
+				qsort( list[t], num[t], sizeof( int ), SV_AreaCompareNums );
+				break;
+			}
+		}
+		if ( events[i].type == AREALOG_QUERY ) {
+			found += num[0];
+			if ( num[0] != num[1] || memcmp( list[0], list[1], num[0] * sizeof( int ) ) != 0 ) {
+				if ( mismatches++ < 8 ) {
+					Com_Printf( S_COLOR_YELLOW "mismatch at event %i: %i/%i entities\n", i, num[0], num[1] );
+				}
+			}
+		}
+	}
+
+	// interleave the passes so that clock changes affect both the same way
+	time[0] = time[1] = 0;
+	for ( n = 0; n < iterations; n++ ) {
+		for ( t = 0; t < 2; t++ ) {
+			SV_FreeAreaIndex( ai[t] );
+			SV_InitAreaIndex( ai[t], t ? AREA_GRID : AREA_SECTORS, mins, maxs );
+			start = Sys_Microseconds();
+			SV_AreaReplay( ai[t], events, count );
+			time[t] += Sys_Microseconds() - start;
+		}
+	}
+
+	Com_Printf( "%i links, %i unlinks, %i queries from %s on %s, %i iterations\n", links, count - links - queries, queries, filename, mapname, iterations );
+	for ( t = 0; t < 2; t++ ) {
+		Com_Printf( "%s: %.1f boxes tested per query, %.3f msec per replay\n", typeNames[t],
+			(double)tested[t] / queries, (double)time[t] / ( 1000.0 * iterations ) );
+	}
+	Com_Printf( "grid of %i levels, finest %ix%i cells of %.0f units\n", ai[1]->numLevels,
+		ai[1]->levels[0].size[0], ai[1]->levels[0].size[1], ai[1]->levels[0].cellSize );
+	Com_Printf( "%.1f entities found per query, %i mismatches\n", (double)found / queries, mismatches );
+
+	for ( t = 0; t < 2; t++ ) {
+		SV_FreeAreaIndex( ai[t] );
+		Z_Free( ai[t] );
+	}
+
+	FS_FreeFile( buffer );
+}
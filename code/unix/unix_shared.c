@@ -28,10 +28,13 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 #include <dirent.h>
 #include <unistd.h>
 #include <sys/mman.h>
+#include <fcntl.h>
 #include <sys/time.h>
+#include <time.h>
 #include <pwd.h>
 #include <dlfcn.h>
 #include <libgen.h>
+#include <pthread.h>
 
 #include "../qcommon/q_shared.h"
 #include "../qcommon/qcommon.h"
@@ -563,6 +566,307 @@ int Sys_LoadFunctionErrors( void )
 }
 
 
+typedef struct {
+	pthread_t	handle;
+	void		(*func)( void *param );
+	void		*param;
+} sysThread_t;
+
+typedef struct {
+	pthread_mutex_t	mutex;
+	pthread_cond_t	cond;
+	qboolean		raised;
+} sysSignal_t;
+
+
+static void *Sys_ThreadProc( void *arg )
+{
+	sysThread_t *thread = (sysThread_t *)arg;
+
+	thread->func( thread->param );
+
+	return NULL;
+}
+
+
+/*
+=================
+Sys_CreateThread
+=================
+*/
+void *Sys_CreateThread( void (*func)( void *param ), void *param )
+{
+	sysThread_t *thread;
+
+	thread = malloc( sizeof( *thread ) );
+	if ( thread == NULL )
+		return NULL;
+
+	thread->func = func;
+	thread->param = param;
+
+	if ( pthread_create( &thread->handle, NULL, Sys_ThreadProc, thread ) != 0 )
+	{
+		free( thread );
+		return NULL;
+	}
+
+	return thread;
+}
+
+
+/*
+=================
+Sys_JoinThread
+=================
+*/
+void Sys_JoinThread( void *thread )
+{
+	if ( thread == NULL )
+		return;
+
+	pthread_join( ((sysThread_t *)thread)->handle, NULL );
+	free( thread );
+}
+
+
+/*
+=================
+Sys_NumCPUs
+=================
+*/
+int Sys_NumCPUs( void )
+{
+	long n = sysconf( _SC_NPROCESSORS_ONLN );
+
+	if ( n < 1 )
+		return 1;
+
+	return (int)n;
+}
+
+
+/*
+=================
+Sys_CreateMutex
+=================
+*/
+void *Sys_CreateMutex( void )
+{
+	pthread_mutex_t *mutex;
+
+	mutex = malloc( sizeof( *mutex ) );
+	if ( mutex == NULL )
+		return NULL;
+
+	pthread_mutex_init( mutex, NULL );
+
+	return mutex;
+}
+
+
+void Sys_DestroyMutex( void *mutex )
+{
+	if ( mutex == NULL )
+		return;
+
+	pthread_mutex_destroy( (pthread_mutex_t *)mutex );
+	free( mutex );
+}
+
+
+void Sys_LockMutex( void *mutex )
+{
+	pthread_mutex_lock( (pthread_mutex_t *)mutex );
+}
+
+
+void Sys_UnlockMutex( void *mutex )
+{
+	pthread_mutex_unlock( (pthread_mutex_t *)mutex );
+}
+
+
+/*
+=================
+Sys_CreateSignal
+=================
+*/
+void *Sys_CreateSignal( void )
+{
+	sysSignal_t *signal;
+
+	signal = malloc( sizeof( *signal ) );
+	if ( signal == NULL )
+		return NULL;
+
+	pthread_mutex_init( &signal->mutex, NULL );
+	pthread_cond_init( &signal->cond, NULL );
+	signal->raised = qfalse;
+
+	return signal;
+}
+
+
+void Sys_DestroySignal( void *signal )
+{
+	sysSignal_t *s = (sysSignal_t *)signal;
+
+	if ( s == NULL )
+		return;
+
+	pthread_cond_destroy( &s->cond );
+	pthread_mutex_destroy( &s->mutex );
+	free( s );
+}
+
+
+void Sys_RaiseSignal( void *signal )
+{
+	sysSignal_t *s = (sysSignal_t *)signal;
+
+	pthread_mutex_lock( &s->mutex );
+	s->raised = qtrue;
+	pthread_cond_signal( &s->cond );
+	pthread_mutex_unlock( &s->mutex );
+}
+
+
+qboolean Sys_WaitSignal( void *signal, int msec )
+{
+	sysSignal_t *s = (sysSignal_t *)signal;
+	struct timespec ts;
+	qboolean raised;
+
+	clock_gettime( CLOCK_REALTIME, &ts );
+	ts.tv_sec += msec / 1000;
+	ts.tv_nsec += ( msec % 1000 ) * 1000000L;
+	if ( ts.tv_nsec >= 1000000000L )
+	{
+		ts.tv_sec++;
+		ts.tv_nsec -= 1000000000L;
+	}
+
+	pthread_mutex_lock( &s->mutex );
+	while ( !s->raised )
+	{
+		if ( pthread_cond_timedwait( &s->cond, &s->mutex, &ts ) != 0 )
+			break;
+	}
+	raised = s->raised;
+	s->raised = qfalse;
+	pthread_mutex_unlock( &s->mutex );
+
+	return raised;
+}
+
+
+/*
+=================
+Sys_MapFile
+=================
+*/
+const void *Sys_MapFile( const char *ospath, fileOffset_t *size )
+{
+	struct stat st;
+	void *data;
+	int fd;
+
+	*size = 0;
+
+	fd = open( ospath, O_RDONLY );
+	if ( fd == -1 )
+		return NULL;
+
+	if ( fstat( fd, &st ) == -1 || st.st_size <= 0 )
+	{
+		close( fd );
+		return NULL;
+	}
+
+	data = mmap( NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+	close( fd );
+
+	if ( data == MAP_FAILED )
+		return NULL;
+
+	*size = st.st_size;
+	return data;
+}
+
+
+/*
+=================
+Sys_UnmapFile
+=================
+*/
+void Sys_UnmapFile( const void *data, fileOffset_t size )
+{
+	if ( data != NULL )
+		munmap( (void *)data, size );
+}
+
+
+/*
+=================
+Sys_MapFileRange
+=================
+*/
+void *Sys_MapFileRange( const char *ospath, fileOffset_t offset, int length )
+{
+	struct stat st;
+	fileOffset_t base;
+	byte *data;
+	long page;
+	int fd;
+
+	if ( offset < 0 || length <= 0 )
+		return NULL;
+
+	fd = open( ospath, O_RDONLY );
+	if ( fd == -1 )
+		return NULL;
+
+	// pages past the end of file can't be accessed
+	if ( fstat( fd, &st ) == -1 || offset + length > st.st_size )
+	{
+		close( fd );
+		return NULL;
+	}
+
+	page = sysconf( _SC_PAGESIZE );
+	base = offset - offset % page;
+
+	data = mmap( NULL, length + ( offset - base ), PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, base );
+	close( fd );
+
+	if ( data == MAP_FAILED )
+		return NULL;
+
+	return data + ( offset - base );
+}
+
+
+/*
+=================
+Sys_UnmapFileRange
+=================
+*/
+void Sys_UnmapFileRange( void *data, int length )
+{
+	long page;
+	byte *base;
+
+	if ( data == NULL )
+		return;
+
+	page = sysconf( _SC_PAGESIZE );
+	base = (byte *)data - (intptr_t)data % page;
+
+	munmap( base, length + ( (byte *)data - base ) );
+}
+
+
 /*
 =================
 Sys_SetAffinityMask
@@ -240,3 +240,264 @@ void Sys_SetAffinityMask( int mask )
 	}
 }
 #endif // USE_AFFINITY_MASK
+
+
+typedef struct {
+	HANDLE		handle;
+	void		(*func)( void *param );
+	void		*param;
+} sysThread_t;
+
+
+static DWORD WINAPI Sys_ThreadProc( LPVOID arg )
+{
+	sysThread_t *thread = (sysThread_t *)arg;
+
+	thread->func( thread->param );
+
+	return 0;
+}
+
+
+/*
+================
+Sys_CreateThread
+================
+*/
+void *Sys_CreateThread( void (*func)( void *param ), void *param )
+{
+	sysThread_t *thread;
+
+	thread = malloc( sizeof( *thread ) );
+	if ( thread == NULL )
+		return NULL;
+
+	thread->func = func;
+	thread->param = param;
+	thread->handle = CreateThread( NULL, 0, Sys_ThreadProc, thread, 0, NULL );
+
+	if ( thread->handle == NULL ) {
+		free( thread );
+		return NULL;
+	}
+
+	return thread;
+}
+
+
+/*
+================
+Sys_JoinThread
+================
+*/
+void Sys_JoinThread( void *thread )
+{
+	sysThread_t *t = (sysThread_t *)thread;
+
+	if ( t == NULL )
+		return;
+
+	WaitForSingleObject( t->handle, INFINITE );
+	CloseHandle( t->handle );
+	free( t );
+}
+
+
+/*
+================
+Sys_NumCPUs
+================
+*/
+int Sys_NumCPUs( void )
+{
+	SYSTEM_INFO info;
+
+	GetSystemInfo( &info );
+
+	if ( info.dwNumberOfProcessors < 1 )
+		return 1;
+
+	return (int)info.dwNumberOfProcessors;
+}
+
+
+/*
+================
+Sys_CreateMutex
+================
+*/
+void *Sys_CreateMutex( void )
+{
+	CRITICAL_SECTION *cs;
+
+	cs = malloc( sizeof( *cs ) );
+	if ( cs == NULL )
+		return NULL;
+
+	InitializeCriticalSection( cs );
+
+	return cs;
+}
+
+
+void Sys_DestroyMutex( void *mutex )
+{
+	if ( mutex == NULL )
+		return;
+
+	DeleteCriticalSection( (CRITICAL_SECTION *)mutex );
+	free( mutex );
+}
+
+
+void Sys_LockMutex( void *mutex )
+{
+	EnterCriticalSection( (CRITICAL_SECTION *)mutex );
+}
+
+
+void Sys_UnlockMutex( void *mutex )
+{
+	LeaveCriticalSection( (CRITICAL_SECTION *)mutex );
+}
+
+
+/*
+================
+Sys_CreateSignal
+================
+*/
+void *Sys_CreateSignal( void )
+{
+	return CreateEvent( NULL, FALSE, FALSE, NULL );
+}
+
+
+void Sys_DestroySignal( void *signal )
+{
+	if ( signal != NULL )
+		CloseHandle( (HANDLE)signal );
+}
+
+
+void Sys_RaiseSignal( void *signal )
+{
+	SetEvent( (HANDLE)signal );
+}
+
+
+qboolean Sys_WaitSignal( void *signal, int msec )
+{
+	return WaitForSingleObject( (HANDLE)signal, msec ) == WAIT_OBJECT_0 ? qtrue : qfalse;
+}
+
+
+/*
+================
+Sys_MapFile
+================
+*/
+const void *Sys_MapFile( const char *ospath, fileOffset_t *size )
+{
+	LARGE_INTEGER len;
+	HANDLE file, mapping;
+	void *data;
+
+	*size = 0;
+
+	file = CreateFileA( ospath, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL );
+	if ( file == INVALID_HANDLE_VALUE )
+		return NULL;
+
+	if ( !GetFileSizeEx( file, &len ) || len.QuadPart <= 0 )
+	{
+		CloseHandle( file );
+		return NULL;
+	}
+
+	mapping = CreateFileMappingA( file, NULL, PAGE_READONLY, 0, 0, NULL );
+	CloseHandle( file );
+	if ( mapping == NULL )
+		return NULL;
+
+	// view keeps the mapping alive
+	data = MapViewOfFile( mapping, FILE_MAP_READ, 0, 0, 0 );
+	CloseHandle( mapping );
+	if ( data == NULL )
+		return NULL;
+
+	*size = len.QuadPart;
+	return data;
+}
+
+
+/*
+================
+Sys_UnmapFile
+================
+*/
+void Sys_UnmapFile( const void *data, fileOffset_t size )
+{
+	if ( data != NULL )
+		UnmapViewOfFile( data );
+}
+
+
+/*
+================
+Sys_MapFileRange
+================
+*/
+void *Sys_MapFileRange( const char *ospath, fileOffset_t offset, int length )
+{
+	SYSTEM_INFO info;
+	LARGE_INTEGER len, base;
+	HANDLE file, mapping;
+	byte *data;
+
+	if ( offset < 0 || length <= 0 )
+		return NULL;
+
+	file = CreateFileA( ospath, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL );
+	if ( file == INVALID_HANDLE_VALUE )
+		return NULL;
+
+	if ( !GetFileSizeEx( file, &len ) || offset + length > len.QuadPart )
+	{
+		CloseHandle( file );
+		return NULL;
+	}
+
+	mapping = CreateFileMappingA( file, NULL, PAGE_WRITECOPY, 0, 0, NULL );
+	CloseHandle( file );
+	if ( mapping == NULL )
+		return NULL;
+
+	// views must start at allocation granularity
+	GetSystemInfo( &info );
+	base.QuadPart = offset - offset % info.dwAllocationGranularity;
+
+	data = MapViewOfFile( mapping, FILE_MAP_COPY, base.HighPart, base.LowPart, length + ( offset - base.QuadPart ) );
+	CloseHandle( mapping );
+	if ( data == NULL )
+		return NULL;
+
+	return data + ( offset - base.QuadPart );
+}
+
+
+/*
+================
+Sys_UnmapFileRange
+================
+*/
+void Sys_UnmapFileRange( void *data, int length )
+{
+	SYSTEM_INFO info;
+
+	if ( data == NULL )
+		return;
+
+	GetSystemInfo( &info );
+	UnmapViewOfFile( (byte *)data - (uintptr_t)data % info.dwAllocationGranularity );
+}